@@ -0,0 +1,98 @@
+#pragma once
+#include <DirectXMath.h>
+
+/*
+	Compact storage for affine transforms. The last column of an
+	affine 4x4 matrix is always (0, 0, 0, 1) so only the first three
+	columns are kept, each one stored as a row of four floats. This
+	is the layout XMLoadFloat3x4 and XMStoreFloat3x4 use and the same
+	bytes a shader reads as a row_major float3x4
+*/
+typedef DirectX::XMFLOAT3X4 AffineMatrix;
+
+/// <summary>
+/// Expand an affine matrix into a full matrix for general math
+/// </summary>
+inline DirectX::XMMATRIX AffineLoad(const AffineMatrix& a)
+{
+	return DirectX::XMLoadFloat3x4(&a);
+}
+
+/// <summary>
+/// Store a full matrix, dropping its last column
+/// </summary>
+inline void AffineStore(AffineMatrix* out, DirectX::FXMMATRIX m)
+{
+	DirectX::XMStoreFloat3x4(out, m);
+}
+
+/// <summary>
+/// Expand an affine matrix into a 4x4 for code that
+/// still expects one
+/// </summary>
+inline DirectX::XMFLOAT4X4 AffineToFloat4x4(const AffineMatrix& a)
+{
+	DirectX::XMFLOAT4X4 m;
+	DirectX::XMStoreFloat4x4(&m, DirectX::XMLoadFloat3x4(&a));
+	return m;
+}
+
+/// <summary>
+/// Same as a * b on the full matrices, so a is applied first.
+/// Out may not be either of the inputs
+/// </summary>
+inline void AffineMultiply(AffineMatrix* out, const AffineMatrix& a, const AffineMatrix& b)
+{
+	using namespace DirectX;
+
+	XMVECTOR a0 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(a.m[0]));
+	XMVECTOR a1 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(a.m[1]));
+	XMVECTOR a2 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(a.m[2]));
+	XMVECTOR onlyW = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+	// Each stored row is a column of the full matrix. The hidden
+	// (0, 0, 0, 1) column of a only ever adds b's translation
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		XMVECTOR bi = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(b.m[i]));
+
+		XMVECTOR row = XMVectorMultiply(XMVectorSplatX(bi), a0);
+		row = XMVectorMultiplyAdd(XMVectorSplatY(bi), a1, row);
+		row = XMVectorMultiplyAdd(XMVectorSplatZ(bi), a2, row);
+		row = XMVectorMultiplyAdd(bi, onlyW, row);
+
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out->m[i]), row);
+	}
+}
+
+/// <summary>
+/// Inverse transpose of a scale * rotation * translation matrix
+/// without a general inverse. Only valid for matrices without
+/// shear, which every local transform is. Translation is dropped
+/// since normals never use it
+/// </summary>
+inline void AffineInverseTranspose(AffineMatrix* out, const AffineMatrix& a)
+{
+	using namespace DirectX;
+
+	XMVECTOR a0 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(a.m[0]));
+	XMVECTOR a1 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(a.m[1]));
+	XMVECTOR a2 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(a.m[2]));
+
+	// Axis i of the matrix is rotation row i times scale i, so dividing
+	// it by its squared length leaves rotation row i over scale i.
+	// The axes are spread across the stored rows so one component of
+	// each stored row belongs to each axis
+	XMVECTOR lengthSq = XMVectorMultiply(a0, a0);
+	lengthSq = XMVectorMultiplyAdd(a1, a1, lengthSq);
+	lengthSq = XMVectorMultiplyAdd(a2, a2, lengthSq);
+
+	// Collapsed axes stay collapsed instead of becoming infinite
+	XMVECTOR hasLength = XMVectorGreater(lengthSq, XMVectorReplicate(1e-12f));
+	XMVECTOR inverseLengthSq = XMVectorSelect(XMVectorZero(), XMVectorReciprocal(lengthSq), hasLength);
+	inverseLengthSq = XMVectorSetW(inverseLengthSq, 0.0f);
+
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out->m[0]), XMVectorMultiply(a0, inverseLengthSq));
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out->m[1]), XMVectorMultiply(a1, inverseLengthSq));
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out->m[2]), XMVectorMultiply(a2, inverseLengthSq));
+}
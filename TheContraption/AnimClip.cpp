@@ -0,0 +1,562 @@
+#include "AnimClip.h"
+#include "ThreadPool.h"
+#include "Material.h"
+#include "MorphAnimator.h"
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+using namespace DirectX;
+
+#pragma region CLIP
+
+AnimClip::AnimClip(float duration, bool looping) :
+	duration(std::max(duration, 0.0f)),
+	looping(looping),
+	partCount(0),
+	tracksLocked(false)
+{
+}
+
+AnimClip::~AnimClip()
+{
+
+}
+
+unsigned int AnimClip::AddTrack(unsigned int part, int type)
+{
+	// Playing instances have a cursor per track already, and
+	// the compressed copy only has the tracks it was made from
+	if (tracksLocked || compressed)
+		return CLIP_TRACK_NONE;
+
+	ClipTrack track = {};
+	track.part = part;
+	track.type = type;
+	track.pendingHandle = false;
+	tracks.push_back(track);
+
+	partCount = std::max(partCount, part + 1);
+	return (unsigned int)tracks.size() - 1;
+}
+
+void AnimClip::LockTracks()
+{
+	tracksLocked = true;
+}
+
+void AnimClip::AddKey(unsigned int track, float time, DirectX::XMFLOAT4 value, int interpolation)
+{
+	if (track >= tracks.size())
+		return;
+
+	PushKey(tracks[track], time, XMLoadFloat4(&value), XMVectorZero(), XMVectorZero(), interpolation);
+}
+
+void AnimClip::AddHermiteKey(unsigned int track, float time, DirectX::XMFLOAT4 value, DirectX::XMFLOAT4 inTangent, DirectX::XMFLOAT4 outTangent)
+{
+	if (track >= tracks.size())
+		return;
+
+	PushKey(tracks[track], time, XMLoadFloat4(&value), XMLoadFloat4(&inTangent), XMLoadFloat4(&outTangent), CLIP_KEY_HERMITE);
+}
+
+void AnimClip::AddBezierKey(unsigned int track, float time, DirectX::XMFLOAT4 value, DirectX::XMFLOAT4 inHandle, DirectX::XMFLOAT4 outHandle)
+{
+	if (track >= tracks.size())
+		return;
+
+	ClipTrack& clipTrack = tracks[track];
+	XMVECTOR keyValue = XMLoadFloat4(&value);
+
+	// A cubic Bezier leaves its end points at three times the
+	// slope towards their handles, over the length of the segment
+	XMVECTOR inTangent = XMVectorZero();
+	if (!clipTrack.times.empty() && time > clipTrack.times.back())
+	{
+		inTangent = (keyValue - XMLoadFloat4(&inHandle)) * (3.0f / (time - clipTrack.times.back()));
+	}
+
+	float side = PushKey(clipTrack, time, keyValue, inTangent, XMVectorZero(), CLIP_KEY_HERMITE);
+
+	// The out tangent waits for the next key
+	clipTrack.pendingHandle = true;
+	XMStoreFloat4(&clipTrack.outHandle, (XMLoadFloat4(&outHandle) - keyValue) * side);
+}
+
+float AnimClip::PushKey(ClipTrack& track, float time, XMVECTOR value, XMVECTOR inTangent, XMVECTOR outTangent, int interpolation)
+{
+	float side = 1.0f;
+	if (compressed)
+		return side;
+
+	if (!track.times.empty())
+	{
+		// Keys only ever go forward in time
+		time = std::max(time, track.times.back());
+
+		// A quaternion and its negative are the same rotation, blending
+		// between opposite ones would take the long way around
+		if (track.type == CLIP_TRACK_ROTATION &&
+			XMVectorGetX(XMVector4Dot(XMLoadFloat4(&track.values.back()), value)) < 0.0f)
+		{
+			side = -1.0f;
+			value = -value;
+			inTangent = -inTangent;
+			outTangent = -outTangent;
+		}
+
+		if (track.pendingHandle)
+		{
+			float length = time - track.times.back();
+			XMVECTOR previousOut = length > 0.0f ? XMLoadFloat4(&track.outHandle) * (3.0f / length) : XMVectorZero();
+			XMStoreFloat4(&track.outTangents.back(), previousOut);
+			track.pendingHandle = false;
+		}
+	}
+
+	XMFLOAT4 key, keyIn, keyOut;
+	XMStoreFloat4(&key, value);
+	XMStoreFloat4(&keyIn, inTangent);
+	XMStoreFloat4(&keyOut, outTangent);
+
+	track.times.push_back(time);
+	track.values.push_back(key);
+	track.inTangents.push_back(keyIn);
+	track.outTangents.push_back(keyOut);
+	track.interpolations.push_back((unsigned char)interpolation);
+	return side;
+}
+
+DirectX::XMFLOAT4 AnimClip::Sample(unsigned int track, float time, unsigned int& cursor) const
+{
+	XMFLOAT4 result;
+	XMStoreFloat4(&result, compressed ? compressed->Sample(track, time) : Evaluate(tracks[track], time, cursor));
+	return result;
+}
+
+void AnimClip::SampleBatch(const float* times, unsigned int* cursors, DirectX::XMFLOAT4* results, unsigned int count) const
+{
+	// Compressed clips find their frames from the time alone
+	if (compressed)
+	{
+		compressed->SampleBatch(times, results, count);
+		return;
+	}
+
+	unsigned int trackCount = (unsigned int)tracks.size();
+	for (unsigned int t = 0; t < trackCount; t++)
+	{
+		const ClipTrack& track = tracks[t];
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int slot = i * trackCount + t;
+			XMStoreFloat4(&results[slot], Evaluate(track, times[i], cursors[slot]));
+		}
+	}
+}
+
+void AnimClip::Compress(float maxError, Skeleton* skeleton)
+{
+	if (compressed)
+		return;
+
+	compressed = CompressedClip::Compress(*this, maxError, skeleton);
+
+	// Only what each track animates is still needed
+	for (unsigned int t = 0; t < tracks.size(); t++)
+	{
+		ClipTrack& track = tracks[t];
+		std::vector<float>().swap(track.times);
+		std::vector<XMFLOAT4>().swap(track.values);
+		std::vector<XMFLOAT4>().swap(track.inTangents);
+		std::vector<XMFLOAT4>().swap(track.outTangents);
+		std::vector<unsigned char>().swap(track.interpolations);
+		track.pendingHandle = false;
+	}
+}
+
+bool AnimClip::IsCompressed()
+{
+	return compressed != nullptr;
+}
+
+ClipCompressionStats AnimClip::GetCompressionStats()
+{
+	return compressed ? compressed->GetStats() : ClipCompressionStats();
+}
+
+unsigned int AnimClip::GetMemorySize()
+{
+	size_t size = sizeof(AnimClip) + tracks.size() * sizeof(ClipTrack);
+	if (compressed)
+		return (unsigned int)size + compressed->GetMemorySize();
+
+	for (unsigned int t = 0; t < tracks.size(); t++)
+	{
+		size += tracks[t].times.size() * (sizeof(float) + 3 * sizeof(XMFLOAT4) + sizeof(unsigned char));
+	}
+	return (unsigned int)size;
+}
+
+unsigned int AnimClip::Seek(const ClipTrack& track, float time, unsigned int cursor)
+{
+	// Cursors name the key a segment starts at, the last key starts none
+	unsigned int lastSegment = (unsigned int)track.times.size() - 2;
+	cursor = std::min(cursor, lastSegment);
+
+	// Playing forward lands in the same segment or one just after it
+	if (time >= track.times[cursor])
+	{
+		for (unsigned int step = 0; step <= CLIP_CURSOR_SCAN; step++)
+		{
+			if (cursor == lastSegment || time < track.times[cursor + 1])
+				return cursor;
+			cursor++;
+		}
+	}
+
+	// Jumped or wrapped around, look it up
+	unsigned int after = (unsigned int)(std::upper_bound(track.times.begin(), track.times.end(), time) - track.times.begin());
+	return after == 0 ? 0 : std::min(after - 1, lastSegment);
+}
+
+DirectX::XMVECTOR AnimClip::Evaluate(const ClipTrack& track, float time, unsigned int& cursor)
+{
+	size_t keyCount = track.times.size();
+	if (keyCount == 0)
+		return track.type == CLIP_TRACK_ROTATION ? XMQuaternionIdentity() : XMVectorZero();
+	if (keyCount == 1)
+		return XMLoadFloat4(&track.values[0]);
+
+	unsigned int key = cursor = Seek(track, time, cursor);
+	float start = track.times[key];
+	float end = track.times[key + 1];
+
+	// Before the first key and after the last hold them
+	if (time <= start)
+		return XMLoadFloat4(&track.values[key]);
+	if (time >= end)
+		return XMLoadFloat4(&track.values[key + 1]);
+
+	XMVECTOR from = XMLoadFloat4(&track.values[key]);
+	XMVECTOR to = XMLoadFloat4(&track.values[key + 1]);
+	float length = end - start;
+	float s = (time - start) / length;
+
+	XMVECTOR value;
+	switch (track.interpolations[key])
+	{
+	case CLIP_KEY_STEP:
+		return from;
+	case CLIP_KEY_LINEAR:
+		value = XMVectorLerp(from, to, s);
+		break;
+	default:
+	{
+		// Hermite basis, tangents are per second so they scale with the segment
+		float s2 = s * s;
+		float s3 = s2 * s;
+		XMVECTOR outTangent = XMLoadFloat4(&track.outTangents[key]);
+		XMVECTOR inTangent = XMLoadFloat4(&track.inTangents[key + 1]);
+		value =
+			from * (2.0f * s3 - 3.0f * s2 + 1.0f) +
+			outTangent * ((s3 - 2.0f * s2 + s) * length) +
+			to * (3.0f * s2 - 2.0f * s3) +
+			inTangent * ((s3 - s2) * length);
+		break;
+	}
+	}
+
+	// Blended quaternions are only rotations again once they're unit length
+	if (track.type == CLIP_TRACK_ROTATION)
+		value = XMQuaternionNormalize(value);
+	return value;
+}
+
+float AnimClip::GetDuration()
+{
+	return duration;
+}
+
+bool AnimClip::IsLooping()
+{
+	return looping;
+}
+
+unsigned int AnimClip::GetTrackCount()
+{
+	return (unsigned int)tracks.size();
+}
+
+unsigned int AnimClip::GetTrackPart(unsigned int track)
+{
+	return tracks[track].part;
+}
+
+int AnimClip::GetTrackType(unsigned int track)
+{
+	return tracks[track].type;
+}
+
+unsigned int AnimClip::GetPartCount()
+{
+	return partCount;
+}
+
+#pragma endregion
+
+#pragma region PLAYER
+
+AnimClipPlayer::AnimClipPlayer() :
+	instanceCount(0),
+	lastUpdateTime(0.0f)
+{
+}
+
+AnimClipPlayer::~AnimClipPlayer()
+{
+
+}
+
+unsigned int AnimClipPlayer::Play(std::shared_ptr<AnimClip> clip, const std::vector<ClipBinding>& parts, float speed)
+{
+	// Few clips play at once, so finding their group is a short walk
+	unsigned int groupIndex = 0;
+	while (groupIndex < groups.size() && groups[groupIndex].clip != clip)
+	{
+		groupIndex++;
+	}
+	if (groupIndex == groups.size())
+	{
+		groups.push_back(ClipGroup());
+		groups.back().clip = clip;
+	}
+	ClipGroup& group = groups[groupIndex];
+	clip->LockTracks();
+
+	unsigned int id;
+	if (!freeIds.empty())
+	{
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+	else
+	{
+		id = (unsigned int)slots.size();
+		slots.push_back({ CLIP_NONE, 0 });
+	}
+
+	unsigned int index = (unsigned int)group.ids.size();
+	group.ids.push_back(id);
+	group.times.push_back(0.0f);
+	group.speeds.push_back(speed);
+	group.finished.push_back(0);
+
+	unsigned int trackCount = clip->GetTrackCount();
+	group.cursors.resize(group.cursors.size() + trackCount, 0);
+	group.results.resize(group.results.size() + trackCount, XMFLOAT4(0, 0, 0, 0));
+
+	unsigned int partCount = clip->GetPartCount();
+	for (unsigned int p = 0; p < partCount; p++)
+	{
+		ClipBinding binding = p < parts.size() ? parts[p] : ClipBinding();
+		group.handles.push_back(binding.transform ? binding.transform->GetHandle() : CLIP_NONE);
+		group.bindings.push_back(binding);
+	}
+
+	slots[id].group = groupIndex;
+	slots[id].index = index;
+	instanceCount++;
+	return id;
+}
+
+void AnimClipPlayer::Stop(unsigned int id)
+{
+	if (!IsPlaying(id))
+		return;
+
+	RemoveInstance(slots[id].group, slots[id].index);
+}
+
+bool AnimClipPlayer::IsPlaying(unsigned int id)
+{
+	return id < slots.size() && slots[id].group != CLIP_NONE;
+}
+
+void AnimClipPlayer::SetTime(unsigned int id, float time)
+{
+	if (!IsPlaying(id))
+		return;
+
+	groups[slots[id].group].times[slots[id].index] = time;
+}
+
+float AnimClipPlayer::GetTime(unsigned int id)
+{
+	if (!IsPlaying(id))
+		return 0.0f;
+
+	return groups[slots[id].group].times[slots[id].index];
+}
+
+void AnimClipPlayer::UpdateClips(float deltaTime)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (unsigned int g = 0; g < groups.size(); g++)
+	{
+		ClipGroup& group = groups[g];
+		unsigned int count = (unsigned int)group.ids.size();
+		if (count == 0)
+			continue;
+
+		// Sampling only touches the group's own arrays, so it can be
+		// split between threads. Writing into what they drive can't
+		ThreadPool::GetInstance().ParallelFor(count, CLIP_MIN_BATCH_SIZE, [&](unsigned int first, unsigned int last)
+		{
+			EvaluateInstances(group, deltaTime, first, last);
+		});
+		ApplyGroup(group);
+
+		// Walk backwards so whatever is swapped into a removed
+		// instance's place has already been checked
+		for (unsigned int i = count; i-- > 0;)
+		{
+			if (group.finished[i])
+				RemoveInstance(g, i);
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	lastUpdateTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+unsigned int AnimClipPlayer::GetInstanceCount()
+{
+	return instanceCount;
+}
+
+float AnimClipPlayer::GetLastUpdateTime()
+{
+	return lastUpdateTime;
+}
+
+#pragma endregion
+
+#pragma region INSTANCES
+
+void AnimClipPlayer::EvaluateInstances(ClipGroup& group, float deltaTime, unsigned int first, unsigned int last)
+{
+	AnimClip& clip = *group.clip;
+	float duration = clip.GetDuration();
+	bool looping = clip.IsLooping();
+
+	for (unsigned int i = first; i < last; i++)
+	{
+		float time = group.times[i] + deltaTime * group.speeds[i];
+		if (looping && duration > 0.0f)
+		{
+			time = fmodf(time, duration);
+			time = time < 0.0f ? time + duration : time;
+		}
+		else if (time >= duration || time < 0.0f)
+		{
+			// Played to the end (or back to the start), land exactly on it
+			time = time < 0.0f ? 0.0f : duration;
+			group.finished[i] = 1;
+		}
+		group.times[i] = time;
+	}
+
+	unsigned int trackCount = clip.GetTrackCount();
+	clip.SampleBatch(&group.times[first], &group.cursors[(size_t)first * trackCount], &group.results[(size_t)first * trackCount], last - first);
+}
+
+void AnimClipPlayer::ApplyGroup(ClipGroup& group)
+{
+	TransformPool& pool = TransformPool::GetInstance();
+	AnimClip& clip = *group.clip;
+	unsigned int trackCount = clip.GetTrackCount();
+	unsigned int partCount = clip.GetPartCount();
+
+	for (unsigned int t = 0; t < trackCount; t++)
+	{
+		unsigned int part = clip.GetTrackPart(t);
+		int type = clip.GetTrackType(t);
+
+		for (unsigned int i = 0; i < group.ids.size(); i++)
+		{
+			const XMFLOAT4& result = group.results[(size_t)i * trackCount + t];
+			size_t binding = (size_t)i * partCount + part;
+			unsigned int handle = group.handles[binding];
+
+			switch (type)
+			{
+			case CLIP_TRACK_POSITION:
+				if (handle != CLIP_NONE)
+					pool.SetPosition(handle, XMFLOAT3(result.x, result.y, result.z));
+				break;
+			case CLIP_TRACK_ROTATION:
+				if (handle != CLIP_NONE)
+					pool.SetRotation(handle, result);
+				break;
+			case CLIP_TRACK_SCALE:
+				if (handle != CLIP_NONE)
+					pool.SetScale(handle, XMFLOAT3(result.x, result.y, result.z));
+				break;
+			case CLIP_TRACK_TINT:
+				if (group.bindings[binding].material)
+					group.bindings[binding].material->SetTint(result);
+				break;
+			case CLIP_TRACK_LIGHT_INTENSITY:
+				if (group.bindings[binding].light)
+					group.bindings[binding].light->intensity = result.x;
+				break;
+			case CLIP_TRACK_MORPH_WEIGHT:
+			{
+				const ClipBinding& morph = group.bindings[binding];
+				if (morph.morphAnimator)
+					morph.morphAnimator->SetWeight(morph.morphInstance, morph.morphTarget, result.x);
+				break;
+			}
+			}
+		}
+	}
+}
+
+void AnimClipPlayer::RemoveInstance(unsigned int groupIndex, unsigned int index)
+{
+	ClipGroup& group = groups[groupIndex];
+	unsigned int trackCount = group.clip->GetTrackCount();
+	unsigned int partCount = group.clip->GetPartCount();
+
+	slots[group.ids[index]].group = CLIP_NONE;
+	freeIds.push_back(group.ids[index]);
+
+	unsigned int last = (unsigned int)group.ids.size() - 1;
+	if (index != last)
+	{
+		group.ids[index] = group.ids[last];
+		group.times[index] = group.times[last];
+		group.speeds[index] = group.speeds[last];
+		group.finished[index] = group.finished[last];
+		std::copy_n(group.cursors.begin() + (size_t)last * trackCount, trackCount, group.cursors.begin() + (size_t)index * trackCount);
+		std::copy_n(group.results.begin() + (size_t)last * trackCount, trackCount, group.results.begin() + (size_t)index * trackCount);
+		std::move(group.bindings.begin() + (size_t)last * partCount, group.bindings.begin() + (size_t)(last + 1) * partCount, group.bindings.begin() + (size_t)index * partCount);
+		std::copy_n(group.handles.begin() + (size_t)last * partCount, partCount, group.handles.begin() + (size_t)index * partCount);
+
+		slots[group.ids[index]].index = index;
+	}
+
+	group.ids.pop_back();
+	group.times.pop_back();
+	group.speeds.pop_back();
+	group.finished.pop_back();
+	group.cursors.resize((size_t)last * trackCount);
+	group.results.resize((size_t)last * trackCount);
+	group.bindings.resize((size_t)last * partCount);
+	group.handles.resize((size_t)last * partCount);
+	instanceCount--;
+}
+
+#pragma endregion
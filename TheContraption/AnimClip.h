@@ -0,0 +1,288 @@
+#pragma once
+#include <memory>
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Transform.h"
+#include "Lights.h"
+#include "CompressedClip.h"
+
+class Material;
+class MorphAnimator;
+
+/*
+	Keyframed animation clips. A clip holds any number of
+	tracks, each one keying a single property of one part
+	(a transform, a material, a light or a morph target). Clips are shared,
+	every instance playing one only keeps its own time and
+	a cursor per track, so playing forward finds the current
+	key in constant time instead of searching every frame
+*/
+
+// What a track animates
+#define CLIP_TRACK_POSITION 0
+#define CLIP_TRACK_ROTATION 1			// Quaternion
+#define CLIP_TRACK_SCALE 2
+#define CLIP_TRACK_TINT 3				// Material color tint
+#define CLIP_TRACK_LIGHT_INTENSITY 4	// Only x is used
+#define CLIP_TRACK_MORPH_WEIGHT 5		// Weight of one morph target, only x is used
+#define CLIP_TRACK_TYPE_COUNT 6
+
+// How a key blends into the next one
+#define CLIP_KEY_STEP 0		// Holds its value until the next key
+#define CLIP_KEY_LINEAR 1
+#define CLIP_KEY_HERMITE 2	// Cubic through the key's out tangent and the next key's in tangent
+
+// Keys a cursor steps forward through before it gives up and
+// binary searches, enough for any frame that isn't a jump
+#define CLIP_CURSOR_SCAN 4
+
+// Instances of one clip that are sampled on one thread,
+// below it handing work to other threads costs more than it saves
+#define CLIP_MIN_BATCH_SIZE 256
+
+// Instance id that never refers to a playing clip
+#define CLIP_NONE 0xffffffff
+
+// Track index AddTrack gives back once tracks can't be added
+#define CLIP_TRACK_NONE 0xffffffff
+
+
+class AnimClip
+{
+public:
+	/// <summary>
+	/// Make an empty clip
+	/// </summary>
+	/// <param name="duration">Length in seconds, keys past it are never reached</param>
+	/// <param name="looping">Whether instances wrap around instead of finishing</param>
+	AnimClip(float duration, bool looping = false);
+	~AnimClip();
+
+	/// <summary>
+	/// Add a track that animates one property of a part. Tracks
+	/// can't be added once the clip has played or been compressed
+	/// </summary>
+	/// <param name="part">Which of the parts bound when playing it drives</param>
+	/// <param name="type">CLIP_TRACK define of what to animate</param>
+	/// <returns>Index of the track for adding keys, or CLIP_TRACK_NONE</returns>
+	unsigned int AddTrack(unsigned int part, int type);
+	/// <summary>
+	/// Stop tracks from being added. Called by anything that sizes
+	/// per instance state from the track count when it plays the clip
+	/// </summary>
+	void LockTracks();
+
+	/// <summary>
+	/// Add a key with flat tangents, so Hermite keys ease in and out of it.
+	/// Keys have to be added in time order
+	/// </summary>
+	/// <param name="interpolation">CLIP_KEY define of how to reach the next key</param>
+	void AddKey(unsigned int track, float time, DirectX::XMFLOAT4 value, int interpolation = CLIP_KEY_HERMITE);
+	/// <summary>
+	/// Add a Hermite key with tangents in units per second
+	/// </summary>
+	void AddHermiteKey(unsigned int track, float time, DirectX::XMFLOAT4 value, DirectX::XMFLOAT4 inTangent, DirectX::XMFLOAT4 outTangent);
+	/// <summary>
+	/// Add a key with Bezier handles. The in handle is a third of the way
+	/// back to the previous key and the out handle a third of the way on
+	/// to the next one, which is how they become Hermite tangents
+	/// </summary>
+	void AddBezierKey(unsigned int track, float time, DirectX::XMFLOAT4 value, DirectX::XMFLOAT4 inHandle, DirectX::XMFLOAT4 outHandle);
+
+	/// <summary>
+	/// Sample one track. The cursor is the key the last sample fell after,
+	/// start it at 0 and keep it between calls
+	/// </summary>
+	DirectX::XMFLOAT4 Sample(unsigned int track, float time, unsigned int& cursor) const;
+	/// <summary>
+	/// Sample every track of many instances, one track at a time so its
+	/// keys stay in cache. Cursors and results are per instance, per track
+	/// </summary>
+	/// <param name="times">Time of each instance</param>
+	/// <param name="cursors">GetTrackCount() cursors per instance</param>
+	/// <param name="results">GetTrackCount() results per instance</param>
+	void SampleBatch(const float* times, unsigned int* cursors, DirectX::XMFLOAT4* results, unsigned int count) const;
+
+	/// <summary>
+	/// Swap every track's keys for a compressed copy of them, see
+	/// CompressedClip. Samples come straight from the compressed
+	/// data afterwards and keys can no longer be added
+	/// </summary>
+	/// <param name="maxError">How far, in world units, anything it moves may end up from where the keys put it</param>
+	/// <param name="skeleton">Skeleton whose joints are the clip's parts, if any</param>
+	void Compress(float maxError = CLIP_COMPRESSION_MAX_ERROR, Skeleton* skeleton = nullptr);
+	bool IsCompressed();
+	/// <summary>
+	/// What compressing did, all zero if it hasn't been compressed
+	/// </summary>
+	ClipCompressionStats GetCompressionStats();
+	/// <summary>
+	/// Bytes used by the keys, or by the compressed copy once compressed
+	/// </summary>
+	unsigned int GetMemorySize();
+
+	float GetDuration();
+	bool IsLooping();
+	unsigned int GetTrackCount();
+	unsigned int GetTrackPart(unsigned int track);
+	int GetTrackType(unsigned int track);
+	/// <summary>
+	/// Amount of parts an instance has to bind, one past the highest track part
+	/// </summary>
+	unsigned int GetPartCount();
+
+private:
+	/// <summary>
+	/// Every key of one property, kept in separate arrays so
+	/// finding the current key only walks the times
+	/// </summary>
+	struct ClipTrack
+	{
+		unsigned int part;
+		int type;
+
+		std::vector<float> times;
+		std::vector<DirectX::XMFLOAT4> values;
+		std::vector<DirectX::XMFLOAT4> inTangents;
+		std::vector<DirectX::XMFLOAT4> outTangents;
+		std::vector<unsigned char> interpolations;
+
+		// How far the last key's out handle is from its value, turned
+		// into a tangent once the next key says how long the segment is
+		bool pendingHandle;
+		DirectX::XMFLOAT4 outHandle;
+	};
+
+	/// <summary>
+	/// Append a key, keeping rotations on the same side as the last one
+	/// </summary>
+	/// <returns>-1 if the key was flipped to the other side, otherwise 1</returns>
+	float PushKey(ClipTrack& track, float time, DirectX::XMVECTOR value, DirectX::XMVECTOR inTangent, DirectX::XMVECTOR outTangent, int interpolation);
+	/// <summary>
+	/// Move a cursor onto the key a time falls after
+	/// </summary>
+	static unsigned int Seek(const ClipTrack& track, float time, unsigned int cursor);
+	static DirectX::XMVECTOR Evaluate(const ClipTrack& track, float time, unsigned int& cursor);
+
+	std::vector<ClipTrack> tracks;
+	float duration;
+	bool looping;
+	unsigned int partCount;
+	bool tracksLocked;
+
+	std::shared_ptr<CompressedClip> compressed;
+};
+
+
+/// <summary>
+/// What one part of a clip drives when it plays. Tracks
+/// whose binding is empty are sampled but not applied
+/// </summary>
+struct ClipBinding
+{
+	std::shared_ptr<Transform> transform;
+	std::shared_ptr<Material> material;
+	std::shared_ptr<Light> light;
+
+	// Morph weight tracks drive one target of one morphed instance
+	std::shared_ptr<MorphAnimator> morphAnimator;
+	unsigned int morphInstance;
+	unsigned int morphTarget;
+};
+
+
+class AnimClipPlayer
+{
+public:
+	AnimClipPlayer();
+	~AnimClipPlayer();
+
+	/// <summary>
+	/// Start playing a clip from its beginning
+	/// </summary>
+	/// <param name="parts">What each part of the clip drives, GetPartCount() of them</param>
+	/// <param name="speed">How fast time passes for this instance</param>
+	/// <returns>Id of the instance, valid until it finishes or is stopped</returns>
+	unsigned int Play(std::shared_ptr<AnimClip> clip, const std::vector<ClipBinding>& parts, float speed = 1.0f);
+	/// <summary>
+	/// Stop an instance, leaving everything it drives where it is
+	/// </summary>
+	void Stop(unsigned int id);
+	bool IsPlaying(unsigned int id);
+	/// <summary>
+	/// Jump an instance to a time. The next update searches for its keys once
+	/// </summary>
+	void SetTime(unsigned int id, float time);
+	float GetTime(unsigned int id);
+
+	/// <summary>
+	/// Advance, sample and apply every playing instance. Instances of
+	/// clips that don't loop land on their last frame and are removed
+	/// </summary>
+	void UpdateClips(float deltaTime);
+
+	/// <summary>
+	/// Amount of instances currently playing
+	/// </summary>
+	unsigned int GetInstanceCount();
+	/// <summary>
+	/// How long the last update took in milliseconds
+	/// </summary>
+	float GetLastUpdateTime();
+
+private:
+	/// <summary>
+	/// Every playing instance of the same clip
+	/// </summary>
+	struct ClipGroup
+	{
+		std::shared_ptr<AnimClip> clip;
+
+		// Per instance
+		std::vector<unsigned int> ids;
+		std::vector<float> times;
+		std::vector<float> speeds;
+		std::vector<unsigned char> finished;
+
+		// Per instance, per track
+		std::vector<unsigned int> cursors;
+		std::vector<DirectX::XMFLOAT4> results;
+
+		// Per instance, per part
+		std::vector<ClipBinding> bindings;
+		std::vector<unsigned int> handles;	// Transform pool handles
+	};
+
+	/// <summary>
+	/// Where an instance lives
+	/// </summary>
+	struct ClipSlot
+	{
+		unsigned int group;
+		unsigned int index;
+	};
+
+	/// <summary>
+	/// Advance and sample a range of instances within a group
+	/// </summary>
+	void EvaluateInstances(ClipGroup& group, float deltaTime, unsigned int first, unsigned int last);
+	/// <summary>
+	/// Write a group's sampled values into what its instances drive
+	/// </summary>
+	void ApplyGroup(ClipGroup& group);
+	/// <summary>
+	/// Swap the last instance of a group into a removed one's place
+	/// </summary>
+	void RemoveInstance(unsigned int groupIndex, unsigned int index);
+
+	std::vector<ClipGroup> groups;
+	/// <summary>
+	/// Indexed by instance id, freed ids are reused
+	/// </summary>
+	std::vector<ClipSlot> slots;
+	std::vector<unsigned int> freeIds;
+
+	unsigned int instanceCount;
+	float lastUpdateTime;
+};
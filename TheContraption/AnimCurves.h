@@ -33,6 +33,9 @@
 #define EASE_OUT_BOUNCE 28
 #define EASE_IN_OUT_BOUNCE 29
 
+// How many curve types there are
+#define EASE_CURVE_COUNT 30
+
 const float PI = 3.14159265358979323846f;
 
 
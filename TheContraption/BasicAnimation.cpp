@@ -1,11 +1,26 @@
 #include "BasicAnimation.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
 using namespace DirectX;
 
+// Shortest an animation may last, so progress never divides by zero
+#define TWEEN_MIN_DURATION 1e-6f
+
 #pragma region MANAGER
 
-BasicAnimationManager::BasicAnimationManager()
+BasicAnimationManager::BasicAnimationManager() :
+	animationCount(0),
+	lastUpdateTime(0.0f),
+	easeMode(EASE_MODE_EXACT)
 {
-
+	groups.resize(TWEEN_CHANNEL_COUNT * (EASE_CURVE_COUNT + 1));
+	for (unsigned int i = 0; i < groups.size(); i++)
+	{
+		groups[i].curveType = (int)(i % (EASE_CURVE_COUNT + 1));
+		groups[i].channel = (int)(i / (EASE_CURVE_COUNT + 1));
+		groups[i].count = 0;
+	}
 }
 
 BasicAnimationManager::~BasicAnimationManager()
@@ -13,61 +28,412 @@ BasicAnimationManager::~BasicAnimationManager()
 
 }
 
-void BasicAnimationManager::AddAnimation(std::shared_ptr<Transform> target, DirectX::XMFLOAT3 start, DirectX::XMFLOAT3 end, float time, int curveType)
+void BasicAnimationManager::AddAnimation(std::shared_ptr<Transform> target, DirectX::XMFLOAT3 start, DirectX::XMFLOAT3 end, float time, int curveType, int channel)
+{
+	if (channel < 0 || channel >= TWEEN_CHANNEL_COUNT)
+		return;
+
+	unsigned int handle = target->GetHandle();
+	RemoveSlot(GetSlot(handle, channel));
+
+	unsigned int curveIndex = curveType >= 0 && curveType < EASE_CURVE_COUNT ? (unsigned int)curveType : EASE_CURVE_COUNT;
+	unsigned int groupIndex = channel * (EASE_CURVE_COUNT + 1) + curveIndex;
+	TweenGroup& group = groups[groupIndex];
+
+	// Grow a whole batch at a time so the last batch can always be loaded
+	if (group.count == group.targets.size())
+	{
+		size_t size = group.count + TWEEN_BATCH_WIDTH;
+		group.targets.resize(size, 0);
+		group.startX.resize(size, 0.0f); group.startY.resize(size, 0.0f); group.startZ.resize(size, 0.0f);
+		group.endX.resize(size, 0.0f); group.endY.resize(size, 0.0f); group.endZ.resize(size, 0.0f);
+		group.timer.resize(size, 0.0f);
+		group.duration.resize(size, 1.0f);
+		group.progress.resize(size, 0.0f);
+		group.valueX.resize(size, 0.0f); group.valueY.resize(size, 0.0f); group.valueZ.resize(size, 0.0f); group.valueW.resize(size, 0.0f);
+		group.owners.resize(size);
+	}
+
+	unsigned int i = group.count++;
+	group.targets[i] = handle;
+	group.startX[i] = start.x; group.startY[i] = start.y; group.startZ[i] = start.z;
+	group.endX[i] = end.x; group.endY[i] = end.y; group.endZ[i] = end.z;
+	group.timer[i] = 0.0f;
+	group.duration[i] = std::max(time, TWEEN_MIN_DURATION);
+	group.owners[i] = target;
+
+	TweenSlot& slot = GetSlot(handle, channel);
+	slot.group = groupIndex;
+	slot.index = i;
+	animationCount++;
+}
+
+void BasicAnimationManager::StopAnimation(std::shared_ptr<Transform> target)
 {
-	animations[target] = std::make_shared<AnimDetails>(
-		target,
-		start,
-		end,
-		time,
-		curveType);
+	unsigned int handle = target->GetHandle();
+	for (unsigned int channel = 0; channel < TWEEN_CHANNEL_COUNT; channel++)
+	{
+		RemoveSlot(GetSlot(handle, channel));
+	}
+}
+
+void BasicAnimationManager::AddPathAnimation(std::shared_ptr<Transform> target, std::shared_ptr<SplinePath> path, float time, int curveType, bool followPath)
+{
+	if (!path)
+		return;
+
+	unsigned int handle = target->GetHandle();
+	RemoveSlot(GetSlot(handle, TWEEN_CHANNEL_POSITION));
+	if (followPath)
+		RemoveSlot(GetSlot(handle, TWEEN_CHANNEL_ROTATION));
+
+	// Same path and curve share a group, otherwise an emptied one is reused
+	unsigned int groupIndex = (unsigned int)pathGroups.size();
+	for (unsigned int g = 0; g < pathGroups.size() && groupIndex == pathGroups.size(); g++)
+	{
+		if (pathGroups[g].path == path && pathGroups[g].curveType == curveType)
+			groupIndex = g;
+	}
+	for (unsigned int g = 0; g < pathGroups.size() && groupIndex == pathGroups.size(); g++)
+	{
+		if (!pathGroups[g].path)
+			groupIndex = g;
+	}
+	if (groupIndex == pathGroups.size())
+		pathGroups.push_back(PathGroup());
+
+	PathGroup& group = pathGroups[groupIndex];
+	group.path = path;
+	group.curveType = curveType;
+
+	// Grow a whole batch at a time so the last batch can always be loaded
+	if (group.count == group.targets.size())
+	{
+		size_t size = group.count + TWEEN_BATCH_WIDTH;
+		group.targets.resize(size, 0);
+		group.followPath.resize(size, 0);
+		group.timer.resize(size, 0.0f);
+		group.duration.resize(size, 1.0f);
+		group.progress.resize(size, 0.0f);
+		group.distance.resize(size, 0.0f);
+		group.positions.resize(size, XMFLOAT3(0, 0, 0));
+		group.directions.resize(size, XMFLOAT3(0, 0, 1));
+		group.rotations.resize(size, XMFLOAT4(0, 0, 0, 1));
+		group.owners.resize(size);
+	}
+
+	unsigned int i = group.count++;
+	group.targets[i] = handle;
+	group.followPath[i] = followPath ? 1 : 0;
+	group.timer[i] = 0.0f;
+	group.duration[i] = std::max(time, TWEEN_MIN_DURATION);
+	group.owners[i] = target;
+
+	TweenSlot& slot = GetSlot(handle, TWEEN_CHANNEL_POSITION);
+	slot.group = groupIndex | TWEEN_PATH_GROUP;
+	slot.index = i;
+	if (followPath)
+		GetSlot(handle, TWEEN_CHANNEL_ROTATION) = { groupIndex | TWEEN_PATH_GROUP, i };
+	animationCount++;
 }
 
 void BasicAnimationManager::UpdateAnimations(float deltaTime)
 {
-	// Iterate through animations 
-	for (auto anim = animations.begin(); anim != animations.end(); ++anim) {
-		
-		if (anim->second->animFinished)
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (unsigned int g = 0; g < groups.size(); g++)
+	{
+		TweenGroup& group = groups[g];
+		if (group.count == 0)
+			continue;
+
+		// Evaluating only touches the group's own arrays, so it can be
+		// split between threads. Writing into the transform pool can't
+		unsigned int batchCount = (group.count + TWEEN_BATCH_WIDTH - 1) / TWEEN_BATCH_WIDTH;
+		ThreadPool::GetInstance().ParallelFor(batchCount, TWEEN_MIN_BATCH_SIZE / TWEEN_BATCH_WIDTH, [&](unsigned int firstBatch, unsigned int lastBatch)
+		{
+			EvaluateBatches(group, deltaTime, firstBatch, lastBatch);
+		});
+		ApplyGroup(group);
+
+		// Walk backwards so whatever is swapped into a removed
+		// tween's place has already been checked
+		for (unsigned int i = group.count; i-- > 0;)
 		{
-			// Animation is no longer in use 
-			animations.erase(anim);
-			return;
+			if (group.progress[i] >= 1.0f)
+				RemoveTween(g, i);
 		}
+	}
+
+	for (unsigned int g = 0; g < pathGroups.size(); g++)
+	{
+		PathGroup& group = pathGroups[g];
+		if (group.count == 0)
+			continue;
 
-		anim->second->UpdateAnimation(deltaTime);
+		unsigned int batchCount = (group.count + TWEEN_BATCH_WIDTH - 1) / TWEEN_BATCH_WIDTH;
+		ThreadPool::GetInstance().ParallelFor(batchCount, TWEEN_MIN_BATCH_SIZE / TWEEN_BATCH_WIDTH, [&](unsigned int firstBatch, unsigned int lastBatch)
+		{
+			EvaluatePathBatches(group, deltaTime, firstBatch, lastBatch);
+		});
+		ApplyPathGroup(group);
+
+		for (unsigned int i = group.count; i-- > 0;)
+		{
+			if (group.progress[i] >= 1.0f)
+				RemovePathTween(g, i);
+		}
 	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	lastUpdateTime = std::chrono::duration<float, std::milli>(end - start).count();
 }
 
 bool BasicAnimationManager::IsRunningAnimations()
 {
-	return animations.size() != 0;
+	return animationCount != 0;
+}
+
+unsigned int BasicAnimationManager::GetAnimationCount()
+{
+	return animationCount;
+}
+
+float BasicAnimationManager::GetLastUpdateTime()
+{
+	return lastUpdateTime;
+}
+
+void BasicAnimationManager::SetEaseMode(int easeMode)
+{
+	(*this).easeMode = easeMode >= 0 && easeMode < EASE_MODE_COUNT ? easeMode : EASE_MODE_EXACT;
+}
+
+int BasicAnimationManager::GetEaseMode()
+{
+	return easeMode;
 }
 
 #pragma endregion
 
-AnimDetails::AnimDetails(std::shared_ptr<Transform> target, DirectX::XMFLOAT3 start, DirectX::XMFLOAT3 end, float time, int curveType):
-	target(target), start(start), end(end), totalTime(time), curveType(curveType)
+#pragma region TWEENS
+
+void BasicAnimationManager::EvaluateBatches(TweenGroup& group, float deltaTime, unsigned int firstBatch, unsigned int lastBatch)
+{
+	EaseFunction curve = GetEaseFunction(group.curveType, easeMode);
+	XMVECTOR delta = XMVectorReplicate(deltaTime);
+	XMVECTOR one = XMVectorSplatOne();
+
+	for (unsigned int b = firstBatch; b < lastBatch; b++)
+	{
+		// Each vector holds the same value of four
+		// different tweens (one per lane)
+		unsigned int first = b * TWEEN_BATCH_WIDTH;
+		XMFLOAT4* timer = reinterpret_cast<XMFLOAT4*>(&group.timer[first]);
+		XMVECTOR time = XMLoadFloat4(timer) + delta;
+		XMVECTOR progress = XMVectorMin(time / XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&group.duration[first])), one);
+		XMStoreFloat4(timer, time);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&group.progress[first]), progress);
+
+		// Every lane uses the same curve, only the curve itself is scalar
+		alignas(16) float eased[TWEEN_BATCH_WIDTH];
+		for (unsigned int lane = 0; lane < TWEEN_BATCH_WIDTH; lane++)
+		{
+			eased[lane] = curve(group.progress[first + lane]);
+		}
+		XMVECTOR t = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(eased));
+
+		// Unclamped Lerp, the back and elastic curves overshoot on purpose
+		XMVECTOR startX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&group.startX[first]));
+		XMVECTOR startY = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&group.startY[first]));
+		XMVECTOR startZ = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&group.startZ[first]));
+		XMVECTOR endX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&group.endX[first]));
+		XMVECTOR endY = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&group.endY[first]));
+		XMVECTOR endZ = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&group.endZ[first]));
+		XMVECTOR valueX = XMVectorMultiplyAdd(endX - startX, t, startX);
+		XMVECTOR valueY = XMVectorMultiplyAdd(endY - startY, t, startY);
+		XMVECTOR valueZ = XMVectorMultiplyAdd(endZ - startZ, t, startZ);
+
+		if (group.channel == TWEEN_CHANNEL_ROTATION)
+		{
+			// Pitch, yaw and roll to a quaternion, matching XMQuaternionRotationRollPitchYaw
+			XMVECTOR half = XMVectorReplicate(0.5f);
+			XMVECTOR sinPitch, cosPitch, sinYaw, cosYaw, sinRoll, cosRoll;
+			XMVectorSinCos(&sinPitch, &cosPitch, valueX * half);
+			XMVectorSinCos(&sinYaw, &cosYaw, valueY * half);
+			XMVectorSinCos(&sinRoll, &cosRoll, valueZ * half);
+
+			XMVECTOR w = cosYaw * cosPitch * cosRoll + sinYaw * sinPitch * sinRoll;
+			valueX = cosYaw * sinPitch * cosRoll + sinYaw * cosPitch * sinRoll;
+			valueY = sinYaw * cosPitch * cosRoll - cosYaw * sinPitch * sinRoll;
+			valueZ = cosYaw * cosPitch * sinRoll - sinYaw * sinPitch * cosRoll;
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&group.valueW[first]), w);
+		}
+
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&group.valueX[first]), valueX);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&group.valueY[first]), valueY);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&group.valueZ[first]), valueZ);
+	}
+}
+
+void BasicAnimationManager::ApplyGroup(TweenGroup& group)
 {
-	timer = 0.0f;
-	animFinished = false;
+	TransformPool& pool = TransformPool::GetInstance();
+	switch (group.channel)
+	{
+	case TWEEN_CHANNEL_POSITION:
+		for (unsigned int i = 0; i < group.count; i++)
+		{
+			pool.SetPosition(group.targets[i], XMFLOAT3(group.valueX[i], group.valueY[i], group.valueZ[i]));
+		}
+		break;
+	case TWEEN_CHANNEL_ROTATION:
+		for (unsigned int i = 0; i < group.count; i++)
+		{
+			pool.SetRotation(group.targets[i], XMFLOAT4(group.valueX[i], group.valueY[i], group.valueZ[i], group.valueW[i]));
+		}
+		break;
+	case TWEEN_CHANNEL_SCALE:
+		for (unsigned int i = 0; i < group.count; i++)
+		{
+			pool.SetScale(group.targets[i], XMFLOAT3(group.valueX[i], group.valueY[i], group.valueZ[i]));
+		}
+		break;
+	}
 }
 
-void AnimDetails::UpdateAnimation(float deltaTime)
+void BasicAnimationManager::RemoveTween(unsigned int groupIndex, unsigned int index)
 {
-	if (timer > totalTime)
+	TweenGroup& group = groups[groupIndex];
+	GetSlot(group.targets[index], group.channel).group = TWEEN_NONE;
+
+	unsigned int last = --group.count;
+	if (index != last)
 	{
-		animFinished = true;
+		group.targets[index] = group.targets[last];
+		group.startX[index] = group.startX[last]; group.startY[index] = group.startY[last]; group.startZ[index] = group.startZ[last];
+		group.endX[index] = group.endX[last]; group.endY[index] = group.endY[last]; group.endZ[index] = group.endZ[last];
+		group.timer[index] = group.timer[last];
+		group.duration[index] = group.duration[last];
+		group.progress[index] = group.progress[last];
+		group.valueX[index] = group.valueX[last]; group.valueY[index] = group.valueY[last]; group.valueZ[index] = group.valueZ[last]; group.valueW[index] = group.valueW[last];
+		group.owners[index] = std::move(group.owners[last]);
+
+		GetSlot(group.targets[index], group.channel).index = index;
+	}
+	group.owners[last].reset();
+	animationCount--;
+}
+
+void BasicAnimationManager::RemoveSlot(TweenSlot slot)
+{
+	if (slot.group == TWEEN_NONE)
 		return;
+
+	if (slot.group & TWEEN_PATH_GROUP)
+		RemovePathTween(slot.group & ~TWEEN_PATH_GROUP, slot.index);
+	else
+		RemoveTween(slot.group, slot.index);
+}
+
+BasicAnimationManager::TweenSlot& BasicAnimationManager::GetSlot(unsigned int handle, unsigned int channel)
+{
+	// Transform handles are small and reused, so a flat array covers them
+	size_t slot = (size_t)handle * TWEEN_CHANNEL_COUNT + channel;
+	if (slot >= slots.size())
+		slots.resize(slot + 1, { TWEEN_NONE, 0 });
+
+	return slots[slot];
+}
+
+#pragma endregion
+
+#pragma region PATHS
+
+void BasicAnimationManager::EvaluatePathBatches(PathGroup& group, float deltaTime, unsigned int firstBatch, unsigned int lastBatch)
+{
+	EaseFunction curve = GetEaseFunction(group.curveType, easeMode);
+	XMVECTOR delta = XMVectorReplicate(deltaTime);
+	XMVECTOR one = XMVectorSplatOne();
+
+	for (unsigned int b = firstBatch; b < lastBatch; b++)
+	{
+		unsigned int first = b * TWEEN_BATCH_WIDTH;
+		XMFLOAT4* timer = reinterpret_cast<XMFLOAT4*>(&group.timer[first]);
+		XMVECTOR time = XMLoadFloat4(timer) + delta;
+		XMVECTOR progress = XMVectorMin(time / XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&group.duration[first])), one);
+		XMStoreFloat4(timer, time);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&group.progress[first]), progress);
+
+		for (unsigned int lane = 0; lane < TWEEN_BATCH_WIDTH; lane++)
+		{
+			group.distance[first + lane] = curve(group.progress[first + lane]);
+		}
 	}
 
-	DirectX::XMFLOAT3 current;
-	DirectX::XMStoreFloat3(
-		&current,
-		DirectX::XMLoadFloat3(&start) + (DirectX::XMLoadFloat3(&end) - DirectX::XMLoadFloat3(&start)) * GetCurveByIndex(curveType, timer / totalTime));	// Unclamped Lerp 
-	target->SetPosition(current);
+	// The whole range goes through the path's table in one go
+	unsigned int first = firstBatch * TWEEN_BATCH_WIDTH;
+	unsigned int count = (lastBatch - firstBatch) * TWEEN_BATCH_WIDTH;
+	group.path->SampleBatch(&group.distance[first], count, &group.positions[first], &group.directions[first]);
+
+	// Forward along the path, kept as level as the path allows
+	XMVECTOR worldUp = XMVectorSet(0, 1, 0, 0);
+	for (unsigned int i = first; i < first + count; i++)
+	{
+		// Where the path stops dead it has no direction, the last rotation stays
+		XMVECTOR forward = XMLoadFloat3(&group.directions[i]);
+		if (!group.followPath[i] || XMVectorGetX(XMVector3LengthSq(forward)) < 0.5f)
+			continue;
+
+		XMVECTOR right = XMVector3Cross(worldUp, forward);
+		right = XMVectorGetX(XMVector3LengthSq(right)) > 1e-6f ? XMVector3Normalize(right) : XMVectorSet(1, 0, 0, 0);
+		XMVECTOR up = XMVector3Cross(forward, right);
+		XMMATRIX basis(right, up, forward, XMVectorSet(0, 0, 0, 1));
+		XMStoreFloat4(&group.rotations[i], XMQuaternionRotationMatrix(basis));
+	}
+}
 
-	timer += deltaTime;
+void BasicAnimationManager::ApplyPathGroup(PathGroup& group)
+{
+	TransformPool& pool = TransformPool::GetInstance();
+	for (unsigned int i = 0; i < group.count; i++)
+	{
+		pool.SetPosition(group.targets[i], group.positions[i]);
+		if (group.followPath[i])
+			pool.SetRotation(group.targets[i], group.rotations[i]);
+	}
 }
 
+void BasicAnimationManager::RemovePathTween(unsigned int groupIndex, unsigned int index)
+{
+	PathGroup& group = pathGroups[groupIndex];
+	GetSlot(group.targets[index], TWEEN_CHANNEL_POSITION).group = TWEEN_NONE;
+	if (group.followPath[index])
+		GetSlot(group.targets[index], TWEEN_CHANNEL_ROTATION).group = TWEEN_NONE;
 
+	unsigned int last = --group.count;
+	if (index != last)
+	{
+		group.targets[index] = group.targets[last];
+		group.followPath[index] = group.followPath[last];
+		group.timer[index] = group.timer[last];
+		group.duration[index] = group.duration[last];
+		group.progress[index] = group.progress[last];
+		group.distance[index] = group.distance[last];
+		group.positions[index] = group.positions[last];
+		group.directions[index] = group.directions[last];
+		group.rotations[index] = group.rotations[last];
+		group.owners[index] = std::move(group.owners[last]);
+
+		GetSlot(group.targets[index], TWEEN_CHANNEL_POSITION).index = index;
+		if (group.followPath[index])
+			GetSlot(group.targets[index], TWEEN_CHANNEL_ROTATION).index = index;
+	}
+	group.owners[last].reset();
+	animationCount--;
+
+	if (group.count == 0)
+		group.path.reset();
+}
+
+#pragma endregion
@@ -2,42 +2,42 @@
 #include <memory>
 #include <DirectXMath.h>
 #include <vector>
-#include <unordered_map>
 
 #include "Transform.h"
-#include "AnimCurves.h"
+#include "EaseLut.h"
+#include "SplinePath.h"
 
 /*
 	Purpose of this file is to allow simple animation
-	translation controls for the user by managing it 
-	for us here
+	translation controls for the user by managing it
+	for us here.
+
+	Tweens are kept in contiguous arrays (structure of arrays)
+	with one set of arrays per easing curve and channel, so a
+	whole group is advanced and blended four at a time without
+	looking up its curve or channel per tween. Path animations
+	are grouped the same way by path and curve, so a group's
+	eased progress goes through its path's table in one batch
 */
 
+// Which part of the transform a tween drives
+#define TWEEN_CHANNEL_POSITION 0
+#define TWEEN_CHANNEL_ROTATION 1	// Euler angles in radians, like Transform::SetEulerRotation
+#define TWEEN_CHANNEL_SCALE 2
+#define TWEEN_CHANNEL_COUNT 3
 
+// How many tweens are advanced together in one SIMD batch
+#define TWEEN_BATCH_WIDTH 4
 
-/// <summary>
-/// Used to manage translation data
-/// </summary>
-struct AnimDetails
-{
-public:
-	AnimDetails(std::shared_ptr<Transform> target, DirectX::XMFLOAT3 start, DirectX::XMFLOAT3 end, float time, int curveType);
-	void UpdateAnimation(float deltaTime);
+// Groups with fewer tweens than this are updated on one thread,
+// below it handing work to other threads costs more than it saves
+#define TWEEN_MIN_BATCH_SIZE 32768
 
-	bool animFinished;
-private:
-	std::shared_ptr<Transform> target;
-	DirectX::XMFLOAT3 start;
-	DirectX::XMFLOAT3 end;
+// Lookup entry of a transform channel with nothing animating it
+#define TWEEN_NONE 0xffffffff
 
-	// Type of animation curve which is used in the AnimCurves file 
-	int curveType;
-
-	// How much times has passed since starting this animation 
-	float timer;
-	// Total amount of time for animtion 
-	float totalTime;
-};
+// Set on a lookup entry's group when it's a path group
+#define TWEEN_PATH_GROUP 0x80000000
 
 
 class BasicAnimationManager
@@ -47,30 +47,159 @@ public:
 	~BasicAnimationManager();
 
 	/// <summary>
-	///  Add a simple translation animation to this manager to organize 
+	/// Add a simple animation to this manager to organize. A transform
+	/// runs one animation per channel, adding another replaces it
 	/// </summary>
-	void AddAnimation(std::shared_ptr<Transform> target, DirectX::XMFLOAT3 start, DirectX::XMFLOAT3 end, float time, int curveType);
+	/// <param name="curveType">See AnimCurves.h for defines</param>
+	/// <param name="channel">TWEEN_CHANNEL define of what to animate</param>
+	void AddAnimation(std::shared_ptr<Transform> target, DirectX::XMFLOAT3 start, DirectX::XMFLOAT3 end, float time, int curveType, int channel = TWEEN_CHANNEL_POSITION);
 	/// <summary>
-	/// Updates all active animation's held by this manager 
+	/// Move a transform along a path at a constant speed, with the curve
+	/// easing how far along it is. Runs on the position channel, and
+	/// on the rotation channel too when it follows the path
+	/// </summary>
+	/// <param name="curveType">See AnimCurves.h for defines. Overshooting curves
+	/// go around closed paths and hold at the ends of open ones</param>
+	/// <param name="followPath">Whether to turn the transform's forward (+z) along the path</param>
+	void AddPathAnimation(std::shared_ptr<Transform> target, std::shared_ptr<SplinePath> path, float time, int curveType, bool followPath = false);
+	/// <summary>
+	/// Stop every animation running on a transform, leaving it where it is
+	/// </summary>
+	void StopAnimation(std::shared_ptr<Transform> target);
+	/// <summary>
+	/// Updates all active animation's held by this manager. Finished
+	/// animations land exactly on their end value and are removed
 	/// </summary>
 	void UpdateAnimations(float deltaTime);
 	/// <summary>
-	/// Whether or not this manager is running any animations 
+	/// Whether or not this manager is running any animations
 	/// </summary>
 	/// <returns></returns>
 	bool IsRunningAnimations();
 
-	//void RemoveAnimation(std::shared_ptr<DirectX::XMFLOAT3> target);
+	/// <summary>
+	/// Amount of animations currently running
+	/// </summary>
+	unsigned int GetAnimationCount();
+	/// <summary>
+	/// How long the last update took in milliseconds
+	/// </summary>
+	float GetLastUpdateTime();
+
+	/// <summary>
+	/// How every animation's curve is evaluated, exactly or from its table
+	/// </summary>
+	/// <param name="easeMode">EASE_MODE define, see EaseLut.h</param>
+	void SetEaseMode(int easeMode);
+	int GetEaseMode();
 
-	/*
-		Possible future functions:
-		StopAnimation(int index)
-		StopAnimation(target)
-	*/
 private:
 	/// <summary>
-	/// Hold all currently active animation 
+	/// Every animation that eases with the same curve on the same channel
+	/// </summary>
+	struct TweenGroup
+	{
+		int curveType;
+		int channel;
+		unsigned int count;
+
+		// Per tween data, sized to a multiple of TWEEN_BATCH_WIDTH
+		std::vector<unsigned int> targets;	// Transform pool handles
+		std::vector<float> startX, startY, startZ;
+		std::vector<float> endX, endY, endZ;
+		std::vector<float> timer;
+		std::vector<float> duration;
+
+		// Results of the last update, rotations are already quaternions
+		std::vector<float> progress;
+		std::vector<float> valueX, valueY, valueZ, valueW;
+
+		// Keeps the targets alive, never touched while updating
+		std::vector<std::shared_ptr<Transform>> owners;
+	};
+
+	/// <summary>
+	/// Every path animation along the same path with the same curve
+	/// </summary>
+	struct PathGroup
+	{
+		std::shared_ptr<SplinePath> path;	// Released once the group empties, so it can be reused
+		int curveType;
+		unsigned int count;
+
+		// Per tween data, sized to a multiple of TWEEN_BATCH_WIDTH
+		std::vector<unsigned int> targets;	// Transform pool handles
+		std::vector<unsigned char> followPath;
+		std::vector<float> timer;
+		std::vector<float> duration;
+
+		// Results of the last update
+		std::vector<float> progress;
+		std::vector<float> distance;	// Eased progress, the fraction of the path's length
+		std::vector<DirectX::XMFLOAT3> positions;
+		std::vector<DirectX::XMFLOAT3> directions;
+		std::vector<DirectX::XMFLOAT4> rotations;	// Only of tweens following the path
+
+		// Keeps the targets alive, never touched while updating
+		std::vector<std::shared_ptr<Transform>> owners;
+	};
+
+	/// <summary>
+	/// Where the animation of one channel of a transform lives
+	/// </summary>
+	struct TweenSlot
+	{
+		unsigned int group;
+		unsigned int index;
+	};
+
+	/// <summary>
+	/// Advance, ease and blend a range of batches within a group
+	/// </summary>
+	void EvaluateBatches(TweenGroup& group, float deltaTime, unsigned int firstBatch, unsigned int lastBatch);
+	/// <summary>
+	/// Write a group's blended values into the transform pool
+	/// </summary>
+	void ApplyGroup(TweenGroup& group);
+	/// <summary>
+	/// Swap the last tween of a group into a removed one's place
+	/// </summary>
+	void RemoveTween(unsigned int groupIndex, unsigned int index);
+	/// <summary>
+	/// Advance, ease and sample a range of batches within a path group
+	/// </summary>
+	void EvaluatePathBatches(PathGroup& group, float deltaTime, unsigned int firstBatch, unsigned int lastBatch);
+	/// <summary>
+	/// Write a path group's positions, and rotations of tweens following it, into the transform pool
+	/// </summary>
+	void ApplyPathGroup(PathGroup& group);
+	/// <summary>
+	/// Swap the last tween of a path group into a removed one's place
 	/// </summary>
-	std::unordered_map <std::shared_ptr<Transform>, std::shared_ptr<AnimDetails>> animations;
+	void RemovePathTween(unsigned int groupIndex, unsigned int index);
+	/// <summary>
+	/// Remove whatever animation a lookup entry points at, tween or path
+	/// </summary>
+	void RemoveSlot(TweenSlot slot);
+	TweenSlot& GetSlot(unsigned int handle, unsigned int channel);
+
+	/// <summary>
+	/// One group per channel and curve type, plus one per
+	/// channel for unknown curves
+	/// </summary>
+	std::vector<TweenGroup> groups;
+	/// <summary>
+	/// Made as paths are used, emptied groups are reused
+	/// </summary>
+	std::vector<PathGroup> pathGroups;
+	/// <summary>
+	/// Indexed by transform handle and channel so replacing and
+	/// stopping animations never has to search
+	/// </summary>
+	std::vector<TweenSlot> slots;
+
+	unsigned int animationCount;
+	float lastUpdateTime;
+	int easeMode;
 };
 
@@ -71,8 +71,10 @@ void Camera::Update(float dt)
 		float yDiff = *mouseLookSpeed.get() * input.GetMouseYDelta();
 		// roate camera 
 
-		transform->RotateEuler( yDiff * *mouseLookSpeed.get(), 0, 0);
-		transform->RotateEuler(0, xDiff * *mouseLookSpeed.get(), 0);
+		// Pitch around the camera's own right and yaw around the
+		// world up so the horizon never tilts
+		transform->RotateLocal(DirectX::XMFLOAT3(1, 0, 0), yDiff * *mouseLookSpeed.get());
+		transform->Rotate(DirectX::XMFLOAT3(0, 1, 0), xDiff * *mouseLookSpeed.get());
 	}
 
 	// Reset position 
@@ -87,7 +89,7 @@ void Camera::Update(float dt)
 void Camera::UpdateViewMatrix()
 {
 	// Setup
-	DirectX::XMFLOAT3 pos = *(transform->GetPosition().get());
+	DirectX::XMFLOAT3 pos = transform->GetPosition();
 	DirectX::XMFLOAT3 fwd = transform->GetForward();
 
 	// Build view and store 
@@ -0,0 +1,613 @@
+#include "CompressedClip.h"
+#include "AnimClip.h"
+#include "Skeleton.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+using namespace DirectX;
+
+// Smallest three components of a unit quaternion are within this of 0
+static const float SMALLEST_THREE_RANGE = 0.70710678f;
+
+// Lanes of a rebuilt quaternion that come after its dropped component,
+// and the lane of the dropped component, for each one it could be
+static const XMVECTOR SMALLEST_THREE_SHIFT[4] = {
+	XMVectorSelectControl(0, 1, 1, 1),
+	XMVectorSelectControl(0, 0, 1, 1),
+	XMVectorSelectControl(0, 0, 0, 1),
+	XMVectorSelectControl(0, 0, 0, 0) };
+static const XMVECTOR SMALLEST_THREE_INSERT[4] = {
+	XMVectorSelectControl(1, 0, 0, 0),
+	XMVectorSelectControl(0, 1, 0, 0),
+	XMVectorSelectControl(0, 0, 1, 0),
+	XMVectorSelectControl(0, 0, 0, 1) };
+
+// Reads load 8 bytes at a time, so the stream ends with this many spare ones
+static const unsigned int STREAM_PADDING = 8;
+
+/// <summary>
+/// Components a track stores per sample, rotations leave out their largest one
+/// </summary>
+static unsigned int ComponentCount(int type)
+{
+	switch (type)
+	{
+	case CLIP_TRACK_TINT:
+		return 4;
+	case CLIP_TRACK_LIGHT_INTENSITY:
+	case CLIP_TRACK_MORPH_WEIGHT:
+		return 1;
+	default:
+		return 3;
+	}
+}
+
+/// <summary>
+/// Whether a track moves geometry, so its error is measured in world units
+/// </summary>
+static bool IsTransformTrack(int type)
+{
+	return type == CLIP_TRACK_POSITION || type == CLIP_TRACK_ROTATION || type == CLIP_TRACK_SCALE;
+}
+
+/// <summary>
+/// Blend between two values of a track, rotations take the short way around
+/// </summary>
+static XMVECTOR Interpolate(int type, FXMVECTOR a, FXMVECTOR b, float s)
+{
+	if (type != CLIP_TRACK_ROTATION)
+		return XMVectorLerp(a, b, s);
+
+	XMVECTOR to = XMVectorGetX(XMVector4Dot(a, b)) < 0.0f ? -b : b;
+	return XMQuaternionNormalize(XMVectorLerp(a, to, s));
+}
+
+/// <summary>
+/// Sample a track at evenly spaced frames and halfway between each two,
+/// keeping rotations on one side so neighbours blend the short way
+/// </summary>
+static void ResampleTrack(AnimClip& clip, unsigned int track, float duration, unsigned int frameCount,
+	std::vector<XMFLOAT4>& frames, std::vector<XMFLOAT4>& midpoints)
+{
+	frames.resize(frameCount);
+	midpoints.resize(frameCount - 1);
+
+	bool rotation = clip.GetTrackType(track) == CLIP_TRACK_ROTATION;
+	unsigned int cursor = 0;
+	for (unsigned int f = 0; f < frameCount; f++)
+	{
+		float time = frameCount > 1 ? duration * f / (frameCount - 1) : 0.0f;
+		frames[f] = clip.Sample(track, time, cursor);
+		if (rotation && f > 0 && XMVectorGetX(XMVector4Dot(XMLoadFloat4(&frames[f - 1]), XMLoadFloat4(&frames[f]))) < 0.0f)
+			XMStoreFloat4(&frames[f], -XMLoadFloat4(&frames[f]));
+
+		if (f + 1 < frameCount)
+		{
+			unsigned int midpointCursor = cursor;
+			midpoints[f] = clip.Sample(track, duration * (f + 0.5f) / (frameCount - 1), midpointCursor);
+		}
+	}
+}
+
+CompressedClip::CompressedClip() :
+	duration(0.0f),
+	frameRate(0.0f),
+	frameCount(1),
+	frameBits(0),
+	stats()
+{
+}
+
+std::shared_ptr<CompressedClip> CompressedClip::Compress(AnimClip& clip, float maxError, Skeleton* skeleton)
+{
+	std::shared_ptr<CompressedClip> compressed(new CompressedClip());
+	CompressedClip& result = *compressed;
+	result.duration = clip.GetDuration();
+
+	unsigned int trackCount = clip.GetTrackCount();
+	unsigned int jointCount = skeleton ? skeleton->GetJointCount() : 0;
+	unsigned int partCount = std::max(clip.GetPartCount(), jointCount);
+
+	// How far out each part's errors are measured, and how many
+	// transform tracks share the bound along the chains it is in
+	std::vector<float> shellDistances(partCount, CLIP_COMPRESSION_SHELL_DISTANCE);
+	std::vector<unsigned int> chainTracks(partCount, 0);
+	for (unsigned int t = 0; t < trackCount; t++)
+	{
+		if (IsTransformTrack(clip.GetTrackType(t)))
+			chainTracks[clip.GetTrackPart(t)]++;
+	}
+	if (jointCount > 0)
+	{
+		std::vector<AffineMatrix> bind(jointCount);
+		skeleton->ComputeModelMatrices(skeleton->GetBindPose(), &bind[0]);
+
+		// A joint moves everything below it, children come after
+		// their parents so walking backwards hands each reach upwards
+		for (unsigned int j = jointCount; j-- > 0;)
+		{
+			int parent = skeleton->GetParent(j);
+			if (parent == SKELETON_NO_PARENT)
+				continue;
+
+			// Stored rows are columns, so the translation is their last element
+			XMVECTOR offset = XMVectorSet(
+				bind[j].m[0][3] - bind[parent].m[0][3],
+				bind[j].m[1][3] - bind[parent].m[1][3],
+				bind[j].m[2][3] - bind[parent].m[2][3], 0.0f);
+			float reach = shellDistances[j] + XMVectorGetX(XMVector3Length(offset));
+			shellDistances[parent] = std::max(shellDistances[parent], reach);
+		}
+
+		// Errors pile up from the root to the tips, so every track
+		// gets its share of the longest chain it is part of
+		for (unsigned int j = 0; j < jointCount; j++)
+		{
+			int parent = skeleton->GetParent(j);
+			if (parent != SKELETON_NO_PARENT)
+				chainTracks[j] += chainTracks[parent];
+		}
+		for (unsigned int j = jointCount; j-- > 0;)
+		{
+			int parent = skeleton->GetParent(j);
+			if (parent != SKELETON_NO_PARENT)
+				chainTracks[parent] = std::max(chainTracks[parent], chainTracks[j]);
+		}
+	}
+
+	// Every track's share of the bound, and how far out it is measured
+	std::vector<float> bounds(trackCount);
+	std::vector<float> trackShells(trackCount);
+	for (unsigned int t = 0; t < trackCount; t++)
+	{
+		int type = clip.GetTrackType(t);
+		unsigned int part = clip.GetTrackPart(t);
+		trackShells[t] = shellDistances[part];
+		bounds[t] = IsTransformTrack(type) ? maxError / std::max(chainTracks[part], 1u) : CLIP_COMPRESSION_VALUE_ERROR;
+	}
+
+	// Blending strays furthest from the clip halfway between frames, so
+	// the rate goes up until every track follows its clip closely enough there
+	std::vector<std::vector<XMFLOAT4>> frames(trackCount);
+	std::vector<std::vector<XMFLOAT4>> midpoints(trackCount);
+	float sampleRate = CLIP_COMPRESSION_SAMPLE_RATE;
+	while (true)
+	{
+		result.frameCount = result.duration > 0.0f ? (unsigned int)ceilf(result.duration * sampleRate) + 1 : 1;
+		result.frameRate = result.duration > 0.0f ? (result.frameCount - 1) / result.duration : 0.0f;
+
+		float blendShare = 0.0f;
+		for (unsigned int t = 0; t < trackCount; t++)
+		{
+			int type = clip.GetTrackType(t);
+			ResampleTrack(clip, t, result.duration, result.frameCount, frames[t], midpoints[t]);
+			for (unsigned int f = 0; f + 1 < result.frameCount; f++)
+			{
+				XMVECTOR blended = Interpolate(type, XMLoadFloat4(&frames[t][f]), XMLoadFloat4(&frames[t][f + 1]), 0.5f);
+				blendShare = std::max(blendShare, MeasureError(type, blended, XMLoadFloat4(&midpoints[t][f]), trackShells[t]) / bounds[t]);
+			}
+		}
+
+		if (blendShare <= CLIP_COMPRESSION_BLEND_SHARE || sampleRate >= CLIP_COMPRESSION_MAX_SAMPLE_RATE)
+			break;
+		sampleRate *= 2.0f;
+	}
+	result.stats.sampleRate = result.frameCount > 1 ? result.frameRate : sampleRate;
+
+	std::vector<XMFLOAT4> decoded(result.frameCount);
+	unsigned char scratch[32] = {};
+	unsigned int quantizedBits = 0;
+	unsigned int quantizedComponents = 0;
+
+	for (unsigned int t = 0; t < trackCount; t++)
+	{
+		int type = clip.GetTrackType(t);
+		float shellDistance = trackShells[t];
+		float bound = bounds[t];
+		const std::vector<XMFLOAT4>& samples = frames[t];
+		const std::vector<XMFLOAT4>& halfways = midpoints[t];
+
+		CompressedTrack track = {};
+		track.type = (unsigned char)type;
+		track.components = (unsigned char)ComponentCount(type);
+		track.constant = (unsigned int)result.constants.size();
+
+		XMVECTOR first = XMLoadFloat4(&samples[0]);
+		XMVECTOR last = XMLoadFloat4(&samples[result.frameCount - 1]);
+		float constantError = 0.0f;
+		float linearError = 0.0f;
+		for (unsigned int f = 0; f < result.frameCount; f++)
+		{
+			XMVECTOR sample = XMLoadFloat4(&samples[f]);
+			float s = result.frameCount > 1 ? (float)f / (result.frameCount - 1) : 0.0f;
+			constantError = std::max(constantError, MeasureError(type, sample, first, shellDistance));
+			linearError = std::max(linearError, MeasureError(type, sample, Interpolate(type, first, last, s), shellDistance));
+			if (f + 1 == result.frameCount)
+				break;
+
+			XMVECTOR halfway = XMLoadFloat4(&halfways[f]);
+			s = (f + 0.5f) / (result.frameCount - 1);
+			constantError = std::max(constantError, MeasureError(type, halfway, first, shellDistance));
+			linearError = std::max(linearError, MeasureError(type, halfway, Interpolate(type, first, last, s), shellDistance));
+		}
+
+		float error;
+		if (constantError <= bound)
+		{
+			track.format = CLIP_COMPRESSED_CONSTANT;
+			result.constants.push_back(samples[0]);
+			result.stats.constantTracks++;
+			error = constantError;
+		}
+		else if (linearError <= bound)
+		{
+			track.format = CLIP_COMPRESSED_LINEAR;
+			result.constants.push_back(samples[0]);
+			result.constants.push_back(samples[result.frameCount - 1]);
+			result.stats.linearTracks++;
+			error = linearError;
+		}
+		else
+		{
+			track.format = CLIP_COMPRESSED_ANIMATED;
+
+			// Everything else is quantized within the range it covers
+			XMVECTOR minimum = XMVectorZero();
+			XMVECTOR extent = XMVectorZero();
+			if (type != CLIP_TRACK_ROTATION)
+			{
+				minimum = first;
+				XMVECTOR maximum = first;
+				for (unsigned int f = 1; f < result.frameCount; f++)
+				{
+					minimum = XMVectorMin(minimum, XMLoadFloat4(&samples[f]));
+					maximum = XMVectorMax(maximum, XMLoadFloat4(&samples[f]));
+				}
+				extent = maximum - minimum;
+
+				XMFLOAT4 range[2];
+				XMStoreFloat4(&range[0], minimum);
+				XMStoreFloat4(&range[1], extent);
+				result.constants.insert(result.constants.end(), range, range + 2);
+			}
+
+			// Fewest bits that stay under the bound at the frames and blended
+			// halfway between them, or plain floats
+			unsigned int bits = CLIP_COMPRESSION_MIN_BITS;
+			for (;; bits = bits < CLIP_COMPRESSION_MAX_BITS ? bits + 1 : 32)
+			{
+				error = 0.0f;
+				for (unsigned int f = 0; f < result.frameCount && error <= bound; f++)
+				{
+					XMVECTOR sample = XMLoadFloat4(&samples[f]);
+					Encode(scratch, 0, type, bits, track.components, sample, minimum, extent);
+					XMVECTOR unpacked = Unpack(scratch, 0, type, bits, track.components, minimum, extent);
+					XMStoreFloat4(&decoded[f], unpacked);
+					error = std::max(error, MeasureError(type, sample, unpacked, shellDistance));
+					if (f == 0)
+						continue;
+
+					XMVECTOR blended = Interpolate(type, XMLoadFloat4(&decoded[f - 1]), unpacked, 0.5f);
+					error = std::max(error, MeasureError(type, XMLoadFloat4(&halfways[f - 1]), blended, shellDistance));
+				}
+				if (error <= bound || bits == 32)
+					break;
+			}
+
+			track.bits = (unsigned char)bits;
+			track.bitOffset = result.frameBits;
+			result.frameBits += bits * track.components + (type == CLIP_TRACK_ROTATION ? 2 : 0);
+
+			result.stats.animatedTracks++;
+			quantizedBits += bits * track.components;
+			quantizedComponents += track.components;
+		}
+
+		result.tracks.push_back(track);
+		result.stats.maxError = std::max(result.stats.maxError, error);
+		result.stats.rawSize += result.frameCount * (type == CLIP_TRACK_ROTATION ? 4 : track.components) * (unsigned int)sizeof(float);
+	}
+
+	// Pack the animated tracks frame by frame
+	unsigned long long streamBits = (unsigned long long)result.frameCount * result.frameBits;
+	result.stream.assign((size_t)((streamBits + 7) / 8) + STREAM_PADDING, 0);
+	for (unsigned int t = 0; t < trackCount; t++)
+	{
+		const CompressedTrack& track = result.tracks[t];
+		if (track.format != CLIP_COMPRESSED_ANIMATED)
+			continue;
+
+		XMVECTOR minimum = XMVectorZero();
+		XMVECTOR extent = XMVectorZero();
+		if (track.type != CLIP_TRACK_ROTATION)
+		{
+			minimum = XMLoadFloat4(&result.constants[track.constant]);
+			extent = XMLoadFloat4(&result.constants[track.constant + 1]);
+		}
+
+		for (unsigned int f = 0; f < result.frameCount; f++)
+		{
+			unsigned long long position = (unsigned long long)f * result.frameBits + track.bitOffset;
+			Encode(&result.stream[0], position, track.type, track.bits, track.components, XMLoadFloat4(&frames[t][f]), minimum, extent);
+		}
+	}
+
+	result.stats.averageBits = quantizedComponents > 0 ? (float)quantizedBits / quantizedComponents : 0.0f;
+	result.stats.sourceSize = clip.GetMemorySize();
+	result.stats.compressedSize = result.GetMemorySize();
+	return compressed;
+}
+
+DirectX::XMVECTOR CompressedClip::Sample(unsigned int track, float time) const
+{
+	return Evaluate(tracks[track], time, Locate(time));
+}
+
+void CompressedClip::SampleBatch(const float* times, DirectX::XMFLOAT4* results, unsigned int count) const
+{
+	// Every track of an instance shares its frames, so they are found
+	// once per chunk of instances and the tracks are walked over it
+	unsigned int trackCount = (unsigned int)tracks.size();
+	FramePosition positions[CLIP_COMPRESSION_BATCH_CHUNK];
+	for (unsigned int first = 0; first < count; first += CLIP_COMPRESSION_BATCH_CHUNK)
+	{
+		unsigned int chunk = std::min(count - first, (unsigned int)CLIP_COMPRESSION_BATCH_CHUNK);
+		for (unsigned int i = 0; i < chunk; i++)
+		{
+			positions[i] = Locate(times[first + i]);
+		}
+
+		for (unsigned int t = 0; t < trackCount; t++)
+		{
+			const CompressedTrack& track = tracks[t];
+			XMFLOAT4* trackResults = &results[first * trackCount + t];
+			if (track.format != CLIP_COMPRESSED_ANIMATED || frameCount < 2)
+			{
+				for (unsigned int i = 0; i < chunk; i++)
+				{
+					XMStoreFloat4(&trackResults[i * trackCount], Evaluate(track, times[first + i], positions[i]));
+				}
+				continue;
+			}
+
+			// Animated tracks are most of the work, so their range is
+			// only loaded once and both frames are unpacked in place
+			XMVECTOR minimum, extent;
+			LoadRange(track, minimum, extent);
+			for (unsigned int i = 0; i < chunk; i++)
+			{
+				unsigned long long bit = positions[i].bit + track.bitOffset;
+				XMVECTOR from = Unpack(&stream[0], bit, track.type, track.bits, track.components, minimum, extent);
+				XMVECTOR to = Unpack(&stream[0], bit + frameBits, track.type, track.bits, track.components, minimum, extent);
+				XMStoreFloat4(&trackResults[i * trackCount], Interpolate(track.type, from, to, positions[i].blend));
+			}
+		}
+	}
+}
+
+const ClipCompressionStats& CompressedClip::GetStats() const
+{
+	return stats;
+}
+
+unsigned int CompressedClip::GetMemorySize() const
+{
+	return (unsigned int)(sizeof(CompressedClip) +
+		tracks.size() * sizeof(CompressedTrack) +
+		constants.size() * sizeof(XMFLOAT4) +
+		stream.size());
+}
+
+CompressedClip::FramePosition CompressedClip::Locate(float time) const
+{
+	FramePosition position = { 0, 0.0f };
+	if (frameCount < 2)
+		return position;
+
+	// Frames are spread evenly from the start to the end
+	time = time < 0.0f ? 0.0f : time > duration ? duration : time;
+	float frame = time * frameRate;
+	unsigned int before = std::min((unsigned int)frame, frameCount - 2);
+	position.bit = (unsigned long long)before * frameBits;
+	position.blend = frame - before;
+	return position;
+}
+
+DirectX::XMVECTOR CompressedClip::Evaluate(const CompressedTrack& track, float time, FramePosition position) const
+{
+	switch (track.format)
+	{
+	case CLIP_COMPRESSED_CONSTANT:
+		return XMLoadFloat4(&constants[track.constant]);
+	case CLIP_COMPRESSED_LINEAR:
+	{
+		float s = duration > 0.0f ? std::min(std::max(time / duration, 0.0f), 1.0f) : 0.0f;
+		return Interpolate(track.type, XMLoadFloat4(&constants[track.constant]), XMLoadFloat4(&constants[track.constant + 1]), s);
+	}
+	default:
+	{
+		XMVECTOR minimum, extent;
+		LoadRange(track, minimum, extent);
+		XMVECTOR from = Decode(track, position.bit, minimum, extent);
+		if (frameCount < 2)
+			return from;
+		return Interpolate(track.type, from, Decode(track, position.bit + frameBits, minimum, extent), position.blend);
+	}
+	}
+}
+
+DirectX::XMVECTOR CompressedClip::Decode(const CompressedTrack& track, unsigned long long frameBit, DirectX::FXMVECTOR minimum, DirectX::FXMVECTOR extent) const
+{
+	return Unpack(&stream[0], frameBit + track.bitOffset, track.type, track.bits, track.components, minimum, extent);
+}
+
+void CompressedClip::LoadRange(const CompressedTrack& track, DirectX::XMVECTOR& minimum, DirectX::XMVECTOR& extent) const
+{
+	minimum = XMVectorZero();
+	extent = XMVectorZero();
+	if (track.type != CLIP_TRACK_ROTATION)
+	{
+		minimum = XMLoadFloat4(&constants[track.constant]);
+		extent = XMLoadFloat4(&constants[track.constant + 1]);
+	}
+}
+
+void CompressedClip::Encode(unsigned char* stream, unsigned long long position, int type, unsigned int bits, unsigned int components,
+	DirectX::FXMVECTOR value, DirectX::FXMVECTOR minimum, DirectX::FXMVECTOR extent)
+{
+	float values[4];
+	float minimums[4];
+	float extents[4];
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(values), value);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(minimums), minimum);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(extents), extent);
+
+	if (type == CLIP_TRACK_ROTATION)
+	{
+		// Drop the largest component, made positive so it can be rebuilt
+		// from the other three, and store the others in order
+		unsigned int largest = 0;
+		for (unsigned int i = 1; i < 4; i++)
+		{
+			if (fabsf(values[i]) > fabsf(values[largest]))
+				largest = i;
+		}
+		float sign = values[largest] < 0.0f ? -1.0f : 1.0f;
+
+		unsigned int kept = 0;
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+			values[kept] = values[i] * sign;
+			minimums[kept] = -SMALLEST_THREE_RANGE;
+			extents[kept] = 2.0f * SMALLEST_THREE_RANGE;
+			kept++;
+		}
+
+		WriteBits(stream, position, largest, 2);
+		position += 2;
+	}
+
+	for (unsigned int i = 0; i < components; i++, position += bits)
+	{
+		unsigned int packed;
+		if (bits == 32)
+		{
+			memcpy(&packed, &values[i], sizeof(float));
+		}
+		else
+		{
+			// Which of the 2^bits equal steps of the range it falls in
+			float normalized = extents[i] > 0.0f ? (values[i] - minimums[i]) / extents[i] : 0.0f;
+			normalized = normalized < 0.0f ? 0.0f : normalized;
+			packed = std::min((unsigned int)(normalized * (float)(1u << bits)), (1u << bits) - 1);
+		}
+		WriteBits(stream, position, packed, bits);
+	}
+}
+
+DirectX::XMVECTOR CompressedClip::Unpack(const unsigned char* stream, unsigned long long position, int type, unsigned int bits, unsigned int components,
+	DirectX::FXMVECTOR minimum, DirectX::FXMVECTOR extent)
+{
+	unsigned int largest = 0;
+	unsigned int rotationBits = type == CLIP_TRACK_ROTATION ? 2 : 0;
+	unsigned int x, y, z, w;
+	if (rotationBits + bits * components + 7 <= 64)
+	{
+		// Small enough for every component to come out of one read,
+		// components past the last one are never shifted out to
+		unsigned long long word;
+		memcpy(&word, stream + (position >> 3), sizeof(word));
+		word >>= position & 7;
+		largest = (unsigned int)(word & 3);
+		word >>= rotationBits;
+
+		unsigned long long mask = (1ull << bits) - 1;
+		x = (unsigned int)(word & mask);
+		y = components > 1 ? (unsigned int)((word >> bits) & mask) : 0;
+		z = components > 2 ? (unsigned int)((word >> (bits * 2)) & mask) : 0;
+		w = components > 3 ? (unsigned int)((word >> (bits * 3)) & mask) : 0;
+	}
+	else
+	{
+		unsigned int lanes[4] = { 0, 0, 0, 0 };
+		largest = ReadBits(stream, position, 2);
+		position += rotationBits;
+		for (unsigned int i = 0; i < components; i++, position += bits)
+		{
+			lanes[i] = ReadBits(stream, position, bits);
+		}
+		x = lanes[0];
+		y = lanes[1];
+		z = lanes[2];
+		w = lanes[3];
+	}
+
+	// Plain floats are already in the lanes, quantized values are
+	// the middle of their step, (2q + 1) / 2^(bits + 1), four at a time
+	XMVECTOR value = bits == 32 ?
+		XMVectorSetInt(x, y, z, w) :
+		XMConvertVectorUIntToFloat(XMVectorSetInt(x * 2 + 1, y * 2 + 1, z * 2 + 1, w * 2 + 1), bits + 1);
+
+	if (type == CLIP_TRACK_ROTATION)
+	{
+		if (bits != 32)
+			value = XMVectorMultiplyAdd(value, XMVectorReplicate(2.0f * SMALLEST_THREE_RANGE), XMVectorReplicate(-SMALLEST_THREE_RANGE));
+
+		// The dropped component was the positive one that makes it unit length,
+		// it goes back in at its index and the ones after it move up a lane
+		XMVECTOR rebuilt = XMVectorSqrt(XMVectorMax(XMVectorZero(), XMVectorSplatOne() - XMVector3Dot(value, value)));
+		XMVECTOR shifted = XMVectorSwizzle<3, 0, 1, 2>(value);
+		value = XMVectorSelect(value, shifted, SMALLEST_THREE_SHIFT[largest]);
+		return XMVectorSelect(value, rebuilt, SMALLEST_THREE_INSERT[largest]);
+	}
+
+	return bits == 32 ? value : XMVectorMultiplyAdd(value, extent, minimum);
+}
+
+void CompressedClip::WriteBits(unsigned char* stream, unsigned long long position, unsigned int value, unsigned int bits)
+{
+	// Lowest bit first, matching the little endian reads below
+	for (unsigned int i = 0; i < bits; i++, position++)
+	{
+		unsigned char mask = (unsigned char)(1 << (position & 7));
+		if ((value >> i) & 1)
+			stream[position >> 3] |= mask;
+		else
+			stream[position >> 3] &= ~mask;
+	}
+}
+
+unsigned int CompressedClip::ReadBits(const unsigned char* stream, unsigned long long position, unsigned int bits)
+{
+	unsigned long long word;
+	memcpy(&word, stream + (position >> 3), sizeof(word));
+	word >>= position & 7;
+	return (unsigned int)(word & ((1ull << bits) - 1));
+}
+
+float CompressedClip::MeasureError(int type, DirectX::FXMVECTOR a, DirectX::FXMVECTOR b, float shellDistance)
+{
+	switch (type)
+	{
+	case CLIP_TRACK_POSITION:
+		return XMVectorGetX(XMVector3Length(a - b));
+	case CLIP_TRACK_ROTATION:
+	{
+		// A point on the shell moves at most twice its distance times the sine of
+		// half the angle between them, which is the length of the vector part of
+		// the rotation from one to the other, and is exact even for tiny angles
+		XMVECTOR difference = XMQuaternionMultiply(XMQuaternionConjugate(a), b);
+		return 2.0f * shellDistance * XMVectorGetX(XMVector3Length(difference));
+	}
+	case CLIP_TRACK_SCALE:
+		return shellDistance * XMVectorGetX(XMVector3Length(a - b));
+	default:
+	{
+		XMFLOAT4 difference;
+		XMStoreFloat4(&difference, XMVectorAbs(a - b));
+		return std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w));
+	}
+	}
+}
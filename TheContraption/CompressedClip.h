@@ -0,0 +1,168 @@
+#pragma once
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+
+class AnimClip;
+class Skeleton;
+
+/*
+	Compressed storage of an animation clip. Every track is
+	resampled at a fixed rate, then stored in the cheapest form
+	that stays under an error bound: a single value if it never
+	moves, its two ends if it moves in a straight line, otherwise
+	every sample quantized to as few bits as the bound allows.
+	Rotations keep only their three smallest components. Samples
+	of every animated track are packed frame by frame, so sampling
+	any time only reads two small runs of the stream
+*/
+
+// Samples per second tracks are resampled at to begin with. Clips that
+// move too much between samples for blending to follow them are
+// resampled at twice the rate, up to the most
+#define CLIP_COMPRESSION_SAMPLE_RATE 30.0f
+#define CLIP_COMPRESSION_MAX_SAMPLE_RATE 240.0f
+
+// Share of a track's error bound that blending between samples may use
+// halfway between them, the rest is left for quantizing the samples
+#define CLIP_COMPRESSION_BLEND_SHARE 0.5f
+
+// How far, in world units, a point on a compressed part may end up
+// from where the uncompressed clip puts it
+#define CLIP_COMPRESSION_MAX_ERROR 0.001f
+
+// Distance from a part at which its rotation and scale errors are
+// measured, roughly how far its geometry reaches
+#define CLIP_COMPRESSION_SHELL_DISTANCE 0.5f
+
+// Error bound of tracks that don't move anything, tints and intensities
+#define CLIP_COMPRESSION_VALUE_ERROR 0.002f
+
+// Bits per quantized component tried, tracks that need more
+// than the most are stored as plain floats instead
+#define CLIP_COMPRESSION_MIN_BITS 3
+#define CLIP_COMPRESSION_MAX_BITS 16
+
+// Instances whose frames are found together when sampling a batch
+#define CLIP_COMPRESSION_BATCH_CHUNK 64
+
+// How a compressed track is stored
+#define CLIP_COMPRESSED_CONSTANT 0	// One value
+#define CLIP_COMPRESSED_LINEAR 1	// First and last value
+#define CLIP_COMPRESSED_ANIMATED 2	// Every sample, quantized
+
+
+/// <summary>
+/// What compressing a clip did
+/// </summary>
+struct ClipCompressionStats
+{
+	unsigned int constantTracks;
+	unsigned int linearTracks;
+	unsigned int animatedTracks;
+
+	float averageBits;		// Per component of the animated tracks
+	float maxError;			// Largest error at any sample or halfway between two, in world units for transform tracks
+	float sampleRate;		// Samples per second the tracks were resampled at
+
+	unsigned int sourceSize;		// Bytes of the keys it was made from
+	unsigned int rawSize;			// Bytes of every sample as plain floats
+	unsigned int compressedSize;
+};
+
+class CompressedClip
+{
+public:
+	/// <summary>
+	/// Compress every track of a clip
+	/// </summary>
+	/// <param name="maxError">World space error bound, split between a part and its ancestors</param>
+	/// <param name="skeleton">Skeleton the clip's parts are joints of, if any, so errors
+	/// of parents are measured out to their children. Parts are independent without one</param>
+	static std::shared_ptr<CompressedClip> Compress(AnimClip& clip, float maxError = CLIP_COMPRESSION_MAX_ERROR, Skeleton* skeleton = nullptr);
+
+	/// <summary>
+	/// Sample one track straight from the compressed data
+	/// </summary>
+	DirectX::XMVECTOR Sample(unsigned int track, float time) const;
+	/// <summary>
+	/// Sample every track of many instances, same layout as AnimClip::SampleBatch
+	/// </summary>
+	void SampleBatch(const float* times, DirectX::XMFLOAT4* results, unsigned int count) const;
+
+	const ClipCompressionStats& GetStats() const;
+	/// <summary>
+	/// Bytes used by the compressed tracks
+	/// </summary>
+	unsigned int GetMemorySize() const;
+
+private:
+	CompressedClip();
+
+	/// <summary>
+	/// 12 bytes describing one track, its data is in the constants and the stream
+	/// </summary>
+	struct CompressedTrack
+	{
+		unsigned char type;
+		unsigned char format;
+		unsigned char bits;			// Per component, 32 for plain floats
+		unsigned char components;	// Stored per sample
+		unsigned int constant;		// First of its values in constants
+		unsigned int bitOffset;		// Where its samples start within a frame
+	};
+
+	/// <summary>
+	/// Where a time falls between two frames
+	/// </summary>
+	struct FramePosition
+	{
+		unsigned long long bit;	// Where the frame before it starts in the stream
+		float blend;
+	};
+
+	FramePosition Locate(float time) const;
+	/// <summary>
+	/// Sample a track at a time that has already been located
+	/// </summary>
+	DirectX::XMVECTOR Evaluate(const CompressedTrack& track, float time, FramePosition position) const;
+	/// <summary>
+	/// Unpack one frame of an animated track
+	/// </summary>
+	DirectX::XMVECTOR Decode(const CompressedTrack& track, unsigned long long frameBit, DirectX::FXMVECTOR minimum, DirectX::FXMVECTOR extent) const;
+	/// <summary>
+	/// Range an animated track is quantized within, rotations have none
+	/// </summary>
+	void LoadRange(const CompressedTrack& track, DirectX::XMVECTOR& minimum, DirectX::XMVECTOR& extent) const;
+
+	/// <summary>
+	/// Quantize one sample of an animated track into a stream
+	/// </summary>
+	static void Encode(unsigned char* stream, unsigned long long position, int type, unsigned int bits, unsigned int components,
+		DirectX::FXMVECTOR value, DirectX::FXMVECTOR minimum, DirectX::FXMVECTOR extent);
+	/// <summary>
+	/// Turn one sample written by Encode back into a value
+	/// </summary>
+	static DirectX::XMVECTOR Unpack(const unsigned char* stream, unsigned long long position, int type, unsigned int bits, unsigned int components,
+		DirectX::FXMVECTOR minimum, DirectX::FXMVECTOR extent);
+	static void WriteBits(unsigned char* stream, unsigned long long position, unsigned int value, unsigned int bits);
+	/// <summary>
+	/// Read up to 32 bits from anywhere in a stream that has 8 bytes of padding after it
+	/// </summary>
+	static unsigned int ReadBits(const unsigned char* stream, unsigned long long position, unsigned int bits);
+	/// <summary>
+	/// How far apart two values of a track are, in world units for transform tracks
+	/// </summary>
+	static float MeasureError(int type, DirectX::FXMVECTOR a, DirectX::FXMVECTOR b, float shellDistance);
+
+	std::vector<CompressedTrack> tracks;
+	std::vector<DirectX::XMFLOAT4> constants;
+	std::vector<unsigned char> stream;
+
+	float duration;
+	float frameRate;	// Frames per second of the stream, so locating one is a multiply
+	unsigned int frameCount;
+	unsigned int frameBits;
+
+	ClipCompressionStats stats;
+};
@@ -1,5 +1,6 @@
 #include "DXCore.h"
 #include "Input.h"
+#include "GeometryArena.h"
 
 #include <dxgi1_5.h>
 #include <WindowsX.h>
@@ -86,6 +87,9 @@ DXCore::~DXCore()
 
 	// Delete input manager singleton
 	delete& Input::GetInstance();
+
+	// Delete geometry arena singleton, the game's meshes are gone by now
+	delete& GeometryArena::GetInstance();
 }
 
 // --------------------------------------------------------
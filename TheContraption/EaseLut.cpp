@@ -0,0 +1,158 @@
+#include "EaseLut.h"
+
+#include <chrono>
+
+/// <summary>
+/// Every curve's functions and tables in curve type order, with the
+/// jump to the end for unknown curves last
+/// </summary>
+template<int... Curves>
+struct EaseRegistry
+{
+	static constexpr EaseFunction functions[EASE_MODE_COUNT][sizeof...(Curves)] =
+	{
+		{ &Ease<Curves, EASE_MODE_EXACT>... },
+		{ &Ease<Curves, EASE_MODE_LUT_LINEAR>... },
+		{ &Ease<Curves, EASE_MODE_LUT_CUBIC>... },
+	};
+
+	static constexpr const EaseTable* tables[sizeof...(Curves)] = { &EaseLut<Curves>::table... };
+
+	static constexpr float errors[EASE_MODE_COUNT][sizeof...(Curves)] =
+	{
+		{ (0.0f * Curves)... },
+		{ EaseLut<Curves>::linearError... },
+		{ EaseLut<Curves>::cubicError... },
+	};
+};
+
+template<int... Curves> constexpr EaseFunction EaseRegistry<Curves...>::functions[EASE_MODE_COUNT][sizeof...(Curves)];
+template<int... Curves> constexpr const EaseTable* EaseRegistry<Curves...>::tables[sizeof...(Curves)];
+template<int... Curves> constexpr float EaseRegistry<Curves...>::errors[EASE_MODE_COUNT][sizeof...(Curves)];
+
+template<int... Curves>
+static EaseRegistry<Curves...> MakeEaseRegistry(std::integer_sequence<int, Curves...>)
+{
+	return EaseRegistry<Curves...>();
+}
+
+typedef decltype(MakeEaseRegistry(std::make_integer_sequence<int, EASE_CURVE_COUNT + 1>())) AllEaseCurves;
+
+/// <summary>
+/// Anything outside of the known curves uses the jump to the end
+/// </summary>
+static int ClampCurve(int curveType)
+{
+	return curveType >= 0 && curveType < EASE_CURVE_COUNT ? curveType : EASE_CURVE_COUNT;
+}
+
+static int ClampMode(int mode)
+{
+	return mode >= 0 && mode < EASE_MODE_COUNT ? mode : EASE_MODE_EXACT;
+}
+
+EaseFunction GetEaseFunction(int curveType, int mode)
+{
+	return AllEaseCurves::functions[ClampMode(mode)][ClampCurve(curveType)];
+}
+
+const EaseTable& GetEaseTable(int curveType)
+{
+	return *AllEaseCurves::tables[ClampCurve(curveType)];
+}
+
+float GetEaseError(int curveType, int mode)
+{
+	return AllEaseCurves::errors[ClampMode(mode)][ClampCurve(curveType)];
+}
+
+float GetCurveByIndex(int curveType, float p, int mode)
+{
+	return GetEaseFunction(curveType, mode)(p);
+}
+
+const char* GetEaseName(int curveType)
+{
+	static const char* names[EASE_CURVE_COUNT + 1] =
+	{
+		"EaseInSine", "EaseOutSine", "EaseInOutSine",
+		"EaseInQuad", "EaseOutQuad", "EaseInOutQuad",
+		"EaseInCubic", "EaseOutCubic", "EaseInOutCubic",
+		"EaseInQuart", "EaseOutQuart", "EaseInOutQuart",
+		"EaseInQuint", "EaseOutQuint", "EaseInOutQuint",
+		"EaseInExpo", "EaseOutExpo", "EaseInOutExpo",
+		"EaseInCirc", "EaseOutCirc", "EaseInOutCirc",
+		"EaseInBack", "EaseOutBack", "EaseInOutBack",
+		"EaseInElastic", "EaseOutElastic", "EaseInOutElastic",
+		"EaseInBounce", "EaseOutBounce", "EaseInOutBounce",
+		"Unknown",
+	};
+	return names[ClampCurve(curveType)];
+}
+
+#pragma region BENCHMARK
+
+// Every timed sum ends up here, a store the compiler has to keep, so
+// it can't drop the evaluations that went into the sum either
+static volatile float easeBenchmarkSink = 0.0f;
+
+/// <summary>
+/// Time one way of evaluating a curve over the samples, in nanoseconds per evaluation
+/// </summary>
+template<typename Function>
+static float TimeEase(unsigned int samples, Function function)
+{
+	float sum = 0.0f;
+	float step = 1.0f / samples;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < samples; i++)
+	{
+		sum += function(i * step);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	easeBenchmarkSink = sum;
+
+	return std::chrono::duration<float, std::nano>(end - start).count() / samples;
+}
+
+template<int Curve>
+static void BenchmarkEaseCurve(EaseBenchmarkResult& result, unsigned int samples)
+{
+	result.switchNanoseconds = TimeEase(samples, [](float x) { return GetCurveByIndex(Curve, x); });
+	result.nanoseconds[EASE_MODE_EXACT] = TimeEase(samples, Ease<Curve, EASE_MODE_EXACT>);
+	result.nanoseconds[EASE_MODE_LUT_LINEAR] = TimeEase(samples, Ease<Curve, EASE_MODE_LUT_LINEAR>);
+	result.nanoseconds[EASE_MODE_LUT_CUBIC] = TimeEase(samples, Ease<Curve, EASE_MODE_LUT_CUBIC>);
+
+	// Error against the functions the game actually runs, not the compile time math
+	for (int mode = 0; mode < EASE_MODE_COUNT; mode++)
+	{
+		result.maxError[mode] = 0.0f;
+	}
+	float step = 1.0f / samples;
+	for (unsigned int i = 0; i <= samples; i++)
+	{
+		float x = i * step;
+		float exact = EaseCurve<Curve>::Exact(x);
+		result.maxError[EASE_MODE_LUT_LINEAR] = fmaxf(result.maxError[EASE_MODE_LUT_LINEAR], fabsf(Ease<Curve, EASE_MODE_LUT_LINEAR>(x) - exact));
+		result.maxError[EASE_MODE_LUT_CUBIC] = fmaxf(result.maxError[EASE_MODE_LUT_CUBIC], fabsf(Ease<Curve, EASE_MODE_LUT_CUBIC>(x) - exact));
+	}
+}
+
+template<int... Curves>
+static void BenchmarkEaseCurves(EaseBenchmarkResult results[], unsigned int samples, std::integer_sequence<int, Curves...>)
+{
+	// Expands to one call per curve, in order
+	int expand[] = { (BenchmarkEaseCurve<Curves>(results[Curves], samples), 0)... };
+	(void)expand;
+}
+
+void RunEaseBenchmark(EaseBenchmarkResult results[], unsigned int samples)
+{
+	if (samples == 0)
+		return;
+
+	BenchmarkEaseCurves(results, samples, std::make_integer_sequence<int, EASE_CURVE_COUNT>());
+}
+
+#pragma endregion
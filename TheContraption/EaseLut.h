@@ -0,0 +1,588 @@
+#pragma once
+#include <cmath>
+#include <utility>
+
+#include "AnimCurves.h"
+
+/*
+	Easing curves as lookup tables that the compiler fills in, so a
+	curve costs a table read and a blend instead of a switch and a
+	call to pow or sin. Ease<Curve> picks the curve at compile time
+	for callers that know it, with no dispatch at all
+*/
+
+// How curves are evaluated
+#define EASE_MODE_EXACT 0		// The functions in AnimCurves.h
+#define EASE_MODE_LUT_LINEAR 1	// Table, blended linearly between the two nearest samples
+#define EASE_MODE_LUT_CUBIC 2	// Table, Catmull-Rom through the four nearest samples
+#define EASE_MODE_COUNT 3
+
+// Segments every table splits 0 to 1 into
+#define EASE_LUT_SIZE 256
+
+// Points checked in every segment when the tables are built. Between
+// two points the error is bounded by extending the lines through the
+// points on either side, which lands on or above the peak of the
+// error wherever it curves down, smooth or at a kink. Error that climbs
+// ever more steeply into a kink can still peak slightly above it, by
+// about 2% at the in-out bounce, the only curve where that happens
+#define EASE_LUT_CHECKS_PER_SEGMENT 8
+#define EASE_LUT_CHECK_COUNT (EASE_LUT_SIZE * EASE_LUT_CHECKS_PER_SEGMENT)
+
+// How far inside of 0 and 1 the ends are checked. Some curves jump
+// right at their ends, which a table can only show from one side
+#define EASE_LUT_END_OFFSET 1e-9
+
+// Largest difference a table may have from its exact curve, as a
+// fraction of the distance animated. Most curves are far under it,
+// the circ curves come closest since they start or end straight up
+#define EASE_LUT_MAX_ERROR 0.03f
+
+typedef float (*EaseFunction)(float);
+
+#pragma region COMPILE TIME MATH
+
+/// <summary>
+/// The std math functions can't run at compile time, these can.
+/// Series are in double and run to well past float precision
+/// </summary>
+struct EaseMath
+{
+	static constexpr double pi = 3.14159265358979323846;
+
+	static constexpr double Floor(double x)
+	{
+		double whole = (double)(long long)x;
+		return whole > x ? whole - 1.0 : whole;
+	}
+
+	static constexpr double Sin(double x)
+	{
+		// Into -pi to pi, where the series converges quickly
+		x -= 2.0 * pi * Floor((x + pi) / (2.0 * pi));
+
+		double term = x;
+		double sum = x;
+		for (int n = 1; n < 12; n++)
+		{
+			term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+			sum += term;
+		}
+		return sum;
+	}
+
+	static constexpr double Cos(double x)
+	{
+		return Sin(x + pi / 2.0);
+	}
+
+	static constexpr double Sqrt(double x)
+	{
+		if (x <= 0.0)
+			return 0.0;
+
+		// Newton's method from above only ever falls, so stop once it doesn't
+		double root = x > 1.0 ? x : 1.0;
+		for (int i = 0; i < 64; i++)
+		{
+			double next = 0.5 * (root + x / root);
+			if (next >= root)
+				break;
+			root = next;
+		}
+		return root;
+	}
+
+	static constexpr double Pow(double x, int power)
+	{
+		double result = 1.0;
+		for (int i = 0; i < power; i++)
+		{
+			result *= x;
+		}
+		return result;
+	}
+
+	static constexpr double Exp2(double x)
+	{
+		// Whole powers by halving or doubling, the rest by the series of e^(x ln 2)
+		double whole = Floor(x);
+		double part = (x - whole) * 0.69314718055994530942;
+
+		double term = 1.0;
+		double sum = 1.0;
+		for (int n = 1; n < 16; n++)
+		{
+			term *= part / n;
+			sum += term;
+		}
+
+		for (int i = 0; i < (int)whole; i++)
+			sum *= 2.0;
+		for (int i = 0; i > (int)whole; i--)
+			sum *= 0.5;
+		return sum;
+	}
+};
+
+#pragma endregion
+
+#pragma region CURVES
+
+/// <summary>
+/// One curve known at compile time. Exact is the AnimCurves.h function,
+/// Build is the same formula in compile time math for filling its table
+/// </summary>
+template<int Curve> struct EaseCurve;
+
+template<> struct EaseCurve<EASE_IN_SINE>
+{
+	static float Exact(float x) { return EaseInSine(x); }
+	static constexpr double Build(double x) { return 1.0 - EaseMath::Cos(x * EaseMath::pi / 2.0); }
+};
+
+template<> struct EaseCurve<EASE_OUT_SINE>
+{
+	static float Exact(float x) { return EaseOutSine(x); }
+	static constexpr double Build(double x) { return EaseMath::Sin(x * EaseMath::pi / 2.0); }
+};
+
+template<> struct EaseCurve<EASE_IN_OUT_SINE>
+{
+	static float Exact(float x) { return EaseInOutSine(x); }
+	static constexpr double Build(double x) { return -(EaseMath::Cos(EaseMath::pi * x) - 1.0) / 2.0; }
+};
+
+template<> struct EaseCurve<EASE_IN_QUAD>
+{
+	static float Exact(float x) { return EaseInQuad(x); }
+	static constexpr double Build(double x) { return EaseMath::Pow(x, 2); }
+};
+
+template<> struct EaseCurve<EASE_OUT_QUAD>
+{
+	static float Exact(float x) { return EaseOutQuad(x); }
+	static constexpr double Build(double x) { return 1.0 - EaseMath::Pow(1.0 - x, 2); }
+};
+
+template<> struct EaseCurve<EASE_IN_OUT_QUAD>
+{
+	static float Exact(float x) { return EaseInOutQuad(x); }
+	static constexpr double Build(double x) { return x < 0.5 ? 2.0 * EaseMath::Pow(x, 2) : 1.0 - EaseMath::Pow(-2.0 * x + 2.0, 2) / 2.0; }
+};
+
+template<> struct EaseCurve<EASE_IN_CUBIC>
+{
+	static float Exact(float x) { return EaseInCubic(x); }
+	static constexpr double Build(double x) { return EaseMath::Pow(x, 3); }
+};
+
+template<> struct EaseCurve<EASE_OUT_CUBIC>
+{
+	static float Exact(float x) { return EaseOutCubic(x); }
+	static constexpr double Build(double x) { return 1.0 - EaseMath::Pow(1.0 - x, 3); }
+};
+
+template<> struct EaseCurve<EASE_IN_OUT_CUBIC>
+{
+	static float Exact(float x) { return EaseInOutCubic(x); }
+	static constexpr double Build(double x) { return x < 0.5 ? 4.0 * EaseMath::Pow(x, 3) : 1.0 - EaseMath::Pow(-2.0 * x + 2.0, 3) / 2.0; }
+};
+
+template<> struct EaseCurve<EASE_IN_QUART>
+{
+	static float Exact(float x) { return EaseInQuart(x); }
+	static constexpr double Build(double x) { return EaseMath::Pow(x, 4); }
+};
+
+template<> struct EaseCurve<EASE_OUT_QUART>
+{
+	static float Exact(float x) { return EaseOutQuart(x); }
+	static constexpr double Build(double x) { return 1.0 - EaseMath::Pow(1.0 - x, 4); }
+};
+
+template<> struct EaseCurve<EASE_IN_OUT_QUART>
+{
+	static float Exact(float x) { return EaseInOutQuart(x); }
+	static constexpr double Build(double x) { return x < 0.5 ? 8.0 * EaseMath::Pow(x, 4) : 1.0 - EaseMath::Pow(-2.0 * x + 2.0, 4) / 2.0; }
+};
+
+template<> struct EaseCurve<EASE_IN_QUINT>
+{
+	static float Exact(float x) { return EaseInQuint(x); }
+	static constexpr double Build(double x) { return EaseMath::Pow(x, 5); }
+};
+
+template<> struct EaseCurve<EASE_OUT_QUINT>
+{
+	static float Exact(float x) { return EaseOutQuint(x); }
+	static constexpr double Build(double x) { return 1.0 - EaseMath::Pow(1.0 - x, 5); }
+};
+
+template<> struct EaseCurve<EASE_IN_OUT_QUINT>
+{
+	static float Exact(float x) { return EaseInOutQuint(x); }
+	static constexpr double Build(double x) { return x < 0.5 ? 16.0 * EaseMath::Pow(x, 5) : 1.0 - EaseMath::Pow(-2.0 * x + 2.0, 5) / 2.0; }
+};
+
+template<> struct EaseCurve<EASE_IN_EXPO>
+{
+	static float Exact(float x) { return EaseInExpo(x); }
+	static constexpr double Build(double x) { return x == 0.0 ? 0.0 : EaseMath::Exp2(10.0 * x - 10.0); }
+};
+
+template<> struct EaseCurve<EASE_OUT_EXPO>
+{
+	static float Exact(float x) { return EaseOutExpo(x); }
+	static constexpr double Build(double x) { return x == 1.0 ? 1.0 : 1.0 - EaseMath::Exp2(-10.0 * x); }
+};
+
+template<> struct EaseCurve<EASE_IN_OUT_EXPO>
+{
+	static float Exact(float x) { return EaseInOutExpo(x); }
+	static constexpr double Build(double x)
+	{
+		return x == 0.0 ? 0.0
+			: x == 1.0 ? 1.0
+			: x < 0.5 ? EaseMath::Exp2(20.0 * x - 10.0) / 2.0
+			: (2.0 - EaseMath::Exp2(-20.0 * x + 10.0)) / 2.0;
+	}
+};
+
+template<> struct EaseCurve<EASE_IN_CIRC>
+{
+	static float Exact(float x) { return EaseInCirc(x); }
+	static constexpr double Build(double x) { return 1.0 - EaseMath::Sqrt(1.0 - EaseMath::Pow(x, 2)); }
+};
+
+template<> struct EaseCurve<EASE_OUT_CIRC>
+{
+	static float Exact(float x) { return EaseOutCirc(x); }
+	static constexpr double Build(double x) { return EaseMath::Sqrt(1.0 - EaseMath::Pow(x - 1.0, 2)); }
+};
+
+template<> struct EaseCurve<EASE_IN_OUT_CIRC>
+{
+	static float Exact(float x) { return EaseInOutCirc(x); }
+	static constexpr double Build(double x)
+	{
+		return x < 0.5
+			? (1.0 - EaseMath::Sqrt(1.0 - EaseMath::Pow(2.0 * x, 2))) / 2.0
+			: (EaseMath::Sqrt(1.0 - EaseMath::Pow(-2.0 * x + 2.0, 2)) + 1.0) / 2.0;
+	}
+};
+
+template<> struct EaseCurve<EASE_IN_BACK>
+{
+	static float Exact(float x) { return EaseInBack(x); }
+	static constexpr double Build(double x) { return (1.70158 + 1.0) * EaseMath::Pow(x, 3) - 1.70158 * EaseMath::Pow(x, 2); }
+};
+
+template<> struct EaseCurve<EASE_OUT_BACK>
+{
+	static float Exact(float x) { return EaseOutBack(x); }
+	static constexpr double Build(double x) { return 1.0 + (1.70158 + 1.0) * EaseMath::Pow(x - 1.0, 3) + 1.70158 * EaseMath::Pow(x - 1.0, 2); }
+};
+
+template<> struct EaseCurve<EASE_IN_OUT_BACK>
+{
+	static float Exact(float x) { return EaseInOutBack(x); }
+	static constexpr double Build(double x)
+	{
+		return x < 0.5
+			? (EaseMath::Pow(2.0 * x, 2) * ((1.70158 * 1.525 + 1.0) * 2.0 * x - 1.70158 * 1.525)) / 2.0
+			: (EaseMath::Pow(2.0 * x - 2.0, 2) * ((1.70158 * 1.525 + 1.0) * (x * 2.0 - 2.0) + 1.70158 * 1.525) + 2.0) / 2.0;
+	}
+};
+
+template<> struct EaseCurve<EASE_IN_ELASTIC>
+{
+	static float Exact(float x) { return EaseInElastic(x); }
+	static constexpr double Build(double x)
+	{
+		return x == 0.0 ? 0.0
+			: x == 1.0 ? 1.0
+			: -EaseMath::Exp2(10.0 * x - 10.0) * EaseMath::Sin((x * 10.0 - 10.75) * (2.0 * EaseMath::pi) / 3.0);
+	}
+};
+
+template<> struct EaseCurve<EASE_OUT_ELASTIC>
+{
+	static float Exact(float x) { return EaseOutElastic(x); }
+	static constexpr double Build(double x)
+	{
+		return x == 0.0 ? 0.0
+			: x == 1.0 ? 1.0
+			: EaseMath::Exp2(-10.0 * x) * EaseMath::Sin((x * 10.0 - 0.75) * (2.0 * EaseMath::pi) / 3.0) + 1.0;
+	}
+};
+
+template<> struct EaseCurve<EASE_IN_OUT_ELASTIC>
+{
+	static float Exact(float x) { return EaseInOutElastic(x); }
+	static constexpr double Build(double x)
+	{
+		return x == 0.0 ? 0.0
+			: x == 1.0 ? 1.0
+			: x < 0.5
+			? -(EaseMath::Exp2(20.0 * x - 10.0) * EaseMath::Sin((20.0 * x - 11.125) * (2.0 * EaseMath::pi) / 4.5)) / 2.0
+			: (EaseMath::Exp2(-20.0 * x + 10.0) * EaseMath::Sin((20.0 * x - 11.125) * (2.0 * EaseMath::pi) / 4.5)) / 2.0 + 1.0;
+	}
+};
+
+template<> struct EaseCurve<EASE_OUT_BOUNCE>
+{
+	static float Exact(float x) { return EaseOutBounce(x); }
+	static constexpr double Build(double x)
+	{
+		return x < 1.0 / 2.75 ? 7.5625 * x * x
+			: x < 2.0 / 2.75 ? 7.5625 * EaseMath::Pow(x - 1.5 / 2.75, 2) + 0.75
+			: x < 2.5 / 2.75 ? 7.5625 * EaseMath::Pow(x - 2.25 / 2.75, 2) + 0.9375
+			: 7.5625 * EaseMath::Pow(x - 2.625 / 2.75, 2) + 0.984375;
+	}
+};
+
+template<> struct EaseCurve<EASE_IN_BOUNCE>
+{
+	static float Exact(float x) { return EaseInBounce(x); }
+	static constexpr double Build(double x) { return 1.0 - EaseCurve<EASE_OUT_BOUNCE>::Build(1.0 - x); }
+};
+
+template<> struct EaseCurve<EASE_IN_OUT_BOUNCE>
+{
+	static float Exact(float x) { return EaseInOutBounce(x); }
+	static constexpr double Build(double x)
+	{
+		return x < 0.5
+			? (1.0 - EaseCurve<EASE_OUT_BOUNCE>::Build(1.0 - 2.0 * x)) / 2.0
+			: (1.0 + EaseCurve<EASE_OUT_BOUNCE>::Build(2.0 * x - 1.0)) / 2.0;
+	}
+};
+
+// Unknown curve types jump straight to the end, like GetCurveByIndex
+template<> struct EaseCurve<EASE_CURVE_COUNT>
+{
+	static float Exact(float) { return 1.0f; }
+	static constexpr double Build(double) { return 1.0; }
+};
+
+#pragma endregion
+
+#pragma region TABLES
+
+struct EaseTable
+{
+	float values[EASE_LUT_SIZE + 1];
+};
+
+/// <summary>
+/// Sample a table between its two nearest samples. Progress is clamped to 0-1
+/// </summary>
+constexpr float SampleEaseLinear(const EaseTable& table, float x)
+{
+	float position = (x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x) * EASE_LUT_SIZE;
+	int i = (int)position < EASE_LUT_SIZE ? (int)position : EASE_LUT_SIZE - 1;
+	float t = position - i;
+	return table.values[i] + (table.values[i + 1] - table.values[i]) * t;
+}
+
+/// <summary>
+/// Sample a table with a Catmull-Rom spline through the four nearest
+/// samples. Smoother than linear, but it can ring a little at kinks
+/// </summary>
+constexpr float SampleEaseCubic(const EaseTable& table, float x)
+{
+	float position = (x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x) * EASE_LUT_SIZE;
+	int i = (int)position < EASE_LUT_SIZE ? (int)position : EASE_LUT_SIZE - 1;
+	float t = position - i;
+
+	// Past the ends the table is carried on in a straight line
+	float p1 = table.values[i];
+	float p2 = table.values[i + 1];
+	float p0 = i > 0 ? table.values[i - 1] : 2.0f * p1 - p2;
+	float p3 = i + 2 <= EASE_LUT_SIZE ? table.values[i + 2] : 2.0f * p2 - p1;
+	return p1 + 0.5f * t * ((p2 - p0) + t * ((2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) + t * (3.0f * (p1 - p2) + p3 - p0)));
+}
+
+template<int Curve>
+constexpr EaseTable BuildEaseTable()
+{
+	EaseTable table = {};
+	for (int i = 0; i <= EASE_LUT_SIZE; i++)
+	{
+		table.values[i] = (float)EaseCurve<Curve>::Build((double)i / EASE_LUT_SIZE);
+	}
+	return table;
+}
+
+/// <summary>
+/// Largest difference between a table and its curve in each mode
+/// </summary>
+struct EaseTableError
+{
+	float linear;
+	float cubic;
+};
+
+/// <summary>
+/// Difference between a table and its curve at a check point, in every mode
+/// </summary>
+template<int Curve>
+constexpr EaseTableError MeasureEaseCheck(const EaseTable& table, int check)
+{
+	double x = (double)check / EASE_LUT_CHECK_COUNT;
+	x = check <= 0 ? EASE_LUT_END_OFFSET : check >= EASE_LUT_CHECK_COUNT ? 1.0 - EASE_LUT_END_OFFSET : x;
+
+	double exact = EaseCurve<Curve>::Build(x);
+	double linear = SampleEaseLinear(table, (float)x) - exact;
+	double cubic = SampleEaseCubic(table, (float)x) - exact;
+	return { (float)(linear < 0.0 ? -linear : linear), (float)(cubic < 0.0 ? -cubic : cubic) };
+}
+
+/// <summary>
+/// Largest error between two neighbouring check points
+/// </summary>
+/// <param name="errors">Errors at the check points before, at the start of,
+/// at the end of and after the interval</param>
+/// <param name="check">The check point at the start of the interval</param>
+constexpr float BoundEaseInterval(const float* errors, int check)
+{
+	float worst = errors[1] > errors[2] ? errors[1] : errors[2];
+
+	// Lines through the points either side of the interval. The error
+	// drops back to nothing at every sample of the table, so lines are
+	// only taken from points within the same segment
+	bool hasRising = check % EASE_LUT_CHECKS_PER_SEGMENT != 0;
+	bool hasFalling = (check + 1) % EASE_LUT_CHECKS_PER_SEGMENT != 0;
+	double rising = hasRising ? (double)errors[1] - errors[0] : 0.0;
+	double falling = hasFalling ? (double)errors[3] - errors[2] : 0.0;
+
+	// Where the lines meet, or how far the one there is reaches across the
+	// interval. Error that isn't curving down is highest at one of the ends
+	double peak = worst;
+	if (hasRising && hasFalling)
+	{
+		double t = rising > falling ? ((double)errors[2] - errors[1] - falling) / (rising - falling) : -1.0;
+		peak = t > 0.0 && t < 1.0 ? errors[1] + rising * t : peak;
+	}
+	else if (hasRising)
+	{
+		peak = errors[1] + rising;
+	}
+	else if (hasFalling)
+	{
+		peak = errors[2] - falling;
+	}
+	return peak > worst ? (float)peak : worst;
+}
+
+/// <summary>
+/// Largest difference between a table and its curve in each mode,
+/// bounded between EASE_LUT_CHECKS_PER_SEGMENT points in every segment
+/// </summary>
+template<int Curve>
+constexpr EaseTableError MeasureEaseTable(const EaseTable& table)
+{
+	// Errors around the interval being bounded, moving along one check at a time
+	float linear[4] = {};
+	float cubic[4] = {};
+	for (int k = 0; k < 3; k++)
+	{
+		EaseTableError error = MeasureEaseCheck<Curve>(table, k);
+		linear[k + 1] = error.linear;
+		cubic[k + 1] = error.cubic;
+	}
+
+	EaseTableError worst = { 0.0f, 0.0f };
+	for (int i = 0; i < EASE_LUT_CHECK_COUNT; i++)
+	{
+		float linearBound = BoundEaseInterval(linear, i);
+		float cubicBound = BoundEaseInterval(cubic, i);
+		worst.linear = linearBound > worst.linear ? linearBound : worst.linear;
+		worst.cubic = cubicBound > worst.cubic ? cubicBound : worst.cubic;
+
+		EaseTableError next = MeasureEaseCheck<Curve>(table, i + 3);
+		for (int k = 0; k < 3; k++)
+		{
+			linear[k] = linear[k + 1];
+			cubic[k] = cubic[k + 1];
+		}
+		linear[3] = next.linear;
+		cubic[3] = next.cubic;
+	}
+	return worst;
+}
+
+/// <summary>
+/// A curve's table and how far it strays from the curve, all worked
+/// out by the compiler
+/// </summary>
+template<int Curve>
+struct EaseLut
+{
+	static constexpr EaseTable table = BuildEaseTable<Curve>();
+	static constexpr EaseTableError error = MeasureEaseTable<Curve>(table);
+	static constexpr float linearError = error.linear;
+	static constexpr float cubicError = error.cubic;
+
+	static_assert(linearError <= EASE_LUT_MAX_ERROR, "Easing table strays too far from its curve, raise EASE_LUT_SIZE");
+	static_assert(cubicError <= EASE_LUT_MAX_ERROR, "Easing table strays too far from its curve, raise EASE_LUT_SIZE");
+};
+
+template<int Curve> constexpr EaseTable EaseLut<Curve>::table;
+template<int Curve> constexpr EaseTableError EaseLut<Curve>::error;
+template<int Curve> constexpr float EaseLut<Curve>::linearError;
+template<int Curve> constexpr float EaseLut<Curve>::cubicError;
+
+#pragma endregion
+
+/// <summary>
+/// Evaluate a curve that is known at compile time, with no switch
+/// on the curve type or mode at run time
+/// </summary>
+template<int Curve, int Mode = EASE_MODE_EXACT>
+inline float Ease(float x)
+{
+	return Mode == EASE_MODE_LUT_LINEAR ? SampleEaseLinear(EaseLut<Curve>::table, x)
+		: Mode == EASE_MODE_LUT_CUBIC ? SampleEaseCubic(EaseLut<Curve>::table, x)
+		: EaseCurve<Curve>::Exact(x);
+}
+
+/// <summary>
+/// The Ease function of a curve and mode, for picking them at run time
+/// once and calling them many times. Unknown curves jump to the end
+/// </summary>
+EaseFunction GetEaseFunction(int curveType, int mode);
+/// <summary>
+/// The table of a curve, EASE_LUT_SIZE + 1 samples from 0 to 1
+/// </summary>
+const EaseTable& GetEaseTable(int curveType);
+/// <summary>
+/// How far a mode strays from the exact curve at most
+/// </summary>
+float GetEaseError(int curveType, int mode);
+/// <summary>
+/// GetCurveByIndex with a choice of how to evaluate it
+/// </summary>
+float GetCurveByIndex(int curveType, float p, int mode);
+/// <summary>
+/// Name of a curve for display
+/// </summary>
+const char* GetEaseName(int curveType);
+
+/// <summary>
+/// Accuracy and speed of every curve in every mode
+/// </summary>
+struct EaseBenchmarkResult
+{
+	float switchNanoseconds;				// GetCurveByIndex, for comparison
+	float nanoseconds[EASE_MODE_COUNT];	// Ease<Curve, Mode>
+	float maxError[EASE_MODE_COUNT];		// Against the exact curve on the benchmark's samples
+};
+
+/// <summary>
+/// Time and check every curve against the current functions
+/// </summary>
+/// <param name="results">EASE_CURVE_COUNT results, one per curve</param>
+/// <param name="samples">Points evaluated per curve and mode</param>
+void RunEaseBenchmark(EaseBenchmarkResult results[], unsigned int samples);
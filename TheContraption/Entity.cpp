@@ -1,9 +1,11 @@
 #include "Entity.h"
+#include <algorithm>
 
 #include <time.h> // TEMPORARY FOR NOISE
+using namespace DirectX;
 
 Entity::Entity(std::shared_ptr<Mesh> model, std::shared_ptr<Material> mat) :
-	model(model), mat(mat)
+	model(model), mat(mat), lod(0), cullStats(), isStatic(false)
 {
 	transform = std::make_shared<Transform>();
 }
@@ -28,50 +30,144 @@ void Entity::SetMat(std::shared_ptr<Material> nextMat)
 	mat = nextMat;
 }
 
+std::shared_ptr<SimpleVertexShader> Entity::GetVertexShader()
+{
+	return model->IsQuantized() ? mat->GetQuantizedVertexShader() : mat->GetVertexShader();
+}
+
+unsigned int Entity::SelectLod(std::shared_ptr<Camera> camera)
+{
+	if (model->GetLodCount() < 2)
+		return 0;
+
+	// The largest axis scale keeps the error and bounds conservative
+	XMFLOAT4X4 world = transform->GetWorldMatrix();
+	XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+	float scale = std::max(XMVectorGetX(XMVector3Length(worldMatrix.r[0])),
+		std::max(XMVectorGetX(XMVector3Length(worldMatrix.r[1])), XMVectorGetX(XMVector3Length(worldMatrix.r[2]))));
+
+	XMFLOAT3 boundsCenter = model->GetBoundsCenter();
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	XMVECTOR center = XMVector3Transform(XMLoadFloat3(&boundsCenter), worldMatrix);
+	float distance = XMVectorGetX(XMVector3Length(center - XMLoadFloat3(&cameraPosition))) - model->GetBoundsRadius() * scale;
+
+	// Inside of the bounds anything could be right in front of the camera
+	if (distance <= 0.0f)
+		return 0;
+
+	// The projection's y scale turns a size at a distance into a fraction of half the screen
+	float projectionScale = camera->GetProjMatrix()->_22 * scale / distance;
+	unsigned int selected = 0;
+	for (unsigned int i = 1; i < model->GetLodCount(); i++)
+	{
+		if (model->GetLodError(i) * projectionScale > MESH_LOD_SCREEN_ERROR)
+			break;
+		selected = i;
+	}
+	return selected;
+}
+
+unsigned int Entity::GetLod()
+{
+	return lod;
+}
+
+MeshletCullStats Entity::GetCullStats()
+{
+	return cullStats;
+}
+
+void Entity::SetStatic(bool isStatic)
+{
+	(*this).isStatic = isStatic;
+}
+
+bool Entity::IsStatic()
+{
+	return isStatic;
+}
+
+bool Entity::Raycast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, MeshHit& hit)
+{
+	XMFLOAT3 meshOrigin;
+	XMFLOAT3 meshDirection;
+	const MeshBvh* bvh = GetMeshRay(origin, direction, meshOrigin, meshDirection);
+	return bvh && bvh->Raycast(meshOrigin, meshDirection, maxDistance, hit);
+}
+
+bool Entity::Occluded(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance)
+{
+	XMFLOAT3 meshOrigin;
+	XMFLOAT3 meshDirection;
+	const MeshBvh* bvh = GetMeshRay(origin, direction, meshOrigin, meshDirection);
+	return bvh && bvh->Occluded(meshOrigin, meshDirection, maxDistance);
+}
+
+const MeshBvh* Entity::GetMeshRay(const XMFLOAT3& origin, const XMFLOAT3& direction, XMFLOAT3& meshOrigin, XMFLOAT3& meshDirection)
+{
+	if (!model->BuildBvh())
+		return nullptr;
+
+	// The direction is not renormalized, so a distance along it means the same in both spaces
+	XMFLOAT4X4 world = transform->GetWorldMatrix();
+	XMMATRIX inverseWorld = XMMatrixInverse(nullptr, XMLoadFloat4x4(&world));
+	XMStoreFloat3(&meshOrigin, XMVector3TransformCoord(XMLoadFloat3(&origin), inverseWorld));
+	XMStoreFloat3(&meshDirection, XMVector3TransformNormal(XMLoadFloat3(&direction), inverseWorld));
+	return model->GetBvh();
+}
+
 void Entity::Draw(
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, 
 	std::shared_ptr<Camera> camera)
 {
-	mat->GetVertexShader()->SetShader();
+	std::shared_ptr<SimpleVertexShader> vs = GetVertexShader();
+	vs->SetShader();
 	mat->GetPixelShader()->SetShader();
 
 
-	std::shared_ptr<SimpleVertexShader> vs = mat->GetVertexShader();
 	vs->SetFloat4("colorTint", mat->GetTint());
-	vs->SetMatrix4x4("world", transform->GetWorldMatrix()); 
+	vs->SetData("world", &transform->GetAffineWorldMatrix(), sizeof(AffineMatrix)); 
 	vs->SetMatrix4x4("viewMatrix", *camera->GetViewMatrix().get()); 
 	vs->SetMatrix4x4("projMatrix", *camera->GetProjMatrix().get()); 
-	vs->SetMatrix4x4("worldInvTranspose", transform->GetWorldInverseTransposeMatrix());
+	vs->SetData("worldInvTranspose", &transform->GetAffineWorldInverseTransposeMatrix(), sizeof(AffineMatrix));
+	if (model->IsQuantized())
+	{
+		vs->SetFloat3("positionOffset", model->GetPositionOffset());
+		vs->SetFloat3("positionScale", model->GetPositionScale());
+	}
 
 	vs->CopyAllBufferData();
 
 	std::shared_ptr<SimplePixelShader> ps = mat->GetPixelShader();
 	ps->SetFloat4("colorTint", mat->GetTint());
 
-	ps->SetFloat3("camPos", *(camera->GetTransform()->GetPosition().get()));
+	ps->SetFloat3("camPos", camera->GetTransform()->GetPosition());
 	ps->SetFloat("roughness", mat->GetRoughness());
 	ps->SetFloat2("uvOffset", mat->GetUVOffset());
 
 	ps->SetFloat("ditherLevel", mat->GetDitherLevel());
+	ps->SetInt("metalRoughnessPacked", mat->GetMetalRoughnessPacked());
 
 	ps->CopyAllBufferData();
 
 	mat->PrepareMaterial();
 
-	model->Draw();
+	lod = SelectLod(camera);
+	model->Draw(transform->GetWorldMatrix(), *camera->GetViewMatrix().get(), *camera->GetProjMatrix().get(), lod);
+	cullStats = model->GetCullStats();
 }
 
 void Entity::Draw(
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, 
 	std::shared_ptr<Camera> camera, float time)
 {
-	mat->GetVertexShader()->SetShader();
+	std::shared_ptr<SimpleVertexShader> vs = GetVertexShader();
+	vs->SetShader();
 	mat->GetPixelShader()->SetShader();
 
 
-	std::shared_ptr<SimpleVertexShader> vs = mat->GetVertexShader();
 	//vs->SetFloat4("colorTint", mat->GetTint()); // Strings here MUST
-	vs->SetMatrix4x4("world", transform->GetWorldMatrix()); // match variable
+	vs->SetData("world", &transform->GetAffineWorldMatrix(), sizeof(AffineMatrix)); // match variable
 	vs->SetMatrix4x4("viewMatrix", *camera->GetViewMatrix().get()); // names in your
 	vs->SetMatrix4x4("projMatrix", *camera->GetProjMatrix().get()); // shaders cbuffer!
 
@@ -83,5 +179,7 @@ void Entity::Draw(
 
 	ps->CopyAllBufferData();
 
-	model->Draw();
+	lod = SelectLod(camera);
+	model->Draw(transform->GetWorldMatrix(), *camera->GetViewMatrix().get(), *camera->GetProjMatrix().get(), lod);
+	cullStats = model->GetCullStats();
 }
@@ -15,6 +15,11 @@ private:
 	std::shared_ptr <Transform> transform;
 	std::shared_ptr<Mesh> model;
 	std::shared_ptr<Material> mat;
+	unsigned int lod;
+	MeshletCullStats cullStats;
+	bool isStatic;
+
+	const MeshBvh* GetMeshRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, DirectX::XMFLOAT3& meshOrigin, DirectX::XMFLOAT3& meshDirection);
 	
 public:
 	Entity(std::shared_ptr<Mesh> model, std::shared_ptr<Material> mat);
@@ -24,6 +29,45 @@ public:
 	std::shared_ptr<Material> GetMat();
 	void SetMat(std::shared_ptr<Material> nextMat);
 
+	/// <summary>
+	/// The material's vertex shader that can read this entity's mesh
+	/// </summary>
+	std::shared_ptr<SimpleVertexShader> GetVertexShader();
+
+	/// <summary>
+	/// Pick the simplest LOD of the mesh whose error still stays under
+	/// MESH_LOD_SCREEN_ERROR once it is projected by the camera
+	/// </summary>
+	unsigned int SelectLod(std::shared_ptr<Camera> camera);
+	/// <summary>
+	/// LOD picked for the last draw
+	/// </summary>
+	unsigned int GetLod();
+	/// <summary>
+	/// Meshlets the last draw kept and threw away. Meshes can be
+	/// shared, so this is the entity's own copy of its draw
+	/// </summary>
+	MeshletCullStats GetCullStats();
+
+	/// <summary>
+	/// Static entities never move once the scene is built, so their
+	/// meshes can be merged into the scene's static batches
+	/// </summary>
+	void SetStatic(bool isStatic);
+	bool IsStatic();
+
+	/// <summary>
+	/// Find where a world space ray first hits the entity's mesh. The ray
+	/// is moved into mesh space so distances stay in multiples of the
+	/// world direction. Builds the mesh's BVH the first time
+	/// </summary>
+	/// <returns>False if nothing was hit within maxDistance</returns>
+	bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, MeshHit& hit);
+	/// <summary>
+	/// Whether a world space ray hits the entity's mesh at all
+	/// </summary>
+	bool Occluded(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance);
+
 	// In the future this could be allocated to a rendering class that holds all drawing data intstead
 	// of objects drawing themselves 
 	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera>);
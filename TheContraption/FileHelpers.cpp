@@ -0,0 +1,65 @@
+#include "FileHelpers.h"
+
+#ifndef _WIN32
+#include <cstdlib>
+#include <cwchar>
+#include <string>
+#endif
+
+#ifdef _WIN32
+
+FILE* OpenForReading(const wchar_t* path)
+{
+	FILE* file = nullptr;
+	return _wfopen_s(&file, path, L"rb") == 0 ? file : nullptr;
+}
+
+FILE* OpenForWriting(const wchar_t* path)
+{
+	FILE* file = nullptr;
+	return _wfopen_s(&file, path, L"wb") == 0 ? file : nullptr;
+}
+
+void RemoveFile(const wchar_t* path)
+{
+	_wremove(path);
+}
+
+bool MoveIntoPlace(const wchar_t* from, const wchar_t* to)
+{
+	_wremove(to);
+	return _wrename(from, to) == 0;
+}
+
+#else
+
+// POSIX paths are narrow
+static std::string NarrowPath(const wchar_t* path)
+{
+	std::string narrowPath(std::wcslen(path) * MB_CUR_MAX + 1, '\0');
+	size_t length = std::wcstombs(&narrowPath[0], path, narrowPath.size());
+	narrowPath.resize(length == (size_t)-1 ? 0 : length);
+	return narrowPath;
+}
+
+FILE* OpenForReading(const wchar_t* path)
+{
+	return std::fopen(NarrowPath(path).c_str(), "rb");
+}
+
+FILE* OpenForWriting(const wchar_t* path)
+{
+	return std::fopen(NarrowPath(path).c_str(), "wb");
+}
+
+void RemoveFile(const wchar_t* path)
+{
+	std::remove(NarrowPath(path).c_str());
+}
+
+bool MoveIntoPlace(const wchar_t* from, const wchar_t* to)
+{
+	return std::rename(NarrowPath(from).c_str(), NarrowPath(to).c_str()) == 0;
+}
+
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdio>
+
+// Helpers for working with files by their wide paths on any platform
+FILE* OpenForReading(const wchar_t* path);
+FILE* OpenForWriting(const wchar_t* path);
+void RemoveFile(const wchar_t* path);
+// Replace a file with another one, for files written under a temporary name
+bool MoveIntoPlace(const wchar_t* from, const wchar_t* to);
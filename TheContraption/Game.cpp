@@ -4,8 +4,11 @@
 #include "PathHelpers.h"
 
 #include <memory>
+#include <chrono>
 #include "Mesh.h"
 #include "Transform.h"
+#include "GltfImporter.h"
+#include "FileHelpers.h"
 
 
 // Assumes files are in "ImGui" subfolder!
@@ -57,18 +60,24 @@ Game::~Game()
 
 void Game::Init()
 {
+	// Every mesh is uploaded into the shared geometry buffers
+	GeometryArena::GetInstance().Initialize(device, context);
+
 	scene = std::make_shared<Scene>("General");
 	sceneGui = std::make_shared<SceneGui>(scene);
 
 	animScene = std::make_shared<Scene>("Anim");
 	animSceneGui = std::make_shared<SceneGui>(animScene);
 	animManager = std::make_shared<BasicAnimationManager>();
+	clipPlayer = std::make_shared<AnimClipPlayer>();
 
 	shadowScene = std::make_shared<Scene>("Shadow");
 	shadowSceneGui = std::make_shared<SceneGui>(shadowScene);
 
 	skeleScene = std::make_shared<Scene>("Skeletal Anim");
 	skeleSceneGui = std::make_shared<SceneGui>(skeleScene);
+	skinnedAnimator = std::make_shared<SkinnedAnimator>(device, context);
+	morphAnimator = std::make_shared<MorphAnimator>(device, context);
 
 	scenes.push_back(scene);
 	scenes.push_back(animScene);
@@ -87,6 +96,20 @@ void Game::Init()
 	eyeSepCurve = EASE_OUT_ELASTIC;
 	eyeComTime = 1.0f;
 	eyeComCurve = EASE_IN_BOUNCE;
+	easeMode = EASE_MODE_EXACT;
+	hasEaseBenchmark = false;
+	hasTransformBenchmark = false;
+	hasObjBenchmark = false;
+	eyeClipInstance = CLIP_NONE;
+	eyePathType = SPLINE_CATMULL_ROM;
+	eyePathCurve = EASE_IN_OUT_SINE;
+	eyePathTime = 3.0f;
+	eyeFollowPath = false;
+	skinningMode = SKINNING_LINEAR;
+	skinnedBlend = 0.0f;
+	useCompressedClips = false;
+	panelInstance = MORPH_NONE;
+	panelClipInstance = CLIP_NONE;
 
 	buttonCooldown = 2.0f;
 
@@ -97,6 +120,9 @@ void Game::Init()
 	LoadShadowResources();
 	CreateGeometry();
 	CreateCameras();
+	CreateAnimClips();
+	CreateSkinnedCharacters();
+	CreateMorphPanel();
 	
 	// Set initial graphics API state
 	//  - These settings persist until we change them
@@ -228,6 +254,20 @@ void Game::LoadLights()
 
 	shadowScene->SetLights(lightsShadow);
 	#pragma endregion
+
+	#pragma region SkeletalScene
+	std::vector<std::shared_ptr<Light>> lightsSkeletal = std::vector<std::shared_ptr<Light>>();
+
+	Light skeleDir = {};
+	skeleDir.type = LIGHT_TYPE_DIRECTIONAL;
+	skeleDir.directiton = DirectX::XMFLOAT3(0.5f, -1, 1);
+	skeleDir.color = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+	skeleDir.intensity = 1.0;
+	skeleDir.hasShadows = false;
+	lightsSkeletal.push_back(std::make_shared<Light>(skeleDir));
+
+	skeleScene->SetLights(lightsSkeletal);
+	#pragma endregion
 }
 
 void Game::SetupLitMaterial(
@@ -265,18 +305,29 @@ void Game::SetupPBRMaterial(
 {
 	// Create the data storage struct 
 	std::shared_ptr<MatData> tempData = std::make_shared<MatData>(device);
-	matToResources[mat] = tempData;
 	MatData* data = tempData.get();
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> dither;
-	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> dithers(MAX_DITHERS);
-
 	// Load in the textures and store them into matdata
 	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(albedoTextureAddress).c_str(), nullptr, data->albedo.GetAddressOf());
 	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(normalMapAddress).c_str(), nullptr, data->normal.GetAddressOf());
 	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(roughnessMapAddress).c_str(), nullptr, data->roughness.GetAddressOf());
 	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(metalMapAddress).c_str(), nullptr, data->metal.GetAddressOf());
-	
+
+	SetupPBRMaterial(mat, tempData, sky, samplerType);
+}
+
+void Game::SetupPBRMaterial(
+	std::shared_ptr<Material> mat,
+	std::shared_ptr<MatData> tempData,
+	Sky* sky,
+	const char samplerType[])
+{
+	matToResources[mat] = tempData;
+	MatData* data = tempData.get();
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> dither;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> dithers(MAX_DITHERS);
+
 	CreateWICTextureFromFile(device.Get(), context.Get(), 
 		FixPath(L"../../Assets/Textures/Dither/BasicDither.png").c_str(), nullptr, dither.GetAddressOf());
 	
@@ -317,6 +368,144 @@ void Game::SetupPBRMaterial(
 	MaterialsPBR.push_back(mat);
 }
 
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Game::CreateSolidTexture(DirectX::XMFLOAT4 color)
+{
+	// A single texel, so a constant can go through the same shader as a texture
+	unsigned char texel[4] =
+	{
+		(unsigned char)(std::min(std::max(color.x, 0.0f), 1.0f) * 255.0f + 0.5f),
+		(unsigned char)(std::min(std::max(color.y, 0.0f), 1.0f) * 255.0f + 0.5f),
+		(unsigned char)(std::min(std::max(color.z, 0.0f), 1.0f) * 255.0f + 0.5f),
+		(unsigned char)(std::min(std::max(color.w, 0.0f), 1.0f) * 255.0f + 0.5f),
+	};
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = texel;
+	initialData.SysMemPitch = sizeof(texel);
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	device->CreateTexture2D(&desc, &initialData, texture.GetAddressOf());
+	if (texture)
+		device->CreateShaderResourceView(texture.Get(), nullptr, srv.GetAddressOf());
+	return srv;
+}
+
+std::vector<std::shared_ptr<Entity>> Game::LoadGltf(const wchar_t file[], Sky* sky, bool quantize)
+{
+	std::vector<std::shared_ptr<Entity>> entities;
+
+	GltfAsset asset;
+	if (!GltfImporter::Load(FixPath(file).c_str(), asset))
+		return entities;
+
+	// Embedded images are decoded straight out of the mapped file
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> images(asset.images.size());
+	for (size_t i = 0; i < asset.images.size(); i++)
+	{
+		if (asset.images[i].data != nullptr)
+		{
+			CreateWICTextureFromMemory(device.Get(), context.Get(),
+				asset.images[i].data, asset.images[i].size, nullptr, images[i].GetAddressOf());
+		}
+	}
+
+	// Primitives without a material get glTF's default one
+	GltfMaterial defaultMaterial = { "", XMFLOAT4(1, 1, 1, 1), 1.0f, 1.0f, GLTF_NONE, GLTF_NONE, GLTF_NONE };
+	asset.materials.push_back(defaultMaterial);
+
+	// Factors only stand in for textures the material doesn't have
+	std::vector<std::shared_ptr<Material>> materials;
+	for (const GltfMaterial& gltfMaterial : asset.materials)
+	{
+		std::shared_ptr<Material> mat = std::make_shared<Material>(
+			gltfMaterial.baseColor,
+			gltfMaterial.roughness,
+			0.0f,
+			DirectX::XMFLOAT2(0, 0),
+			vertexShader, schlickShader);
+		mat->SetQuantizedVertexShader(quantizedVertexShader);
+
+		std::shared_ptr<MatData> data = std::make_shared<MatData>(device);
+		data->albedo = gltfMaterial.baseColorImage != GLTF_NONE && images[gltfMaterial.baseColorImage] ?
+			images[gltfMaterial.baseColorImage] : CreateSolidTexture(gltfMaterial.baseColor);
+		data->normal = gltfMaterial.normalImage != GLTF_NONE && images[gltfMaterial.normalImage] ?
+			images[gltfMaterial.normalImage] : CreateSolidTexture(XMFLOAT4(0.5f, 0.5f, 1, 1));
+
+		if (gltfMaterial.metallicRoughnessImage != GLTF_NONE && images[gltfMaterial.metallicRoughnessImage])
+		{
+			data->roughness = images[gltfMaterial.metallicRoughnessImage];
+			data->metal = images[gltfMaterial.metallicRoughnessImage];
+			mat->SetMetalRoughnessPacked(true);
+		}
+		else
+		{
+			data->roughness = CreateSolidTexture(XMFLOAT4(gltfMaterial.roughness, 0, 0, 1));
+			data->metal = CreateSolidTexture(XMFLOAT4(gltfMaterial.metallic, 0, 0, 1));
+		}
+
+		SetupPBRMaterial(mat, data, sky);
+		materials.push_back(mat);
+	}
+
+	// Every node becomes a transform, parents come first so they always exist
+	std::vector<std::shared_ptr<Transform>> nodes(asset.nodes.size());
+	for (size_t i = 0; i < asset.nodes.size(); i++)
+	{
+		const GltfNode& node = asset.nodes[i];
+		nodes[i] = std::make_shared<Transform>();
+		nodes[i]->SetPosition(node.translation);
+		nodes[i]->SetRotation(node.rotation);
+		nodes[i]->SetScale(node.scale);
+
+		// Children are kept alive by their parents, only roots need an owner
+		if (node.parent != GLTF_NONE)
+			nodes[i]->SetParent(nodes[node.parent]);
+		else
+			gltfRoots.push_back(nodes[i]);
+	}
+
+	// One entity per primitive, hanging off of the node that uses the mesh
+	std::vector<std::vector<std::shared_ptr<Mesh>>> meshes(asset.meshes.size());
+	for (size_t m = 0; m < asset.meshes.size(); m++)
+	{
+		for (GltfPrimitive& primitive : asset.meshes[m].primitives)
+		{
+			meshes[m].push_back(std::make_shared<Mesh>(device, context, primitive.data, quantize));
+		}
+	}
+
+	for (size_t i = 0; i < asset.nodes.size(); i++)
+	{
+		int mesh = asset.nodes[i].mesh;
+		if (mesh == GLTF_NONE)
+			continue;
+
+		for (size_t p = 0; p < meshes[mesh].size(); p++)
+		{
+			int material = asset.meshes[mesh].primitives[p].material;
+			if (material < 0 || material >= (int)materials.size() - 1)
+				material = (int)materials.size() - 1;
+
+			std::shared_ptr<Entity> entity = std::make_shared<Entity>(meshes[mesh][p], materials[material]);
+			entity->GetTransform()->SetParent(nodes[i]);
+			entities.push_back(entity);
+		}
+	}
+
+	return entities;
+}
+
 
 void Game::LoadShaders()
 {
@@ -332,9 +521,72 @@ void Game::LoadShaders()
 		FixPath(L"litPS.cso").c_str());
 	schlickShader = std::make_shared< SimplePixelShader>(device, context,
 		FixPath(L"Schlick.cso").c_str());
+
+	// Reflection would read the quantized inputs as plain floats, so 
+	// describe the normalized integers and halves of QuantizedVertex here 
+	D3D11_INPUT_ELEMENT_DESC quantizedElements[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	Microsoft::WRL::ComPtr<ID3DBlob> quantizedBlob;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> quantizedLayout;
+	D3DReadFileToBlob(FixPath(L"QuantizedVertexShader.cso").c_str(), quantizedBlob.GetAddressOf());
+	device->CreateInputLayout(
+		quantizedElements, 
+		ARRAYSIZE(quantizedElements), 
+		quantizedBlob->GetBufferPointer(), 
+		quantizedBlob->GetBufferSize(), 
+		quantizedLayout.GetAddressOf());
+
+	// Both take the same input so they can share the layout 
+	quantizedVertexShader = std::make_shared<SimpleVertexShader>(device, context,
+		FixPath(L"QuantizedVertexShader.cso").c_str(), quantizedLayout, false);
+	quantizedShadowVS = std::make_shared<SimpleVertexShader>(device, context,
+		FixPath(L"QuantizedShadowMapVertexShader.cso").c_str(), quantizedLayout, false);
 	
 }
 
+std::shared_ptr<Mesh> Game::LoadMesh(const wchar_t file[], bool quantize)
+{
+	LoadedMesh loaded = {};
+	loaded.file = FixPath(file);
+	loaded.mesh = std::make_shared<Mesh>(device, context, loaded.file.c_str(), quantize);
+
+	std::string path = WideToNarrow(file);
+	loaded.name = path.substr(path.find_last_of('/') + 1);
+	loadedMeshes.push_back(loaded);
+	return loaded.mesh;
+}
+
+void Game::MeasureMeshOrder()
+{
+	for (LoadedMesh& loaded : loadedMeshes)
+	{
+		// Welded straight out of the file, then what actually went to the GPU
+		MeshData data;
+		if (!ObjImporter::Load(loaded.file.c_str(), data, false))
+			continue;
+		loaded.cacheBefore = MeshOptimizer::AnalyzeVertexCache(data.indices, (unsigned int)data.vertices.size());
+		loaded.overdrawBefore = MeshOptimizer::AnalyzeOverdraw(data);
+
+		if (!loaded.mesh->ReadGeometry(data))
+			continue;
+		loaded.cacheAfter = MeshOptimizer::AnalyzeVertexCache(data.indices, (unsigned int)data.vertices.size());
+		loaded.overdrawAfter = MeshOptimizer::AnalyzeOverdraw(data);
+		loaded.measured = true;
+
+		if (loaded.mesh->IsQuantized())
+			continue;
+		QuantizedMeshData quantized;
+		VertexQuantizer::Quantize(&data.vertices[0], (unsigned int)data.vertices.size(), quantized);
+		loaded.quantizationError = VertexQuantizer::MeasureError(&data.vertices[0], quantized);
+	}
+}
+
 void Game::CreateGeometry()
 {
 	D3D11_SAMPLER_DESC sampDesc = {};
@@ -357,24 +609,30 @@ void Game::CreateGeometry()
 	device.Get()->CreateSamplerState(&sampDesc, sampler.GetAddressOf());
 	
 	#pragma region MODELS
+	auto modelLoadStart = std::chrono::high_resolution_clock::now();
 
 	// General Models 
-	std::shared_ptr<Mesh> sphere = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/sphere.obj").c_str());
-	std::shared_ptr<Mesh> helix = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/helix.obj").c_str());
-	std::shared_ptr<Mesh> cube = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/cube.obj").c_str());
-	std::shared_ptr<Mesh> torus = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/torus.obj").c_str());
-	std::shared_ptr<Mesh> quad = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/quad_double_sided.obj").c_str());
-	std::shared_ptr<Mesh> lightGUIModel = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/LightGUIModel.obj").c_str());
+	// - Passing true quantizes the vertices, which needs the materials 
+	//   to have a quantized vertex shader as well 
+	std::shared_ptr<Mesh> sphere = LoadMesh(L"../../Assets/Models/sphere.obj");
+	std::shared_ptr<Mesh> helix = LoadMesh(L"../../Assets/Models/helix.obj", true);
+	std::shared_ptr<Mesh> cube = LoadMesh(L"../../Assets/Models/cube.obj");
+	std::shared_ptr<Mesh> torus = LoadMesh(L"../../Assets/Models/torus.obj");
+	std::shared_ptr<Mesh> quad = LoadMesh(L"../../Assets/Models/quad_double_sided.obj");
+	std::shared_ptr<Mesh> lightGUIModel = LoadMesh(L"../../Assets/Models/LightGUIModel.obj");
 
 	// Setup mec eye 
-	std::shared_ptr<Mesh> connectionA = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/MecEye/ConnectionA.obj").c_str());
-	std::shared_ptr<Mesh> connectionB = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/MecEye/ConnectionB.obj").c_str());
-	std::shared_ptr<Mesh> connectionC = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/MecEye/ConnectionC.obj").c_str());
-	std::shared_ptr<Mesh> Eye_Front = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/MecEye/Eye_Front.obj").c_str());
-	std::shared_ptr<Mesh> Eye_Mid = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/MecEye/Eye_Mid.obj").c_str());
-	std::shared_ptr<Mesh> Eye_Back = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/MecEye/Eye_Back.obj").c_str());
-	std::shared_ptr<Mesh> HeatSink = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/MecEye/HeatSink.obj").c_str());
-	std::shared_ptr<Mesh> Microchip = std::make_shared<Mesh>(device, context, FixPath(L"../../Assets/Models/MecEye/Microchip.obj").c_str());
+	std::shared_ptr<Mesh> connectionA = LoadMesh(L"../../Assets/Models/MecEye/ConnectionA.obj", true);
+	std::shared_ptr<Mesh> connectionB = LoadMesh(L"../../Assets/Models/MecEye/ConnectionB.obj", true);
+	std::shared_ptr<Mesh> connectionC = LoadMesh(L"../../Assets/Models/MecEye/ConnectionC.obj", true);
+	std::shared_ptr<Mesh> Eye_Front = LoadMesh(L"../../Assets/Models/MecEye/Eye_Front.obj", true);
+	std::shared_ptr<Mesh> Eye_Mid = LoadMesh(L"../../Assets/Models/MecEye/Eye_Mid.obj", true);
+	std::shared_ptr<Mesh> Eye_Back = LoadMesh(L"../../Assets/Models/MecEye/Eye_Back.obj", true);
+	std::shared_ptr<Mesh> HeatSink = LoadMesh(L"../../Assets/Models/MecEye/HeatSink.obj", true);
+	std::shared_ptr<Mesh> Microchip = LoadMesh(L"../../Assets/Models/MecEye/Microchip.obj", true);
+
+	auto modelLoadEnd = std::chrono::high_resolution_clock::now();
+	modelLoadTime = std::chrono::duration<float, std::milli>(modelLoadEnd - modelLoadStart).count();
 
 	#pragma endregion
 
@@ -431,6 +689,13 @@ void Game::CreateGeometry()
 		DirectX::XMFLOAT2(0, 0), 
 		vertexShader, schlickShader);
 
+	// Any of these can be used on a quantized mesh 
+	std::shared_ptr<Material> materials[] = { mat1, mat2, mat3, lit, schlickBricks, rough, wood, schlickBronze };
+	for (std::shared_ptr<Material> material : materials)
+	{
+		material->SetQuantizedVertexShader(quantizedVertexShader);
+	}
+
 
 	std::shared_ptr<Sky> sky = std::make_shared<Sky>(
 		device,
@@ -515,6 +780,14 @@ void Game::CreateGeometry()
 	entities.push_back(std::shared_ptr<Entity>(new Entity(cube, rough)));
 	entities[2]->GetTransform()->MoveRelative(-5.0f, 0.0f, 0.0f);
 
+	// glTF lamp, its parts hang off of the node hierarchy and the head has a primitive per material
+	std::vector<std::shared_ptr<Entity>> lamp = LoadGltf(L"../../Assets/Models/Lamp.glb", sky.get());
+	if (!lamp.empty())
+	{
+		gltfRoots.back()->SetPosition(0.0f, -1.0f, 4.0f);
+		entities.insert(entities.end(), lamp.begin(), lamp.end());
+	}
+
 	// Put all into scene(s)
 	scene->SetEntities(entities);
 	scene->GenerateLightGizmos(lightGUIModel, vertexShader, pixelShader);
@@ -537,6 +810,11 @@ void Game::CreateGeometry()
 	entities2.push_back(std::shared_ptr<Entity>(new Entity(HeatSink, schlickBronze)));
 	entities2.push_back(std::shared_ptr<Entity>(new Entity(Microchip, schlickBronze)));
 
+	// Parts that travel with the back of the eye are parented to it
+	// so the whole assembly follows a single animated transform 
+	entities2[5]->GetTransform()->AddChild(entities2[6]->GetTransform()); // Heatsink
+	entities2[5]->GetTransform()->AddChild(entities2[7]->GetTransform()); // Microchip
+
 
 	animScene->SetEntities(entities2);
 	animScene->GenerateLightGizmos(lightGUIModel, vertexShader, pixelShader);
@@ -556,18 +834,29 @@ void Game::CreateGeometry()
 
 	shadowEntities.push_back(std::shared_ptr<Entity>(new Entity(cube, rough)));
 	shadowEntities[2]->GetTransform()->MoveRelative(-5.0f, 0.0f, 0.0f);
+	shadowEntities[2]->SetStatic(true);
 	
 	shadowEntities.push_back(std::shared_ptr<Entity>(new Entity(quad, wood)));
 	shadowEntities[3]->GetTransform()->MoveRelative(0.0f, -2.0f, 0.0f);
 	shadowEntities[3]->GetTransform()->SetScale(DirectX::XMFLOAT3(10, 1, 10));
+	shadowEntities[3]->SetStatic(true);
 
 	shadowEntities.push_back(std::shared_ptr<Entity>(new Entity(quad, rough)));
 	shadowEntities[4]->GetTransform()->MoveRelative(0.0f, -10.0f, 0.0f);
 	shadowEntities[4]->GetTransform()->SetScale(DirectX::XMFLOAT3(20, 1, 20));
+	shadowEntities[4]->SetStatic(true);
 
 	// Put all into scene(s)
 	shadowScene->SetEntities(shadowEntities);
 	shadowScene->GenerateLightGizmos(lightGUIModel, vertexShader, pixelShader);
+	shadowScene->BuildStaticBatches(device, context);
+
+	#pragma endregion
+
+	#pragma region SKELETAL_SCENE_ENTITIES
+
+	// The skinned characters themselves come from CreateSkinnedCharacters 
+	skeleScene->GenerateLightGizmos(lightGUIModel, vertexShader, pixelShader);
 
 	#pragma endregion
 }
@@ -689,7 +978,7 @@ void Game::AnimSceneLogic(float deltaTime)
 	static DirectX::XMFLOAT3 front	(0, 0,	1.0f);
 	static DirectX::XMFLOAT3 back	(0, 0, -1.0f);
 
-	if (animManager->IsRunningAnimations())
+	if (animManager->IsRunningAnimations() || clipPlayer->IsPlaying(eyeClipInstance))
 	{
 		startAnimation = false;
 		return;
@@ -718,21 +1007,7 @@ void Game::AnimSceneLogic(float deltaTime)
 			isSplit ? eyeComCurve : eyeSepCurve
 		);
 
-		animManager->AddAnimation( // Heatsink
-			animScene->GetEntities()[6]->GetTransform(),
-			isSplit ? back : rest,
-			isSplit ? rest : back,
-			isSplit ? eyeComTime : eyeSepTime,
-			isSplit ? eyeComCurve : eyeSepCurve
-		);
-
-		animManager->AddAnimation( // Microchip
-			animScene->GetEntities()[7]->GetTransform(),
-			isSplit ? back : rest,
-			isSplit ? rest : back,
-			isSplit ? eyeComTime : eyeSepTime,
-			isSplit ? eyeComCurve : eyeSepCurve
-		);
+		// Heatsink and Microchip are children of Eye_Back and follow it 
 
 
 		isSplit = !isSplit;
@@ -740,6 +1015,305 @@ void Game::AnimSceneLogic(float deltaTime)
 	
 }
 
+/// <summary>
+/// Build the keyframed clips of the animation scene. Parts are
+/// bound when a clip is played, see the Animation Controls
+/// </summary>
+void Game::CreateAnimClips()
+{
+	// Eye cycle: pull apart, spin the front, put back together 
+	// Parts: 0 Eye_Front, 1 Eye_Back, 2 point light 
+	eyeClip = std::make_shared<AnimClip>(4.0f);
+
+	unsigned int frontPosition = eyeClip->AddTrack(0, CLIP_TRACK_POSITION);
+	eyeClip->AddKey(frontPosition, 0.0f, XMFLOAT4(0, 0, 0, 0));
+	eyeClip->AddHermiteKey(frontPosition, 1.0f, XMFLOAT4(0, 0, 1.0f, 0), XMFLOAT4(0, 0, 0.5f, 0), XMFLOAT4(0, 0, 0, 0));
+	eyeClip->AddKey(frontPosition, 3.0f, XMFLOAT4(0, 0, 1.0f, 0));
+	eyeClip->AddKey(frontPosition, 4.0f, XMFLOAT4(0, 0, 0, 0));
+
+	unsigned int backPosition = eyeClip->AddTrack(1, CLIP_TRACK_POSITION);
+	eyeClip->AddKey(backPosition, 0.0f, XMFLOAT4(0, 0, 0, 0));
+	eyeClip->AddBezierKey(backPosition, 1.0f, XMFLOAT4(0, 0, -1.0f, 0), XMFLOAT4(0, 0, -1.2f, 0), XMFLOAT4(0, 0, -1.0f, 0));
+	eyeClip->AddKey(backPosition, 3.0f, XMFLOAT4(0, 0, -1.0f, 0));
+	eyeClip->AddKey(backPosition, 4.0f, XMFLOAT4(0, 0, 0, 0));
+
+	// A full turn in thirds, a single key at 360 degrees would be the same as 0 
+	unsigned int frontRotation = eyeClip->AddTrack(0, CLIP_TRACK_ROTATION);
+	for (int i = 0; i <= 3; i++)
+	{
+		XMFLOAT4 rotation;
+		XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(0, 0, i * XM_2PI / 3.0f));
+		eyeClip->AddKey(frontRotation, 1.0f + i * (2.0f / 3.0f), rotation, CLIP_KEY_LINEAR);
+	}
+
+	unsigned int lightIntensity = eyeClip->AddTrack(2, CLIP_TRACK_LIGHT_INTENSITY);
+	eyeClip->AddKey(lightIntensity, 0.0f, XMFLOAT4(1.0f, 0, 0, 0));
+	eyeClip->AddKey(lightIntensity, 1.0f, XMFLOAT4(3.0f, 0, 0, 0));
+	eyeClip->AddKey(lightIntensity, 3.0f, XMFLOAT4(3.0f, 0, 0, 0));
+	eyeClip->AddKey(lightIntensity, 4.0f, XMFLOAT4(1.0f, 0, 0, 0));
+
+	// Closed loops that start and end at rest heading forward (+z), so
+	// the eye lands back where it was facing the way it was 
+	std::vector<XMFLOAT3> loop = {
+		XMFLOAT3(0, 0, 0), XMFLOAT3(0.6f, 0.2f, 0.8f), XMFLOAT3(0, 0.6f, 1.6f),
+		XMFLOAT3(-0.8f, 0.4f, 0.4f), XMFLOAT3(-0.2f, 0.3f, -1.0f), XMFLOAT3(0.6f, 0.2f, -0.8f) };
+	eyePaths[SPLINE_CATMULL_ROM] = std::make_shared<SplinePath>(SPLINE_CATMULL_ROM, loop, true);
+
+	// Anchors every third point, the handles either side of one are in line 
+	std::vector<XMFLOAT3> bezierLoop = {
+		XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0.8f), XMFLOAT3(0.8f, 0.6f, 1.4f),
+		XMFLOAT3(0, 1.0f, 2.0f), XMFLOAT3(-0.8f, 1.4f, 2.6f), XMFLOAT3(-1.2f, 0.6f, 0.4f),
+		XMFLOAT3(-0.6f, 0.4f, -0.6f), XMFLOAT3(-0.24f, 0.28f, -1.2f), XMFLOAT3(0, 0, -0.8f) };
+	eyePaths[SPLINE_BEZIER] = std::make_shared<SplinePath>(SPLINE_BEZIER, bezierLoop, true);
+
+	// B-splines start at a sixth of their neighbours plus two thirds of the
+	// first point, so it's moved to bring the start back to rest 
+	std::vector<XMFLOAT3> smoothLoop = loop;
+	smoothLoop[0] = XMFLOAT3(-(loop[1].x + loop[5].x) / 4.0f, -(loop[1].y + loop[5].y) / 4.0f, -(loop[1].z + loop[5].z) / 4.0f);
+	eyePaths[SPLINE_B_SPLINE] = std::make_shared<SplinePath>(SPLINE_B_SPLINE, smoothLoop, true);
+}
+
+/// <summary>
+/// Fill the skeletal animation scene with a field of tentacles,
+/// each one a tube skinned to a chain of joints and deformed
+/// on the CPU every frame, see SkinnedAnimator
+/// </summary>
+void Game::CreateSkinnedCharacters()
+{
+	const int jointCount = 8;
+	const float jointLength = 0.25f;
+	const int rings = 48;
+	const int sides = 16;
+	const int gridSize = 16;
+
+	// A straight chain of joints up the tentacle 
+	std::shared_ptr<SkinnedMeshData> tentacle = std::make_shared<SkinnedMeshData>();
+	tentacle->skeleton = std::make_shared<Skeleton>();
+	tentacleSkeleton = tentacle->skeleton;
+	int parent = SKELETON_NO_PARENT;
+	for (int j = 0; j < jointCount; j++)
+	{
+		parent = (int)tentacle->skeleton->AddJoint("Joint" + std::to_string(j), parent,
+			XMFLOAT3(0, j == 0 ? 0.0f : jointLength, 0), XMFLOAT4(0, 0, 0, 1));
+	}
+
+	// Tapered tube, the extra side repeats the first one so the UVs can wrap 
+	float height = (jointCount - 1) * jointLength;
+	for (int r = 0; r < rings; r++)
+	{
+		float y = height * r / (rings - 1);
+		float radius = 0.12f * (1.0f - 0.7f * y / height);
+
+		// Every ring is split between the two joints it sits between 
+		float along = y / jointLength;
+		int joint = (int)along < jointCount - 2 ? (int)along : jointCount - 2;
+		float weight = along - joint;
+
+		for (int s = 0; s <= sides; s++)
+		{
+			float angle = XM_2PI * s / sides;
+			Vertex vertex = {};
+			vertex.Position = XMFLOAT3(radius * cosf(angle), y, radius * sinf(angle));
+			vertex.Normal = XMFLOAT3(cosf(angle), 0, sinf(angle));
+			vertex.Tangent = XMFLOAT4(-sinf(angle), 0, cosf(angle), 1.0f);
+			vertex.UV = XMFLOAT2((float)s / sides, (float)r / (rings - 1));
+			tentacle->geometry.vertices.push_back(vertex);
+
+			VertexSkin skin = {};
+			skin.Joints[0] = (unsigned short)joint;
+			skin.Joints[1] = (unsigned short)(joint + 1);
+			skin.Weights = XMFLOAT4(1.0f - weight, weight, 0, 0);
+			tentacle->skin.push_back(skin);
+		}
+	}
+	for (int r = 0; r + 1 < rings; r++)
+	{
+		for (int s = 0; s < sides; s++)
+		{
+			unsigned int bottom = r * (sides + 1) + s;
+			unsigned int top = bottom + sides + 1;
+			unsigned int indices[] = { bottom, top, top + 1, bottom, top + 1, bottom + 1 };
+			tentacle->geometry.indices.insert(tentacle->geometry.indices.end(), indices, indices + 6);
+		}
+	}
+
+	// Keys of a joint swinging around an axis, with the slope of
+	// the swing as Hermite tangents so the curve stays smooth 
+	auto addSwing = [](std::shared_ptr<AnimClip> clip, unsigned int joint, XMFLOAT3 axis, float offset, float amplitude, float phase, int keys)
+	{
+		unsigned int track = clip->AddTrack(joint, CLIP_TRACK_ROTATION);
+		float frequency = XM_2PI / clip->GetDuration();
+		for (int k = 0; k <= keys; k++)
+		{
+			float time = clip->GetDuration() * k / keys;
+			float angle = offset + amplitude * sinf(frequency * time + phase);
+			float speed = amplitude * frequency * cosf(frequency * time + phase) * 0.5f;
+			float s = sinf(angle * 0.5f);
+			float c = cosf(angle * 0.5f);
+			XMFLOAT4 rotation(axis.x * s, axis.y * s, axis.z * s, c);
+			XMFLOAT4 tangent(axis.x * c * speed, axis.y * c * speed, axis.z * c * speed, -s * speed);
+			clip->AddHermiteKey(track, time, rotation, tangent, tangent);
+		}
+	};
+
+	// Sway side to side, each joint a little behind the one below it 
+	tentacleSway = std::make_shared<AnimClip>(2.0f, true);
+	for (int j = 1; j < jointCount; j++)
+	{
+		addSwing(tentacleSway, j, XMFLOAT3(0, 0, 1), 0.0f, 0.1f + 0.02f * j, -0.6f * j, 8);
+	}
+
+	// Curl forwards and back out 
+	tentacleCurl = std::make_shared<AnimClip>(3.0f, true);
+	for (int j = 1; j < jointCount; j++)
+	{
+		addSwing(tentacleCurl, j, XMFLOAT3(1, 0, 0), 0.3f, 0.3f, -0.3f * j, 8);
+	}
+
+	// Compressed copies to switch to, errors measured along the chain 
+	compressedSway = std::make_shared<AnimClip>(*tentacleSway);
+	compressedSway->Compress(CLIP_COMPRESSION_MAX_ERROR, tentacleSkeleton.get());
+	compressedCurl = std::make_shared<AnimClip>(*tentacleCurl);
+	compressedCurl->Compress(CLIP_COMPRESSION_MAX_ERROR, tentacleSkeleton.get());
+
+	// Every tentacle deforms its own mesh, at its own pace 
+	std::vector<std::shared_ptr<Entity>> skeleEntities = std::vector<std::shared_ptr<Entity>>();
+	for (int i = 0; i < gridSize * gridSize; i++)
+	{
+		unsigned int character = skinnedAnimator->AddCharacter(tentacle);
+
+		std::shared_ptr<Entity> entity = std::make_shared<Entity>(skinnedAnimator->GetMesh(character), schlickBronze);
+		entity->GetTransform()->SetPosition(
+			(i % gridSize - (gridSize - 1) * 0.5f) * 0.6f, -2.0f, 2.0f + (i / gridSize) * 0.6f);
+		skeleEntities.push_back(entity);
+	}
+	skinnedAnimator->SetMode(skinningMode);
+	PlayTentacleClips();
+
+	skeleScene->SetEntities(skeleEntities);
+}
+
+/// <summary>
+/// (Re)start the sway and curl on every tentacle, from either
+/// the keyed clips or their compressed copies
+/// </summary>
+void Game::PlayTentacleClips()
+{
+	std::shared_ptr<AnimClip> sway = useCompressedClips ? compressedSway : tentacleSway;
+	std::shared_ptr<AnimClip> curl = useCompressedClips ? compressedCurl : tentacleCurl;
+	for (unsigned int i = 0; i < skinnedAnimator->GetCharacterCount(); i++)
+	{
+		float speed = 0.8f + 0.4f * ((i * 7) % 11) / 10.0f;
+		skinnedAnimator->Play(i, sway, 0, speed);
+		skinnedAnimator->Play(i, curl, 1, speed);
+	}
+}
+
+/// <summary>
+/// Put a large panel behind the tentacles with a few morph targets
+/// denting small parts of it, their weights animated by a clip
+/// </summary>
+void Game::CreateMorphPanel()
+{
+	const int columns = 256;
+	const int rows = 128;
+	const float width = 10.0f;
+	const float height = 5.0f;
+
+	// Flat grid facing the camera 
+	std::shared_ptr<MorphedMeshData> panel = std::make_shared<MorphedMeshData>();
+	for (int r = 0; r < rows; r++)
+	{
+		for (int c = 0; c < columns; c++)
+		{
+			Vertex vertex = {};
+			vertex.Position = XMFLOAT3(width * ((float)c / (columns - 1) - 0.5f), height * r / (rows - 1), 0);
+			vertex.Normal = XMFLOAT3(0, 0, -1);
+			vertex.Tangent = XMFLOAT4(1, 0, 0, 1.0f);
+			vertex.UV = XMFLOAT2(4.0f * c / (columns - 1), 2.0f * (1.0f - (float)r / (rows - 1)));
+			panel->geometry.vertices.push_back(vertex);
+		}
+	}
+	for (int r = 0; r + 1 < rows; r++)
+	{
+		for (int c = 0; c + 1 < columns; c++)
+		{
+			unsigned int bottom = r * columns + c;
+			unsigned int top = bottom + columns;
+			unsigned int indices[] = { bottom, top, top + 1, bottom, top + 1, bottom + 1 };
+			panel->geometry.indices.insert(panel->geometry.indices.end(), indices, indices + 6);
+		}
+	}
+
+	// Each dent pushes a small round patch into the panel. Its normals and
+	// tangents follow the slope, so the target is made from the whole shape 
+	struct Dent { float x, y, radius, depth; };
+	const Dent dents[] = {
+		{ -3.5f, 1.0f, 0.3f, 0.15f },
+		{ -1.2f, 3.6f, 0.4f, 0.2f },
+		{ 1.0f, 1.8f, 0.25f, -0.1f },	// Bulges out instead
+		{ 3.2f, 3.0f, 0.5f, 0.25f },
+	};
+	for (int d = 0; d < 4; d++)
+	{
+		std::vector<Vertex> shaped = panel->geometry.vertices;
+		for (unsigned int v = 0; v < shaped.size(); v++)
+		{
+			float dx = shaped[v].Position.x - dents[d].x;
+			float dy = shaped[v].Position.y - dents[d].y;
+			float falloff = (dx * dx + dy * dy) / (dents[d].radius * dents[d].radius);
+			if (falloff > 9.0f)
+				continue;
+
+			// Gaussian bump and its slope along x and y
+			float depth = dents[d].depth * expf(-falloff);
+			float slopeX = -2.0f * dx / (dents[d].radius * dents[d].radius) * depth;
+			float slopeY = -2.0f * dy / (dents[d].radius * dents[d].radius) * depth;
+			shaped[v].Position.z += depth;
+			XMStoreFloat3(&shaped[v].Normal, XMVector3Normalize(XMVectorSet(slopeX, slopeY, -1.0f, 0)));
+			XMStoreFloat4(&shaped[v].Tangent, XMVectorSetW(XMVector3Normalize(XMVectorSet(1.0f, 0, slopeX, 0)), 1.0f));
+		}
+		panel->targets.push_back(Morphing::CreateTarget("Dent" + std::to_string(d), &panel->geometry.vertices[0], &shaped[0],
+			(unsigned int)shaped.size()));
+	}
+
+	panelInstance = morphAnimator->AddInstance(panel);
+	std::shared_ptr<Entity> entity = std::make_shared<Entity>(morphAnimator->GetMesh(panelInstance), schlickBricks);
+	entity->GetTransform()->SetPosition(0, -2.0f, 12.0f);
+	std::vector<std::shared_ptr<Entity>> skeleEntities = skeleScene->GetEntities();
+	skeleEntities.push_back(entity);
+	skeleScene->SetEntities(skeleEntities);
+
+	// Dents pop in and out one after another, each one a part of the clip 
+	panelClip = std::make_shared<AnimClip>(4.0f, true);
+	for (unsigned int d = 0; d < panel->targets.size(); d++)
+	{
+		float start = 0.1f + 0.8f * d;
+		unsigned int track = panelClip->AddTrack(d, CLIP_TRACK_MORPH_WEIGHT);
+		panelClip->AddKey(track, 0.0f, XMFLOAT4(0, 0, 0, 0));
+		panelClip->AddKey(track, start, XMFLOAT4(0, 0, 0, 0));
+		panelClip->AddKey(track, start + 0.5f, XMFLOAT4(1, 0, 0, 0));
+		panelClip->AddKey(track, start + 1.2f, XMFLOAT4(0, 0, 0, 0));
+		panelClip->AddKey(track, 4.0f, XMFLOAT4(0, 0, 0, 0));
+	}
+	PlayPanelClip();
+}
+
+/// <summary>
+/// Start the dent clip, each of its parts drives the panel target of the same index
+/// </summary>
+void Game::PlayPanelClip()
+{
+	std::vector<ClipBinding> parts(panelClip->GetPartCount());
+	for (unsigned int d = 0; d < parts.size(); d++)
+	{
+		parts[d].morphAnimator = morphAnimator;
+		parts[d].morphInstance = panelInstance;
+		parts[d].morphTarget = d;
+	}
+	panelClipInstance = clipPlayer->Play(panelClip, parts);
+}
+
 void Game::OnResize()
 {
 	// Handle base-level DX resize stuff
@@ -782,6 +1356,37 @@ void Game::UpdateImGui(float deltaTime)
 		1000.0 / frameRate, frameRate);
 	ImGui::Text("Window Width: %i", windowWidth);
 	ImGui::Text("Window Height: %i", windowHeight);
+	ImGui::Text("Transform rebuild: %.3f ms (%u transforms)",
+		TransformPool::GetInstance().GetLastUpdateTime(), TransformPool::GetInstance().GetCount());
+	ImGui::Text("Transforms changed: %u",
+		(unsigned int)TransformPool::GetInstance().GetChangedThisFrame().size());
+	ImGui::Text("Animation update: %.3f ms (%u animations)",
+		animManager->GetLastUpdateTime(), animManager->GetAnimationCount());
+	ImGui::Text("Clip update: %.3f ms (%u clips)",
+		clipPlayer->GetLastUpdateTime(), clipPlayer->GetInstanceCount());
+	ImGui::Text("Model load: %.3f ms", modelLoadTime);
+
+	GeometryArenaStats arenaStats = GeometryArena::GetInstance().GetStats();
+	ImGui::Text("Geometry arena: %u pools, %u meshes, %.1f%% of vertices used",
+		arenaStats.pools, arenaStats.vertices.allocations,
+		arenaStats.vertices.capacity == 0 ? 0.0f : 100.0f * arenaStats.vertices.used / arenaStats.vertices.capacity);
+	ImGui::Text("Buffer binds: %u (%u skipped)", arenaStats.binds, arenaStats.skippedBinds);
+
+	// What meshlet culling kept of the current scene in the last frame
+	std::vector<std::shared_ptr<Entity>> sceneEntities = scenes[currentScene]->GetEntities();
+	MeshletCullStats sceneCull = {};
+	unsigned int sceneMeshlets = 0;
+	for (unsigned int i = 0; i < sceneEntities.size(); i++)
+	{
+		MeshletCullStats cull = sceneEntities[i]->GetCullStats();
+		sceneCull.meshletsVisible += cull.meshletsVisible;
+		sceneCull.meshletsFrustumCulled += cull.meshletsFrustumCulled;
+		sceneCull.meshletsBackfaceCulled += cull.meshletsBackfaceCulled;
+		sceneCull.trianglesVisible += cull.trianglesVisible;
+		sceneMeshlets += cull.meshletsVisible + cull.meshletsFrustumCulled + cull.meshletsBackfaceCulled;
+	}
+	ImGui::Text("Meshlets drawn: %u of %u (%u off screen, %u facing away), %u triangles",
+		sceneCull.meshletsVisible, sceneMeshlets, sceneCull.meshletsFrustumCulled, sceneCull.meshletsBackfaceCulled, sceneCull.trianglesVisible);
 
 	// Scene Management
 	sceneGui->CreateSceneGui(scenes, &currentScene);
@@ -835,6 +1440,143 @@ void Game::UpdateImGui(float deltaTime)
 		ImGui::TreePop();
 	}
 
+	// Rebuilding every transform on its own, like Transform used to, against the pool's batches
+	if (ImGui::TreeNode("Transform Benchmark"))
+	{
+		if (ImGui::Button("Run transform benchmark"))
+		{
+			const unsigned int counts[] = { 1000, 10000, 100000 };
+			for (int i = 0; i < 3; i++)
+			{
+				transformBenchmark[i] = TransformPool::RunBenchmark(counts[i], 10);
+			}
+			hasTransformBenchmark = true;
+		}
+		if (hasTransformBenchmark && ImGui::BeginTable("TransformBenchmark", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+		{
+			ImGui::TableSetupColumn("Transforms");
+			ImGui::TableSetupColumn("Per object ms");
+			ImGui::TableSetupColumn("Batched ms");
+			ImGui::TableSetupColumn("Speedup");
+			ImGui::TableSetupColumn("Max difference");
+			ImGui::TableHeadersRow();
+
+			for (int i = 0; i < 3; i++)
+			{
+				const TransformBenchmarkResult& result = transformBenchmark[i];
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::Text("%u", result.count);
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", result.perObjectMilliseconds);
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", result.batchedMilliseconds);
+				ImGui::TableNextColumn(); ImGui::Text("%.1fx", result.batchedMilliseconds > 0.0f ? result.perObjectMilliseconds / result.batchedMilliseconds : 0.0f);
+				ImGui::TableNextColumn(); ImGui::Text("%.6f", result.maxDifference);
+			}
+			ImGui::EndTable();
+		}
+
+		ImGui::TreePop();
+	}
+
+	// The getline and sscanf_s loader meshes used to go through, against the importer
+	if (ImGui::TreeNode("OBJ Benchmark"))
+	{
+		if (ImGui::Button("Run obj benchmark"))
+		{
+			objBenchmark[0] = ObjImporter::Benchmark(FixPath(L"../../Assets/Models/helix.obj").c_str());
+
+			// About a million triangles and 100MB of text, only kept while it is timed
+			std::wstring bigFile = FixPath(L"BenchmarkTorus.obj");
+			objBenchmark[1] = ObjBenchmarkResult();
+			if (ObjImporter::WriteBenchmarkFile(bigFile.c_str(), 768, 768))
+				objBenchmark[1] = ObjImporter::Benchmark(bigFile.c_str());
+			RemoveFile(bigFile.c_str());
+			hasObjBenchmark = true;
+		}
+		if (hasObjBenchmark && ImGui::BeginTable("ObjBenchmark", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+		{
+			ImGui::TableSetupColumn("File");
+			ImGui::TableSetupColumn("Size MB");
+			ImGui::TableSetupColumn("Triangles");
+			ImGui::TableSetupColumn("getline ms");
+			ImGui::TableSetupColumn("Import ms");
+			ImGui::TableSetupColumn("Weld + optimize ms");
+			ImGui::TableSetupColumn("Speedup");
+			ImGui::TableHeadersRow();
+
+			static const char* files[] = { "helix.obj", "Generated torus" };
+			for (int i = 0; i < 2; i++)
+			{
+				const ObjBenchmarkResult& result = objBenchmark[i];
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::Text("%s", files[i]);
+				if (!result.loaded)
+				{
+					ImGui::TableNextColumn(); ImGui::Text("Failed");
+					continue;
+				}
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", result.fileSize / (1024.0f * 1024.0f));
+				ImGui::TableNextColumn(); ImGui::Text("%u", result.triangles);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", result.referenceMilliseconds);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", result.importMilliseconds);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", result.optimizeMilliseconds);
+				ImGui::TableNextColumn(); ImGui::Text("%.1fx", result.importMilliseconds > 0.0f ? result.referenceMilliseconds / result.importMilliseconds : 0.0f);
+			}
+			ImGui::EndTable();
+		}
+
+		ImGui::TreePop();
+	}
+
+	// Every loaded mesh and what was done to it at import
+	if (ImGui::TreeNode("Mesh Stats"))
+	{
+		// Order from the file against the order uploaded, in a 16 entry FIFO
+		// cache and from the six axis views of MeshOptimizer::AnalyzeOverdraw
+		if (ImGui::Button("Measure meshes"))
+			MeasureMeshOrder();
+
+		if (ImGui::BeginTable("MeshStats", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+		{
+			ImGui::TableSetupColumn("Mesh");
+			ImGui::TableSetupColumn("Vertices");
+			ImGui::TableSetupColumn("LODs");
+			ImGui::TableSetupColumn("Position error");
+			ImGui::TableSetupColumn("Normal error");
+			ImGui::TableSetupColumn("ACMR");
+			ImGui::TableSetupColumn("ATVR");
+			ImGui::TableSetupColumn("Overdraw");
+			ImGui::TableHeadersRow();
+
+			for (const LoadedMesh& loaded : loadedMeshes)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::Text("%s", loaded.name.c_str());
+				ImGui::TableNextColumn(); ImGui::Text("%d", loaded.mesh->GetVertexCount());
+				ImGui::TableNextColumn(); ImGui::Text("%u", loaded.mesh->GetLodCount());
+
+				// What quantizing cost, or would cost in brackets once measured,
+				// to tell which meshes can take it
+				bool quantized = loaded.mesh->IsQuantized();
+				QuantizationError error = quantized ? loaded.mesh->GetQuantizationError() : loaded.quantizationError;
+				ImGui::TableNextColumn();
+				if (quantized || loaded.measured)
+					ImGui::Text(quantized ? "%.5f" : "(%.5f)", error.position);
+				ImGui::TableNextColumn();
+				if (quantized || loaded.measured)
+					ImGui::Text(quantized ? "%.2f deg" : "(%.2f deg)", error.normal);
+
+				if (!loaded.measured)
+					continue;
+				ImGui::TableNextColumn(); ImGui::Text("%.3f -> %.3f", loaded.cacheBefore.acmr, loaded.cacheAfter.acmr);
+				ImGui::TableNextColumn(); ImGui::Text("%.3f -> %.3f", loaded.cacheBefore.atvr, loaded.cacheAfter.atvr);
+				ImGui::TableNextColumn(); ImGui::Text("%.3f -> %.3f", loaded.overdrawBefore.overdraw, loaded.overdrawAfter.overdraw);
+			}
+			ImGui::EndTable();
+		}
+
+		ImGui::TreePop();
+	}
+
 	// Scene specific gui
 	switch (currentScene)
 	{
@@ -844,6 +1586,49 @@ void Game::UpdateImGui(float deltaTime)
 		if (ImGui::TreeNode("Animation Controls"))
 		{
 			if (ImGui::Button("Animate", ImVec2(90, 25))) startAnimation = true;
+			ImGui::SameLine();
+
+			// The clip starts and ends with the eye together
+			bool clipPlaying = clipPlayer->IsPlaying(eyeClipInstance);
+			if (ImGui::Button(clipPlaying ? "Stop Clip" : "Play Clip", ImVec2(90, 25)))
+			{
+				if (clipPlaying)
+				{
+					clipPlayer->Stop(eyeClipInstance);
+				}
+				else if (!animManager->IsRunningAnimations())
+				{
+					std::vector<std::shared_ptr<Entity>> entities = animScene->GetEntities();
+					std::vector<ClipBinding> parts(3);
+					parts[0].transform = entities[3]->GetTransform(); // Eye_Front
+					parts[1].transform = entities[5]->GetTransform(); // Eye_Back
+					parts[2].light = animScene->GetLights()[1];
+					eyeClipInstance = clipPlayer->Play(eyeClip, parts);
+				}
+			}
+			if (clipPlayer->IsPlaying(eyeClipInstance))
+			{
+				ImGui::ProgressBar(clipPlayer->GetTime(eyeClipInstance) / eyeClip->GetDuration());
+			}
+			ImGui::Dummy(ImVec2(0, 10));
+
+			// The front of the eye flies a loop at an even speed, eased by the curve 
+			if (ImGui::Button("Fly Path", ImVec2(90, 25)) && !animManager->IsRunningAnimations() && !clipPlayer->IsPlaying(eyeClipInstance))
+			{
+				animManager->AddPathAnimation(animScene->GetEntities()[3]->GetTransform(), // Eye_Front
+					eyePaths[eyePathType], eyePathTime, eyePathCurve, eyeFollowPath);
+			}
+			ImGui::SameLine();
+			ImGui::Checkbox("Face along path", &eyeFollowPath);
+
+			static const char* pathTypes[] = { "Catmull-Rom", "Bezier", "B-spline" };
+			ImGui::Combo("Path", &eyePathType, pathTypes, SPLINE_TYPE_COUNT);
+			ImGui::Text("Length: %.2f, %u segments", eyePaths[eyePathType]->GetLength(), eyePaths[eyePathType]->GetSegmentCount());
+
+			ImGui::PushID(2);
+			animSceneGui->CreateCurveGuiWithDropDown("Path", &eyePathCurve);
+			ImGui::InputFloat("Animation Time", &eyePathTime, 0.01f);
+			ImGui::PopID();
 			ImGui::Dummy(ImVec2(0, 10));
 
 			ImGui::PushID(0);
@@ -858,12 +1643,123 @@ void Game::UpdateImGui(float deltaTime)
 			ImGui::InputFloat("Animation Time", &eyeComTime, 0.01f);
 			ImGui::PopID();
 
+			ImGui::Dummy(ImVec2(0, 10));
+			static const char* easeModes[] = { "Exact", "Table (linear)", "Table (cubic)" };
+			if (ImGui::Combo("Curve evaluation", &easeMode, easeModes, EASE_MODE_COUNT))
+			{
+				animManager->SetEaseMode(easeMode);
+			}
+
+			// Accuracy and speed of every curve, against the switch in AnimCurves.h
+			if (ImGui::Button("Run easing benchmark"))
+			{
+				RunEaseBenchmark(easeBenchmark, 1 << 18);
+				hasEaseBenchmark = true;
+			}
+			if (hasEaseBenchmark && ImGui::BeginTable("EaseBenchmark", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+			{
+				ImGui::TableSetupColumn("Curve");
+				ImGui::TableSetupColumn("Switch ns");
+				ImGui::TableSetupColumn("Exact ns");
+				ImGui::TableSetupColumn("Linear ns");
+				ImGui::TableSetupColumn("Cubic ns");
+				ImGui::TableSetupColumn("Linear error");
+				ImGui::TableSetupColumn("Cubic error");
+				ImGui::TableHeadersRow();
+
+				for (int i = 0; i < EASE_CURVE_COUNT; i++)
+				{
+					const EaseBenchmarkResult& result = easeBenchmark[i];
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::Text("%s", GetEaseName(i));
+					ImGui::TableNextColumn(); ImGui::Text("%.2f", result.switchNanoseconds);
+					ImGui::TableNextColumn(); ImGui::Text("%.2f", result.nanoseconds[EASE_MODE_EXACT]);
+					ImGui::TableNextColumn(); ImGui::Text("%.2f", result.nanoseconds[EASE_MODE_LUT_LINEAR]);
+					ImGui::TableNextColumn(); ImGui::Text("%.2f", result.nanoseconds[EASE_MODE_LUT_CUBIC]);
+					ImGui::TableNextColumn(); ImGui::Text("%.5f", result.maxError[EASE_MODE_LUT_LINEAR]);
+					ImGui::TableNextColumn(); ImGui::Text("%.5f", result.maxError[EASE_MODE_LUT_CUBIC]);
+				}
+				ImGui::EndTable();
+			}
+
 			ImGui::TreePop();
 		}
 
 		break;
 	case SCENE_SHADOWS:
 		//shadowSceneGui->CreateShadowGui();
+		break;
+	case SCENE_SKELETAL:
+
+		// Skeletal Animation Scene 
+		if (ImGui::TreeNode("Skinning Controls"))
+		{
+			static const char* skinningModes[] = { "Linear blend", "Dual quaternion" };
+			if (ImGui::Combo("Skinning", &skinningMode, skinningModes, 2))
+			{
+				skinnedAnimator->SetMode(skinningMode);
+			}
+
+			if (ImGui::SliderFloat("Curl", &skinnedBlend, 0.0f, 1.0f))
+			{
+				for (unsigned int i = 0; i < skinnedAnimator->GetCharacterCount(); i++)
+				{
+					skinnedAnimator->SetBlend(i, skinnedBlend);
+				}
+			}
+
+			ImGui::Text("Skinning: %.3f ms (%u characters, %u vertices)",
+				skinnedAnimator->GetLastSkinTime(), skinnedAnimator->GetCharacterCount(), skinnedAnimator->GetVertexCount());
+			ImGui::Text("Vertex upload: %.3f ms", skinnedAnimator->GetLastUploadTime());
+
+			if (ImGui::Checkbox("Compressed clips", &useCompressedClips))
+			{
+				PlayTentacleClips();
+			}
+
+			// What compression did to both clips together
+			ClipCompressionStats sway = compressedSway->GetCompressionStats();
+			ClipCompressionStats curl = compressedCurl->GetCompressionStats();
+			ImGui::Text("Clip memory: %u bytes of keys, %u compressed",
+				tentacleSway->GetMemorySize() + tentacleCurl->GetMemorySize(), sway.compressedSize + curl.compressedSize);
+			ImGui::Text("Tracks: %u constant, %u linear, %u animated",
+				sway.constantTracks + curl.constantTracks, sway.linearTracks + curl.linearTracks, sway.animatedTracks + curl.animatedTracks);
+			ImGui::Text("Sample rate: %.0f sway, %.0f curl Hz", sway.sampleRate, curl.sampleRate);
+			ImGui::Text("Bits per component: %.1f sway, %.1f curl", sway.averageBits, curl.averageBits);
+			ImGui::Text("Largest error: %.5f", sway.maxError > curl.maxError ? sway.maxError : curl.maxError);
+
+			ImGui::TreePop();
+		}
+
+		if (ImGui::TreeNode("Morph Controls"))
+		{
+			// Weights can be set by hand while the clip is stopped
+			bool clipPlaying = clipPlayer->IsPlaying(panelClipInstance);
+			if (ImGui::Checkbox("Animate dents", &clipPlaying))
+			{
+				if (clipPlaying)
+					PlayPanelClip();
+				else
+					clipPlayer->Stop(panelClipInstance);
+			}
+
+			for (unsigned int d = 0; d < panelClip->GetPartCount(); d++)
+			{
+				float weight = morphAnimator->GetWeight(panelInstance, d);
+				std::string label = "Dent " + std::to_string(d);
+				if (ImGui::SliderFloat(label.c_str(), &weight, 0.0f, 1.0f) && !clipPlaying)
+				{
+					morphAnimator->SetWeight(panelInstance, d, weight);
+				}
+			}
+
+			ImGui::Text("Morphing: %.3f ms (%u target vertices)", morphAnimator->GetLastMorphTime(), morphAnimator->GetMorphedVertexCount());
+			ImGui::Text("Vertex upload: %.3f ms (%u of %d vertices)", morphAnimator->GetLastUploadTime(),
+				morphAnimator->GetUploadedVertexCount(), morphAnimator->GetMesh(panelInstance)->GetVertexCount());
+
+			ImGui::TreePop();
+		}
+
 		break;
 	default:
 		break;
@@ -882,19 +1778,37 @@ void Game::Update(float deltaTime, float totalTime)
 
 	scene->GetCurrentCam()->Update(deltaTime);
 	animManager->UpdateAnimations(deltaTime);
+	clipPlayer->UpdateClips(deltaTime);
 
 	switch (currentScene)
 	{
 	case SCENE_ANIM:
 		AnimSceneLogic(deltaTime);
 		break;
+	case SCENE_SKELETAL:
+		// Nothing else looks at the deformed meshes
+		skinnedAnimator->UpdateCharacters(deltaTime);
+		morphAnimator->UpdateMorphs();
+		break;
 	default:
 		break;
 	}
+
+	// Rebuild every transform that changed this frame in one pass
+	TransformPool::GetInstance().UpdateWorldMatrices();
+
+	// Right click selects what is under the mouse, the left button is for looking around
+	Input& input = Input::GetInstance();
+	if (input.MouseRightPress())
+	{
+		std::shared_ptr<Entity> picked = scenes[currentScene]->Pick(
+			(float)input.GetMouseX(), (float)input.GetMouseY(), (float)this->windowWidth, (float)this->windowHeight);
+		sceneGuis[currentScene]->SetSelected(picked);
+	}
 	
 
 	// Example input checking: Quit if the escape key is pressed
-	if (Input::GetInstance().KeyDown(VK_ESCAPE))
+	if (input.KeyDown(VK_ESCAPE))
 		Quit();
 }
 
@@ -910,6 +1824,9 @@ void Game::Draw(float deltaTime, float totalTime)
 
 		// Clear the depth buffer (resets per-pixel occlusion information)
 		context->ClearDepthStencilView(depthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+		// Nothing bound last frame can be trusted to still be there
+		GeometryArena::GetInstance().ResetBindings();
 	}
 
 
@@ -938,6 +1855,7 @@ void Game::Draw(float deltaTime, float totalTime)
 				backBufferRTV,
 				depthBufferDSV,
 				shadowVS,
+				quantizedShadowVS,
 				SHADOW_MAP_RESOLUTION,
 				(float)this->windowWidth,
 				(float)this->windowHeight);
@@ -8,6 +8,7 @@
 #define SCENE_PRIMARY 0
 #define SCENE_ANIM 1
 #define SCENE_SHADOWS 2
+#define SCENE_SKELETAL 3
 
 #define SHADOW_MAP_RESOLUTION 1024
 
@@ -30,6 +31,8 @@
 #include "packages/directxtk_desktop_win10.2023.9.6.1/include/WICTextureLoader.h"
 
 #include "Lights.h"
+#include "ObjImporter.h"
+#include "MeshOptimizer.h"
 #include "MatData.h"
 
 #include "Sky.h"
@@ -39,6 +42,28 @@
 #include "SceneGui.h"
 
 #include "BasicAnimation.h"
+#include "AnimClip.h"
+#include "SkinnedAnimator.h"
+#include "MorphAnimator.h"
+
+/// <summary>
+/// A mesh loaded from an obj file, listed in the mesh stats
+/// </summary>
+struct LoadedMesh
+{
+	std::string name;
+	std::wstring file;
+	std::shared_ptr<Mesh> mesh;
+
+	// Triangles in file order against the order they were uploaded in,
+	// only measured when asked since rasterizing the overdraw is slow
+	bool measured;
+	VertexCacheStats cacheBefore;
+	VertexCacheStats cacheAfter;
+	OverdrawStats overdrawBefore;
+	OverdrawStats overdrawAfter;
+	QuantizationError quantizationError;	// What quantizing would cost a mesh that isn't
+};
 
 class Game 
 	: public DXCore
@@ -59,6 +84,15 @@ private:
 	void LoadLights();
 	void LoadShaders(); 
 	void CreateGeometry();
+	/// <summary>
+	/// Load a mesh from an obj file under the assets and list it in the mesh stats
+	/// </summary>
+	std::shared_ptr<Mesh> LoadMesh(const wchar_t file[], bool quantize = false);
+	/// <summary>
+	/// Measure what reordering did to the vertex cache and overdraw of every
+	/// loaded mesh, and what quantizing would cost the ones that aren't
+	/// </summary>
+	void MeasureMeshOrder();
 	void CreateCameras();
 	void LoadShadowResources();
 
@@ -70,6 +104,13 @@ private:
 
 	// Logic specifically for animation demonstration
 	void AnimSceneLogic(float deltaTime);
+	// Keyframed clips of the animation scene's parts
+	void CreateAnimClips();
+	// Skinned characters of the skeletal animation scene
+	void CreateSkinnedCharacters();
+	void PlayTentacleClips();
+	void CreateMorphPanel();
+	void PlayPanelClip();
 
 	// Gui - Used to tell the computer which gui to display 
 	void UpdateImGui(float deltaTime);
@@ -92,6 +133,28 @@ private:
 		const char samplerType[] = "BasicSampler"
 	);
 
+	/// <summary>
+	/// Set up a PBR material with textures that are already loaded 
+	/// </summary>
+	void SetupPBRMaterial(
+		std::shared_ptr<Material> mat,
+		std::shared_ptr<MatData> data,
+		Sky* sky,
+		const char samplerType[] = "BasicSampler"
+	);
+
+	/// <summary>
+	/// Create a 1x1 texture of a single color 
+	/// </summary>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateSolidTexture(DirectX::XMFLOAT4 color);
+
+	/// <summary>
+	/// Load a .glb file as entities with PBR materials. Every node becomes
+	/// a transform and each primitive of its mesh an entity parented to it 
+	/// </summary>
+	/// <param name="quantize">Store the vertices as QuantizedVertex</param>
+	std::vector<std::shared_ptr<Entity>> LoadGltf(const wchar_t file[], Sky* sky, bool quantize = false);
+
 	// Buffers to hold actual geometry data
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
@@ -109,6 +172,8 @@ private:
 	std::shared_ptr<SimplePixelShader> customPShader;
 	std::shared_ptr<SimpleVertexShader> vertexShader;
 	std::shared_ptr<SimpleVertexShader> shadowVS;
+	std::shared_ptr<SimpleVertexShader> quantizedVertexShader;
+	std::shared_ptr<SimpleVertexShader> quantizedShadowVS;
 
 	// Materials 
 	std::shared_ptr<Material> mat1;
@@ -175,6 +240,7 @@ private:
 	std::shared_ptr<SceneGui> animSceneGui;
 
 	std::shared_ptr<BasicAnimationManager> animManager;
+	std::shared_ptr<AnimClipPlayer> clipPlayer;
 	bool startAnimation; // Whether to start animation or not 
 	float buttonCooldown;
 
@@ -185,6 +251,22 @@ private:
 	// Combine 
 	float eyeComTime;
 	int eyeComCurve;
+
+	// Easing tables 
+	int easeMode;
+	bool hasEaseBenchmark;
+	EaseBenchmarkResult easeBenchmark[EASE_CURVE_COUNT];
+
+	// Keyframed eye cycle 
+	std::shared_ptr<AnimClip> eyeClip;
+	unsigned int eyeClipInstance;
+
+	// Loops the front of the eye can fly, one of every spline type 
+	std::shared_ptr<SplinePath> eyePaths[SPLINE_TYPE_COUNT];
+	int eyePathType;
+	int eyePathCurve;
+	float eyePathTime;
+	bool eyeFollowPath;
 	#pragma endregion
 
 	// Shadow Scene 
@@ -195,6 +277,36 @@ private:
 	std::shared_ptr<Scene> skeleScene;
 	std::shared_ptr<SceneGui> skeleSceneGui;
 
+	std::shared_ptr<SkinnedAnimator> skinnedAnimator;
+	std::shared_ptr<Skeleton> tentacleSkeleton;
+	std::shared_ptr<AnimClip> tentacleSway;
+	std::shared_ptr<AnimClip> tentacleCurl;
+	std::shared_ptr<AnimClip> compressedSway;	// Same clips, compressed, see CompressedClip
+	std::shared_ptr<AnimClip> compressedCurl;
+	bool useCompressedClips;
+	int skinningMode;
+	float skinnedBlend; // How much of the curl is blended over the sway 
+
+	std::shared_ptr<MorphAnimator> morphAnimator;
+	std::shared_ptr<AnimClip> panelClip;	// Weight tracks of every panel dent
+	unsigned int panelInstance;
+	unsigned int panelClipInstance;
+
 	// Dithering 
 	float ditherAmount; 
+
+	// How long every model took to load in milliseconds
+	float modelLoadTime;
+	std::vector<LoadedMesh> loadedMeshes;
+
+	// Per object against batched transform rebuilds, at a few counts
+	bool hasTransformBenchmark;
+	TransformBenchmarkResult transformBenchmark[3];
+
+	// Old obj loader against ObjImporter, on the helix and a big generated torus
+	bool hasObjBenchmark;
+	ObjBenchmarkResult objBenchmark[2];
+
+	// Root nodes of loaded glTF files, their children are owned through them
+	std::vector<std::shared_ptr<Transform>> gltfRoots;
 };
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "GeometryArena.h"
+#include <algorithm>
+#include <cstring>
+
+// Singleton requirement
+GeometryArena* GeometryArena::instance;
+
+GeometryArena::GeometryArena() :
+	boundVertexBuffer(nullptr),
+	boundIndexBuffer(nullptr),
+	defragmentations(0),
+	binds(0),
+	skippedBinds(0)
+{
+
+}
+
+void GeometryArena::Initialize(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	(*this).device = device;
+	(*this).context = context;
+}
+
+#pragma region ALLOCATION
+
+bool GeometryArena::Allocate(unsigned int vertexStride, DXGI_FORMAT indexFormat,
+	const void* vertices, unsigned int vertexCount,
+	const void* indices, unsigned int indexCount,
+	GeometryAllocation& out)
+{
+	out = { 0, RANGE_INVALID, RANGE_INVALID };
+	if (device.Get() == nullptr || vertexCount == 0 || indexCount == 0)
+		return false;
+
+	out.pool = FindPool(vertexStride, indexFormat);
+	Pool& pool = pools[out.pool];
+
+	if (!Reserve(pool.vertices, pool.vertexBuffer, pool.vertexStride, D3D11_BIND_VERTEX_BUFFER, vertexCount, out.vertices) ||
+		!Reserve(pool.indices, pool.indexBuffer, pool.indexSize, D3D11_BIND_INDEX_BUFFER, indexCount, out.indices))
+	{
+		Free(out);
+		return false;
+	}
+
+	// Default usage buffers can be written in place a range at a time
+	D3D11_BOX box = {};
+	box.left = pool.vertices.GetOffset(out.vertices) * pool.vertexStride;
+	box.right = box.left + vertexCount * pool.vertexStride;
+	box.bottom = 1;
+	box.back = 1;
+	context->UpdateSubresource(pool.vertexBuffer.Get(), 0, &box, vertices, 0, 0);
+
+	box.left = pool.indices.GetOffset(out.indices) * pool.indexSize;
+	box.right = box.left + indexCount * pool.indexSize;
+	context->UpdateSubresource(pool.indexBuffer.Get(), 0, &box, indices, 0, 0);
+	return true;
+}
+
+bool GeometryArena::WriteVertices(const GeometryAllocation& allocation, const void* vertices, unsigned int vertexCount, unsigned int firstVertex)
+{
+	if (allocation.pool >= pools.size() || vertexCount == 0)
+		return false;
+
+	Pool& pool = pools[allocation.pool];
+	if ((unsigned long long)firstVertex + vertexCount > pool.vertices.GetSize(allocation.vertices))
+		return false;
+
+	D3D11_BOX box = {};
+	box.left = (pool.vertices.GetOffset(allocation.vertices) + firstVertex) * pool.vertexStride;
+	box.right = box.left + vertexCount * pool.vertexStride;
+	box.bottom = 1;
+	box.back = 1;
+	context->UpdateSubresource(pool.vertexBuffer.Get(), 0, &box, vertices, 0, 0);
+	return true;
+}
+
+void GeometryArena::Free(const GeometryAllocation& allocation)
+{
+	if (allocation.pool >= pools.size())
+		return;
+
+	pools[allocation.pool].vertices.Free(allocation.vertices);
+	pools[allocation.pool].indices.Free(allocation.indices);
+}
+
+unsigned int GeometryArena::GetBaseVertex(const GeometryAllocation& allocation)
+{
+	return allocation.pool < pools.size() ? pools[allocation.pool].vertices.GetOffset(allocation.vertices) : 0;
+}
+
+unsigned int GeometryArena::GetStartIndex(const GeometryAllocation& allocation)
+{
+	return allocation.pool < pools.size() ? pools[allocation.pool].indices.GetOffset(allocation.indices) : 0;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> GeometryArena::GetVertexBuffer(const GeometryAllocation& allocation)
+{
+	return allocation.pool < pools.size() ? pools[allocation.pool].vertexBuffer : nullptr;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> GeometryArena::GetIndexBuffer(const GeometryAllocation& allocation)
+{
+	return allocation.pool < pools.size() ? pools[allocation.pool].indexBuffer : nullptr;
+}
+
+unsigned int GeometryArena::FindPool(unsigned int vertexStride, DXGI_FORMAT indexFormat)
+{
+	for (unsigned int i = 0; i < pools.size(); i++)
+	{
+		if (pools[i].vertexStride == vertexStride && pools[i].indexFormat == indexFormat)
+			return i;
+	}
+
+	// Buffers are only made once something is put in them
+	Pool pool;
+	pool.vertexStride = vertexStride;
+	pool.indexFormat = indexFormat;
+	pool.indexSize = indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(unsigned int);
+	pool.streamCapacity = 0;
+	pool.streamOffset = 0;
+	pools.push_back(pool);
+	return (unsigned int)pools.size() - 1;
+}
+
+bool GeometryArena::Reserve(RangeAllocator& allocator, Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer, unsigned int elementSize, UINT bindFlags, unsigned int count, unsigned int& handle)
+{
+	handle = allocator.Allocate(count);
+	if (handle != RANGE_INVALID)
+		return true;
+
+	// Packing is enough when the space is there but split up,
+	// otherwise the buffer doubles until the mesh fits
+	RangeAllocatorStats stats = allocator.GetStats();
+	unsigned int capacity = std::max(stats.capacity, (unsigned int)(bindFlags == D3D11_BIND_VERTEX_BUFFER ? GEOMETRY_ARENA_VERTEX_CAPACITY : GEOMETRY_ARENA_INDEX_CAPACITY));
+	if (buffer.Get() != nullptr && stats.capacity - stats.used >= count)
+		capacity = stats.capacity;
+	while (capacity - stats.used < count)
+		capacity *= 2;
+
+	if (!Rebuild(allocator, buffer, elementSize, bindFlags, capacity))
+		return false;
+
+	handle = allocator.Allocate(count);
+	return handle != RANGE_INVALID;
+}
+
+#pragma endregion
+
+#pragma region BINDING
+
+void GeometryArena::Bind(const GeometryAllocation& allocation)
+{
+	if (allocation.pool >= pools.size())
+		return;
+
+	Pool& pool = pools[allocation.pool];
+	BindBuffers(pool.vertexBuffer.Get(), pool.vertexStride, pool.indexBuffer.Get(), pool.indexFormat);
+}
+
+void* GeometryArena::MapStream(const GeometryAllocation& allocation, unsigned int indexCount, unsigned int& startIndex)
+{
+	if (allocation.pool >= pools.size() || indexCount == 0)
+		return nullptr;
+
+	Pool& pool = pools[allocation.pool];
+	if (indexCount > pool.streamCapacity)
+	{
+		unsigned int capacity = std::max(pool.streamCapacity, (unsigned int)GEOMETRY_ARENA_STREAM_CAPACITY);
+		while (capacity < indexCount)
+			capacity *= 2;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth = capacity * pool.indexSize;
+		desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		Microsoft::WRL::ComPtr<ID3D11Buffer> stream;
+		if (FAILED(device->CreateBuffer(&desc, nullptr, stream.GetAddressOf())))
+			return nullptr;
+
+		pool.streamBuffer = stream;
+		pool.streamCapacity = capacity;
+		pool.streamOffset = capacity;
+	}
+
+	// Appending never touches indices the GPU may still be reading,
+	// the whole ring is only thrown away once it is full
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (pool.streamOffset + indexCount > pool.streamCapacity)
+	{
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		pool.streamOffset = 0;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(pool.streamBuffer.Get(), 0, mapType, 0, &mapped)))
+		return nullptr;
+
+	startIndex = pool.streamOffset;
+	pool.streamOffset += indexCount;
+	return static_cast<unsigned char*>(mapped.pData) + startIndex * pool.indexSize;
+}
+
+void GeometryArena::UnmapStream(const GeometryAllocation& allocation)
+{
+	if (allocation.pool >= pools.size())
+		return;
+
+	Pool& pool = pools[allocation.pool];
+	context->Unmap(pool.streamBuffer.Get(), 0);
+	BindBuffers(pool.vertexBuffer.Get(), pool.vertexStride, pool.streamBuffer.Get(), pool.indexFormat);
+}
+
+void GeometryArena::ResetBindings()
+{
+	boundVertexBuffer = nullptr;
+	boundIndexBuffer = nullptr;
+	binds = 0;
+	skippedBinds = 0;
+}
+
+void GeometryArena::BindBuffers(ID3D11Buffer* vertexBuffer, unsigned int vertexStride, ID3D11Buffer* indexBuffer, DXGI_FORMAT indexFormat)
+{
+	if (vertexBuffer == boundVertexBuffer && indexBuffer == boundIndexBuffer)
+	{
+		skippedBinds++;
+		return;
+	}
+
+	if (vertexBuffer != boundVertexBuffer)
+	{
+		UINT stride = vertexStride;
+		UINT offset = 0;
+		context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+		boundVertexBuffer = vertexBuffer;
+	}
+	if (indexBuffer != boundIndexBuffer)
+	{
+		context->IASetIndexBuffer(indexBuffer, indexFormat, 0);
+		boundIndexBuffer = indexBuffer;
+	}
+	binds++;
+}
+
+#pragma endregion
+
+#pragma region DEFRAGMENTATION
+
+void GeometryArena::Defragment()
+{
+	for (Pool& pool : pools)
+	{
+		if (pool.vertices.GetStats().fragmentation > 0.0f)
+			Rebuild(pool.vertices, pool.vertexBuffer, pool.vertexStride, D3D11_BIND_VERTEX_BUFFER, pool.vertices.GetCapacity());
+		if (pool.indices.GetStats().fragmentation > 0.0f)
+			Rebuild(pool.indices, pool.indexBuffer, pool.indexSize, D3D11_BIND_INDEX_BUFFER, pool.indices.GetCapacity());
+	}
+}
+
+bool GeometryArena::Rebuild(RangeAllocator& allocator, Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer, unsigned int elementSize, UINT bindFlags, unsigned int capacity)
+{
+	// A resource can't be copied onto itself where the ranges
+	// overlap, so the packed ranges go into a new buffer
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = capacity * elementSize;
+	desc.BindFlags = bindFlags;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> packed;
+	if (FAILED(device->CreateBuffer(&desc, nullptr, packed.GetAddressOf())))
+		return false;
+
+	if (buffer.Get() != nullptr)
+	{
+		std::vector<RangeMove> moves;
+		unsigned int used = allocator.GetStats().used;
+		allocator.Defragment(moves);
+
+		// Everything before the first gap stays where it is
+		D3D11_BOX box = {};
+		box.bottom = 1;
+		box.back = 1;
+		box.right = (moves.empty() ? used : moves[0].to) * elementSize;
+		if (box.right > 0)
+			context->CopySubresourceRegion(packed.Get(), 0, 0, 0, 0, buffer.Get(), 0, &box);
+
+		for (const RangeMove& move : moves)
+		{
+			box.left = move.from * elementSize;
+			box.right = (move.from + move.size) * elementSize;
+			context->CopySubresourceRegion(packed.Get(), 0, move.to * elementSize, 0, 0, buffer.Get(), 0, &box);
+		}
+		defragmentations++;
+	}
+
+	allocator.Grow(capacity);
+	buffer = packed;
+
+	// The old buffer may still be bound
+	boundVertexBuffer = nullptr;
+	boundIndexBuffer = nullptr;
+	return true;
+}
+
+#pragma endregion
+
+bool GeometryArena::Read(const GeometryAllocation& allocation, std::vector<unsigned char>& vertices, std::vector<unsigned char>& indices)
+{
+	if (allocation.pool >= pools.size())
+		return false;
+
+	Pool& pool = pools[allocation.pool];
+	return
+		ReadRange(pool.vertexBuffer.Get(), pool.vertices.GetOffset(allocation.vertices) * pool.vertexStride, pool.vertices.GetSize(allocation.vertices) * pool.vertexStride, vertices) &&
+		ReadRange(pool.indexBuffer.Get(), pool.indices.GetOffset(allocation.indices) * pool.indexSize, pool.indices.GetSize(allocation.indices) * pool.indexSize, indices);
+}
+
+bool GeometryArena::ReadRange(ID3D11Buffer* buffer, unsigned int offset, unsigned int size, std::vector<unsigned char>& out)
+{
+	out.clear();
+	if (buffer == nullptr || size == 0)
+		return false;
+
+	// Default usage buffers can only be read through a staging copy
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_STAGING;
+	desc.ByteWidth = size;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> staging;
+	if (FAILED(device->CreateBuffer(&desc, nullptr, staging.GetAddressOf())))
+		return false;
+
+	D3D11_BOX box = {};
+	box.left = offset;
+	box.right = offset + size;
+	box.bottom = 1;
+	box.back = 1;
+	context->CopySubresourceRegion(staging.Get(), 0, 0, 0, 0, buffer, 0, &box);
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(staging.Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+		return false;
+	const unsigned char* data = static_cast<const unsigned char*>(mapped.pData);
+	out.assign(data, data + size);
+	context->Unmap(staging.Get(), 0);
+	return true;
+}
+
+GeometryArenaStats GeometryArena::GetStats()
+{
+	GeometryArenaStats stats = {};
+	stats.pools = (unsigned int)pools.size();
+	stats.defragmentations = defragmentations;
+	stats.binds = binds;
+	stats.skippedBinds = skippedBinds;
+
+	auto add = [](RangeAllocatorStats& total, const RangeAllocatorStats& pool)
+	{
+		total.capacity += pool.capacity;
+		total.used += pool.used;
+		total.allocations += pool.allocations;
+		total.freeRanges += pool.freeRanges;
+		total.largestFree = std::max(total.largestFree, pool.largestFree);
+		total.fragmentation = std::max(total.fragmentation, pool.fragmentation);
+	};
+	for (const Pool& pool : pools)
+	{
+		add(stats.vertices, pool.vertices.GetStats());
+		add(stats.indices, pool.indices.GetStats());
+	}
+	return stats;
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+
+#include "RangeAllocator.h"
+
+/*
+	Holds the geometry of every mesh in a few large buffers, one
+	vertex and index buffer pair per vertex layout and index format.
+	Meshes only own ranges of them, so drawing different meshes only
+	changes the base vertex and start index and the input assembler
+	is rebound when the layout changes instead of every draw
+*/
+
+// Starting size of every pool, they double when they run out
+#define GEOMETRY_ARENA_VERTEX_CAPACITY 262144
+#define GEOMETRY_ARENA_INDEX_CAPACITY 1048576
+
+// Starting size of the index ring that culled draws write into
+#define GEOMETRY_ARENA_STREAM_CAPACITY 262144
+
+// Where a mesh lives in the arena
+struct GeometryAllocation
+{
+	unsigned int pool;
+	unsigned int vertices;	// Handles in the pool's allocators
+	unsigned int indices;
+};
+
+struct GeometryArenaStats
+{
+	unsigned int pools;
+	RangeAllocatorStats vertices;	// Summed over every pool, the free range stats are the worst pool's
+	RangeAllocatorStats indices;
+	unsigned int defragmentations;
+
+	// Input assembler binds since the last reset, and how many were already bound
+	unsigned int binds;
+	unsigned int skippedBinds;
+};
+
+class GeometryArena
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static GeometryArena& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new GeometryArena();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	GeometryArena(GeometryArena const&) = delete;
+	void operator=(GeometryArena const&) = delete;
+
+private:
+	static GeometryArena* instance;
+	GeometryArena();
+#pragma endregion
+
+public:
+	/// <summary>
+	/// Give the arena the device its buffers are made with. Has to
+	/// happen before the first mesh is created
+	/// </summary>
+	void Initialize(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	/// <summary>
+	/// Copy a mesh into the pool for its layout. Indices are relative
+	/// to the mesh's first vertex, so 16 bit indices work for any mesh
+	/// under 65536 vertices no matter where it ends up in the pool
+	/// </summary>
+	/// <returns>False if the buffers could not be made big enough</returns>
+	bool Allocate(unsigned int vertexStride, DXGI_FORMAT indexFormat,
+		const void* vertices, unsigned int vertexCount,
+		const void* indices, unsigned int indexCount,
+		GeometryAllocation& out);
+	void Free(const GeometryAllocation& allocation);
+	/// <summary>
+	/// Overwrite the vertices of an allocation in place, for meshes that
+	/// deform on the CPU. The count can't be more than was allocated
+	/// </summary>
+	/// <param name="firstVertex">Where within the allocation the first one goes</param>
+	/// <returns>False if the allocation is too small or not valid</returns>
+	bool WriteVertices(const GeometryAllocation& allocation, const void* vertices, unsigned int vertexCount, unsigned int firstVertex = 0);
+
+	unsigned int GetBaseVertex(const GeometryAllocation& allocation);
+	unsigned int GetStartIndex(const GeometryAllocation& allocation);
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer(const GeometryAllocation& allocation);
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer(const GeometryAllocation& allocation);
+
+	/// <summary>
+	/// Bind the pool of an allocation to the input assembler, unless
+	/// it is already bound
+	/// </summary>
+	void Bind(const GeometryAllocation& allocation);
+	/// <summary>
+	/// Reserve room for indices in the pool's index ring, for draws
+	/// that build their indices every frame. Ranges that were handed
+	/// out earlier stay untouched until the ring wraps around
+	/// </summary>
+	/// <returns>Where to write the indices, nullptr if the ring could not be mapped</returns>
+	void* MapStream(const GeometryAllocation& allocation, unsigned int indexCount, unsigned int& startIndex);
+	/// <summary>
+	/// Finish writing indices and bind the ring with the pool's vertices
+	/// </summary>
+	void UnmapStream(const GeometryAllocation& allocation);
+	/// <summary>
+	/// Forget what is bound, for when something outside the arena may
+	/// have changed the input assembler. Also resets the bind counters
+	/// </summary>
+	void ResetBindings();
+
+	/// <summary>
+	/// Pack every pool so its free space is in one range
+	/// </summary>
+	void Defragment();
+	/// <summary>
+	/// Read an allocation back from the GPU. Slow, meant for build steps
+	/// </summary>
+	bool Read(const GeometryAllocation& allocation, std::vector<unsigned char>& vertices, std::vector<unsigned char>& indices);
+
+	GeometryArenaStats GetStats();
+
+private:
+	struct Pool
+	{
+		unsigned int vertexStride;
+		DXGI_FORMAT indexFormat;
+		unsigned int indexSize;
+
+		RangeAllocator vertices;
+		RangeAllocator indices;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+
+		Microsoft::WRL::ComPtr<ID3D11Buffer> streamBuffer;
+		unsigned int streamCapacity;
+		unsigned int streamOffset;
+	};
+
+	unsigned int FindPool(unsigned int vertexStride, DXGI_FORMAT indexFormat);
+	bool Reserve(RangeAllocator& allocator, Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer, unsigned int elementSize, UINT bindFlags, unsigned int count, unsigned int& handle);
+	bool Rebuild(RangeAllocator& allocator, Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer, unsigned int elementSize, UINT bindFlags, unsigned int capacity);
+	bool ReadRange(ID3D11Buffer* buffer, unsigned int offset, unsigned int size, std::vector<unsigned char>& out);
+	void BindBuffers(ID3D11Buffer* vertexBuffer, unsigned int vertexStride, ID3D11Buffer* indexBuffer, DXGI_FORMAT indexFormat);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	std::vector<Pool> pools;
+
+	// Last thing bound to the input assembler
+	ID3D11Buffer* boundVertexBuffer;
+	ID3D11Buffer* boundIndexBuffer;
+
+	unsigned int defragmentations;
+	unsigned int binds;
+	unsigned int skippedBinds;
+};
@@ -0,0 +1,476 @@
+#include "GltfImporter.h"
+#include "MeshOptimizer.h"
+
+#include <cstring>
+using namespace DirectX;
+
+// Layout of the start of a .glb file and of each of its chunks
+struct GlbHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int length;
+};
+
+struct GlbChunkHeader
+{
+	unsigned int length;
+	unsigned int type;
+};
+
+bool GltfImporter::Load(const wchar_t* file, GltfAsset& out)
+{
+	out = GltfAsset();
+	out.file.reset(new MappedFile(file));
+	if (!out.file->IsOpen() || out.file->GetSize() < sizeof(GlbHeader) + sizeof(GlbChunkHeader))
+		return false;
+
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(out.file->GetData());
+	size_t size = out.file->GetSize();
+
+	GlbHeader header;
+	std::memcpy(&header, data, sizeof(GlbHeader));
+	if (header.magic != GLTF_MAGIC || header.version != 2 || header.length > size)
+		return false;
+	size = header.length;
+
+	// The json chunk comes first, the binary chunk is optional
+	GlbChunkHeader jsonChunk;
+	std::memcpy(&jsonChunk, data + sizeof(GlbHeader), sizeof(GlbChunkHeader));
+	size_t jsonStart = sizeof(GlbHeader) + sizeof(GlbChunkHeader);
+	if (jsonChunk.type != GLTF_CHUNK_JSON || jsonChunk.length > size - jsonStart)
+		return false;
+
+	JsonValue root;
+	if (!JsonValue::Parse(reinterpret_cast<const char*>(data + jsonStart), jsonChunk.length, root))
+		return false;
+
+	Chunks chunks = { &root, nullptr, 0 };
+	size_t binHeader = jsonStart + jsonChunk.length;
+	if (binHeader + sizeof(GlbChunkHeader) <= size)
+	{
+		GlbChunkHeader binChunk;
+		std::memcpy(&binChunk, data + binHeader, sizeof(GlbChunkHeader));
+		size_t binStart = binHeader + sizeof(GlbChunkHeader);
+		if (binChunk.type == GLTF_CHUNK_BIN && binChunk.length <= size - binStart)
+		{
+			chunks.bin = data + binStart;
+			chunks.binSize = binChunk.length;
+		}
+	}
+
+	const JsonValue& meshes = root["meshes"];
+	out.meshes.resize(meshes.GetSize());
+	for (size_t i = 0; i < meshes.GetSize(); i++)
+	{
+		if (!LoadMesh(chunks, meshes[i], out.meshes[i]))
+			return false;
+	}
+
+	const JsonValue& materials = root["materials"];
+	out.materials.resize(materials.GetSize());
+	for (size_t i = 0; i < materials.GetSize(); i++)
+	{
+		LoadMaterial(root, materials[i], out.materials[i]);
+	}
+
+	// Images that are not embedded can't be handed out as views, they stay empty
+	const JsonValue& images = root["images"];
+	out.images.resize(images.GetSize());
+	for (size_t i = 0; i < images.GetSize(); i++)
+	{
+		GltfImage& image = out.images[i];
+		image.data = nullptr;
+		image.size = 0;
+		image.mimeType = images[i]["mimeType"].GetString();
+
+		unsigned int stride;
+		GetBufferView(chunks, images[i]["bufferView"].GetInt(GLTF_NONE), image.data, image.size, stride);
+	}
+
+	return LoadNodes(root, out);
+}
+
+bool GltfImporter::LoadMesh(const Chunks& chunks, const JsonValue& mesh, GltfMesh& out)
+{
+	out.name = mesh["name"].GetString();
+
+	const JsonValue& primitives = mesh["primitives"];
+	for (size_t i = 0; i < primitives.GetSize(); i++)
+	{
+		// Points and lines have nothing to shade
+		if (primitives[i]["mode"].GetInt(GLTF_MODE_TRIANGLES) != GLTF_MODE_TRIANGLES)
+			continue;
+
+		out.primitives.emplace_back();
+		if (!LoadPrimitive(chunks, primitives[i], out.primitives.back()))
+			return false;
+	}
+	return true;
+}
+
+bool GltfImporter::LoadPrimitive(const Chunks& chunks, const JsonValue& primitive, GltfPrimitive& out)
+{
+	out.material = primitive["material"].GetInt(GLTF_NONE);
+
+	const JsonValue& attributes = primitive["attributes"];
+	Accessor positions;
+	if (!GetAccessor(chunks, attributes["POSITION"].GetInt(GLTF_NONE), positions) ||
+		positions.componentType != GLTF_FLOAT || positions.components != 3)
+		return false;
+
+	Accessor normals;
+	bool hasNormals = GetAccessor(chunks, attributes["NORMAL"].GetInt(GLTF_NONE), normals) &&
+		normals.componentType == GLTF_FLOAT && normals.components == 3 && normals.count == positions.count;
+
+	Accessor uvs;
+	bool hasUVs = GetAccessor(chunks, attributes["TEXCOORD_0"].GetInt(GLTF_NONE), uvs) &&
+		uvs.components == 2 && uvs.count == positions.count;
+
+	// Interleave straight out of the binary chunk. glTF is right handed
+	// with the same uv origin as Direct3D, so only z is mirrored
+	std::vector<Vertex>& vertices = out.data.vertices;
+	vertices.resize(positions.count);
+	for (unsigned int i = 0; i < positions.count; i++)
+	{
+		Vertex& v = vertices[i];
+		ReadFloats(positions, i, &v.Position.x, 3);
+		v.Position.z = -v.Position.z;
+
+		v.Normal = XMFLOAT3(0, 0, 0);
+		if (hasNormals)
+		{
+			ReadFloats(normals, i, &v.Normal.x, 3);
+			v.Normal.z = -v.Normal.z;
+		}
+
+		v.UV = XMFLOAT2(0, 0);
+		if (hasUVs)
+			ReadFloats(uvs, i, &v.UV.x, 2);
+
+		v.Tangent = XMFLOAT4(0, 0, 0, 1);
+	}
+
+	// Mirroring flips the winding, so the last two corners swap
+	std::vector<unsigned int>& indices = out.data.indices;
+	Accessor indexAccessor;
+	int indexIndex = primitive["indices"].GetInt(GLTF_NONE);
+	if (indexIndex != GLTF_NONE)
+	{
+		if (!GetAccessor(chunks, indexIndex, indexAccessor) || indexAccessor.components != 1 ||
+			indexAccessor.componentType == GLTF_FLOAT)
+			return false;
+
+		indices.resize(indexAccessor.count / 3 * 3);
+		for (unsigned int i = 0; i < indices.size(); i += 3)
+		{
+			indices[i + 0] = ReadIndex(indexAccessor, i + 0);
+			indices[i + 1] = ReadIndex(indexAccessor, i + 2);
+			indices[i + 2] = ReadIndex(indexAccessor, i + 1);
+		}
+	}
+	else
+	{
+		indices.resize(positions.count / 3 * 3);
+		for (unsigned int i = 0; i < indices.size(); i += 3)
+		{
+			indices[i + 0] = i + 0;
+			indices[i + 1] = i + 2;
+			indices[i + 2] = i + 1;
+		}
+	}
+
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		if (indices[i] >= positions.count)
+			return false;
+	}
+
+	if (!hasNormals)
+		CalculateNormals(out.data);
+
+	MeshOptimizer::Optimize(out.data);
+	return true;
+}
+
+void GltfImporter::LoadMaterial(const JsonValue& root, const JsonValue& material, GltfMaterial& out)
+{
+	const JsonValue& pbr = material["pbrMetallicRoughness"];
+	const JsonValue& baseColor = pbr["baseColorFactor"];
+
+	out.name = material["name"].GetString();
+	out.baseColor = XMFLOAT4(
+		baseColor[(size_t)0].GetFloat(1.0f),
+		baseColor[(size_t)1].GetFloat(1.0f),
+		baseColor[(size_t)2].GetFloat(1.0f),
+		baseColor[(size_t)3].GetFloat(1.0f));
+	out.metallic = pbr["metallicFactor"].GetFloat(1.0f);
+	out.roughness = pbr["roughnessFactor"].GetFloat(1.0f);
+
+	out.baseColorImage = GetImage(root, pbr["baseColorTexture"]);
+	out.metallicRoughnessImage = GetImage(root, pbr["metallicRoughnessTexture"]);
+	out.normalImage = GetImage(root, material["normalTexture"]);
+}
+
+bool GltfImporter::LoadNodes(const JsonValue& root, GltfAsset& out)
+{
+	const JsonValue& nodes = root["nodes"];
+
+	// Only what the default scene shows, or every node if there are no scenes
+	std::vector<int> roots;
+	const JsonValue& scenes = root["scenes"];
+	if (scenes.GetSize() > 0)
+	{
+		const JsonValue& scene = scenes[(size_t)root["scene"].GetInt(0)]["nodes"];
+		for (size_t i = 0; i < scene.GetSize(); i++)
+		{
+			roots.push_back(scene[i].GetInt(GLTF_NONE));
+		}
+	}
+	else
+	{
+		std::vector<bool> isChild(nodes.GetSize(), false);
+		for (size_t i = 0; i < nodes.GetSize(); i++)
+		{
+			const JsonValue& children = nodes[i]["children"];
+			for (size_t c = 0; c < children.GetSize(); c++)
+			{
+				int child = children[c].GetInt(GLTF_NONE);
+				if (child >= 0 && child < (int)nodes.GetSize())
+					isChild[child] = true;
+			}
+		}
+		for (size_t i = 0; i < nodes.GetSize(); i++)
+		{
+			if (!isChild[i])
+				roots.push_back((int)i);
+		}
+	}
+
+	// Depth first, so parents are always written out before their children.
+	// Each entry is a node of the file and its parent in the output
+	std::vector<bool> visited(nodes.GetSize(), false);
+	std::vector<std::pair<int, int>> stack;
+	for (size_t i = roots.size(); i-- > 0;)
+	{
+		stack.push_back(std::make_pair(roots[i], GLTF_NONE));
+	}
+
+	while (!stack.empty())
+	{
+		int index = stack.back().first;
+		int parent = stack.back().second;
+		stack.pop_back();
+
+		// A node can only have one parent, anything else is a broken file
+		if (index < 0 || index >= (int)nodes.GetSize() || visited[index])
+			return false;
+		visited[index] = true;
+
+		const JsonValue& node = nodes[(size_t)index];
+		GltfNode result;
+		result.name = node["name"].GetString();
+		result.parent = parent;
+		result.mesh = node["mesh"].GetInt(GLTF_NONE);
+		if (result.mesh >= (int)out.meshes.size())
+			result.mesh = GLTF_NONE;
+		LoadNodeTransform(node, result);
+
+		int outIndex = (int)out.nodes.size();
+		out.nodes.push_back(result);
+
+		const JsonValue& children = node["children"];
+		for (size_t c = children.GetSize(); c-- > 0;)
+		{
+			stack.push_back(std::make_pair(children[c].GetInt(GLTF_NONE), outIndex));
+		}
+	}
+
+	return true;
+}
+
+void GltfImporter::LoadNodeTransform(const JsonValue& node, GltfNode& out)
+{
+	XMVECTOR translation = XMVectorZero();
+	XMVECTOR rotation = XMQuaternionIdentity();
+	XMVECTOR scale = XMVectorSplatOne();
+
+	const JsonValue& matrix = node["matrix"];
+	if (matrix.GetSize() == 16)
+	{
+		// Column major with column vectors reads as row major with row vectors
+		XMFLOAT4X4 m;
+		for (size_t i = 0; i < 16; i++)
+		{
+			m.m[i / 4][i % 4] = matrix[i].GetFloat();
+		}
+		XMMatrixDecompose(&scale, &rotation, &translation, XMLoadFloat4x4(&m));
+	}
+	else
+	{
+		const JsonValue& t = node["translation"];
+		const JsonValue& r = node["rotation"];
+		const JsonValue& s = node["scale"];
+		if (t.GetSize() == 3)
+			translation = XMVectorSet(t[(size_t)0].GetFloat(), t[(size_t)1].GetFloat(), t[(size_t)2].GetFloat(), 0.0f);
+		if (r.GetSize() == 4)
+			rotation = XMVectorSet(r[(size_t)0].GetFloat(), r[(size_t)1].GetFloat(), r[(size_t)2].GetFloat(), r[(size_t)3].GetFloat(1.0f));
+		if (s.GetSize() == 3)
+			scale = XMVectorSet(s[(size_t)0].GetFloat(1.0f), s[(size_t)1].GetFloat(1.0f), s[(size_t)2].GetFloat(1.0f), 0.0f);
+	}
+
+	XMStoreFloat3(&out.translation, translation);
+	XMStoreFloat4(&out.rotation, XMQuaternionNormalize(rotation));
+	XMStoreFloat3(&out.scale, scale);
+
+	// Mirroring z negates the translation's z and the rotation's x and y
+	out.translation.z = -out.translation.z;
+	out.rotation.x = -out.rotation.x;
+	out.rotation.y = -out.rotation.y;
+}
+
+bool GltfImporter::GetAccessor(const Chunks& chunks, int index, Accessor& out)
+{
+	const JsonValue& accessor = (*chunks.json)["accessors"][(size_t)index];
+	if (index < 0 || accessor.GetType() != JSON_OBJECT || accessor.Has("sparse"))
+		return false;
+
+	out.count = (unsigned int)accessor["count"].GetInt(0);
+	out.componentType = (unsigned int)accessor["componentType"].GetInt(0);
+	out.normalized = accessor["normalized"].GetBool(false);
+
+	const std::string& type = accessor["type"].GetString();
+	out.components =
+		type == "SCALAR" ? 1 :
+		type == "VEC2" ? 2 :
+		type == "VEC3" ? 3 :
+		type == "VEC4" ? 4 : 0;
+
+	unsigned int componentSize =
+		out.componentType == GLTF_UNSIGNED_BYTE ? 1 :
+		out.componentType == GLTF_UNSIGNED_SHORT ? 2 :
+		out.componentType == GLTF_UNSIGNED_INT || out.componentType == GLTF_FLOAT ? 4 : 0;
+	if (out.components == 0 || componentSize == 0 || out.count == 0)
+		return false;
+
+	const unsigned char* view;
+	size_t viewSize;
+	if (!GetBufferView(chunks, accessor["bufferView"].GetInt(GLTF_NONE), view, viewSize, out.stride))
+		return false;
+
+	// Tightly packed unless the buffer view says otherwise
+	unsigned int elementSize = componentSize * out.components;
+	if (out.stride == 0)
+		out.stride = elementSize;
+
+	size_t offset = (size_t)accessor["byteOffset"].GetInt(0);
+	size_t lastElement = offset + (size_t)out.stride * (out.count - 1) + elementSize;
+	if (lastElement > viewSize)
+		return false;
+
+	out.data = view + offset;
+	return true;
+}
+
+bool GltfImporter::GetBufferView(const Chunks& chunks, int index, const unsigned char*& data, size_t& size, unsigned int& stride)
+{
+	const JsonValue& view = (*chunks.json)["bufferViews"][(size_t)index];
+	if (index < 0 || view.GetType() != JSON_OBJECT || chunks.bin == nullptr)
+		return false;
+
+	// Buffer 0 without a uri is the binary chunk, external buffers aren't supported
+	const JsonValue& buffer = (*chunks.json)["buffers"][(size_t)view["buffer"].GetInt(0)];
+	if (view["buffer"].GetInt(0) != 0 || buffer.Has("uri"))
+		return false;
+
+	size_t offset = (size_t)view["byteOffset"].GetNumber(0.0);
+	size = (size_t)view["byteLength"].GetNumber(0.0);
+	stride = (unsigned int)view["byteStride"].GetInt(0);
+	if (offset > chunks.binSize || size > chunks.binSize - offset)
+		return false;
+
+	data = chunks.bin + offset;
+	return true;
+}
+
+void GltfImporter::ReadFloats(const Accessor& accessor, unsigned int element, float* out, unsigned int count)
+{
+	const unsigned char* source = accessor.data + (size_t)accessor.stride * element;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		switch (accessor.componentType)
+		{
+		case GLTF_FLOAT:
+			std::memcpy(&out[i], source + i * sizeof(float), sizeof(float));
+			break;
+		case GLTF_UNSIGNED_SHORT:
+		{
+			unsigned short value;
+			std::memcpy(&value, source + i * sizeof(unsigned short), sizeof(unsigned short));
+			out[i] = accessor.normalized ? value / 65535.0f : (float)value;
+			break;
+		}
+		case GLTF_UNSIGNED_BYTE:
+			out[i] = accessor.normalized ? source[i] / 255.0f : (float)source[i];
+			break;
+		default:
+			out[i] = 0.0f;
+			break;
+		}
+	}
+}
+
+unsigned int GltfImporter::ReadIndex(const Accessor& accessor, unsigned int element)
+{
+	const unsigned char* source = accessor.data + (size_t)accessor.stride * element;
+	switch (accessor.componentType)
+	{
+	case GLTF_UNSIGNED_INT:
+	{
+		unsigned int value;
+		std::memcpy(&value, source, sizeof(unsigned int));
+		return value;
+	}
+	case GLTF_UNSIGNED_SHORT:
+	{
+		unsigned short value;
+		std::memcpy(&value, source, sizeof(unsigned short));
+		return value;
+	}
+	default:
+		return *source;
+	}
+}
+
+int GltfImporter::GetImage(const JsonValue& root, const JsonValue& textureInfo)
+{
+	int texture = textureInfo["index"].GetInt(GLTF_NONE);
+	if (texture < 0)
+		return GLTF_NONE;
+
+	int image = root["textures"][(size_t)texture]["source"].GetInt(GLTF_NONE);
+	return image < (int)root["images"].GetSize() ? image : GLTF_NONE;
+}
+
+void GltfImporter::CalculateNormals(MeshData& mesh)
+{
+	// Area weighted, the cross product's length does the weighting
+	for (unsigned int i = 0; i < mesh.indices.size(); i += 3)
+	{
+		Vertex& v0 = mesh.vertices[mesh.indices[i + 0]];
+		Vertex& v1 = mesh.vertices[mesh.indices[i + 1]];
+		Vertex& v2 = mesh.vertices[mesh.indices[i + 2]];
+
+		XMVECTOR p0 = XMLoadFloat3(&v0.Position);
+		XMVECTOR normal = XMVector3Cross(XMLoadFloat3(&v1.Position) - p0, XMLoadFloat3(&v2.Position) - p0);
+
+		XMStoreFloat3(&v0.Normal, XMLoadFloat3(&v0.Normal) + normal);
+		XMStoreFloat3(&v1.Normal, XMLoadFloat3(&v1.Normal) + normal);
+		XMStoreFloat3(&v2.Normal, XMLoadFloat3(&v2.Normal) + normal);
+	}
+
+	for (unsigned int i = 0; i < mesh.vertices.size(); i++)
+	{
+		XMStoreFloat3(&mesh.vertices[i].Normal, XMVector3Normalize(XMLoadFloat3(&mesh.vertices[i].Normal)));
+	}
+}
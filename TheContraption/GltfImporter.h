@@ -0,0 +1,137 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "MappedFile.h"
+#include "MeshData.h"
+#include "Json.h"
+
+/*
+	Loads binary glTF 2.0 (.glb) files. The file is memory mapped
+	and every accessor is read straight out of the binary chunk into
+	the final vertices and indices, embedded images are handed out as
+	views into the mapping. Positions, normals and rotations are
+	converted to left handed space like the obj importer does
+*/
+
+// "glTF" at the start of the file and the types of its two chunks
+#define GLTF_MAGIC 0x46546c67
+#define GLTF_CHUNK_JSON 0x4e4f534a
+#define GLTF_CHUNK_BIN 0x004e4942
+
+// Accessor component types
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+
+// The only primitive mode that is imported
+#define GLTF_MODE_TRIANGLES 4
+
+// Index into one of the asset's arrays that isn't there
+#define GLTF_NONE -1
+
+// One draw of a mesh, with a single material
+struct GltfPrimitive
+{
+	MeshData data;
+	int material;
+};
+
+struct GltfMesh
+{
+	std::string name;
+	std::vector<GltfPrimitive> primitives;
+};
+
+struct GltfNode
+{
+	std::string name;
+	int parent;
+	int mesh;
+
+	// Relative to the parent
+	DirectX::XMFLOAT3 translation;
+	DirectX::XMFLOAT4 rotation;
+	DirectX::XMFLOAT3 scale;
+};
+
+// Metallic roughness material. Textures are indices into the images
+struct GltfMaterial
+{
+	std::string name;
+	DirectX::XMFLOAT4 baseColor;
+	float metallic;
+	float roughness;
+
+	int baseColorImage;
+	int normalImage;
+	int metallicRoughnessImage;	// Roughness in green, metalness in blue
+};
+
+// Encoded image (png or jpeg) that still lives inside the mapped file
+struct GltfImage
+{
+	const unsigned char* data;
+	size_t size;
+	std::string mimeType;
+};
+
+// Everything in a .glb file. Images point into the file, so it
+// stays mapped for as long as the asset is around
+struct GltfAsset
+{
+	std::unique_ptr<MappedFile> file;
+
+	std::vector<GltfMesh> meshes;
+	std::vector<GltfNode> nodes;		// Parents always come before their children
+	std::vector<GltfMaterial> materials;
+	std::vector<GltfImage> images;
+};
+
+class GltfImporter
+{
+public:
+	/// <summary>
+	/// Read a .glb file. Every primitive is reordered for the vertex
+	/// cache, overdraw and vertex fetch like obj meshes are. Tangents
+	/// are left for the mesh to generate
+	/// </summary>
+	/// <returns>False if the file could not be read or is broken</returns>
+	static bool Load(const wchar_t* file, GltfAsset& out);
+
+private:
+	// Where the elements of an accessor are in the binary chunk
+	struct Accessor
+	{
+		const unsigned char* data;
+		unsigned int count;
+		unsigned int stride;
+		unsigned int componentType;
+		unsigned int components;
+		bool normalized;
+	};
+
+	// The file's two chunks
+	struct Chunks
+	{
+		const JsonValue* json;
+		const unsigned char* bin;
+		size_t binSize;
+	};
+
+	static bool LoadMesh(const Chunks& chunks, const JsonValue& mesh, GltfMesh& out);
+	static bool LoadPrimitive(const Chunks& chunks, const JsonValue& primitive, GltfPrimitive& out);
+	static void LoadMaterial(const JsonValue& root, const JsonValue& material, GltfMaterial& out);
+	static bool LoadNodes(const JsonValue& root, GltfAsset& out);
+	static void LoadNodeTransform(const JsonValue& node, GltfNode& out);
+
+	static bool GetAccessor(const Chunks& chunks, int index, Accessor& out);
+	static bool GetBufferView(const Chunks& chunks, int index, const unsigned char*& data, size_t& size, unsigned int& stride);
+	static void ReadFloats(const Accessor& accessor, unsigned int element, float* out, unsigned int count);
+	static unsigned int ReadIndex(const Accessor& accessor, unsigned int element);
+	static int GetImage(const JsonValue& root, const JsonValue& textureInfo);
+	static void CalculateNormals(MeshData& mesh);
+};
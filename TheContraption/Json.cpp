@@ -0,0 +1,317 @@
+#include "Json.h"
+#include <cstdlib>
+#include <cstring>
+
+// Numbers longer than this are not something an asset header would hold
+#define JSON_MAX_NUMBER_LENGTH 64
+
+// Handed out for missing members so lookups never fail
+static const JsonValue nullValue;
+static const std::string emptyString;
+
+JsonValue::JsonValue() :
+	type(JSON_NULL),
+	boolean(false),
+	number(0.0)
+{
+}
+
+bool JsonValue::Parse(const char* text, size_t length, JsonValue& out)
+{
+	out = JsonValue();
+	const char* end = text + length;
+	const char* c = ParseValue(SkipWhitespace(text, end), end, out, 0);
+	if (c == nullptr)
+		return false;
+
+	// Only whitespace (or the padding of a binary container) may follow
+	c = SkipWhitespace(c, end);
+	while (c < end && *c == '\0')
+		c++;
+	return c == end;
+}
+
+JsonType JsonValue::GetType() const
+{
+	return type;
+}
+
+size_t JsonValue::GetSize() const
+{
+	return elements.size();
+}
+
+bool JsonValue::Has(const char* key) const
+{
+	return &(*this)[key] != &nullValue;
+}
+
+const JsonValue& JsonValue::operator[](const char* key) const
+{
+	if (type != JSON_OBJECT)
+		return nullValue;
+
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		if (keys[i] == key)
+			return elements[i];
+	}
+	return nullValue;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	return type == JSON_ARRAY && index < elements.size() ? elements[index] : nullValue;
+}
+
+double JsonValue::GetNumber(double fallback) const
+{
+	return type == JSON_NUMBER ? number : fallback;
+}
+
+float JsonValue::GetFloat(float fallback) const
+{
+	return type == JSON_NUMBER ? (float)number : fallback;
+}
+
+int JsonValue::GetInt(int fallback) const
+{
+	return type == JSON_NUMBER ? (int)number : fallback;
+}
+
+bool JsonValue::GetBool(bool fallback) const
+{
+	return type == JSON_BOOL ? boolean : fallback;
+}
+
+const std::string& JsonValue::GetString() const
+{
+	return type == JSON_STRING ? string : emptyString;
+}
+
+const char* JsonValue::SkipWhitespace(const char* c, const char* end)
+{
+	while (c < end && (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r'))
+		c++;
+	return c;
+}
+
+const char* JsonValue::ParseValue(const char* c, const char* end, JsonValue& out, int depth)
+{
+	if (c >= end || depth > JSON_MAX_DEPTH)
+		return nullptr;
+
+	switch (*c)
+	{
+	case '{':
+	{
+		out.type = JSON_OBJECT;
+		c = SkipWhitespace(c + 1, end);
+		if (c < end && *c == '}')
+			return c + 1;
+
+		while (c != nullptr && c < end)
+		{
+			out.keys.emplace_back();
+			c = ParseString(c, end, out.keys.back());
+			if (c == nullptr)
+				return nullptr;
+
+			c = SkipWhitespace(c, end);
+			if (c >= end || *c != ':')
+				return nullptr;
+
+			out.elements.emplace_back();
+			c = ParseValue(SkipWhitespace(c + 1, end), end, out.elements.back(), depth + 1);
+			if (c == nullptr)
+				return nullptr;
+
+			c = SkipWhitespace(c, end);
+			if (c < end && *c == '}')
+				return c + 1;
+			if (c >= end || *c != ',')
+				return nullptr;
+			c = SkipWhitespace(c + 1, end);
+		}
+		return nullptr;
+	}
+
+	case '[':
+	{
+		out.type = JSON_ARRAY;
+		c = SkipWhitespace(c + 1, end);
+		if (c < end && *c == ']')
+			return c + 1;
+
+		while (c != nullptr && c < end)
+		{
+			out.elements.emplace_back();
+			c = ParseValue(c, end, out.elements.back(), depth + 1);
+			if (c == nullptr)
+				return nullptr;
+
+			c = SkipWhitespace(c, end);
+			if (c < end && *c == ']')
+				return c + 1;
+			if (c >= end || *c != ',')
+				return nullptr;
+			c = SkipWhitespace(c + 1, end);
+		}
+		return nullptr;
+	}
+
+	case '"':
+		out.type = JSON_STRING;
+		return ParseString(c, end, out.string);
+
+	case 't':
+		out.type = JSON_BOOL;
+		out.boolean = true;
+		return ParseLiteral(c, end, "true");
+
+	case 'f':
+		out.type = JSON_BOOL;
+		out.boolean = false;
+		return ParseLiteral(c, end, "false");
+
+	case 'n':
+		out.type = JSON_NULL;
+		return ParseLiteral(c, end, "null");
+
+	default:
+		out.type = JSON_NUMBER;
+		return ParseNumber(c, end, out.number);
+	}
+}
+
+const char* JsonValue::ParseString(const char* c, const char* end, std::string& out)
+{
+	if (c >= end || *c != '"')
+		return nullptr;
+	c++;
+
+	while (c < end && *c != '"')
+	{
+		if (*c != '\\')
+		{
+			out.push_back(*c++);
+			continue;
+		}
+
+		if (++c >= end)
+			return nullptr;
+
+		switch (*c++)
+		{
+		case '"': out.push_back('"'); break;
+		case '\\': out.push_back('\\'); break;
+		case '/': out.push_back('/'); break;
+		case 'b': out.push_back('\b'); break;
+		case 'f': out.push_back('\f'); break;
+		case 'n': out.push_back('\n'); break;
+		case 'r': out.push_back('\r'); break;
+		case 't': out.push_back('\t'); break;
+		case 'u':
+		{
+			// Surrogate pairs come as two escapes in a row
+			unsigned int codePoint = 0;
+			for (int escape = 0; escape < 2; escape++)
+			{
+				if (end - c < 4)
+					return nullptr;
+
+				unsigned int unit = 0;
+				for (int i = 0; i < 4; i++, c++)
+				{
+					char h = *c;
+					unsigned int digit =
+						h >= '0' && h <= '9' ? h - '0' :
+						h >= 'a' && h <= 'f' ? h - 'a' + 10 :
+						h >= 'A' && h <= 'F' ? h - 'A' + 10 : 16;
+					if (digit == 16)
+						return nullptr;
+					unit = unit * 16 + digit;
+				}
+
+				if (escape == 1)
+				{
+					if (unit < 0xdc00 || unit > 0xdfff)
+						return nullptr;
+					codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (unit - 0xdc00);
+					break;
+				}
+
+				codePoint = unit;
+				if (unit < 0xd800 || unit > 0xdbff)
+					break;
+				if (end - c < 2 || c[0] != '\\' || c[1] != 'u')
+					return nullptr;
+				c += 2;
+			}
+			AppendUtf8(out, codePoint);
+			break;
+		}
+		default:
+			return nullptr;
+		}
+	}
+
+	return c < end ? c + 1 : nullptr;
+}
+
+const char* JsonValue::ParseNumber(const char* c, const char* end, double& out)
+{
+	// The text may not be null terminated, so the number is copied out first
+	char buffer[JSON_MAX_NUMBER_LENGTH + 1];
+	size_t length = 0;
+	while (c + length < end && length < JSON_MAX_NUMBER_LENGTH &&
+		std::strchr("0123456789+-.eE", c[length]) != nullptr && c[length] != '\0')
+	{
+		buffer[length] = c[length];
+		length++;
+	}
+	if (length == 0)
+		return nullptr;
+	buffer[length] = '\0';
+
+	char* parsedEnd = nullptr;
+	out = std::strtod(buffer, &parsedEnd);
+	if (parsedEnd != buffer + length)
+		return nullptr;
+
+	return c + length;
+}
+
+const char* JsonValue::ParseLiteral(const char* c, const char* end, const char* literal)
+{
+	size_t length = std::strlen(literal);
+	if ((size_t)(end - c) < length || std::memcmp(c, literal, length) != 0)
+		return nullptr;
+	return c + length;
+}
+
+void JsonValue::AppendUtf8(std::string& out, unsigned int codePoint)
+{
+	if (codePoint < 0x80)
+	{
+		out.push_back((char)codePoint);
+	}
+	else if (codePoint < 0x800)
+	{
+		out.push_back((char)(0xc0 | (codePoint >> 6)));
+		out.push_back((char)(0x80 | (codePoint & 0x3f)));
+	}
+	else if (codePoint < 0x10000)
+	{
+		out.push_back((char)(0xe0 | (codePoint >> 12)));
+		out.push_back((char)(0x80 | ((codePoint >> 6) & 0x3f)));
+		out.push_back((char)(0x80 | (codePoint & 0x3f)));
+	}
+	else
+	{
+		out.push_back((char)(0xf0 | (codePoint >> 18)));
+		out.push_back((char)(0x80 | ((codePoint >> 12) & 0x3f)));
+		out.push_back((char)(0x80 | ((codePoint >> 6) & 0x3f)));
+		out.push_back((char)(0x80 | (codePoint & 0x3f)));
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+	Small read only JSON document. It is meant for the headers of
+	asset formats like glTF, which are a few kilobytes at most, so
+	every value simply owns its children
+*/
+
+// Objects and arrays nested deeper than this are rejected
+#define JSON_MAX_DEPTH 64
+
+enum JsonType
+{
+	JSON_NULL,
+	JSON_BOOL,
+	JSON_NUMBER,
+	JSON_STRING,
+	JSON_ARRAY,
+	JSON_OBJECT
+};
+
+class JsonValue
+{
+public:
+	JsonValue();
+
+	/// <summary>
+	/// Parse a whole document. The text does not need to be null terminated
+	/// </summary>
+	/// <returns>False if the text is not valid JSON</returns>
+	static bool Parse(const char* text, size_t length, JsonValue& out);
+
+	JsonType GetType() const;
+	/// <summary>
+	/// Elements of an array or members of an object, 0 for anything else
+	/// </summary>
+	size_t GetSize() const;
+	/// <summary>
+	/// Whether this is an object with the given member
+	/// </summary>
+	bool Has(const char* key) const;
+
+	/// <summary>
+	/// Member of an object. Missing members and anything that is not
+	/// an object give a null value, so lookups can be chained
+	/// </summary>
+	const JsonValue& operator[](const char* key) const;
+	/// <summary>
+	/// Element of an array, or a null value if it is out of range
+	/// </summary>
+	const JsonValue& operator[](size_t index) const;
+
+	// Values of the wrong type give the fallback
+	double GetNumber(double fallback = 0.0) const;
+	float GetFloat(float fallback = 0.0f) const;
+	int GetInt(int fallback = 0) const;
+	bool GetBool(bool fallback = false) const;
+	const std::string& GetString() const;
+
+private:
+	JsonType type;
+	bool boolean;
+	double number;
+	std::string string;
+
+	// Objects keep their keys next to the values in elements
+	std::vector<JsonValue> elements;
+	std::vector<std::string> keys;
+
+	static const char* SkipWhitespace(const char* c, const char* end);
+	static const char* ParseValue(const char* c, const char* end, JsonValue& out, int depth);
+	static const char* ParseString(const char* c, const char* end, std::string& out);
+	static const char* ParseNumber(const char* c, const char* end, double& out);
+	static const char* ParseLiteral(const char* c, const char* end, const char* literal);
+	static void AppendUtf8(std::string& out, unsigned int codePoint);
+};
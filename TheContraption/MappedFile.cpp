@@ -0,0 +1,105 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cstdlib>
+#include <cwchar>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const wchar_t* path) :
+	data(nullptr),
+	size(0),
+	file(INVALID_HANDLE_VALUE),
+	mapping(nullptr)
+{
+	file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+		return;
+
+	data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data != nullptr)
+		size = (size_t)fileSize.QuadPart;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mapping != nullptr)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+
+#else
+
+MappedFile::MappedFile(const wchar_t* path) :
+	data(nullptr),
+	size(0),
+	file(-1)
+{
+	// POSIX paths are narrow
+	std::string narrowPath(std::wcslen(path) * MB_CUR_MAX + 1, '\0');
+	size_t length = std::wcstombs(&narrowPath[0], path, narrowPath.size());
+	if (length == (size_t)-1)
+		return;
+	narrowPath.resize(length);
+
+	file = open(narrowPath.c_str(), O_RDONLY);
+	if (file < 0)
+		return;
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0)
+		return;
+
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (view == MAP_FAILED)
+		return;
+
+	madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+	data = static_cast<const char*>(view);
+	size = (size_t)info.st_size;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data != nullptr)
+		munmap(const_cast<char*>(data), size);
+	if (file >= 0)
+		close(file);
+}
+
+#endif
+
+bool MappedFile::IsOpen()
+{
+	return data != nullptr;
+}
+
+const char* MappedFile::GetData()
+{
+	return data;
+}
+
+size_t MappedFile::GetSize()
+{
+	return size;
+}
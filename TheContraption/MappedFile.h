@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+
+/*
+	Read only view of a whole file mapped into memory. The
+	operating system pages the file in as it is touched so
+	nothing has to be copied into a buffer first
+*/
+class MappedFile
+{
+public:
+	MappedFile(const wchar_t* path);
+	~MappedFile();
+
+	// Owns the mapping so it can't be copied
+	MappedFile(MappedFile const&) = delete;
+	void operator=(MappedFile const&) = delete;
+
+	/// <summary>
+	/// Whether the file was opened and mapped
+	/// </summary>
+	bool IsOpen();
+	/// <summary>
+	/// Start of the file's contents
+	/// </summary>
+	const char* GetData();
+	/// <summary>
+	/// Size of the file in bytes
+	/// </summary>
+	size_t GetSize();
+
+private:
+	const char* data;
+	size_t size;
+
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+};
@@ -6,7 +6,7 @@ Material::Material(
 	float ditherLevel,
 	DirectX::XMFLOAT2 uvOffset, 
 	std::shared_ptr<SimpleVertexShader> vertex, std::shared_ptr<SimplePixelShader> pixel) :
-	tint(tint), roughness(roughness), ditherLevel(ditherLevel), uvOffset(uvOffset), vertex(vertex), pixel(pixel)
+	tint(tint), roughness(roughness), ditherLevel(ditherLevel), uvOffset(uvOffset), metalRoughnessPacked(false), vertex(vertex), pixel(pixel)
 {
 	camPos = DirectX::XMFLOAT3(0, 0, 0);
 }
@@ -26,11 +26,21 @@ float Material::GetDitherLevel()
 	return ditherLevel;
 }
 
+bool Material::GetMetalRoughnessPacked()
+{
+	return metalRoughnessPacked;
+}
+
 std::shared_ptr<SimpleVertexShader> Material::GetVertexShader()
 {
 	return vertex;
 }
 
+std::shared_ptr<SimpleVertexShader> Material::GetQuantizedVertexShader()
+{
+	return quantizedVertex;
+}
+
 std::shared_ptr<SimplePixelShader> Material::GetPixelShader()
 {
 	return pixel;
@@ -58,6 +68,11 @@ void Material::SetDither(float nextDither)
 	ditherLevel = nextDither;
 }
 
+void Material::SetMetalRoughnessPacked(bool packed)
+{
+	metalRoughnessPacked = packed;
+}
+
 void Material::SetUVOffset(DirectX::XMFLOAT2 nextOffset)
 {
 	uvOffset = nextOffset;
@@ -68,6 +83,11 @@ void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> nextVertex)
 	vertex = nextVertex;
 }
 
+void Material::SetQuantizedVertexShader(std::shared_ptr<SimpleVertexShader> nextVertex)
+{
+	quantizedVertex = nextVertex;
+}
+
 void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> nextPixel)
 {
 	pixel = nextPixel;
@@ -30,11 +30,21 @@ public:
 	/// </summary>
 	float GetDitherLevel();
 	/// <summary>
+	/// Whether roughness and metalness share one texture in its green
+	/// and blue channels, like glTF stores them 
+	/// </summary>
+	bool GetMetalRoughnessPacked();
+	/// <summary>
 	/// Get this material's current vertex shader shared pointer 
 	/// </summary>
 	/// <returns></returns>
 	std::shared_ptr<SimpleVertexShader> GetVertexShader();
 	/// <summary>
+	/// Get the vertex shader used for meshes with quantized vertices 
+	/// </summary>
+	/// <returns></returns>
+	std::shared_ptr<SimpleVertexShader> GetQuantizedVertexShader();
+	/// <summary>
 	/// Get this material's current pixel shader shared pointer 
 	/// </summary>
 	/// <returns></returns>
@@ -64,6 +74,12 @@ public:
 	/// <param name="nextDither"></param>
 	void SetDither(float nextDither);
 
+	/// <summary>
+	/// Set whether roughness and metalness share one texture 
+	/// </summary>
+	/// <param name="packed"></param>
+	void SetMetalRoughnessPacked(bool packed);
+
 	/// <summary>
 	/// Set this material's current uv offset 
 	/// </summary>
@@ -77,6 +93,12 @@ public:
 	/// <param name="nextVertex"></param>
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader> nextVertex);
 
+	/// <summary>
+	/// Set the vertex shader used for meshes with quantized vertices 
+	/// </summary>
+	/// <param name="nextVertex"></param>
+	void SetQuantizedVertexShader(std::shared_ptr<SimpleVertexShader> nextVertex);
+
 	/// <summary>
 	/// Set this materials current pixel shader 
 	/// </summary>
@@ -94,8 +116,10 @@ private:
 	float roughness;
 	DirectX::XMFLOAT2 uvOffset;
 	float ditherLevel;
+	bool metalRoughnessPacked;
 
 	std::shared_ptr<SimpleVertexShader> vertex;
+	std::shared_ptr<SimpleVertexShader> quantizedVertex;
 	std::shared_ptr<SimplePixelShader> pixel;
 
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
@@ -1,386 +1,330 @@
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "TangentGenerator.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
 using namespace DirectX;
 
+// Handed out to every upload of any mesh, geometry only
+// changes on the thread that owns the device context
+static unsigned int nextGeometryVersion = 1;
+
 Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, Vertex vertices[], unsigned int indices[], int vertexCount, int indexCount)
-	:device(device), deviceContext(deviceContext), indicesCount(indexCount), vertexCount(vertexCount)
+	:device(device), deviceContext(deviceContext), indicesCount(indexCount), vertexCount(vertexCount),
+	vertexStride(sizeof(Vertex)), indexFormat(DXGI_FORMAT_R32_UINT), quantized(false), positionOffset(0, 0, 0), positionScale(1, 1, 1), quantizationError(), cullStats(),
+	boundsCenter(0, 0, 0), boundsRadius(0), geometry({ 0, RANGE_INVALID, RANGE_INVALID }), geometryVersion(0), streamed(false)
 {
-	CalculateTangents(&vertices[0], vertexCount, &indices[0], indexCount);
-	ContructVIBuffers(device, deviceContext, vertices, indices);
+	TangentGenerator::Generate(&vertices[0], vertexCount, &indices[0], indexCount);
+	lods.push_back({ 0, (unsigned int)indexCount, 0.0f });
+	CalculateBounds(vertices);
+	ContructVIBuffers(vertices, indices);
 }
 
-Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const wchar_t* objFile):
-	device(device), deviceContext(deviceContext)
+Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const wchar_t* objFile, bool quantize, size_t streamBudget):
+	device(device), deviceContext(deviceContext), indicesCount(0), vertexCount(0),
+	vertexStride(sizeof(Vertex)), indexFormat(DXGI_FORMAT_R32_UINT), quantized(quantize), positionOffset(0, 0, 0), positionScale(1, 1, 1), quantizationError(), cullStats(),
+	boundsCenter(0, 0, 0), boundsRadius(0), geometry({ 0, RANGE_INVALID, RANGE_INVALID }), geometryVersion(0), streamed(false)
 {
-	// Author: Chris Cascioli
-// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-//
-// - NOTE: You'll need to #include <fstream>
+	// Files this big are streamed into the cache a piece at a time and
+	// uploaded from there, so the whole obj is never held in memory
+	streamed = MappedFile(objFile).GetSize() > MESH_STREAM_IMPORT_SIZE;
+
+	// Upload straight out of the cache if the obj hasn't changed since it was written
+	unsigned long long sourceHash = MeshCache::HashFile(objFile);
+	std::wstring cacheFile = MeshCache::GetCachePath(objFile);
+	if (LoadCache(cacheFile.c_str(), sourceHash))
+		return;
+
+	if (streamed)
+	{
+		if (StreamToCache(objFile, cacheFile.c_str(), sourceHash, streamBudget))
+			LoadCache(cacheFile.c_str(), sourceHash);
+		return;
+	}
+
+	// Parse the file in parallel straight out of a memory mapping
+	MeshData data;
+	if (!ObjImporter::Load(objFile, data))
+		return;
 
+	Import(data);
 
-// File input object
-	std::ifstream obj(objFile);
+	// A failed write only means the next launch imports again
+	MeshCache::Write(cacheFile.c_str(), sourceHash, data);
+}
 
-	// Check for successful open
-	if (!obj.is_open())
+Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, MeshData& data, bool quantize, bool process) :
+	device(device), deviceContext(deviceContext), indicesCount(0), vertexCount(0),
+	vertexStride(sizeof(Vertex)), indexFormat(DXGI_FORMAT_R32_UINT), quantized(quantize), positionOffset(0, 0, 0), positionScale(1, 1, 1), quantizationError(), cullStats(),
+	boundsCenter(0, 0, 0), boundsRadius(0), geometry({ 0, RANGE_INVALID, RANGE_INVALID }), geometryVersion(0), streamed(false)
+{
+	if (data.vertices.empty() || data.indices.empty())
 		return;
 
-	// Variables used while reading the file
-	std::vector<DirectX::XMFLOAT3> positions;	// Positions from the file
-	std::vector<DirectX::XMFLOAT3> normals;		// Normals from the file
-	std::vector<DirectX::XMFLOAT2> uvs;		// UVs from the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-	char chars[100];			// String for line reading
-
-	// Still have data left?
-	while (obj.good())
+	if (process)
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
-
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			DirectX::XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(DirectX::XMFLOAT2(0, 0));
-			}
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-			}
-		}
+		Import(data);
+		return;
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
+	// Ready to draw as it is, whatever meshlets and LODs it has are kept
+	vertexCount = (int)data.vertices.size();
+	indicesCount = (int)data.indices.size();
+	meshlets = data.meshlets;
+	lods = data.lods;
+	if (lods.empty())
+		lods.push_back({ 0, (unsigned int)indicesCount, 0.0f });
+
+	UploadVertices(&data.vertices[0], &data.indices[0]);
+}
+
+Mesh::~Mesh()
+{
+	GeometryArena::GetInstance().Free(geometry);
+}
+
+void Mesh::Import(MeshData& data)
+{
+	// Mirrored uv seams can add a few vertices
+	TangentGenerator::Generate(data);
+	vertexCount = (int)data.vertices.size();
+
+	// Reorders the triangles, so it has to happen before anything is uploaded
+	Meshlets::Build(data);
+	meshlets = data.meshlets;
 
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is the number of vertices
-	// - "indexCounter" is the number of indices
-	// - Yes, these are effectively the same since OBJs do not index entire vertices!  This means
-	//    an index buffer isn't doing much for us.  We could try to optimize the mesh ourselves
-	//    and detect duplicate vertices, but at that point it would be better to use a more
-	//    sophisticated model loading library like TinyOBJLoader or The Open Asset Importer Library
+	// Simpler levels are appended after the full mesh in the same index buffer
+	MeshSimplifier::GenerateLods(data);
+	lods = data.lods;
+	indicesCount = (int)data.indices.size();
 
-	indicesCount = indexCounter;
-	vertexCount = vertCounter;
+	UploadVertices(&data.vertices[0], &data.indices[0]);
+}
 
-	CalculateTangents(&verts[0], vertexCount, &indices[0], indicesCount);
-	ContructVIBuffers(device, deviceContext, &(verts[0]), &(indices[0]));
+bool Mesh::LoadCache(const wchar_t* cacheFile, unsigned long long sourceHash)
+{
+	MappedFile cache(cacheFile);
+	const MeshCacheHeader* header = MeshCache::Open(cache, sourceHash);
+	if (header == nullptr)
+		return false;
+
+	indicesCount = (int)header->indexCount;
+	vertexCount = (int)header->vertexCount;
+	// Culling meshlets needs a copy of every index on the CPU, which
+	// is the size of the obj again for streamed meshes, so they draw whole
+	if (!streamed)
+		meshlets.assign(MeshCache::GetMeshlets(header), MeshCache::GetMeshlets(header) + header->meshletCount);
+	lods.assign(MeshCache::GetLods(header), MeshCache::GetLods(header) + header->lodCount);
+	if (lods.empty())
+		lods.push_back({ 0, header->indexCount, 0.0f });
+	UploadVertices(MeshCache::GetVertices(header), MeshCache::GetIndices(header));
+	return true;
 }
 
-Mesh::~Mesh()
+bool Mesh::StreamToCache(const wchar_t* objFile, const wchar_t* cacheFile, unsigned long long sourceHash, size_t streamBudget)
 {
+	// Pieces go through the same passes as a whole import, apart
+	// from LODs which need the whole mesh at once
+	MeshCacheWriter writer(cacheFile, sourceHash);
+	bool streamed = ObjImporter::LoadStreaming(objFile, streamBudget, [&](MeshData& piece)
+	{
+		TangentGenerator::Generate(piece);
+		Meshlets::Build(piece);
+		return writer.Append(piece);
+	});
+	return streamed && writer.Finish();
+}
+
+void Mesh::UploadVertices(const Vertex vertices[], const unsigned int indices[])
+{
+	CalculateBounds(vertices);
+
+	if (!quantized)
+	{
+		ContructVIBuffers(vertices, indices);
+		return;
+	}
 
+	// Pack the vertices on the way to the GPU, the full ones stay in the cache
+	QuantizedMeshData data;
+	VertexQuantizer::Quantize(vertices, vertexCount, data);
+	quantizationError = VertexQuantizer::MeasureError(vertices, data);
+	positionOffset = data.positionOffset;
+	positionScale = data.positionScale;
+
+	vertexStride = sizeof(QuantizedVertex);
+	ContructVIBuffers(&data.vertices[0], indices);
 }
 
-void Mesh::ContructVIBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, Vertex vertices[], unsigned int indices[])
+void Mesh::CalculateBounds(const Vertex vertices[])
 {
-	// Create a VERTEX BUFFER
-		// - This holds the vertex data of triangles for a single object
-		// - This buffer is created on the GPU, which is where the data needs to
-		//    be if we want the GPU to act on it (as in: draw it to the screen)
+	if (vertexCount == 0)
+		return;
+
+	// Sphere around the center of the bounding box
+	XMVECTOR minBounds = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxBounds = XMVectorReplicate(-FLT_MAX);
+	for (int i = 0; i < vertexCount; i++)
 	{
-		// First, we need to describe the buffer we want Direct3D to make on the GPU
-		//  - Note that this variable is created on the stack since we only need it once
-		//  - After the buffer is created, this description variable is unnecessary
-		D3D11_BUFFER_DESC vbd = {};
-		vbd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		vbd.ByteWidth = sizeof(Vertex) * vertexCount;       // 3 = number of vertices in the buffer
-		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
-		vbd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		vbd.MiscFlags = 0;
-		vbd.StructureByteStride = 0;
-
-		// Create the proper struct to hold the initial vertex data
-		// - This is how we initially fill the buffer with data
-		// - Essentially, we're specifying a pointer to the data to copy
-		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
-
-		// Actually create the buffer on the GPU with the initial data
-		// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
-		device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
+		XMVECTOR p = XMLoadFloat3(&vertices[i].Position);
+		minBounds = XMVectorMin(minBounds, p);
+		maxBounds = XMVectorMax(maxBounds, p);
 	}
 
-	// Create an INDEX BUFFER
-	// - This holds indices to elements in the vertex buffer
-	// - This is most useful when vertices are shared among neighboring triangles
-	// - This buffer is created on the GPU, which is where the data needs to
-	//    be if we want the GPU to act on it (as in: draw it to the screen)
+	XMVECTOR center = (minBounds + maxBounds) * 0.5f;
+	XMVECTOR radiusSq = XMVectorZero();
+	for (int i = 0; i < vertexCount; i++)
 	{
-		// Describe the buffer, as we did above, with two major differences
-		//  - Byte Width (3 unsigned integers vs. 3 whole vertices)
-		//  - Bind Flag (used as an index buffer instead of a vertex buffer) 
-		D3D11_BUFFER_DESC ibd = {};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth = sizeof(unsigned int) * indicesCount;
-		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
-		ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
-		ibd.MiscFlags = 0;
-		ibd.StructureByteStride = 0;
-
-		// Specify the initial data for this buffer, similar to above
-		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
-
-		// Actually create the buffer with the initial data
-		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-		device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+		radiusSq = XMVectorMax(radiusSq, XMVector3LengthSq(XMLoadFloat3(&vertices[i].Position) - center));
 	}
+	XMStoreFloat3(&boundsCenter, center);
+	boundsRadius = std::sqrt(XMVectorGetX(radiusSq));
 }
 
-// --------------------------------------------------------
-// Calculates the tangents of the vertices in a mesh
-// - Code originally adapted from: http://www.terathon.com/code/tangent.html
-// - Updated version found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
-// - See listing 7.4 in section 7.5 (page 9 of the PDF)
-//
-// - Note: For this code to work, your Vertex format must
-// contain an XMFLOAT3 called Tangent
-//
-// - Be sure to call this BEFORE creating your D3D vertex/index buffers
-// --------------------------------------------------------
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
-{
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
+void Mesh::ContructVIBuffers(const void* vertices, const unsigned int indices[])
+{
+	// Indices of small meshes fit in 16 bits, which halves the buffer.
+	// They are relative to the mesh's base vertex in the arena, so
+	// this still holds once the mesh shares a buffer with others
+	std::vector<unsigned short> shortIndices;
+	const void* indexData = indices;
+	unsigned int indexSize = sizeof(unsigned int);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	if (vertexCount < MESH_SHORT_INDEX_LIMIT)
+	{
+		shortIndices.assign(indices, indices + indicesCount);
+		indexData = &shortIndices[0];
+		indexSize = sizeof(unsigned short);
+		indexFormat = DXGI_FORMAT_R16_UINT;
+	}
+
+	// Every mesh with the same layout lives in the same pair of buffers
+	GeometryArena::GetInstance().Allocate(vertexStride, indexFormat, vertices, vertexCount, indexData, indicesCount, geometry);
+	geometryVersion = nextGeometryVersion++;
+
+	// Meshlets that survive culling are copied into the arena's index
+	// ring every draw, they only ever come out of LOD 0 at the start
+	if (!meshlets.empty())
 	{
-		verts[i].Tangent = DirectX::XMFLOAT3(0, 0, 0);
+		const unsigned char* indexBytes = static_cast<const unsigned char*>(indexData);
+		cpuIndices.assign(indexBytes, indexBytes + indexSize * lods[0].indexCount);
 	}
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
+}
+
+bool Mesh::UpdateVertices(const Vertex vertices[])
+{
+	if (quantized || vertexCount == 0)
+		return false;
+
+	// Culling data and ray queries were built for the old shape
+	meshlets.clear();
+	cpuIndices.clear();
+	bvh.reset();
+
+	CalculateBounds(vertices);
+	geometryVersion = nextGeometryVersion++;
+	return GeometryArena::GetInstance().WriteVertices(geometry, vertices, vertexCount);
+}
+
+bool Mesh::UpdateVertexRange(const Vertex vertices[], unsigned int first, unsigned int count)
+{
+	if (quantized || count == 0 || (unsigned long long)first + count > (unsigned long long)vertexCount)
+		return false;
+
+	meshlets.clear();
+	cpuIndices.clear();
+	bvh.reset();
+
+	// Growing the sphere around its old center is enough to keep culling
+	// right, refitting it would need every vertex
+	XMVECTOR center = XMLoadFloat3(&boundsCenter);
+	XMVECTOR radiusSq = XMVectorReplicate(boundsRadius * boundsRadius);
+	for (unsigned int i = first; i < first + count; i++)
 	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
+		radiusSq = XMVectorMax(radiusSq, XMVector3LengthSq(XMLoadFloat3(&vertices[i].Position) - center));
 	}
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
+	boundsRadius = std::sqrt(XMVectorGetX(radiusSq));
+
+	geometryVersion = nextGeometryVersion++;
+	return GeometryArena::GetInstance().WriteVertices(geometry, &vertices[first], count, first);
+}
+
+unsigned int Mesh::GetGeometryVersion()
+{
+	return geometryVersion;
+}
+
+bool Mesh::ReadGeometry(MeshData& out)
+{
+	out = MeshData();
+	if (lods.empty())
+		return false;
+
+	std::vector<unsigned char> vertexBytes;
+	std::vector<unsigned char> indexBytes;
+	if (!GeometryArena::GetInstance().Read(geometry, vertexBytes, indexBytes))
+		return false;
+
+	out.vertices.resize(vertexCount);
+	if (quantized)
+		VertexQuantizer::Decode(reinterpret_cast<const QuantizedVertex*>(&vertexBytes[0]), vertexCount, positionOffset, positionScale, &out.vertices[0]);
+	else
+		memcpy(&out.vertices[0], &vertexBytes[0], vertexCount * sizeof(Vertex));
+
+	// Only LOD 0, widened back to 32 bits
+	out.indices.resize(lods[0].indexCount);
+	for (unsigned int i = 0; i < lods[0].indexCount; i++)
 	{
-		// Grab the two vectors
-		DirectX::XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		DirectX::XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = DirectX::XMVector3Normalize(
-			tangent - normal * DirectX::XMVector3Dot(normal, tangent)); // Value is repeated for each componenent apparently 
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
+		unsigned int index = lods[0].indexOffset + i;
+		if (indexFormat == DXGI_FORMAT_R16_UINT)
+		{
+			unsigned short shortIndex;
+			memcpy(&shortIndex, &indexBytes[index * sizeof(unsigned short)], sizeof(unsigned short));
+			out.indices[i] = shortIndex;
+		}
+		else
+		{
+			memcpy(&out.indices[i], &indexBytes[index * sizeof(unsigned int)], sizeof(unsigned int));
+		}
 	}
+	return true;
+}
+
+bool Mesh::BuildBvh()
+{
+	if (bvh)
+		return true;
+
+	MeshData data;
+	if (!ReadGeometry(data))
+		return false;
+
+	bvh.reset(new MeshBvh());
+	bvh->Build(data.vertices.data(), (unsigned int)data.vertices.size(), data.indices.data(), (unsigned int)data.indices.size());
+	return true;
 }
 
+const MeshBvh* Mesh::GetBvh()
+{
+	return bvh.get();
+}
 
 /// <summary>
-/// Get this mesh's vertex buffer 
+/// Get the arena buffer this mesh's vertices are in
 /// </summary>
 /// <returns></returns>
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
 {
-	return vertexBuffer;
+	return GeometryArena::GetInstance().GetVertexBuffer(geometry);
 }
 /// <summary>
-/// Get this mesh's index buffer 
+/// Get the arena buffer this mesh's indices are in
 /// </summary>
 /// <returns></returns>
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
 {
-	return indexBuffer;
+	return GeometryArena::GetInstance().GetIndexBuffer(geometry);
 }
 
 /// <summary>
@@ -392,21 +336,72 @@ int Mesh::GetIndexCount()
 	return indicesCount;
 }
 
+int Mesh::GetVertexCount()
+{
+	return vertexCount;
+}
+
+bool Mesh::IsQuantized()
+{
+	return quantized;
+}
+
+DirectX::XMFLOAT3 Mesh::GetPositionOffset()
+{
+	return positionOffset;
+}
+
+DirectX::XMFLOAT3 Mesh::GetPositionScale()
+{
+	return positionScale;
+}
+
+QuantizationError Mesh::GetQuantizationError()
+{
+	return quantizationError;
+}
+
+unsigned int Mesh::GetMeshletCount()
+{
+	return (unsigned int)meshlets.size();
+}
+
+MeshletCullStats Mesh::GetCullStats()
+{
+	return cullStats;
+}
+
+unsigned int Mesh::GetLodCount()
+{
+	return (unsigned int)lods.size();
+}
+
+float Mesh::GetLodError(unsigned int lod)
+{
+	return lod < lods.size() ? lods[lod].error : 0.0f;
+}
+
+DirectX::XMFLOAT3 Mesh::GetBoundsCenter()
+{
+	return boundsCenter;
+}
+
+float Mesh::GetBoundsRadius()
+{
+	return boundsRadius;
+}
+
 void Mesh::Draw()
 {
 	// DRAW geometry
 	// - These steps are generally repeated for EACH object you draw
 	// - Other Direct3D calls will also be necessary to do more complex things
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
+	GeometryArena& arena = GeometryArena::GetInstance();
 	{
 		// Set buffers in the input assembler (IA) stage
-		//  - Do this ONCE PER OBJECT, since each object may have different geometry
-		//  - For this demo, this step *could* simply be done once during Init()
-		//  - However, this needs to be done between EACH DrawIndexed() call
-		//     when drawing different geometry, so it's here as an example
-		deviceContext->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-		deviceContext->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+		//  - Meshes with the same layout share the arena's buffers, so
+		//     they are only bound when the last draw used another pool
+		arena.Bind(geometry);
 
 		// Tell Direct3D to draw
 		//  - Begins the rendering pipeline on the GPU
@@ -415,11 +410,69 @@ void Mesh::Draw()
 		//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 		//     vertices in the currently set VERTEX BUFFER
 		deviceContext->DrawIndexed(
-			indicesCount,     // The number of indices to use (we could draw a subset if we wanted)
-			0,     // Offset to the first index we want to use
-			0);    // Offset to add to each index when looking up vertices
+			lods.empty() ? 0 : lods[0].indexCount,     // The full mesh, simpler LODs come after it
+			arena.GetStartIndex(geometry),     // Offset to the first index we want to use
+			arena.GetBaseVertex(geometry));    // Offset to add to each index when looking up vertices
 	}
 
 }
 
+void Mesh::Draw(const XMFLOAT4X4& world, const XMFLOAT4X4& view, const XMFLOAT4X4& projection, unsigned int lod)
+{
+	// Simplified levels are already cheap and draw straight from their range
+	GeometryArena& arena = GeometryArena::GetInstance();
+	if (lod > 0 && lod < lods.size())
+	{
+		cullStats = MeshletCullStats();
+		arena.Bind(geometry);
+		deviceContext->DrawIndexed(lods[lod].indexCount, arena.GetStartIndex(geometry) + lods[lod].indexOffset, arena.GetBaseVertex(geometry));
+		return;
+	}
+
+	if (meshlets.empty() || cpuIndices.empty())
+	{
+		cullStats = MeshletCullStats();
+		Draw();
+		return;
+	}
+
+	// Meshlets are culled in mesh space, where the camera is the
+	// origin of view space taken back through the world view matrix
+	XMMATRIX worldView = XMLoadFloat4x4(&world) * XMLoadFloat4x4(&view);
+	XMFLOAT4X4 worldViewProjection;
+	XMStoreFloat4x4(&worldViewProjection, worldView * XMLoadFloat4x4(&projection));
+	XMFLOAT3 camera;
+	XMStoreFloat3(&camera, XMMatrixInverse(nullptr, worldView).r[3]);
+
+	cullStats = Meshlets::Cull(&meshlets[0], (unsigned int)meshlets.size(), worldViewProjection, camera, visibleMeshlets);
+	if (cullStats.trianglesVisible == 0)
+		return;
+
+	unsigned int startIndex = 0;
+	void* mapped = arena.MapStream(geometry, cullStats.trianglesVisible * 3, startIndex);
+	if (mapped == nullptr)
+	{
+		Draw();
+		return;
+	}
+
+	// Neighbouring meshlets are usually visible together, so
+	// their index ranges are merged into a single copy
+	unsigned int indexSize = indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(unsigned int);
+	unsigned char* culledIndices = static_cast<unsigned char*>(mapped);
+	unsigned int culledCount = 0;
+	for (unsigned int i = 0; i < visibleMeshlets.size();)
+	{
+		unsigned int start = meshlets[visibleMeshlets[i]].indexOffset;
+		unsigned int count = 0;
+		for (; i < visibleMeshlets.size() && meshlets[visibleMeshlets[i]].indexOffset == start + count; i++)
+		{
+			count += meshlets[visibleMeshlets[i]].triangleCount * 3;
+		}
 
+		memcpy(culledIndices + culledCount * indexSize, &cpuIndices[start * indexSize], count * indexSize);
+		culledCount += count;
+	}
+	arena.UnmapStream(geometry);
+	deviceContext->DrawIndexed(culledCount, startIndex, arena.GetBaseVertex(geometry));
+}
@@ -4,27 +4,73 @@
 #include <d3d11.h>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include "Vertex.h"
+#include "MeshData.h"
+#include "VertexQuantizer.h"
+#include "Meshlets.h"
+#include "MeshSimplifier.h"
+#include "GeometryArena.h"
+#include "MeshBvh.h"
+#include "ObjImporter.h"
 
-#include <fstream>
 #include <vector>
+#include <memory>
 #include <DirectXMath.h>
 
+// Meshes with fewer vertices than this get 16 bit indices
+#define MESH_SHORT_INDEX_LIMIT 65536
+
+// Obj files bigger than this are streamed instead of imported whole,
+// and drawn without meshlet culling
+#define MESH_STREAM_IMPORT_SIZE (512ull * 1024 * 1024)
+
+// Largest error a LOD may show on screen, as a fraction of half the
+// screen height (about one pixel at 1080p)
+#define MESH_LOD_SCREEN_ERROR 0.002f
+
 class Mesh
 {
 private:
-	void ContructVIBuffers(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, Vertex vertices[], unsigned int indices[]);
-
-	// Buffers that connect data to the GPU 
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	void ContructVIBuffers(const void* vertices, const unsigned int indices[]);
+	void Import(MeshData& data);
+	bool LoadCache(const wchar_t* cacheFile, unsigned long long sourceHash);
+	bool StreamToCache(const wchar_t* objFile, const wchar_t* cacheFile, unsigned long long sourceHash, size_t streamBudget);
+	void UploadVertices(const Vertex vertices[], const unsigned int indices[]);
+	void CalculateBounds(const Vertex vertices[]);
 
 	Microsoft::WRL::ComPtr<ID3D11Device> device; 
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
 
 	int indicesCount;
 	int vertexCount;
+	unsigned int vertexStride;
+	DXGI_FORMAT indexFormat;
+
+	// Only used when the vertices are quantized
+	bool quantized;
+	DirectX::XMFLOAT3 positionOffset;
+	DirectX::XMFLOAT3 positionScale;
+	QuantizationError quantizationError;
+
+	// Only used when the mesh was split into meshlets
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned char> cpuIndices;	// Copy of LOD 0's indices in the same format
+	std::vector<unsigned int> visibleMeshlets;
+	MeshletCullStats cullStats;
 
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	// LOD 0 is always there and covers the whole mesh unless it was simplified
+	std::vector<MeshLod> lods;
+	DirectX::XMFLOAT3 boundsCenter;
+	float boundsRadius;
+
+	// Range of the shared geometry buffers the mesh was uploaded to
+	GeometryAllocation geometry;
+	// Changes every time the geometry is uploaded, never the same for two meshes
+	unsigned int geometryVersion;
+	// Too big to import whole, so its meshlets are left in the cache with its indices
+	bool streamed;
+
+	// Only built once something asks for ray queries
+	std::unique_ptr<MeshBvh> bvh;
 
 public:
 	/// <summary>
@@ -34,13 +80,114 @@ public:
 	/// <summary>
 	/// Create a mesh based on a given obj file 
 	/// </summary>
-	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const wchar_t* file);
+	/// <param name="quantize">Store the vertices as QuantizedVertex, which needs the quantized vertex shaders</param>
+	/// <param name="streamBudget">Roughly the most memory importing may use when the file is too big to import whole</param>
+	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, const wchar_t* file, bool quantize = false,
+		size_t streamBudget = OBJ_STREAM_DEFAULT_BUDGET);
+	/// <summary>
+	/// Create a mesh from geometry an importer has already loaded. It goes
+	/// through the same tangent, meshlet and LOD passes as an obj file and
+	/// is left changed by them
+	/// </summary>
+	/// <param name="quantize">Store the vertices as QuantizedVertex, which needs the quantized vertex shaders</param>
+	/// <param name="process">False uploads the data as it is, keeping its meshlets and LODs</param>
+	Mesh(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext, MeshData& data, bool quantize = false, bool process = true);
 	~Mesh();
 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 	int GetIndexCount();
+	int GetVertexCount();
+
+	/// <summary>
+	/// Read LOD 0 back from the GPU. Quantized vertices are decoded, so
+	/// they come back with the precision they lost. Slow, meant for
+	/// build steps like static batching
+	/// </summary>
+	/// <returns>False if the buffers could not be read</returns>
+	bool ReadGeometry(MeshData& out);
+
+	/// <summary>
+	/// Replace every vertex, for meshes that deform on the CPU like skinned
+	/// ones. The bounds follow the new vertices, meshlets and the BVH are
+	/// dropped since they no longer match. Not for quantized meshes
+	/// </summary>
+	/// <param name="vertices">GetVertexCount() vertices</param>
+	/// <returns>False if the mesh is quantized or the upload failed</returns>
+	bool UpdateVertices(const Vertex vertices[]);
+	/// <summary>
+	/// Replace a range of vertices, for deformations that only touch part
+	/// of a mesh. The bounds only grow to fit the range, meshlets and the
+	/// BVH are dropped like with UpdateVertices. Not for quantized meshes
+	/// </summary>
+	/// <param name="vertices">GetVertexCount() vertices, only the range is uploaded</param>
+	/// <returns>False if the mesh is quantized, the range is outside it or the upload failed</returns>
+	bool UpdateVertexRange(const Vertex vertices[], unsigned int first, unsigned int count);
+	/// <summary>
+	/// Counter that changes every time the mesh's geometry is uploaded,
+	/// including by UpdateVertices and UpdateVertexRange. No two meshes
+	/// share one, so it also tells a different mesh apart from this one
+	/// </summary>
+	unsigned int GetGeometryVersion();
+
+	/// <summary>
+	/// Build the triangle BVH of LOD 0 for ray queries, if it isn't
+	/// already. Reads the geometry back from the GPU the first time
+	/// </summary>
+	/// <returns>False if the geometry could not be read</returns>
+	bool BuildBvh();
+	/// <summary>
+	/// The mesh's BVH, nullptr until BuildBvh has been called
+	/// </summary>
+	const MeshBvh* GetBvh();
+
+	/// <summary>
+	/// Whether the vertex buffer holds QuantizedVertex instead of Vertex
+	/// </summary>
+	bool IsQuantized();
+	/// <summary>
+	/// Bounds min that the quantized positions are relative to
+	/// </summary>
+	DirectX::XMFLOAT3 GetPositionOffset();
+	/// <summary>
+	/// Bounds size that the quantized positions are scaled by
+	/// </summary>
+	DirectX::XMFLOAT3 GetPositionScale();
+	/// <summary>
+	/// How much precision quantizing cost this mesh (all zero if it isn't quantized)
+	/// </summary>
+	QuantizationError GetQuantizationError();
+
+	/// <summary>
+	/// How many meshlets the mesh was split into (0 if it can't be culled)
+	/// </summary>
+	unsigned int GetMeshletCount();
+	/// <summary>
+	/// What the last draw kept and threw away, all zero if it
+	/// wasn't culled by meshlets
+	/// </summary>
+	MeshletCullStats GetCullStats();
+
+	/// <summary>
+	/// How many levels of detail the mesh has, including the full one
+	/// </summary>
+	unsigned int GetLodCount();
+	/// <summary>
+	/// Furthest the surface of a LOD may be from the full mesh, in mesh units
+	/// </summary>
+	float GetLodError(unsigned int lod);
+	/// <summary>
+	/// Sphere around every vertex, in mesh space
+	/// </summary>
+	DirectX::XMFLOAT3 GetBoundsCenter();
+	float GetBoundsRadius();
 
 	void Draw();
+	/// <summary>
+	/// Draw one level of detail. LOD 0 culls meshlets that are off screen
+	/// or facing away from the camera and draws the rest, the simplified
+	/// levels are drawn whole
+	/// </summary>
+	void Draw(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection, unsigned int lod = 0);
 };
 
@@ -0,0 +1,519 @@
+#include "MeshBvh.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Slab tests round a little, the far side is pushed out by a few
+// ulps so rays grazing a box are never lost (Ize, Robust BVH Ray Traversal)
+#define BVH_ROBUST_FAR 1.0000004f
+
+// Direction components smaller than this are clamped so the slab test never divides by zero
+#define BVH_MIN_DIRECTION 1e-20f
+
+static float Component(const XMFLOAT3& v, int axis)
+{
+	return (&v.x)[axis];
+}
+
+static unsigned char& Lane(XMUBYTE4& v, unsigned int lane)
+{
+	return (&v.x)[lane];
+}
+
+// One quantized step across a box, a hair over 1/255 of it so 255 always reaches the far side
+static XMVECTOR QuantizationScale(const XMFLOAT3& min, const XMFLOAT3& max)
+{
+	return (XMLoadFloat3(&max) - XMLoadFloat3(&min)) * (1.0f / 255.0f * 1.000001f);
+}
+
+// Building and traversal both go through this so they agree to the last bit
+static XMVECTOR Dequantize(FXMVECTOR quantized, FXMVECTOR scale, FXMVECTOR origin)
+{
+	return XMVectorMultiplyAdd(quantized, scale, origin);
+}
+
+static float Dequantize(int quantized, float scale, float origin)
+{
+	return XMVectorGetX(Dequantize(XMVectorReplicate((float)quantized), XMVectorReplicate(scale), XMVectorReplicate(origin)));
+}
+
+// Smallest run of steps across the parent's box that still covers min to max
+static void QuantizeAxis(float min, float max, float origin, float scale, unsigned char& quantizedMin, unsigned char& quantizedMax, float& dequantizedMin, float& dequantizedMax)
+{
+	int low = 0;
+	int high = 0;
+	if (scale > 0.0f)
+	{
+		low = std::max(0, std::min(255, (int)std::floor((min - origin) / scale)));
+		high = std::max(0, std::min(255, (int)std::ceil((max - origin) / scale)));
+	}
+
+	while (low > 0 && Dequantize(low, scale, origin) > min)
+		low--;
+	while (high < 255 && Dequantize(high, scale, origin) < max)
+		high++;
+
+	quantizedMin = (unsigned char)low;
+	quantizedMax = (unsigned char)high;
+	dequantizedMin = Dequantize(low, scale, origin);
+	dequantizedMax = Dequantize(high, scale, origin);
+}
+
+MeshBvh::MeshBvh() :
+	bounds(),
+	triangleCount(0),
+	buildVertices(nullptr),
+	buildIndices(nullptr)
+{
+}
+
+#pragma region BUILDING
+
+void MeshBvh::Build(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+{
+	nodes.clear();
+	packets.clear();
+	bounds = Bounds();
+	triangleCount = indexCount / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	buildVertices = vertices;
+	buildIndices = indices;
+	buildTriangles.resize(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3 + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+
+		BuildTriangle& triangle = buildTriangles[t];
+		XMStoreFloat3(&triangle.min, XMVectorMin(p0, XMVectorMin(p1, p2)));
+		XMStoreFloat3(&triangle.max, XMVectorMax(p0, XMVectorMax(p1, p2)));
+		XMStoreFloat3(&triangle.centroid, (p0 + p1 + p2) * (1.0f / 3.0f));
+		triangle.index = t;
+	}
+
+	bounds = GetBounds(0, triangleCount);
+	nodes.emplace_back();
+	BuildNode(0, 0, triangleCount, bounds, 0);
+
+	std::vector<BuildTriangle>().swap(buildTriangles);
+	buildVertices = nullptr;
+	buildIndices = nullptr;
+}
+
+void MeshBvh::BuildNode(unsigned int node, unsigned int begin, unsigned int end, const Bounds& box, unsigned int depth)
+{
+	if (end - begin <= BVH_WIDTH)
+	{
+		BuildLeaf(node, begin, end);
+		return;
+	}
+
+	// Keep splitting the child with the most surface area until there are four
+	struct Range
+	{
+		unsigned int begin;
+		unsigned int end;
+		float area;
+	};
+	Range ranges[BVH_WIDTH] = { { begin, end, 0.0f } };
+	unsigned int rangeCount = 1;
+	while (rangeCount < BVH_WIDTH)
+	{
+		int widest = -1;
+		for (unsigned int i = 0; i < rangeCount; i++)
+		{
+			if (ranges[i].end - ranges[i].begin > BVH_WIDTH && (widest < 0 || ranges[i].area > ranges[widest].area))
+				widest = (int)i;
+		}
+		if (widest < 0)
+			break;
+
+		Range range = ranges[widest];
+		unsigned int middle = Split(range.begin, range.end, depth);
+		ranges[widest] = { range.begin, middle, SurfaceArea(GetBounds(range.begin, middle)) };
+		ranges[rangeCount++] = { middle, range.end, SurfaceArea(GetBounds(middle, range.end)) };
+	}
+
+	// Children are next to each other so the node only needs the first
+	BvhNode wide = {};
+	wide.first = (unsigned int)nodes.size();
+	wide.count = (unsigned short)rangeCount;
+	nodes.resize(nodes.size() + rangeCount);
+
+	// Child boxes are quantized against the box traversal will have
+	// for this node, and passed on the way traversal will see them
+	XMFLOAT3 scale;
+	XMStoreFloat3(&scale, QuantizationScale(box.min, box.max));
+	Bounds childBoxes[BVH_WIDTH];
+	for (unsigned int i = 0; i < rangeCount; i++)
+	{
+		Bounds exact = GetBounds(ranges[i].begin, ranges[i].end);
+		QuantizeAxis(exact.min.x, exact.max.x, box.min.x, scale.x, Lane(wide.minX, i), Lane(wide.maxX, i), childBoxes[i].min.x, childBoxes[i].max.x);
+		QuantizeAxis(exact.min.y, exact.max.y, box.min.y, scale.y, Lane(wide.minY, i), Lane(wide.maxY, i), childBoxes[i].min.y, childBoxes[i].max.y);
+		QuantizeAxis(exact.min.z, exact.max.z, box.min.z, scale.z, Lane(wide.minZ, i), Lane(wide.maxZ, i), childBoxes[i].min.z, childBoxes[i].max.z);
+	}
+	nodes[node] = wide;
+
+	for (unsigned int i = 0; i < rangeCount; i++)
+	{
+		BuildNode(wide.first + i, ranges[i].begin, ranges[i].end, childBoxes[i], depth + 1);
+	}
+}
+
+void MeshBvh::BuildLeaf(unsigned int node, unsigned int begin, unsigned int end)
+{
+	BvhTrianglePacket packet = {};
+	for (unsigned int i = 0; i < end - begin; i++)
+	{
+		unsigned int triangle = buildTriangles[begin + i].index;
+		XMFLOAT3 p0 = buildVertices[buildIndices[triangle * 3 + 0]].Position;
+		XMFLOAT3 p1 = buildVertices[buildIndices[triangle * 3 + 1]].Position;
+		XMFLOAT3 p2 = buildVertices[buildIndices[triangle * 3 + 2]].Position;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			(&packet.v0[axis].x)[i] = Component(p0, axis);
+			(&packet.edge1[axis].x)[i] = Component(p1, axis) - Component(p0, axis);
+			(&packet.edge2[axis].x)[i] = Component(p2, axis) - Component(p0, axis);
+		}
+		packet.triangles[i] = triangle;
+	}
+
+	BvhNode leaf = {};
+	leaf.first = (unsigned int)packets.size();
+	leaf.count = (unsigned short)(end - begin);
+	leaf.flags = BVH_NODE_LEAF;
+	nodes[node] = leaf;
+	packets.push_back(packet);
+}
+
+unsigned int MeshBvh::Split(unsigned int begin, unsigned int end, unsigned int depth)
+{
+	XMVECTOR centroidMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR centroidMax = XMVectorReplicate(-FLT_MAX);
+	for (unsigned int i = begin; i < end; i++)
+	{
+		XMVECTOR centroid = XMLoadFloat3(&buildTriangles[i].centroid);
+		centroidMin = XMVectorMin(centroidMin, centroid);
+		centroidMax = XMVectorMax(centroidMax, centroid);
+	}
+	XMFLOAT3 minimum;
+	XMFLOAT3 extent;
+	XMStoreFloat3(&minimum, centroidMin);
+	XMStoreFloat3(&extent, centroidMax - centroidMin);
+
+	auto binOf = [&](const BuildTriangle& triangle, int axis)
+	{
+		int bin = (int)((Component(triangle.centroid, axis) - Component(minimum, axis)) * (BVH_SAH_BINS / Component(extent, axis)));
+		return std::min(std::max(bin, 0), BVH_SAH_BINS - 1);
+	};
+
+	// Binned surface area heuristic over all three axes
+	if (depth < BVH_SAH_MAX_DEPTH)
+	{
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		int bestBin = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (Component(extent, axis) <= 0.0f)
+				continue;
+
+			Bounds bins[BVH_SAH_BINS];
+			unsigned int counts[BVH_SAH_BINS] = {};
+			for (int b = 0; b < BVH_SAH_BINS; b++)
+			{
+				bins[b] = { XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX), XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+			}
+			for (unsigned int i = begin; i < end; i++)
+			{
+				int bin = binOf(buildTriangles[i], axis);
+				XMStoreFloat3(&bins[bin].min, XMVectorMin(XMLoadFloat3(&bins[bin].min), XMLoadFloat3(&buildTriangles[i].min)));
+				XMStoreFloat3(&bins[bin].max, XMVectorMax(XMLoadFloat3(&bins[bin].max), XMLoadFloat3(&buildTriangles[i].max)));
+				counts[bin]++;
+			}
+
+			// Sweep from the right first so each split is one step from the left
+			float rightArea[BVH_SAH_BINS];
+			unsigned int rightCount[BVH_SAH_BINS];
+			Bounds right = bins[BVH_SAH_BINS - 1];
+			unsigned int count = 0;
+			for (int b = BVH_SAH_BINS - 1; b > 0; b--)
+			{
+				XMStoreFloat3(&right.min, XMVectorMin(XMLoadFloat3(&right.min), XMLoadFloat3(&bins[b].min)));
+				XMStoreFloat3(&right.max, XMVectorMax(XMLoadFloat3(&right.max), XMLoadFloat3(&bins[b].max)));
+				count += counts[b];
+				rightArea[b] = count == 0 ? 0.0f : SurfaceArea(right);
+				rightCount[b] = count;
+			}
+
+			Bounds left = bins[0];
+			count = 0;
+			for (int b = 0; b < BVH_SAH_BINS - 1; b++)
+			{
+				XMStoreFloat3(&left.min, XMVectorMin(XMLoadFloat3(&left.min), XMLoadFloat3(&bins[b].min)));
+				XMStoreFloat3(&left.max, XMVectorMax(XMLoadFloat3(&left.max), XMLoadFloat3(&bins[b].max)));
+				count += counts[b];
+				if (count == 0 || rightCount[b + 1] == 0)
+					continue;
+
+				float cost = SurfaceArea(left) * count + rightArea[b + 1] * rightCount[b + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		if (bestAxis >= 0)
+		{
+			auto middle = std::partition(buildTriangles.begin() + begin, buildTriangles.begin() + end, [&](const BuildTriangle& triangle)
+			{
+				return binOf(triangle, bestAxis) <= bestBin;
+			});
+			unsigned int split = (unsigned int)(middle - buildTriangles.begin());
+			if (split != begin && split != end)
+				return split;
+		}
+	}
+
+	// Halving along the longest axis always makes progress, even
+	// when every centroid is in the same place
+	int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+	unsigned int middle = begin + (end - begin) / 2;
+	std::nth_element(buildTriangles.begin() + begin, buildTriangles.begin() + middle, buildTriangles.begin() + end, [&](const BuildTriangle& a, const BuildTriangle& b)
+	{
+		return Component(a.centroid, axis) < Component(b.centroid, axis);
+	});
+	return middle;
+}
+
+MeshBvh::Bounds MeshBvh::GetBounds(unsigned int begin, unsigned int end) const
+{
+	XMVECTOR minBounds = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxBounds = XMVectorReplicate(-FLT_MAX);
+	for (unsigned int i = begin; i < end; i++)
+	{
+		minBounds = XMVectorMin(minBounds, XMLoadFloat3(&buildTriangles[i].min));
+		maxBounds = XMVectorMax(maxBounds, XMLoadFloat3(&buildTriangles[i].max));
+	}
+
+	Bounds result;
+	XMStoreFloat3(&result.min, minBounds);
+	XMStoreFloat3(&result.max, maxBounds);
+	return result;
+}
+
+float MeshBvh::SurfaceArea(const Bounds& bounds)
+{
+	float x = bounds.max.x - bounds.min.x;
+	float y = bounds.max.y - bounds.min.y;
+	float z = bounds.max.z - bounds.min.z;
+	return x * y + y * z + z * x;
+}
+
+#pragma endregion
+
+#pragma region QUERIES
+
+bool MeshBvh::Raycast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, MeshHit& hit) const
+{
+	return Traverse(origin, direction, maxDistance, false, hit);
+}
+
+bool MeshBvh::Occluded(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance) const
+{
+	MeshHit hit;
+	return Traverse(origin, direction, maxDistance, true, hit);
+}
+
+bool MeshBvh::Traverse(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, bool anyHit, MeshHit& hit) const
+{
+	if (nodes.empty())
+		return false;
+
+	// Every value is splatted across the lanes, one lane per child or triangle
+	XMVECTOR originX = XMVectorReplicate(origin.x);
+	XMVECTOR originY = XMVectorReplicate(origin.y);
+	XMVECTOR originZ = XMVectorReplicate(origin.z);
+	XMVECTOR directionX = XMVectorReplicate(direction.x);
+	XMVECTOR directionY = XMVectorReplicate(direction.y);
+	XMVECTOR directionZ = XMVectorReplicate(direction.z);
+
+	auto safeInverse = [](float d)
+	{
+		return 1.0f / (std::fabs(d) < BVH_MIN_DIRECTION ? (d < 0.0f ? -BVH_MIN_DIRECTION : BVH_MIN_DIRECTION) : d);
+	};
+	XMVECTOR inverseX = XMVectorReplicate(safeInverse(direction.x));
+	XMVECTOR inverseY = XMVectorReplicate(safeInverse(direction.y));
+	XMVECTOR inverseZ = XMVectorReplicate(safeInverse(direction.z));
+
+	// Nodes carry the box they were reached with, since their
+	// own children are quantized inside of it
+	struct Entry
+	{
+		unsigned int node;
+		float distance;
+		Bounds box;
+	};
+	Entry stack[BVH_STACK_SIZE];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = { 0, 0.0f, bounds };
+
+	float closest = maxDistance;
+	bool found = false;
+	while (stackSize > 0)
+	{
+		Entry entry = stack[--stackSize];
+		if (entry.distance > closest)
+			continue;
+
+		const BvhNode& node = nodes[entry.node];
+		if (node.flags & BVH_NODE_LEAF)
+		{
+			// Moller-Trumbore on every triangle of the packet at once
+			const BvhTrianglePacket& packet = packets[node.first];
+			XMVECTOR edge1X = XMLoadFloat4(&packet.edge1[0]);
+			XMVECTOR edge1Y = XMLoadFloat4(&packet.edge1[1]);
+			XMVECTOR edge1Z = XMLoadFloat4(&packet.edge1[2]);
+			XMVECTOR edge2X = XMLoadFloat4(&packet.edge2[0]);
+			XMVECTOR edge2Y = XMLoadFloat4(&packet.edge2[1]);
+			XMVECTOR edge2Z = XMLoadFloat4(&packet.edge2[2]);
+
+			XMVECTOR pX = directionY * edge2Z - directionZ * edge2Y;
+			XMVECTOR pY = directionZ * edge2X - directionX * edge2Z;
+			XMVECTOR pZ = directionX * edge2Y - directionY * edge2X;
+			XMVECTOR determinant = edge1X * pX + edge1Y * pY + edge1Z * pZ;
+			XMVECTOR inverseDeterminant = XMVectorReciprocal(determinant);
+
+			XMVECTOR toOriginX = originX - XMLoadFloat4(&packet.v0[0]);
+			XMVECTOR toOriginY = originY - XMLoadFloat4(&packet.v0[1]);
+			XMVECTOR toOriginZ = originZ - XMLoadFloat4(&packet.v0[2]);
+			XMVECTOR u = (toOriginX * pX + toOriginY * pY + toOriginZ * pZ) * inverseDeterminant;
+
+			XMVECTOR qX = toOriginY * edge1Z - toOriginZ * edge1Y;
+			XMVECTOR qY = toOriginZ * edge1X - toOriginX * edge1Z;
+			XMVECTOR qZ = toOriginX * edge1Y - toOriginY * edge1X;
+			XMVECTOR v = (directionX * qX + directionY * qY + directionZ * qZ) * inverseDeterminant;
+			XMVECTOR t = (edge2X * qX + edge2Y * qY + edge2Z * qZ) * inverseDeterminant;
+
+			// Empty lanes have no area, so they fail the determinant test
+			XMVECTOR zero = XMVectorZero();
+			XMVECTOR inside = XMVectorAndInt(
+				XMVectorAndInt(XMVectorGreater(XMVectorAbs(determinant), zero), XMVectorGreaterOrEqual(u, zero)),
+				XMVectorAndInt(XMVectorGreaterOrEqual(v, zero), XMVectorLessOrEqual(u + v, XMVectorSplatOne())));
+			inside = XMVectorAndInt(inside, XMVectorAndInt(XMVectorGreaterOrEqual(t, zero), XMVectorLessOrEqual(t, XMVectorReplicate(closest))));
+
+			XMUINT4 mask;
+			XMFLOAT4 distances;
+			XMFLOAT4 us;
+			XMFLOAT4 vs;
+			XMStoreUInt4(&mask, inside);
+			XMStoreFloat4(&distances, t);
+			XMStoreFloat4(&us, u);
+			XMStoreFloat4(&vs, v);
+
+			for (unsigned int i = 0; i < node.count; i++)
+			{
+				if ((&mask.x)[i] == 0 || (&distances.x)[i] > closest)
+					continue;
+
+				closest = (&distances.x)[i];
+				hit.distance = closest;
+				hit.triangle = packet.triangles[i];
+				hit.u = (&us.x)[i];
+				hit.v = (&vs.x)[i];
+				found = true;
+			}
+
+			if (found && anyHit)
+				return true;
+			continue;
+		}
+
+		// Slab test against all four children
+		XMVECTOR scale = QuantizationScale(entry.box.min, entry.box.max);
+		XMVECTOR minX = Dequantize(XMLoadUByte4(&node.minX), XMVectorSplatX(scale), XMVectorReplicate(entry.box.min.x));
+		XMVECTOR maxX = Dequantize(XMLoadUByte4(&node.maxX), XMVectorSplatX(scale), XMVectorReplicate(entry.box.min.x));
+		XMVECTOR minY = Dequantize(XMLoadUByte4(&node.minY), XMVectorSplatY(scale), XMVectorReplicate(entry.box.min.y));
+		XMVECTOR maxY = Dequantize(XMLoadUByte4(&node.maxY), XMVectorSplatY(scale), XMVectorReplicate(entry.box.min.y));
+		XMVECTOR minZ = Dequantize(XMLoadUByte4(&node.minZ), XMVectorSplatZ(scale), XMVectorReplicate(entry.box.min.z));
+		XMVECTOR maxZ = Dequantize(XMLoadUByte4(&node.maxZ), XMVectorSplatZ(scale), XMVectorReplicate(entry.box.min.z));
+
+		XMVECTOR nearX = (minX - originX) * inverseX;
+		XMVECTOR farX = (maxX - originX) * inverseX;
+		XMVECTOR nearY = (minY - originY) * inverseY;
+		XMVECTOR farY = (maxY - originY) * inverseY;
+		XMVECTOR nearZ = (minZ - originZ) * inverseZ;
+		XMVECTOR farZ = (maxZ - originZ) * inverseZ;
+
+		XMVECTOR entryDistance = XMVectorMax(
+			XMVectorMax(XMVectorMin(nearX, farX), XMVectorMin(nearY, farY)),
+			XMVectorMax(XMVectorMin(nearZ, farZ), XMVectorZero()));
+		XMVECTOR exitDistance = XMVectorMin(
+			XMVectorMin(XMVectorMax(nearX, farX), XMVectorMax(nearY, farY)),
+			XMVectorMin(XMVectorMax(nearZ, farZ), XMVectorReplicate(closest)));
+		exitDistance *= BVH_ROBUST_FAR;
+
+		XMUINT4 mask;
+		XMFLOAT4 distances;
+		XMFLOAT4 lows[3];
+		XMFLOAT4 highs[3];
+		XMStoreUInt4(&mask, XMVectorLessOrEqual(entryDistance, exitDistance));
+		XMStoreFloat4(&distances, entryDistance);
+		XMStoreFloat4(&lows[0], minX);
+		XMStoreFloat4(&lows[1], minY);
+		XMStoreFloat4(&lows[2], minZ);
+		XMStoreFloat4(&highs[0], maxX);
+		XMStoreFloat4(&highs[1], maxY);
+		XMStoreFloat4(&highs[2], maxZ);
+
+		// Push the hit children furthest first so the nearest is visited next
+		unsigned int order[BVH_WIDTH];
+		unsigned int hitCount = 0;
+		for (unsigned int i = 0; i < node.count; i++)
+		{
+			if ((&mask.x)[i] == 0)
+				continue;
+
+			unsigned int slot = hitCount++;
+			while (slot > 0 && (&distances.x)[order[slot - 1]] < (&distances.x)[i])
+			{
+				order[slot] = order[slot - 1];
+				slot--;
+			}
+			order[slot] = i;
+		}
+
+		for (unsigned int h = 0; h < hitCount && stackSize < BVH_STACK_SIZE; h++)
+		{
+			unsigned int i = order[h];
+			Entry& child = stack[stackSize++];
+			child.node = node.first + i;
+			child.distance = (&distances.x)[i];
+			child.box.min = XMFLOAT3((&lows[0].x)[i], (&lows[1].x)[i], (&lows[2].x)[i]);
+			child.box.max = XMFLOAT3((&highs[0].x)[i], (&highs[1].x)[i], (&highs[2].x)[i]);
+		}
+	}
+
+	return found;
+}
+
+#pragma endregion
+
+unsigned int MeshBvh::GetNodeCount() const
+{
+	return (unsigned int)nodes.size();
+}
+
+unsigned int MeshBvh::GetTriangleCount() const
+{
+	return triangleCount;
+}
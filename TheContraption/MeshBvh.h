@@ -0,0 +1,128 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include "Vertex.h"
+
+/*
+	Bounding volume hierarchy over the triangles of a mesh for ray
+	queries in mesh space. Every node holds the boxes of up to four
+	children, quantized to 8 bits inside of its own box so a node is
+	only 32 bytes, and a ray is tested against all four at once.
+	Leaves are packets of up to four triangles tested together
+*/
+
+// Children per node and triangles per leaf
+#define BVH_WIDTH 4
+
+// Buckets the surface area heuristic sorts triangles into per axis
+#define BVH_SAH_BINS 16
+
+// Below this depth splits give up on the surface area heuristic
+// and halve the triangles, which keeps the tree from getting deep
+#define BVH_SAH_MAX_DEPTH 48
+
+// Enough for the deepest tree the build can make, each level
+// leaves at most three siblings on the stack
+#define BVH_STACK_SIZE 256
+
+// Node flags
+#define BVH_NODE_LEAF 0x1
+
+struct BvhNode
+{
+	// Child boxes as 0-255 across this node's box, one
+	// vector per plane so the children line up in lanes
+	DirectX::PackedVector::XMUBYTE4 minX;
+	DirectX::PackedVector::XMUBYTE4 maxX;
+	DirectX::PackedVector::XMUBYTE4 minY;
+	DirectX::PackedVector::XMUBYTE4 maxY;
+	DirectX::PackedVector::XMUBYTE4 minZ;
+	DirectX::PackedVector::XMUBYTE4 maxZ;
+
+	unsigned int first;		// First child node, or the triangle packet of a leaf
+	unsigned short count;	// Children, or triangles in the packet
+	unsigned short flags;	// BVH_NODE flags
+};
+
+// Up to four triangles laid out for testing together. Each XMFLOAT4
+// holds one coordinate of the four triangles, unused lanes are zero
+struct BvhTrianglePacket
+{
+	DirectX::XMFLOAT4 v0[3];
+	DirectX::XMFLOAT4 edge1[3];
+	DirectX::XMFLOAT4 edge2[3];
+	unsigned int triangles[BVH_WIDTH];	// Which triangle of the mesh each lane is
+};
+
+// Closest hit of a ray, in the units of the ray direction
+struct MeshHit
+{
+	float distance;
+	unsigned int triangle;
+
+	// Barycentrics of the hit towards the second and third corner
+	float u;
+	float v;
+};
+
+class MeshBvh
+{
+public:
+	MeshBvh();
+
+	/// <summary>
+	/// Build the tree over a triangle list with the surface area heuristic
+	/// </summary>
+	void Build(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+
+	/// <summary>
+	/// Find the closest triangle along a ray, from either side.
+	/// Distances are in multiples of the direction, so a normalized
+	/// direction gives distances in mesh units
+	/// </summary>
+	/// <returns>False if nothing was hit within maxDistance</returns>
+	bool Raycast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, MeshHit& hit) const;
+	/// <summary>
+	/// Whether anything is along a ray at all. Stops at the first
+	/// triangle found, so it is cheaper than Raycast for line of sight
+	/// </summary>
+	bool Occluded(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance) const;
+
+	unsigned int GetNodeCount() const;
+	unsigned int GetTriangleCount() const;
+
+private:
+	struct BuildTriangle
+	{
+		DirectX::XMFLOAT3 min;
+		DirectX::XMFLOAT3 max;
+		DirectX::XMFLOAT3 centroid;
+		unsigned int index;
+	};
+
+	struct Bounds
+	{
+		DirectX::XMFLOAT3 min;
+		DirectX::XMFLOAT3 max;
+	};
+
+	void BuildNode(unsigned int node, unsigned int begin, unsigned int end, const Bounds& box, unsigned int depth);
+	void BuildLeaf(unsigned int node, unsigned int begin, unsigned int end);
+	unsigned int Split(unsigned int begin, unsigned int end, unsigned int depth);
+	Bounds GetBounds(unsigned int begin, unsigned int end) const;
+	bool Traverse(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, bool anyHit, MeshHit& hit) const;
+
+	static float SurfaceArea(const Bounds& bounds);
+
+	std::vector<BvhNode> nodes;
+	std::vector<BvhTrianglePacket> packets;
+	Bounds bounds;
+	unsigned int triangleCount;
+
+	// Only alive while building
+	std::vector<BuildTriangle> buildTriangles;
+	const Vertex* buildVertices;
+	const unsigned int* buildIndices;
+};
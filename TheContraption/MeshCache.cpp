@@ -0,0 +1,360 @@
+#include "MeshCache.h"
+#include "FileHelpers.h"
+#include <cfloat>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+using namespace DirectX;
+
+// Zeros written between the blobs to keep them aligned
+static bool WritePadding(FILE* file, unsigned long long from, unsigned long long to)
+{
+	static const char zeros[MESH_CACHE_ALIGNMENT] = {};
+	return to == from || std::fwrite(zeros, 1, (size_t)(to - from), file) == to - from;
+}
+
+unsigned long long MeshCache::HashFile(const wchar_t* file)
+{
+	MappedFile source(file);
+	if (!source.IsOpen())
+		return 0;
+
+	const char* data = source.GetData();
+	size_t size = source.GetSize();
+
+	// Eight bytes at a time so hashing stays far cheaper than parsing
+	const unsigned long long multiplier = 0x9e3779b97f4a7c15ULL;
+	unsigned long long hash = 0xcbf29ce484222325ULL ^ size;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		unsigned long long word;
+		std::memcpy(&word, data + i, 8);
+		hash = (hash ^ word) * multiplier;
+		hash ^= hash >> 32;
+	}
+
+	unsigned long long tail = 0;
+	std::memcpy(&tail, data + i, size - i);
+	hash = (hash ^ tail) * multiplier;
+	hash ^= hash >> 29;
+
+	// 0 means the source could not be read
+	return hash == 0 ? 1 : hash;
+}
+
+std::wstring MeshCache::GetCachePath(const wchar_t* sourceFile)
+{
+	return std::wstring(sourceFile) + MESH_CACHE_EXTENSION;
+}
+
+const MeshCacheHeader* MeshCache::Open(MappedFile& cache, unsigned long long sourceHash)
+{
+	if (!cache.IsOpen() || cache.GetSize() < sizeof(MeshCacheHeader) || sourceHash == 0)
+		return nullptr;
+
+	const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(cache.GetData());
+	if (header->magic != MESH_CACHE_MAGIC ||
+		header->version != MESH_CACHE_VERSION ||
+		header->sourceHash != sourceHash)
+		return nullptr;
+
+	// The Vertex struct may have changed since the cache was written
+	MeshCacheHeader expected = {};
+	DescribeVertex(expected);
+	if (header->vertexStride != expected.vertexStride ||
+		header->attributeCount != expected.attributeCount ||
+		std::memcmp(header->attributes, expected.attributes, sizeof(expected.attributes)) != 0)
+		return nullptr;
+
+	// Blobs have to be aligned and inside of the file
+	unsigned long long vertexBytes = (unsigned long long)header->vertexCount * header->vertexStride;
+	unsigned long long indexBytes = (unsigned long long)header->indexCount * sizeof(unsigned int);
+	unsigned long long meshletBytes = (unsigned long long)header->meshletCount * sizeof(Meshlet);
+	unsigned long long lodBytes = (unsigned long long)header->lodCount * sizeof(MeshLod);
+	if (header->vertexOffset % MESH_CACHE_ALIGNMENT != 0 ||
+		header->indexOffset % MESH_CACHE_ALIGNMENT != 0 ||
+		header->meshletOffset % MESH_CACHE_ALIGNMENT != 0 ||
+		header->lodOffset % MESH_CACHE_ALIGNMENT != 0 ||
+		header->vertexOffset + vertexBytes > cache.GetSize() ||
+		header->indexOffset + indexBytes > cache.GetSize() ||
+		header->meshletOffset + meshletBytes > cache.GetSize() ||
+		header->lodOffset + lodBytes > cache.GetSize())
+		return nullptr;
+
+	// Every LOD has to stay inside of the index blob
+	const MeshLod* lods = GetLods(header);
+	for (unsigned int i = 0; i < header->lodCount; i++)
+	{
+		if ((unsigned long long)lods[i].indexOffset + lods[i].indexCount > header->indexCount)
+			return nullptr;
+	}
+
+	// Meshlets are ranges of LOD 0 (every index when there are no LODs),
+	// and culling copies the visible ones into a stream only as big as it
+	const Meshlet* meshlets = GetMeshlets(header);
+	unsigned long long meshletIndices = 0;
+	unsigned long long lodIndices = header->lodCount > 0 ? lods[0].indexCount : header->indexCount;
+	for (unsigned int i = 0; i < header->meshletCount; i++)
+	{
+		meshletIndices += (unsigned long long)meshlets[i].triangleCount * 3;
+		if ((unsigned long long)meshlets[i].indexOffset + meshlets[i].triangleCount * 3ull > lodIndices ||
+			meshletIndices > lodIndices)
+			return nullptr;
+	}
+
+	return header;
+}
+
+const Vertex* MeshCache::GetVertices(const MeshCacheHeader* header)
+{
+	return reinterpret_cast<const Vertex*>(reinterpret_cast<const char*>(header) + header->vertexOffset);
+}
+
+const unsigned int* MeshCache::GetIndices(const MeshCacheHeader* header)
+{
+	return reinterpret_cast<const unsigned int*>(reinterpret_cast<const char*>(header) + header->indexOffset);
+}
+
+const Meshlet* MeshCache::GetMeshlets(const MeshCacheHeader* header)
+{
+	return reinterpret_cast<const Meshlet*>(reinterpret_cast<const char*>(header) + header->meshletOffset);
+}
+
+const MeshLod* MeshCache::GetLods(const MeshCacheHeader* header)
+{
+	return reinterpret_cast<const MeshLod*>(reinterpret_cast<const char*>(header) + header->lodOffset);
+}
+
+bool MeshCache::Write(const wchar_t* cacheFile, unsigned long long sourceHash, const MeshData& mesh)
+{
+	if (sourceHash == 0)
+		return false;
+
+	MeshCacheHeader header = {};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.vertexCount = (unsigned int)mesh.vertices.size();
+	header.indexCount = (unsigned int)mesh.indices.size();
+	header.meshletCount = (unsigned int)mesh.meshlets.size();
+	header.lodCount = (unsigned int)mesh.lods.size();
+	DescribeVertex(header);
+
+	XMVECTOR minBounds = XMVectorReplicate(mesh.vertices.empty() ? 0.0f : FLT_MAX);
+	XMVECTOR maxBounds = XMVectorReplicate(mesh.vertices.empty() ? 0.0f : -FLT_MAX);
+	for (unsigned int i = 0; i < mesh.vertices.size(); i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&mesh.vertices[i].Position);
+		minBounds = XMVectorMin(minBounds, p);
+		maxBounds = XMVectorMax(maxBounds, p);
+	}
+	XMStoreFloat3(&header.boundsMin, minBounds);
+	XMStoreFloat3(&header.boundsMax, maxBounds);
+
+	unsigned long long vertexBytes = (unsigned long long)header.vertexCount * header.vertexStride;
+	unsigned long long indexBytes = (unsigned long long)header.indexCount * sizeof(unsigned int);
+	unsigned long long meshletBytes = (unsigned long long)header.meshletCount * sizeof(Meshlet);
+	unsigned long long lodBytes = (unsigned long long)header.lodCount * sizeof(MeshLod);
+	header.vertexOffset = Align(sizeof(MeshCacheHeader));
+	header.indexOffset = Align(header.vertexOffset + vertexBytes);
+	header.meshletOffset = Align(header.indexOffset + indexBytes);
+	header.lodOffset = Align(header.meshletOffset + meshletBytes);
+
+	std::wstring tempFile = std::wstring(cacheFile) + L".tmp";
+	FILE* file = OpenForWriting(tempFile.c_str());
+	if (file == nullptr)
+		return false;
+
+	bool written =
+		std::fwrite(&header, sizeof(MeshCacheHeader), 1, file) == 1 &&
+		WritePadding(file, sizeof(MeshCacheHeader), header.vertexOffset) &&
+		(vertexBytes == 0 || std::fwrite(mesh.vertices.data(), (size_t)vertexBytes, 1, file) == 1) &&
+		WritePadding(file, header.vertexOffset + vertexBytes, header.indexOffset) &&
+		(indexBytes == 0 || std::fwrite(mesh.indices.data(), (size_t)indexBytes, 1, file) == 1) &&
+		WritePadding(file, header.indexOffset + indexBytes, header.meshletOffset) &&
+		(meshletBytes == 0 || std::fwrite(mesh.meshlets.data(), (size_t)meshletBytes, 1, file) == 1) &&
+		WritePadding(file, header.meshletOffset + meshletBytes, header.lodOffset) &&
+		(lodBytes == 0 || std::fwrite(mesh.lods.data(), (size_t)lodBytes, 1, file) == 1);
+
+	written = std::fclose(file) == 0 && written;
+	if (!written)
+	{
+		RemoveFile(tempFile.c_str());
+		return false;
+	}
+
+	return MoveIntoPlace(tempFile.c_str(), cacheFile);
+}
+
+void MeshCache::DescribeVertex(MeshCacheHeader& header)
+{
+	const MeshCacheAttribute attributes[] =
+	{
+		{ "POSITION", 3, (unsigned int)offsetof(Vertex, Position) },
+		{ "NORMAL", 3, (unsigned int)offsetof(Vertex, Normal) },
+		{ "TANGENT", 4, (unsigned int)offsetof(Vertex, Tangent) },
+		{ "TEXCOORD", 2, (unsigned int)offsetof(Vertex, UV) },
+	};
+
+	header.vertexStride = sizeof(Vertex);
+	header.attributeCount = sizeof(attributes) / sizeof(attributes[0]);
+	std::memcpy(header.attributes, attributes, sizeof(attributes));
+}
+
+unsigned long long MeshCache::Align(unsigned long long offset)
+{
+	return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+}
+
+MeshCacheWriter::MeshCacheWriter(const wchar_t* cacheFile, unsigned long long sourceHash) :
+	cacheFile(cacheFile),
+	tempFile(std::wstring(cacheFile) + L".tmp"),
+	indexFile(std::wstring(cacheFile) + L".indices.tmp"),
+	meshletFile(std::wstring(cacheFile) + L".meshlets.tmp"),
+	file(nullptr),
+	indices(nullptr),
+	meshlets(nullptr),
+	header(),
+	boundsMin(FLT_MAX, FLT_MAX, FLT_MAX),
+	boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX),
+	failed(sourceHash == 0)
+{
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	MeshCache::DescribeVertex(header);
+	header.vertexOffset = MeshCache::Align(sizeof(MeshCacheHeader));
+
+	if (failed)
+		return;
+
+	// The header is written for real once everything is counted
+	file = OpenForWriting(tempFile.c_str());
+	indices = OpenForWriting(indexFile.c_str());
+	meshlets = OpenForWriting(meshletFile.c_str());
+	failed =
+		file == nullptr || indices == nullptr || meshlets == nullptr ||
+		std::fwrite(&header, sizeof(MeshCacheHeader), 1, file) != 1 ||
+		!WritePadding(file, sizeof(MeshCacheHeader), header.vertexOffset);
+}
+
+MeshCacheWriter::~MeshCacheWriter()
+{
+	if (file != nullptr)
+		std::fclose(file);
+	if (indices != nullptr)
+		std::fclose(indices);
+	if (meshlets != nullptr)
+		std::fclose(meshlets);
+
+	// Only the finished cache is kept
+	RemoveFile(indexFile.c_str());
+	RemoveFile(meshletFile.c_str());
+	RemoveFile(tempFile.c_str());
+}
+
+bool MeshCacheWriter::Append(const MeshData& piece)
+{
+	if (failed || file == nullptr)
+		return false;
+
+	unsigned long long vertexCount = (unsigned long long)header.vertexCount + piece.vertices.size();
+	unsigned long long indexCount = (unsigned long long)header.indexCount + piece.indices.size();
+	if (vertexCount > 0xffffffff || indexCount > 0xffffffff)
+	{
+		failed = true;
+		return false;
+	}
+
+	if (!piece.vertices.empty())
+		failed |= std::fwrite(piece.vertices.data(), sizeof(Vertex) * piece.vertices.size(), 1, file) != 1;
+
+	// Indices and meshlets move up past the pieces before this one
+	unsigned int shifted[MESH_CACHE_COPY_SIZE / sizeof(unsigned int)];
+	const size_t batch = sizeof(shifted) / sizeof(shifted[0]);
+	for (size_t i = 0; i < piece.indices.size() && !failed; i += batch)
+	{
+		size_t count = piece.indices.size() - i < batch ? piece.indices.size() - i : batch;
+		for (size_t k = 0; k < count; k++)
+		{
+			shifted[k] = piece.indices[i + k] + header.vertexCount;
+		}
+		failed |= std::fwrite(shifted, sizeof(unsigned int) * count, 1, indices) != 1;
+	}
+
+	for (size_t i = 0; i < piece.meshlets.size() && !failed; i++)
+	{
+		Meshlet meshlet = piece.meshlets[i];
+		meshlet.indexOffset += header.indexCount;
+		failed |= std::fwrite(&meshlet, sizeof(Meshlet), 1, meshlets) != 1;
+	}
+
+	XMVECTOR minBounds = XMLoadFloat3(&boundsMin);
+	XMVECTOR maxBounds = XMLoadFloat3(&boundsMax);
+	for (const Vertex& v : piece.vertices)
+	{
+		XMVECTOR p = XMLoadFloat3(&v.Position);
+		minBounds = XMVectorMin(minBounds, p);
+		maxBounds = XMVectorMax(maxBounds, p);
+	}
+	XMStoreFloat3(&boundsMin, minBounds);
+	XMStoreFloat3(&boundsMax, maxBounds);
+
+	header.vertexCount = (unsigned int)vertexCount;
+	header.indexCount = (unsigned int)indexCount;
+	header.meshletCount += (unsigned int)piece.meshlets.size();
+	return !failed;
+}
+
+bool MeshCacheWriter::Finish()
+{
+	if (failed || file == nullptr || header.indexCount == 0)
+		return false;
+
+	unsigned long long vertexBytes = (unsigned long long)header.vertexCount * header.vertexStride;
+	unsigned long long indexBytes = (unsigned long long)header.indexCount * sizeof(unsigned int);
+	unsigned long long meshletBytes = (unsigned long long)header.meshletCount * sizeof(Meshlet);
+	header.lodCount = 1;
+	header.indexOffset = MeshCache::Align(header.vertexOffset + vertexBytes);
+	header.meshletOffset = MeshCache::Align(header.indexOffset + indexBytes);
+	header.lodOffset = MeshCache::Align(header.meshletOffset + meshletBytes);
+	header.boundsMin = boundsMin;
+	header.boundsMax = boundsMax;
+
+	MeshLod lod = { 0, header.indexCount, 0.0f };
+	bool written =
+		WritePadding(file, header.vertexOffset + vertexBytes, header.indexOffset) &&
+		CopyScratch(indices, indexFile, indexBytes) &&
+		WritePadding(file, header.indexOffset + indexBytes, header.meshletOffset) &&
+		CopyScratch(meshlets, meshletFile, meshletBytes) &&
+		WritePadding(file, header.meshletOffset + meshletBytes, header.lodOffset) &&
+		std::fwrite(&lod, sizeof(MeshLod), 1, file) == 1 &&
+		std::fseek(file, 0, SEEK_SET) == 0 &&
+		std::fwrite(&header, sizeof(MeshCacheHeader), 1, file) == 1;
+
+	written = std::fclose(file) == 0 && written;
+	file = nullptr;
+	failed = !written || !MoveIntoPlace(tempFile.c_str(), cacheFile.c_str());
+	return !failed;
+}
+
+bool MeshCacheWriter::CopyScratch(FILE*& scratch, const std::wstring& path, unsigned long long size)
+{
+	// Written through its own handle, so it is reopened to be read back
+	bool closed = std::fclose(scratch) == 0;
+	scratch = closed ? OpenForReading(path.c_str()) : nullptr;
+	if (scratch == nullptr)
+		return false;
+
+	char buffer[MESH_CACHE_COPY_SIZE];
+	while (size > 0)
+	{
+		size_t count = size < sizeof(buffer) ? (size_t)size : sizeof(buffer);
+		if (std::fread(buffer, 1, count, scratch) != count || std::fwrite(buffer, 1, count, file) != count)
+			return false;
+		size -= count;
+	}
+	return true;
+}
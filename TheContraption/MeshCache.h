@@ -0,0 +1,160 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <DirectXMath.h>
+
+#include "MappedFile.h"
+#include "MeshData.h"
+
+/*
+	Binary copies of imported meshes written next to their source
+	file. Later loads map the cache and hand its vertex and index
+	blobs straight to the GPU without parsing anything
+*/
+
+// "TCMC" at the start of every cache file
+#define MESH_CACHE_MAGIC 0x434d4354
+
+// Bump whenever the layout of the file or the import passes change
+#define MESH_CACHE_VERSION 4
+
+// Added to the source path to get the cache path
+#define MESH_CACHE_EXTENSION L".meshcache"
+
+// Blobs start on this boundary so they can be uploaded in place
+#define MESH_CACHE_ALIGNMENT 16
+
+// Size of the buffer blobs are copied through when a cache is streamed
+#define MESH_CACHE_COPY_SIZE (64 * 1024)
+
+// Attributes a vertex layout can describe
+#define MESH_CACHE_MAX_ATTRIBUTES 8
+
+// One attribute of the stored vertex layout
+struct MeshCacheAttribute
+{
+	char semantic[12];
+	unsigned int components;	// Number of 32 bit floats
+	unsigned int offset;		// Bytes from the start of the vertex
+};
+
+struct MeshCacheHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long sourceHash;
+
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int meshletCount;
+	unsigned int lodCount;
+	unsigned int vertexStride;
+	unsigned int attributeCount;
+	MeshCacheAttribute attributes[MESH_CACHE_MAX_ATTRIBUTES];
+
+	// Bytes from the start of the file
+	unsigned long long vertexOffset;
+	unsigned long long indexOffset;
+	unsigned long long meshletOffset;
+	unsigned long long lodOffset;
+};
+
+class MeshCache
+{
+public:
+	/// <summary>
+	/// Hash the whole contents of a file
+	/// </summary>
+	/// <returns>0 if the file could not be read</returns>
+	static unsigned long long HashFile(const wchar_t* file);
+	/// <summary>
+	/// Where the cache of a source file lives
+	/// </summary>
+	static std::wstring GetCachePath(const wchar_t* sourceFile);
+
+	/// <summary>
+	/// Check a mapped cache file against the hash of its source
+	/// and the current vertex layout
+	/// </summary>
+	/// <returns>The header, or null if the cache is missing or stale</returns>
+	static const MeshCacheHeader* Open(MappedFile& cache, unsigned long long sourceHash);
+	/// <summary>
+	/// Vertices stored in an opened cache
+	/// </summary>
+	static const Vertex* GetVertices(const MeshCacheHeader* header);
+	/// <summary>
+	/// Indices stored in an opened cache
+	/// </summary>
+	static const unsigned int* GetIndices(const MeshCacheHeader* header);
+	/// <summary>
+	/// Meshlets stored in an opened cache
+	/// </summary>
+	static const Meshlet* GetMeshlets(const MeshCacheHeader* header);
+	/// <summary>
+	/// LODs stored in an opened cache
+	/// </summary>
+	static const MeshLod* GetLods(const MeshCacheHeader* header);
+
+	/// <summary>
+	/// Write the mesh to a cache file. The file is written under a
+	/// temporary name first so a half written cache is never read
+	/// </summary>
+	/// <returns>False if the file could not be written</returns>
+	static bool Write(const wchar_t* cacheFile, unsigned long long sourceHash, const MeshData& mesh);
+
+private:
+	friend class MeshCacheWriter;
+
+	static void DescribeVertex(MeshCacheHeader& header);
+	static unsigned long long Align(unsigned long long offset);
+};
+
+/*
+	Writes a cache a piece at a time for meshes too big to hold in
+	memory at once. Vertices go straight into the cache, indices
+	and meshlets wait in scratch files until the vertex count is
+	known and are copied in after it
+*/
+class MeshCacheWriter
+{
+public:
+	MeshCacheWriter(const wchar_t* cacheFile, unsigned long long sourceHash);
+	~MeshCacheWriter();
+
+	// Owns open files so it can't be copied
+	MeshCacheWriter(MeshCacheWriter const&) = delete;
+	void operator=(MeshCacheWriter const&) = delete;
+
+	/// <summary>
+	/// Add a piece of the mesh after the ones before it. Its indices
+	/// and meshlets are relative to the piece
+	/// </summary>
+	/// <returns>False if the piece could not be written</returns>
+	bool Append(const MeshData& piece);
+	/// <summary>
+	/// Copy the indices and meshlets in, write the header and move
+	/// the cache into place. The mesh gets a single LOD
+	/// </summary>
+	/// <returns>False if anything could not be written</returns>
+	bool Finish();
+
+private:
+	bool CopyScratch(FILE*& scratch, const std::wstring& path, unsigned long long size);
+
+	std::wstring cacheFile;
+	std::wstring tempFile;
+	std::wstring indexFile;
+	std::wstring meshletFile;
+
+	FILE* file;
+	FILE* indices;
+	FILE* meshlets;
+
+	MeshCacheHeader header;
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+	bool failed;
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// A cluster of triangles that is culled as a whole (see Meshlets.h)
+struct Meshlet
+{
+	DirectX::XMFLOAT3 center;	// Bounding sphere in mesh space
+	float radius;
+	DirectX::XMFLOAT3 coneAxis;	// Average direction of the triangle normals
+	float coneCutoff;			// Sine of the widest normal's angle to the axis, 1 if it can't be cone culled
+	unsigned int indexOffset;	// First index of the meshlet's range in the index buffer
+	unsigned int triangleCount;
+	unsigned int vertexCount;	// Unique vertices the triangles use
+	unsigned int padding;
+};
+
+// One level of detail, a range of the index buffer that shares
+// the vertices of the full mesh (see MeshSimplifier.h)
+struct MeshLod
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	float error;	// Furthest the surface may have moved from the full mesh, in mesh units
+};
+
+/*
+	Geometry of a mesh while it is still on the CPU. Importers
+	fill this out and Mesh turns it into GPU buffers
+*/
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+
+	// Empty unless Meshlets::Build has run, meshlets only cover LOD 0
+	std::vector<Meshlet> meshlets;
+
+	// Empty unless MeshSimplifier::GenerateLods has run
+	std::vector<MeshLod> lods;
+};
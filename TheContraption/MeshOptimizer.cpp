@@ -0,0 +1,525 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+using namespace DirectX;
+
+// Slot in the weld table that has not been filled yet
+#define WELD_EMPTY_SLOT 0xffffffff
+
+// Bits of a float with -0 folded into 0 so they weld together
+static unsigned int FloatBits(float f)
+{
+	f = f == 0.0f ? 0.0f : f;
+
+	unsigned int bits;
+	std::memcpy(&bits, &f, sizeof(unsigned int));
+	return bits;
+}
+
+void MeshOptimizer::WeldVertices(MeshData& mesh)
+{
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	if (vertexCount == 0)
+		return;
+
+	// Open addressing table at most half full, holding
+	// indices into the welded vertex list
+	unsigned int tableSize = 1;
+	while (tableSize < vertexCount * 2)
+		tableSize <<= 1;
+	std::vector<unsigned int> table(tableSize, WELD_EMPTY_SLOT);
+
+	std::vector<Vertex> welded;
+	welded.reserve(vertexCount);
+	std::vector<unsigned int> remap(vertexCount);
+
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const Vertex& v = mesh.vertices[i];
+		unsigned int slot = HashVertex(v) & (tableSize - 1);
+
+		// Probe until the same vertex or an empty slot is found
+		while (table[slot] != WELD_EMPTY_SLOT && !SameVertex(welded[table[slot]], v))
+			slot = (slot + 1) & (tableSize - 1);
+
+		if (table[slot] == WELD_EMPTY_SLOT)
+		{
+			table[slot] = (unsigned int)welded.size();
+			welded.push_back(v);
+		}
+
+		remap[i] = table[slot];
+	}
+
+	for (unsigned int i = 0; i < mesh.indices.size(); i++)
+	{
+		mesh.indices[i] = remap[mesh.indices[i]];
+	}
+
+	mesh.vertices.swap(welded);
+}
+
+unsigned int MeshOptimizer::HashVertex(const Vertex& v)
+{
+	// FNV-1a over the bits of every compared component
+	unsigned int values[8] =
+	{
+		FloatBits(v.Position.x), FloatBits(v.Position.y), FloatBits(v.Position.z),
+		FloatBits(v.Normal.x), FloatBits(v.Normal.y), FloatBits(v.Normal.z),
+		FloatBits(v.UV.x), FloatBits(v.UV.y)
+	};
+
+	unsigned int hash = 2166136261u;
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		hash = (hash ^ values[i]) * 16777619u;
+	}
+
+	// Fold the high bits down since the table only uses the low ones
+	return hash ^ (hash >> 16);
+}
+
+bool MeshOptimizer::SameVertex(const Vertex& a, const Vertex& b)
+{
+	return
+		a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z &&
+		a.Normal.x == b.Normal.x && a.Normal.y == b.Normal.y && a.Normal.z == b.Normal.z &&
+		a.UV.x == b.UV.x && a.UV.y == b.UV.y;
+}
+
+void MeshOptimizer::Optimize(MeshData& mesh)
+{
+	std::vector<unsigned int> clusters;
+	OptimizeVertexCache(mesh.indices, (unsigned int)mesh.vertices.size(), &clusters);
+	OptimizeOverdraw(mesh, clusters);
+	OptimizeVertexFetch(mesh);
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, std::vector<unsigned int>* clusters)
+{
+	if (clusters != nullptr)
+		clusters->clear();
+
+	unsigned int triangleCount = (unsigned int)indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// How many triangles still need each vertex
+	std::vector<unsigned int> live(vertexCount, 0);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+	{
+		live[indices[i]]++;
+	}
+
+	// Triangles around each vertex, one vertex after another
+	std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		adjacencyStart[v + 1] = adjacencyStart[v] + live[v];
+	}
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+	{
+		adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	// Time each vertex last entered the cache. Time only moves on
+	// a miss so anything older than the cache size has been pushed out
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	unsigned int time = VERTEX_CACHE_SIZE + 1;
+
+	std::vector<unsigned char> emitted(triangleCount, 0);
+	std::vector<unsigned int> deadEnds;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+
+	unsigned int cursor = 0;
+	int fan = SkipDeadEnd(deadEnds, live, cursor, vertexCount);
+	if (clusters != nullptr)
+		clusters->push_back(0);
+
+	while (fan >= 0)
+	{
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (unsigned int a = adjacencyStart[fan]; a < adjacencyStart[fan + 1]; a++)
+		{
+			unsigned int t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+
+				if (time - cacheTime[v] > VERTEX_CACHE_SIZE)
+				{
+					cacheTime[v] = time;
+					time++;
+				}
+			}
+
+			emitted[t] = 1;
+		}
+
+		// Fan around the oldest vertex that will still be
+		// in the cache once all of its triangles are emitted
+		int next = -1;
+		int bestPriority = -1;
+		for (unsigned int c = 0; c < candidates.size(); c++)
+		{
+			unsigned int v = candidates[c];
+			if (live[v] == 0)
+				continue;
+
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= VERTEX_CACHE_SIZE)
+				priority = (int)(time - cacheTime[v]);
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = (int)v;
+			}
+		}
+
+		// Nothing nearby is left so jump somewhere else
+		if (next == -1)
+		{
+			next = SkipDeadEnd(deadEnds, live, cursor, vertexCount);
+			if (next >= 0 && clusters != nullptr)
+				clusters->push_back((unsigned int)output.size() / 3);
+		}
+
+		fan = next;
+	}
+
+	indices.swap(output);
+}
+
+int MeshOptimizer::SkipDeadEnd(std::vector<unsigned int>& deadEnds, const std::vector<unsigned int>& live, unsigned int& cursor, unsigned int vertexCount)
+{
+	// Recently used vertices first since they may still be cached
+	while (!deadEnds.empty())
+	{
+		unsigned int v = deadEnds.back();
+		deadEnds.pop_back();
+		if (live[v] > 0)
+			return (int)v;
+	}
+
+	// Otherwise the next vertex in the buffer with work left
+	while (cursor < vertexCount)
+	{
+		if (live[cursor] > 0)
+			return (int)cursor;
+		cursor++;
+	}
+
+	return -1;
+}
+
+void MeshOptimizer::OptimizeOverdraw(MeshData& mesh, const std::vector<unsigned int>& clusters, float threshold)
+{
+	std::vector<unsigned int>& indices = mesh.indices;
+	unsigned int triangleCount = (unsigned int)indices.size() / 3;
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	if (triangleCount == 0 || clusters.empty())
+		return;
+
+	// Split the clusters further wherever they have already made good
+	// enough use of the cache, assuming each one starts out cold
+	float targetAcmr = AnalyzeVertexCache(indices, vertexCount).acmr * threshold;
+
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	unsigned int time = VERTEX_CACHE_SIZE + 1;
+
+	std::vector<unsigned int> starts;
+	for (unsigned int c = 0; c < clusters.size(); c++)
+	{
+		unsigned int begin = clusters[c];
+		unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+		unsigned int start = begin;
+		unsigned int misses = 0;
+		time += VERTEX_CACHE_SIZE + 1;
+		starts.push_back(start);
+
+		for (unsigned int t = begin; t < end; t++)
+		{
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				if (time - cacheTime[v] > VERTEX_CACHE_SIZE)
+				{
+					cacheTime[v] = time;
+					time++;
+					misses++;
+				}
+			}
+
+			if (t + 1 < end && misses <= targetAcmr * (t - start + 1))
+			{
+				start = t + 1;
+				misses = 0;
+				time += VERTEX_CACHE_SIZE + 1;
+				starts.push_back(start);
+			}
+		}
+	}
+
+	// Area weighted centroid and normal of every cluster
+	unsigned int clusterCount = (unsigned int)starts.size();
+	std::vector<XMFLOAT3> centroids(clusterCount);
+	std::vector<XMFLOAT3> normals(clusterCount);
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+
+	for (unsigned int c = 0; c < clusterCount; c++)
+	{
+		unsigned int end = c + 1 < clusterCount ? starts[c + 1] : triangleCount;
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+
+		for (unsigned int t = starts[c]; t < end; t++)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&mesh.vertices[indices[t * 3 + 0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&mesh.vertices[indices[t * 3 + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&mesh.vertices[indices[t * 3 + 2]].Position);
+
+			// Cross product length is twice the area
+			XMVECTOR cross = XMVector3Cross(p1 - p0, p2 - p0);
+			float triangleArea = XMVectorGetX(XMVector3Length(cross)) * 0.5f;
+
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+
+		XMStoreFloat3(&centroids[c], area > 0.0f ? centroid / area : centroid);
+		XMStoreFloat3(&normals[c], XMVector3Normalize(normal));
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// Clusters on the outside facing out are the most likely to
+	// hide the others, so they are drawn first
+	std::vector<float> sortKeys(clusterCount);
+	std::vector<unsigned int> order(clusterCount);
+	for (unsigned int c = 0; c < clusterCount; c++)
+	{
+		XMVECTOR outward = XMLoadFloat3(&centroids[c]) - meshCentroid;
+		sortKeys[c] = XMVectorGetX(XMVector3Dot(outward, XMLoadFloat3(&normals[c])));
+		order[c] = c;
+	}
+
+	std::stable_sort(order.begin(), order.end(),
+		[&sortKeys](unsigned int a, unsigned int b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	for (unsigned int o = 0; o < clusterCount; o++)
+	{
+		unsigned int c = order[o];
+		unsigned int end = c + 1 < clusterCount ? starts[c + 1] : triangleCount;
+		output.insert(output.end(), indices.begin() + starts[c] * 3, indices.begin() + end * 3);
+	}
+
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(MeshData& mesh)
+{
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	std::vector<unsigned int> remap(vertexCount, WELD_EMPTY_SLOT);
+
+	std::vector<Vertex> ordered;
+	ordered.reserve(vertexCount);
+
+	for (unsigned int i = 0; i < mesh.indices.size(); i++)
+	{
+		unsigned int v = mesh.indices[i];
+		if (remap[v] == WELD_EMPTY_SLOT)
+		{
+			remap[v] = (unsigned int)ordered.size();
+			ordered.push_back(mesh.vertices[v]);
+		}
+
+		mesh.indices[i] = remap[v];
+	}
+
+	mesh.vertices.swap(ordered);
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = {};
+	unsigned int triangleCount = (unsigned int)indices.size() / 3;
+	if (triangleCount == 0)
+		return stats;
+
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<unsigned char> used(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	unsigned int misses = 0;
+	unsigned int uniqueVertices = 0;
+
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int v = indices[i];
+		if (time - cacheTime[v] > cacheSize)
+		{
+			cacheTime[v] = time;
+			time++;
+			misses++;
+		}
+
+		uniqueVertices += used[v] == 0;
+		used[v] = 1;
+	}
+
+	stats.acmr = (float)misses / (float)triangleCount;
+	stats.atvr = (float)misses / (float)uniqueVertices;
+	return stats;
+}
+
+OverdrawStats MeshOptimizer::AnalyzeOverdraw(const MeshData& mesh)
+{
+	OverdrawStats stats = {};
+	unsigned int triangleCount = (unsigned int)mesh.indices.size() / 3;
+	if (triangleCount == 0)
+		return stats;
+
+	XMVECTOR minBounds = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxBounds = XMVectorReplicate(-FLT_MAX);
+	for (unsigned int i = 0; i < mesh.vertices.size(); i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&mesh.vertices[i].Position);
+		minBounds = XMVectorMin(minBounds, p);
+		maxBounds = XMVectorMax(maxBounds, p);
+	}
+
+	XMFLOAT3 minimum;
+	XMFLOAT3 size;
+	XMStoreFloat3(&minimum, minBounds);
+	XMStoreFloat3(&size, maxBounds - minBounds);
+
+	float extent = std::max(size.x, std::max(size.y, size.z));
+	if (extent <= 0.0f)
+		return stats;
+
+	// Fit the largest side of the mesh to the view
+	float scale = (OVERDRAW_RESOLUTION - 1) / extent;
+	std::vector<float> depth(OVERDRAW_RESOLUTION * OVERDRAW_RESOLUTION);
+
+	for (unsigned int axis = 0; axis < 3; axis++)
+	{
+		for (int direction = -1; direction <= 1; direction += 2)
+		{
+			std::fill(depth.begin(), depth.end(), FLT_MAX);
+			unsigned int u = (axis + 1) % 3;
+			unsigned int v = (axis + 2) % 3;
+
+			for (unsigned int t = 0; t < triangleCount; t++)
+			{
+				const XMFLOAT3* positions[3] =
+				{
+					&mesh.vertices[mesh.indices[t * 3 + 0]].Position,
+					&mesh.vertices[mesh.indices[t * 3 + 1]].Position,
+					&mesh.vertices[mesh.indices[t * 3 + 2]].Position
+				};
+
+				// Back faces are culled just like on the GPU
+				XMVECTOR p0 = XMLoadFloat3(positions[0]);
+				XMVECTOR normal = XMVector3Cross(XMLoadFloat3(positions[1]) - p0, XMLoadFloat3(positions[2]) - p0);
+				XMFLOAT3 n;
+				XMStoreFloat3(&n, normal);
+				float facing = (&n.x)[axis] * direction;
+				if (facing >= 0.0f)
+					continue;
+
+				// Project along the axis, depth grows away from the viewer
+				XMFLOAT3 projected[3];
+				for (unsigned int k = 0; k < 3; k++)
+				{
+					const float* p = &positions[k]->x;
+					const float* m = &minimum.x;
+					projected[k] = XMFLOAT3(
+						(p[u] - m[u]) * scale,
+						(p[v] - m[v]) * scale,
+						p[axis] * direction);
+				}
+
+				RasterizeOverdraw(projected, depth, stats.pixelsShaded);
+			}
+
+			for (unsigned int i = 0; i < depth.size(); i++)
+			{
+				stats.pixelsCovered += depth[i] != FLT_MAX;
+			}
+		}
+	}
+
+	stats.overdraw = stats.pixelsCovered > 0 ? (float)stats.pixelsShaded / (float)stats.pixelsCovered : 0.0f;
+	return stats;
+}
+
+void MeshOptimizer::RasterizeOverdraw(const XMFLOAT3 p[3], std::vector<float>& depth, unsigned int& pixelsShaded)
+{
+	// Put the triangle in a consistent winding so every
+	// edge function is positive inside of it
+	XMFLOAT3 a = p[0];
+	XMFLOAT3 b = p[1];
+	XMFLOAT3 c = p[2];
+
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (area == 0.0f)
+		return;
+	if (area < 0.0f)
+	{
+		std::swap(b, c);
+		area = -area;
+	}
+
+	int minX = std::max(0, (int)std::min(a.x, std::min(b.x, c.x)));
+	int minY = std::max(0, (int)std::min(a.y, std::min(b.y, c.y)));
+	int maxX = std::min(OVERDRAW_RESOLUTION - 1, (int)std::max(a.x, std::max(b.x, c.x)));
+	int maxY = std::min(OVERDRAW_RESOLUTION - 1, (int)std::max(a.y, std::max(b.y, c.y)));
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		float py = y + 0.5f;
+		for (int x = minX; x <= maxX; x++)
+		{
+			float px = x + 0.5f;
+
+			float w0 = (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x);
+			float w1 = (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x);
+			float w2 = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+
+			// Early depth test, only passing pixels are shaded
+			float z = (w0 * a.z + w1 * b.z + w2 * c.z) / area;
+			float& stored = depth[y * OVERDRAW_RESOLUTION + x];
+			if (z < stored)
+			{
+				stored = z;
+				pixelsShaded++;
+			}
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+
+#include "MeshData.h"
+
+/*
+	Passes run over mesh data on the CPU before it is turned
+	into GPU buffers
+*/
+
+// Size of the post transform cache the passes optimize for
+#define VERTEX_CACHE_SIZE 16
+
+// How much worse the cache may get to reduce overdraw
+#define OVERDRAW_CACHE_THRESHOLD 1.05f
+
+// Width and height of the views used to measure overdraw
+#define OVERDRAW_RESOLUTION 256
+
+struct VertexCacheStats
+{
+	float acmr;	// Vertices transformed per triangle (0.5 is best, 3 is worst)
+	float atvr;	// Vertices transformed per unique vertex (1 is best)
+};
+
+struct OverdrawStats
+{
+	unsigned int pixelsCovered;
+	unsigned int pixelsShaded;
+	float overdraw;	// Times each covered pixel is shaded (1 is best)
+};
+
+class MeshOptimizer
+{
+public:
+	/// <summary>
+	/// Merge vertices that have the exact same position, normal
+	/// and uv so the vertex buffer only holds unique vertices and
+	/// the index buffer shares them between triangles. Tangents
+	/// are ignored since they are calculated afterwards
+	/// </summary>
+	static void WeldVertices(MeshData& mesh);
+
+	/// <summary>
+	/// Run the cache, overdraw and fetch passes one after another
+	/// </summary>
+	static void Optimize(MeshData& mesh);
+	/// <summary>
+	/// Reorder triangles so vertices are reused while they are still
+	/// in the post transform cache (Tipsify). Optionally outputs the
+	/// first triangle of every run that starts with a cold cache
+	/// </summary>
+	static void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, std::vector<unsigned int>* clusters = nullptr);
+	/// <summary>
+	/// Reorder clusters of triangles so the ones facing out of the mesh
+	/// are drawn first and hide the rest from any view. Clusters are
+	/// split further while their cache use stays within the threshold
+	/// </summary>
+	static void OptimizeOverdraw(MeshData& mesh, const std::vector<unsigned int>& clusters, float threshold = OVERDRAW_CACHE_THRESHOLD);
+	/// <summary>
+	/// Reorder vertices into the order triangles first use them
+	/// and drop any vertex that is never used
+	/// </summary>
+	static void OptimizeVertexFetch(MeshData& mesh);
+
+	/// <summary>
+	/// Simulate a FIFO post transform cache over the index buffer
+	/// </summary>
+	static VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+	/// <summary>
+	/// Rasterize the mesh from the six axis directions with a depth
+	/// test and count how often covered pixels pass it
+	/// </summary>
+	static OverdrawStats AnalyzeOverdraw(const MeshData& mesh);
+
+private:
+	static unsigned int HashVertex(const Vertex& v);
+	static bool SameVertex(const Vertex& a, const Vertex& b);
+
+	static int SkipDeadEnd(std::vector<unsigned int>& deadEnds, const std::vector<unsigned int>& live, unsigned int& cursor, unsigned int vertexCount);
+	static void RasterizeOverdraw(const DirectX::XMFLOAT3 p[3], std::vector<float>& depth, unsigned int& pixelsShaded);
+};
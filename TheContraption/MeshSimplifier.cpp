@@ -0,0 +1,433 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+using namespace DirectX;
+
+// Vertex that has no collapse lined up
+#define SIMPLIFY_NO_TARGET 0xffffffff
+
+void MeshSimplifier::GenerateLods(MeshData& mesh, unsigned int lodCount)
+{
+	mesh.lods.clear();
+	unsigned int fullCount = (unsigned int)mesh.indices.size();
+	mesh.lods.push_back({ 0, fullCount, 0.0f });
+	if (fullCount == 0)
+		return;
+
+	Positions positions;
+	GroupPositions(mesh, mesh.indices, positions);
+	ComputeQuadrics(mesh, mesh.indices, positions);
+
+	// Each level keeps simplifying the one before, so the quadrics carry
+	// the error all the way back to the full mesh
+	std::vector<unsigned int> indices = mesh.indices;
+	std::vector<std::vector<unsigned int>> levels;
+	float maxError = MESH_SIMPLIFY_MAX_ERROR * BoundsDiagonal(mesh);
+	float error = 0.0f;
+
+	for (unsigned int lod = 1; lod < lodCount; lod++)
+	{
+		unsigned int previousCount = (unsigned int)indices.size();
+		unsigned int target = (unsigned int)(previousCount / 3 * MESH_LOD_RATIO) * 3;
+		error = std::max(error, Collapse(mesh, indices, positions, target, maxError));
+
+		if (indices.empty() || indices.size() > previousCount * MESH_LOD_MIN_REDUCTION)
+			break;
+
+		std::vector<unsigned int> level = indices;
+		MeshOptimizer::OptimizeVertexCache(level, (unsigned int)mesh.vertices.size());
+		mesh.lods.push_back({ 0, (unsigned int)level.size(), error });
+		levels.push_back(level);
+	}
+
+	for (unsigned int i = 0; i < levels.size(); i++)
+	{
+		mesh.lods[i + 1].indexOffset = (unsigned int)mesh.indices.size();
+		mesh.indices.insert(mesh.indices.end(), levels[i].begin(), levels[i].end());
+	}
+}
+
+float MeshSimplifier::Simplify(const MeshData& mesh, unsigned int targetIndexCount, float maxError, std::vector<unsigned int>& out)
+{
+	out = mesh.indices;
+
+	Positions positions;
+	GroupPositions(mesh, out, positions);
+	ComputeQuadrics(mesh, out, positions);
+
+	return Collapse(mesh, out, positions, targetIndexCount, maxError);
+}
+
+void MeshSimplifier::GroupPositions(const MeshData& mesh, const std::vector<unsigned int>& indices, Positions& positions)
+{
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	const std::vector<Vertex>& vertices = mesh.vertices;
+
+	// Sorting puts vertices with the exact same position next to each other
+	positions.vertices.resize(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		positions.vertices[v] = v;
+	}
+	std::sort(positions.vertices.begin(), positions.vertices.end(), [&](unsigned int a, unsigned int b)
+	{
+		int order = std::memcmp(&vertices[a].Position, &vertices[b].Position, sizeof(XMFLOAT3));
+		return order < 0 || (order == 0 && a < b);
+	});
+
+	positions.ofVertex.resize(vertexCount);
+	positions.vertexStart.clear();
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		unsigned int v = positions.vertices[i];
+		if (i == 0 || std::memcmp(&vertices[positions.vertices[i - 1]].Position, &vertices[v].Position, sizeof(XMFLOAT3)) != 0)
+			positions.vertexStart.push_back(i);
+		positions.ofVertex[v] = (unsigned int)positions.vertexStart.size() - 1;
+	}
+	unsigned int positionCount = (unsigned int)positions.vertexStart.size();
+	positions.vertexStart.push_back(vertexCount);
+
+	// An edge between two positions that is only walked in one direction
+	// belongs to a single triangle, so it is on the border of the mesh
+	std::vector<unsigned long long> edges;
+	edges.reserve(indices.size());
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		unsigned int a = positions.ofVertex[indices[i]];
+		unsigned int b = positions.ofVertex[indices[i - i % 3 + (i + 1) % 3]];
+		edges.push_back((unsigned long long)a << 32 | b);
+	}
+	std::sort(edges.begin(), edges.end());
+
+	positions.locked.assign(positionCount, false);
+	for (unsigned int i = 0; i < edges.size(); i++)
+	{
+		unsigned int a = (unsigned int)(edges[i] >> 32);
+		unsigned int b = (unsigned int)edges[i];
+		unsigned long long reverse = (unsigned long long)b << 32 | a;
+		if (!std::binary_search(edges.begin(), edges.end(), reverse))
+		{
+			positions.locked[a] = true;
+			positions.locked[b] = true;
+		}
+	}
+}
+
+void MeshSimplifier::ComputeQuadrics(const MeshData& mesh, const std::vector<unsigned int>& indices, Positions& positions)
+{
+	positions.quadrics.assign(positions.locked.size(), Quadric());
+
+	for (unsigned int i = 0; i < indices.size(); i += 3)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&mesh.vertices[indices[i + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&mesh.vertices[indices[i + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&mesh.vertices[indices[i + 2]].Position);
+
+		XMVECTOR cross = XMVector3Cross(p1 - p0, p2 - p0);
+		float area = XMVectorGetX(XMVector3Length(cross));
+		if (area <= 0.0f)
+			continue;
+
+		// Plane ax + by + cz + d = 0 weighted by the triangle's area
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, cross / area);
+		float d = -XMVectorGetX(XMVector3Dot(cross / area, p0));
+
+		Quadric plane;
+		plane.xx = n.x * n.x * area;
+		plane.yy = n.y * n.y * area;
+		plane.zz = n.z * n.z * area;
+		plane.xy = n.x * n.y * area;
+		plane.xz = n.x * n.z * area;
+		plane.yz = n.y * n.z * area;
+		plane.xw = n.x * d * area;
+		plane.yw = n.y * d * area;
+		plane.zw = n.z * d * area;
+		plane.ww = d * d * area;
+		plane.weight = area;
+
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			AddQuadric(positions.quadrics[positions.ofVertex[indices[i + k]]], plane);
+		}
+	}
+}
+
+void MeshSimplifier::BuildAdjacency(const std::vector<unsigned int>& indices, unsigned int vertexCount, Adjacency& adjacency)
+{
+	adjacency.triangleStart.assign(vertexCount + 1, 0);
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		adjacency.triangleStart[indices[i] + 1]++;
+	}
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		adjacency.triangleStart[v + 1] += adjacency.triangleStart[v];
+	}
+
+	adjacency.triangles.resize(indices.size());
+	std::vector<unsigned int> fill(adjacency.triangleStart.begin(), adjacency.triangleStart.end() - 1);
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		adjacency.triangles[fill[indices[i]]++] = i / 3;
+	}
+}
+
+float MeshSimplifier::Collapse(const MeshData& mesh, std::vector<unsigned int>& indices, Positions& positions,
+	unsigned int targetIndexCount, float maxError)
+{
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	unsigned int positionCount = (unsigned int)positions.locked.size();
+	float maxErrorSq = maxError * maxError;
+	float errorSq = 0.0f;
+
+	Adjacency adjacency;
+	std::vector<unsigned int> target(positionCount);
+	std::vector<float> cost(positionCount);
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> neighbours;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<bool> touched(positionCount);
+
+	// Every pass lines up the cheapest collapse of each position and then
+	// makes as many as it can without two of them touching the same
+	// triangles, which keeps the checks of each collapse valid
+	while (indices.size() > targetIndexCount)
+	{
+		BuildAdjacency(indices, vertexCount, adjacency);
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			remap[v] = v;
+		}
+
+		// Cheapest position each unlocked position can move onto
+		candidates.clear();
+		for (unsigned int p = 0; p < positionCount; p++)
+		{
+			target[p] = SIMPLIFY_NO_TARGET;
+			cost[p] = FLT_MAX;
+			if (positions.locked[p])
+				continue;
+
+			neighbours.clear();
+			for (unsigned int w = positions.vertexStart[p]; w < positions.vertexStart[p + 1]; w++)
+			{
+				unsigned int v = positions.vertices[w];
+				for (unsigned int a = adjacency.triangleStart[v]; a < adjacency.triangleStart[v + 1]; a++)
+				{
+					for (unsigned int k = 0; k < 3; k++)
+					{
+						unsigned int q = positions.ofVertex[indices[adjacency.triangles[a] * 3 + k]];
+						if (q != p && std::find(neighbours.begin(), neighbours.end(), q) == neighbours.end())
+							neighbours.push_back(q);
+					}
+				}
+			}
+
+			for (unsigned int n = 0; n < neighbours.size(); n++)
+			{
+				unsigned int q = neighbours[n];
+				Quadric sum = positions.quadrics[p];
+				AddQuadric(sum, positions.quadrics[q]);
+				const XMFLOAT3& destination = mesh.vertices[positions.vertices[positions.vertexStart[q]]].Position;
+				float c = sum.weight > 0.0f ? EvaluateQuadric(sum, destination) / sum.weight : 0.0f;
+				if (c < cost[p] && MatchVertices(indices, positions, adjacency, p, q, nullptr))
+				{
+					cost[p] = c;
+					target[p] = q;
+				}
+			}
+
+			if (target[p] != SIMPLIFY_NO_TARGET && cost[p] <= maxErrorSq)
+				candidates.push_back(p);
+		}
+		std::sort(candidates.begin(), candidates.end(), [&](unsigned int a, unsigned int b) { return cost[a] < cost[b]; });
+
+		std::fill(touched.begin(), touched.end(), false);
+		unsigned int trianglesToRemove = ((unsigned int)indices.size() - targetIndexCount) / 3;
+		unsigned int trianglesRemoved = 0;
+		unsigned int collapses = 0;
+
+		for (unsigned int c = 0; c < candidates.size() && trianglesRemoved < trianglesToRemove; c++)
+		{
+			unsigned int from = candidates[c];
+			unsigned int to = target[from];
+			if (touched[from] || touched[to] || FlipsTriangles(mesh, indices, positions, adjacency, from, to))
+				continue;
+
+			for (unsigned int w = positions.vertexStart[from]; w < positions.vertexStart[from + 1]; w++)
+			{
+				unsigned int v = positions.vertices[w];
+				for (unsigned int a = adjacency.triangleStart[v]; a < adjacency.triangleStart[v + 1]; a++)
+				{
+					const unsigned int* triangle = &indices[adjacency.triangles[a] * 3];
+					bool shared = false;
+					for (unsigned int k = 0; k < 3; k++)
+					{
+						shared = shared || positions.ofVertex[triangle[k]] == to;
+						touched[positions.ofVertex[triangle[k]]] = true;
+					}
+					trianglesRemoved += shared ? 1 : 0;
+				}
+			}
+
+			MatchVertices(indices, positions, adjacency, from, to, &remap);
+			AddQuadric(positions.quadrics[to], positions.quadrics[from]);
+			errorSq = std::max(errorSq, cost[from]);
+			collapses++;
+		}
+
+		if (collapses == 0)
+			break;
+
+		// Triangles that lost a corner to a collapse are gone
+		unsigned int write = 0;
+		for (unsigned int i = 0; i < indices.size(); i += 3)
+		{
+			unsigned int a = remap[indices[i + 0]];
+			unsigned int b = remap[indices[i + 1]];
+			unsigned int c = remap[indices[i + 2]];
+			unsigned int pa = positions.ofVertex[a];
+			unsigned int pb = positions.ofVertex[b];
+			unsigned int pc = positions.ofVertex[c];
+			if (pa == pb || pb == pc || pc == pa)
+				continue;
+
+			indices[write++] = a;
+			indices[write++] = b;
+			indices[write++] = c;
+		}
+		indices.resize(write);
+	}
+
+	return std::sqrt(errorSq);
+}
+
+bool MeshSimplifier::MatchVertices(const std::vector<unsigned int>& indices, const Positions& positions, const Adjacency& adjacency,
+	unsigned int from, unsigned int to, std::vector<unsigned int>* remap)
+{
+	// Every vertex at the position has to reach exactly one vertex at the
+	// destination, otherwise the collapse would tear a seam open. The
+	// first pass only checks, the second writes the remap once the whole
+	// position is known to match
+	for (unsigned int pass = 0; pass < (remap ? 2u : 1u); pass++)
+	{
+		for (unsigned int w = positions.vertexStart[from]; w < positions.vertexStart[from + 1]; w++)
+		{
+			unsigned int v = positions.vertices[w];
+
+			// Vertices the current indices no longer use can stay put
+			if (adjacency.triangleStart[v] == adjacency.triangleStart[v + 1])
+				continue;
+
+			unsigned int match = SIMPLIFY_NO_TARGET;
+			for (unsigned int a = adjacency.triangleStart[v]; a < adjacency.triangleStart[v + 1]; a++)
+			{
+				for (unsigned int k = 0; k < 3; k++)
+				{
+					unsigned int corner = indices[adjacency.triangles[a] * 3 + k];
+					if (positions.ofVertex[corner] != to)
+						continue;
+					if (match != SIMPLIFY_NO_TARGET && match != corner)
+						return false;
+					match = corner;
+				}
+			}
+
+			if (match == SIMPLIFY_NO_TARGET)
+				return false;
+			if (pass == 1)
+				(*remap)[v] = match;
+		}
+	}
+
+	return true;
+}
+
+bool MeshSimplifier::FlipsTriangles(const MeshData& mesh, const std::vector<unsigned int>& indices, const Positions& positions,
+	const Adjacency& adjacency, unsigned int from, unsigned int to)
+{
+	XMVECTOR moved = XMLoadFloat3(&mesh.vertices[positions.vertices[positions.vertexStart[to]]].Position);
+
+	for (unsigned int w = positions.vertexStart[from]; w < positions.vertexStart[from + 1]; w++)
+	{
+		unsigned int v = positions.vertices[w];
+		for (unsigned int a = adjacency.triangleStart[v]; a < adjacency.triangleStart[v + 1]; a++)
+		{
+			const unsigned int* triangle = &indices[adjacency.triangles[a] * 3];
+
+			XMVECTOR before[3];
+			XMVECTOR after[3];
+			bool disappears = false;
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				unsigned int p = positions.ofVertex[triangle[k]];
+				disappears = disappears || p == to;
+				before[k] = XMLoadFloat3(&mesh.vertices[triangle[k]].Position);
+				after[k] = p == from ? moved : before[k];
+			}
+			if (disappears)
+				continue;
+
+			XMVECTOR oldNormal = XMVector3Cross(before[1] - before[0], before[2] - before[0]);
+			XMVECTOR newNormal = XMVector3Cross(after[1] - after[0], after[2] - after[0]);
+			float oldLength = XMVectorGetX(XMVector3Length(oldNormal));
+			float newLength = XMVectorGetX(XMVector3Length(newNormal));
+			if (newLength <= 0.0f)
+				return true;
+
+			float cosine = XMVectorGetX(XMVector3Dot(oldNormal, newNormal));
+			if (cosine < MESH_SIMPLIFY_MIN_NORMAL_DOT * oldLength * newLength)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+void MeshSimplifier::AddQuadric(Quadric& q, const Quadric& other)
+{
+	q.xx += other.xx;
+	q.yy += other.yy;
+	q.zz += other.zz;
+	q.xy += other.xy;
+	q.xz += other.xz;
+	q.yz += other.yz;
+	q.xw += other.xw;
+	q.yw += other.yw;
+	q.zw += other.zw;
+	q.ww += other.ww;
+	q.weight += other.weight;
+}
+
+float MeshSimplifier::EvaluateQuadric(const Quadric& q, const XMFLOAT3& p)
+{
+	// p^T A p + 2 b^T p + c with the symmetric terms written out
+	float result =
+		q.xx * p.x * p.x + q.yy * p.y * p.y + q.zz * p.z * p.z +
+		2.0f * (q.xy * p.x * p.y + q.xz * p.x * p.z + q.yz * p.y * p.z) +
+		2.0f * (q.xw * p.x + q.yw * p.y + q.zw * p.z) +
+		q.ww;
+
+	// Rounding can push a perfect fit slightly below zero
+	return std::max(result, 0.0f);
+}
+
+float MeshSimplifier::BoundsDiagonal(const MeshData& mesh)
+{
+	if (mesh.vertices.empty())
+		return 0.0f;
+
+	XMVECTOR minBounds = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxBounds = XMVectorReplicate(-FLT_MAX);
+	for (unsigned int i = 0; i < mesh.vertices.size(); i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&mesh.vertices[i].Position);
+		minBounds = XMVectorMin(minBounds, p);
+		maxBounds = XMVectorMax(maxBounds, p);
+	}
+	return XMVectorGetX(XMVector3Length(maxBounds - minBounds));
+}
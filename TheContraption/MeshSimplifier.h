@@ -0,0 +1,93 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+
+#include "MeshData.h"
+
+/*
+	Builds simpler versions of a mesh by collapsing edges in the
+	order of their quadric error (Garland and Heckbert). Only the
+	index buffer changes, every LOD draws from the same vertices.
+
+	Collapses work on positions rather than vertices. A position
+	split into several vertices by a uv or normal seam can only
+	move along the seam, with every one of its vertices following
+	an edge to the same position. Border positions never move, so
+	holes and the texture layout keep their shape
+*/
+
+// LOD 0 plus this many simplified levels at most
+#define MESH_LOD_COUNT 4
+
+// Each LOD aims for this fraction of the triangles of the one before
+#define MESH_LOD_RATIO 0.5f
+
+// LODs that can't get below this fraction of the one before are dropped
+#define MESH_LOD_MIN_REDUCTION 0.85f
+
+// Collapses that move the surface further than this fraction of the
+// bounding box diagonal are never made
+#define MESH_SIMPLIFY_MAX_ERROR 0.05f
+
+// Collapses that turn a triangle's normal further than this (cosine) are rejected
+#define MESH_SIMPLIFY_MIN_NORMAL_DOT 0.25f
+
+class MeshSimplifier
+{
+public:
+	/// <summary>
+	/// Simplify the mesh into a chain of LODs that are appended to the
+	/// index buffer. The current indices become LOD 0 and keep their
+	/// place, so this has to run after anything that reorders them
+	/// </summary>
+	static void GenerateLods(MeshData& mesh, unsigned int lodCount = MESH_LOD_COUNT);
+
+	/// <summary>
+	/// Collapse edges until the indices are down to the target count or
+	/// nothing can be collapsed without going over the error limit
+	/// </summary>
+	/// <param name="maxError">Limit in mesh units</param>
+	/// <returns>The largest error of any collapse in mesh units</returns>
+	static float Simplify(const MeshData& mesh, unsigned int targetIndexCount, float maxError, std::vector<unsigned int>& out);
+
+private:
+	// Sum of squared distances to a set of planes, weighted by area
+	struct Quadric
+	{
+		float xx, yy, zz, xy, xz, yz;
+		float xw, yw, zw, ww;
+		float weight;
+	};
+
+	// Vertices grouped by position, shared by every pass
+	struct Positions
+	{
+		std::vector<unsigned int> ofVertex;		// Position of each vertex
+		std::vector<unsigned int> vertexStart;	// Vertices of each position, one after another
+		std::vector<unsigned int> vertices;
+		std::vector<bool> locked;				// On a border of the mesh
+		std::vector<Quadric> quadrics;
+	};
+
+	// Triangles around each vertex of the current indices
+	struct Adjacency
+	{
+		std::vector<unsigned int> triangleStart;
+		std::vector<unsigned int> triangles;
+	};
+
+	static void GroupPositions(const MeshData& mesh, const std::vector<unsigned int>& indices, Positions& positions);
+	static void ComputeQuadrics(const MeshData& mesh, const std::vector<unsigned int>& indices, Positions& positions);
+	static void BuildAdjacency(const std::vector<unsigned int>& indices, unsigned int vertexCount, Adjacency& adjacency);
+
+	static float Collapse(const MeshData& mesh, std::vector<unsigned int>& indices, Positions& positions,
+		unsigned int targetIndexCount, float maxError);
+	static bool MatchVertices(const std::vector<unsigned int>& indices, const Positions& positions, const Adjacency& adjacency,
+		unsigned int from, unsigned int to, std::vector<unsigned int>* remap);
+	static bool FlipsTriangles(const MeshData& mesh, const std::vector<unsigned int>& indices, const Positions& positions,
+		const Adjacency& adjacency, unsigned int from, unsigned int to);
+
+	static void AddQuadric(Quadric& q, const Quadric& other);
+	static float EvaluateQuadric(const Quadric& q, const DirectX::XMFLOAT3& p);
+	static float BoundsDiagonal(const MeshData& mesh);
+};
@@ -0,0 +1,285 @@
+#include "Meshlets.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+using namespace DirectX;
+
+// Vertex that is not part of the meshlet being built
+#define MESHLET_NO_VERTEX 0xffffffff
+
+void Meshlets::Build(MeshData& mesh)
+{
+	mesh.meshlets.clear();
+	unsigned int triangleCount = (unsigned int)mesh.indices.size() / 3;
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	if (triangleCount == 0)
+		return;
+
+	// Triangles around each vertex, one vertex after another
+	std::vector<unsigned int> triangleStart(vertexCount + 1, 0);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+	{
+		triangleStart[mesh.indices[i] + 1]++;
+	}
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		triangleStart[v + 1] += triangleStart[v];
+	}
+
+	std::vector<unsigned int> adjacentTriangles(triangleCount * 3);
+	std::vector<unsigned int> fill(triangleStart.begin(), triangleStart.end() - 1);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+	{
+		adjacentTriangles[fill[mesh.indices[i]]++] = i / 3;
+	}
+
+	// Unit normals, zero for triangles without any area
+	std::vector<XMFLOAT3> faceNormals(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&mesh.vertices[mesh.indices[t * 3 + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&mesh.vertices[mesh.indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&mesh.vertices[mesh.indices[t * 3 + 2]].Position);
+		XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+		float length = XMVectorGetX(XMVector3Length(normal));
+		XMStoreFloat3(&faceNormals[t], length > 0.0f ? normal / length : XMVectorZero());
+	}
+
+	std::vector<unsigned int> reordered;
+	reordered.reserve(mesh.indices.size());
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> localVertex(vertexCount, MESHLET_NO_VERTEX);
+	std::vector<unsigned int> vertices;
+	std::vector<unsigned int> triangles;
+	vertices.reserve(MESHLET_MAX_VERTICES);
+	triangles.reserve(MESHLET_MAX_TRIANGLES);
+
+	XMVECTOR coneSum = XMVectorZero();
+	unsigned int scan = 0;
+
+	// Emit the meshlet being built and start an empty one
+	auto flush = [&]()
+	{
+		// Triangles go back to the order the cache optimizer left them in
+		std::sort(triangles.begin(), triangles.end());
+		mesh.meshlets.push_back(FinishMeshlet(mesh, vertices, triangles, faceNormals, (unsigned int)reordered.size()));
+		for (unsigned int t : triangles)
+		{
+			reordered.insert(reordered.end(), &mesh.indices[t * 3], &mesh.indices[t * 3] + 3);
+		}
+		for (unsigned int v : vertices)
+		{
+			localVertex[v] = MESHLET_NO_VERTEX;
+		}
+		vertices.clear();
+		triangles.clear();
+		coneSum = XMVectorZero();
+	};
+
+	while (true)
+	{
+		int best = -1;
+		if (triangles.empty())
+		{
+			// Seed each meshlet with the next triangle in cache order
+			while (scan < triangleCount && emitted[scan])
+				scan++;
+			if (scan == triangleCount)
+				break;
+			best = (int)scan;
+		}
+		else
+		{
+			// Grow towards triangles that share the most vertices with the
+			// meshlet and bend its cone the least. Neighbours of the last
+			// triangle are tried first, the whole border is only searched
+			// when none of them can be added without a new vertex
+			XMFLOAT3 coneAxis = XMFLOAT3(0, 0, 0);
+			if (XMVectorGetX(XMVector3LengthSq(coneSum)) > 0.0f)
+				XMStoreFloat3(&coneAxis, XMVector3Normalize(coneSum));
+			float bestScore = FLT_MAX;
+			unsigned int lastTriangle = triangles.back();
+
+			for (int pass = 0; pass < 2 && bestScore >= 1.0f; pass++)
+			{
+				unsigned int sourceCount = pass == 0 ? 3 : (unsigned int)vertices.size();
+				for (unsigned int s = 0; s < sourceCount; s++)
+				{
+					unsigned int source = pass == 0 ? mesh.indices[lastTriangle * 3 + s] : vertices[s];
+					for (unsigned int a = triangleStart[source]; a < triangleStart[source + 1]; a++)
+					{
+						unsigned int t = adjacentTriangles[a];
+						if (emitted[t])
+							continue;
+
+						unsigned int extra = 0;
+						for (unsigned int k = 0; k < 3; k++)
+						{
+							extra += localVertex[mesh.indices[t * 3 + k]] == MESHLET_NO_VERTEX ? 1 : 0;
+						}
+						if (vertices.size() + extra > MESHLET_MAX_VERTICES)
+							continue;
+
+						const XMFLOAT3& normal = faceNormals[t];
+						float spread = 1.0f - (coneAxis.x * normal.x + coneAxis.y * normal.y + coneAxis.z * normal.z);
+						float score = extra + spread * MESHLET_CONE_WEIGHT;
+						if (score < bestScore)
+						{
+							bestScore = score;
+							best = (int)t;
+						}
+					}
+				}
+			}
+		}
+
+		// Nothing around the meshlet fits anymore
+		if (best < 0)
+		{
+			flush();
+			continue;
+		}
+
+		emitted[best] = true;
+		triangles.push_back((unsigned int)best);
+		coneSum += XMLoadFloat3(&faceNormals[best]);
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			unsigned int v = mesh.indices[best * 3 + k];
+			if (localVertex[v] == MESHLET_NO_VERTEX)
+			{
+				localVertex[v] = (unsigned int)vertices.size();
+				vertices.push_back(v);
+			}
+		}
+
+		if (triangles.size() == MESHLET_MAX_TRIANGLES)
+		{
+			flush();
+		}
+	}
+
+	if (!triangles.empty())
+		flush();
+
+	mesh.indices.swap(reordered);
+}
+
+Meshlet Meshlets::FinishMeshlet(const MeshData& mesh, const std::vector<unsigned int>& vertices,
+	const std::vector<unsigned int>& triangles, const std::vector<XMFLOAT3>& faceNormals,
+	unsigned int indexOffset)
+{
+	Meshlet meshlet = {};
+	meshlet.indexOffset = indexOffset;
+	meshlet.triangleCount = (unsigned int)triangles.size();
+	meshlet.vertexCount = (unsigned int)vertices.size();
+
+	// Sphere around the center of the bounding box
+	XMVECTOR minBounds = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxBounds = XMVectorReplicate(-FLT_MAX);
+	for (unsigned int v : vertices)
+	{
+		XMVECTOR p = XMLoadFloat3(&mesh.vertices[v].Position);
+		minBounds = XMVectorMin(minBounds, p);
+		maxBounds = XMVectorMax(maxBounds, p);
+	}
+
+	XMVECTOR center = (minBounds + maxBounds) * 0.5f;
+	XMVECTOR radiusSq = XMVectorZero();
+	for (unsigned int v : vertices)
+	{
+		radiusSq = XMVectorMax(radiusSq, XMVector3LengthSq(XMLoadFloat3(&mesh.vertices[v].Position) - center));
+	}
+	XMStoreFloat3(&meshlet.center, center);
+	meshlet.radius = std::sqrt(XMVectorGetX(radiusSq));
+
+	// The cone has to hold every normal, degenerate triangles can't be seen anyway
+	XMVECTOR axis = XMVectorZero();
+	for (unsigned int t : triangles)
+	{
+		axis += XMLoadFloat3(&faceNormals[t]);
+	}
+
+	meshlet.coneCutoff = 1.0f;
+	if (XMVectorGetX(XMVector3LengthSq(axis)) <= 0.0f)
+		return meshlet;
+
+	axis = XMVector3Normalize(axis);
+	XMStoreFloat3(&meshlet.coneAxis, axis);
+
+	float minDot = 1.0f;
+	for (unsigned int t : triangles)
+	{
+		XMVECTOR normal = XMLoadFloat3(&faceNormals[t]);
+		if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f)
+			minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(axis, normal)));
+	}
+
+	if (minDot > MESHLET_MIN_CONE_DOT)
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+
+	return meshlet;
+}
+
+MeshletCullStats Meshlets::Cull(const Meshlet* meshlets, unsigned int meshletCount,
+	const XMFLOAT4X4& worldViewProjection, const XMFLOAT3& localCameraPosition,
+	std::vector<unsigned int>& visible)
+{
+	MeshletCullStats stats = {};
+	visible.clear();
+
+	// Clip planes in mesh space (Gribb and Hartmann), pointing inwards.
+	// With row vectors the planes come from the columns of the matrix
+	XMMATRIX columns = XMMatrixTranspose(XMLoadFloat4x4(&worldViewProjection));
+	XMVECTOR planes[6] =
+	{
+		columns.r[3] + columns.r[0],	// Left
+		columns.r[3] - columns.r[0],	// Right
+		columns.r[3] + columns.r[1],	// Bottom
+		columns.r[3] - columns.r[1],	// Top
+		columns.r[2],					// Near (0 to w in Direct3D)
+		columns.r[3] - columns.r[2],	// Far
+	};
+	for (unsigned int p = 0; p < 6; p++)
+	{
+		planes[p] = XMPlaneNormalize(planes[p]);
+	}
+
+	XMVECTOR camera = XMLoadFloat3(&localCameraPosition);
+
+	for (unsigned int m = 0; m < meshletCount; m++)
+	{
+		const Meshlet& meshlet = meshlets[m];
+		XMVECTOR center = XMLoadFloat3(&meshlet.center);
+		XMVECTOR negativeRadius = XMVectorReplicate(-meshlet.radius);
+
+		bool outside = false;
+		for (unsigned int p = 0; p < 6 && !outside; p++)
+		{
+			outside = XMVector4Less(XMPlaneDotCoord(planes[p], center), negativeRadius);
+		}
+		if (outside)
+		{
+			stats.meshletsFrustumCulled++;
+			continue;
+		}
+
+		// Every triangle faces away if the view direction to any point of
+		// the sphere stays inside the cone of normals
+		XMVECTOR view = center - camera;
+		float distance = XMVectorGetX(XMVector3Length(view));
+		float facing = XMVectorGetX(XMVector3Dot(view, XMLoadFloat3(&meshlet.coneAxis)));
+		if (facing >= meshlet.coneCutoff * distance + meshlet.radius)
+		{
+			stats.meshletsBackfaceCulled++;
+			continue;
+		}
+
+		visible.push_back(m);
+		stats.meshletsVisible++;
+		stats.trianglesVisible += meshlet.triangleCount;
+	}
+
+	return stats;
+}
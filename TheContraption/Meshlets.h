@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+
+#include "MeshData.h"
+
+/*
+	Splits a mesh into small clusters of triangles that can be
+	culled as a whole. Every meshlet keeps a bounding sphere for
+	frustum culling and a cone that holds all of its triangle
+	normals, so clusters facing away from the camera can be
+	dropped before anything is submitted
+*/
+
+// Limits of a single meshlet
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// How much a candidate triangle is penalized for bending the cone
+// compared to adding one more vertex to the meshlet
+#define MESHLET_CONE_WEIGHT 0.5f
+
+// Cones whose normals spread wider than this (dot with the axis)
+// can face the camera from anywhere and are never cone culled
+#define MESHLET_MIN_CONE_DOT 0.1f
+
+struct MeshletCullStats
+{
+	unsigned int meshletsVisible;
+	unsigned int meshletsFrustumCulled;
+	unsigned int meshletsBackfaceCulled;
+	unsigned int trianglesVisible;
+};
+
+class Meshlets
+{
+public:
+	/// <summary>
+	/// Group the triangles into meshlets. The index buffer is reordered
+	/// so every meshlet is one contiguous range of it, while triangles
+	/// inside a meshlet keep their vertex cache friendly order
+	/// </summary>
+	static void Build(MeshData& mesh);
+
+	/// <summary>
+	/// Find the meshlets that can be seen by a camera
+	/// </summary>
+	/// <param name="worldViewProjection">Takes the meshlets' local space to clip space</param>
+	/// <param name="localCameraPosition">The camera's position in the meshlets' local space</param>
+	/// <param name="visible">Receives the index of every meshlet that survived</param>
+	static MeshletCullStats Cull(const Meshlet* meshlets, unsigned int meshletCount,
+		const DirectX::XMFLOAT4X4& worldViewProjection, const DirectX::XMFLOAT3& localCameraPosition,
+		std::vector<unsigned int>& visible);
+
+private:
+	static Meshlet FinishMeshlet(const MeshData& mesh, const std::vector<unsigned int>& vertices,
+		const std::vector<unsigned int>& triangles, const std::vector<DirectX::XMFLOAT3>& faceNormals,
+		unsigned int indexOffset);
+};
@@ -0,0 +1,185 @@
+#include "MorphAnimator.h"
+#include "ThreadPool.h"
+#include <chrono>
+using namespace DirectX;
+
+MorphAnimator::MorphAnimator(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) :
+	device(device),
+	context(context),
+	morphedVertexCount(0),
+	uploadedVertexCount(0),
+	lastMorphTime(0.0f),
+	lastUploadTime(0.0f)
+{
+}
+
+MorphAnimator::~MorphAnimator()
+{
+
+}
+
+unsigned int MorphAnimator::AddInstance(std::shared_ptr<MorphedMeshData> model)
+{
+	if (!model || model->geometry.vertices.empty())
+		return MORPH_NONE;
+
+	instances.push_back(Instance());
+	Instance& instance = instances.back();
+	instance.model = model;
+	instance.weights.assign(model->targets.size(), 0.0f);
+	instance.appliedWeights.assign(model->targets.size(), 0.0f);
+	instance.morphed = model->geometry.vertices;
+	instance.uploadBegin = 0;
+	instance.uploadEnd = 0;
+	instance.morphedCount = 0;
+
+	// Uploaded as it is, meshlets and LODs would stop matching once it deforms
+	MeshData baseGeometry;
+	baseGeometry.vertices = model->geometry.vertices;
+	baseGeometry.indices = model->geometry.indices;
+	instance.mesh = std::make_shared<Mesh>(device, context, baseGeometry, false, false);
+	return (unsigned int)instances.size() - 1;
+}
+
+std::shared_ptr<Mesh> MorphAnimator::GetMesh(unsigned int instance)
+{
+	return instance < instances.size() ? instances[instance].mesh : nullptr;
+}
+
+unsigned int MorphAnimator::FindTarget(unsigned int instance, const std::string& name)
+{
+	if (instance >= instances.size())
+		return MORPH_NONE;
+
+	const std::vector<MorphTarget>& targets = instances[instance].model->targets;
+	for (unsigned int t = 0; t < targets.size(); t++)
+	{
+		if (targets[t].name == name)
+			return t;
+	}
+	return MORPH_NONE;
+}
+
+void MorphAnimator::SetWeight(unsigned int instance, unsigned int target, float weight)
+{
+	if (instance >= instances.size() || target >= instances[instance].weights.size())
+		return;
+
+	// Tiny weights are stored as exactly 0, so a target that
+	// settles there stops counting as a change
+	bool active = weight > MORPH_MIN_WEIGHT || weight < -MORPH_MIN_WEIGHT;
+	instances[instance].weights[target] = active ? weight : 0.0f;
+}
+
+float MorphAnimator::GetWeight(unsigned int instance, unsigned int target)
+{
+	if (instance >= instances.size() || target >= instances[instance].weights.size())
+		return 0.0f;
+
+	return instances[instance].weights[target];
+}
+
+void MorphAnimator::UpdateMorphs()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Instances only touch their own vertices, so they can be split between
+	// threads. With too few of them to go around, each one's vertices are split
+	if (instances.size() < MORPH_MIN_BATCH_SIZE * 2)
+	{
+		for (unsigned int i = 0; i < instances.size(); i++)
+		{
+			MorphInstance(instances[i], true);
+		}
+	}
+	else
+	{
+		ThreadPool::GetInstance().ParallelFor((unsigned int)instances.size(), MORPH_MIN_BATCH_SIZE, [&](unsigned int first, unsigned int last)
+		{
+			for (unsigned int i = first; i < last; i++)
+			{
+				MorphInstance(instances[i], false);
+			}
+		});
+	}
+
+	auto morphed = std::chrono::high_resolution_clock::now();
+
+	// The device context can only be used from one thread
+	morphedVertexCount = 0;
+	uploadedVertexCount = 0;
+	for (unsigned int i = 0; i < instances.size(); i++)
+	{
+		Instance& instance = instances[i];
+		morphedVertexCount += instance.morphedCount;
+		if (instance.uploadEnd <= instance.uploadBegin)
+			continue;
+
+		instance.mesh->UpdateVertexRange(&instance.morphed[0], instance.uploadBegin, instance.uploadEnd - instance.uploadBegin);
+		uploadedVertexCount += instance.uploadEnd - instance.uploadBegin;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	lastMorphTime = std::chrono::duration<float, std::milli>(morphed - start).count();
+	lastUploadTime = std::chrono::duration<float, std::milli>(end - morphed).count();
+}
+
+unsigned int MorphAnimator::GetInstanceCount()
+{
+	return (unsigned int)instances.size();
+}
+
+unsigned int MorphAnimator::GetMorphedVertexCount()
+{
+	return morphedVertexCount;
+}
+
+unsigned int MorphAnimator::GetUploadedVertexCount()
+{
+	return uploadedVertexCount;
+}
+
+float MorphAnimator::GetLastMorphTime()
+{
+	return lastMorphTime;
+}
+
+float MorphAnimator::GetLastUploadTime()
+{
+	return lastUploadTime;
+}
+
+void MorphAnimator::MorphInstance(Instance& instance, bool splitVertices)
+{
+	instance.uploadBegin = 0;
+	instance.uploadEnd = 0;
+	instance.morphedCount = 0;
+
+	// Nothing to do for instances that are holding still
+	if (instance.weights.empty() || instance.weights == instance.appliedWeights)
+		return;
+
+	const std::vector<MorphTarget>& targets = instance.model->targets;
+	unsigned int targetCount = (unsigned int)targets.size();
+	const Vertex* base = &instance.model->geometry.vertices[0];
+	if (Morphing::AffectedRange(&targets[0], targetCount, &instance.weights[0], &instance.appliedWeights[0], instance.uploadBegin, instance.uploadEnd))
+	{
+		if (splitVertices)
+			Morphing::Apply(base, &targets[0], targetCount, &instance.weights[0], &instance.appliedWeights[0], &instance.morphed[0]);
+		else
+			Morphing::ApplyRange(base, &targets[0], targetCount, &instance.weights[0], &instance.appliedWeights[0],
+				instance.uploadBegin, instance.uploadEnd, &instance.morphed[0]);
+	}
+	else
+	{
+		instance.uploadBegin = 0;
+		instance.uploadEnd = 0;
+	}
+	instance.appliedWeights = instance.weights;
+
+	for (unsigned int t = 0; t < targetCount; t++)
+	{
+		if (instance.weights[t] != 0.0f)
+			instance.morphedCount += (unsigned int)targets[t].vertices.size();
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "Morphing.h"
+
+/*
+	Keeps the weights of morphed meshes and deforms them on the CPU.
+	Instances whose weights didn't change since the last update are
+	skipped, the rest are morphed on several threads at once and only
+	the range of vertices their targets cover is uploaded, so a small
+	dent in a large panel costs as much as the dent
+*/
+
+// Instances morphed on one thread, below it
+// handing work to other threads costs more than it saves
+#define MORPH_MIN_BATCH_SIZE 4
+
+// Instance or target id that never refers to one
+#define MORPH_NONE 0xffffffff
+
+/// <summary>
+/// Base shape and targets of a morphed mesh, shared by every instance that uses it
+/// </summary>
+struct MorphedMeshData
+{
+	MeshData geometry;
+	std::vector<MorphTarget> targets;
+};
+
+class MorphAnimator
+{
+public:
+	MorphAnimator(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	~MorphAnimator();
+
+	/// <summary>
+	/// Make an instance with its own mesh to deform, starting in the base shape
+	/// </summary>
+	/// <returns>Id of the instance</returns>
+	unsigned int AddInstance(std::shared_ptr<MorphedMeshData> model);
+	/// <summary>
+	/// The mesh an instance is deformed into, for an Entity to draw
+	/// </summary>
+	std::shared_ptr<Mesh> GetMesh(unsigned int instance);
+	/// <summary>
+	/// Index of an instance's target by name
+	/// </summary>
+	/// <returns>MORPH_NONE if it has no target with that name</returns>
+	unsigned int FindTarget(unsigned int instance, const std::string& name);
+
+	/// <summary>
+	/// How far an instance blends towards one of its targets, applied on
+	/// the next update. Usually 0 to 1, but any weight can be used
+	/// </summary>
+	void SetWeight(unsigned int instance, unsigned int target, float weight);
+	float GetWeight(unsigned int instance, unsigned int target);
+
+	/// <summary>
+	/// Morph every instance whose weights changed, then upload what moved
+	/// </summary>
+	void UpdateMorphs();
+
+	unsigned int GetInstanceCount();
+	/// <summary>
+	/// Target vertices applied by the last update
+	/// </summary>
+	unsigned int GetMorphedVertexCount();
+	/// <summary>
+	/// Vertices uploaded by the last update
+	/// </summary>
+	unsigned int GetUploadedVertexCount();
+	/// <summary>
+	/// How long morphing took in the last update, in milliseconds
+	/// </summary>
+	float GetLastMorphTime();
+	/// <summary>
+	/// How long uploading the morphed vertices took in the last update, in milliseconds
+	/// </summary>
+	float GetLastUploadTime();
+
+private:
+	struct Instance
+	{
+		std::shared_ptr<MorphedMeshData> model;
+		std::shared_ptr<Mesh> mesh;
+
+		std::vector<float> weights;
+		std::vector<float> appliedWeights;	// What the vertices were last morphed with
+		std::vector<Vertex> morphed;
+
+		// Set by the last update
+		unsigned int uploadBegin;
+		unsigned int uploadEnd;
+		unsigned int morphedCount;
+	};
+
+	/// <summary>
+	/// Morph an instance if its weights changed
+	/// </summary>
+	/// <param name="splitVertices">Whether to split its vertices between threads, when not already on a worker</param>
+	static void MorphInstance(Instance& instance, bool splitVertices);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	std::vector<Instance> instances;
+
+	unsigned int morphedVertexCount;
+	unsigned int uploadedVertexCount;
+	float lastMorphTime;
+	float lastUploadTime;
+};
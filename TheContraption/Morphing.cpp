@@ -0,0 +1,140 @@
+#include "Morphing.h"
+#include "ThreadPool.h"
+#include <algorithm>
+using namespace DirectX;
+
+/// <summary>
+/// Whether a weight moves its target at all
+/// </summary>
+static inline bool IsActive(float weight)
+{
+	return weight > MORPH_MIN_WEIGHT || weight < -MORPH_MIN_WEIGHT;
+}
+
+MorphTarget Morphing::CreateTarget(const std::string& name, const Vertex* base, const Vertex* shaped, unsigned int vertexCount, float threshold)
+{
+	MorphTarget target;
+	target.name = name;
+
+	XMVECTOR thresholdSq = XMVectorReplicate(threshold * threshold);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		XMVECTOR position = XMLoadFloat3(&shaped[v].Position) - XMLoadFloat3(&base[v].Position);
+		XMVECTOR normal = XMLoadFloat3(&shaped[v].Normal) - XMLoadFloat3(&base[v].Normal);
+		XMVECTOR tangent = XMVectorSetW(XMLoadFloat4(&shaped[v].Tangent) - XMLoadFloat4(&base[v].Tangent), 0.0f);
+
+		XMVECTOR longest = XMVectorMax(XMVector3LengthSq(position), XMVectorMax(XMVector3LengthSq(normal), XMVector3LengthSq(tangent)));
+		if (XMVector3LessOrEqual(longest, thresholdSq))
+			continue;
+
+		XMFLOAT3 delta;
+		target.vertices.push_back(v);
+		XMStoreFloat3(&delta, position);
+		target.positionDeltas.push_back(delta);
+		XMStoreFloat3(&delta, normal);
+		target.normalDeltas.push_back(delta);
+		XMStoreFloat3(&delta, tangent);
+		target.tangentDeltas.push_back(delta);
+	}
+	return target;
+}
+
+bool Morphing::AffectedRange(const MorphTarget* targets, unsigned int targetCount, const float* weights, const float* previousWeights,
+	unsigned int& begin, unsigned int& end)
+{
+	begin = 0xffffffff;
+	end = 0;
+	for (unsigned int t = 0; t < targetCount; t++)
+	{
+		const MorphTarget& target = targets[t];
+		if (target.vertices.empty() || (!IsActive(weights[t]) && !IsActive(previousWeights[t])))
+			continue;
+
+		begin = std::min(begin, target.vertices.front());
+		end = std::max(end, target.vertices.back() + 1);
+	}
+	return begin < end;
+}
+
+void Morphing::Apply(const Vertex* base, const MorphTarget* targets, unsigned int targetCount, const float* weights, const float* previousWeights, Vertex* out)
+{
+	unsigned int begin, end;
+	if (!AffectedRange(targets, targetCount, weights, previousWeights, begin, end))
+		return;
+
+	// Targets are usually bunched together, so only the range they
+	// cover is split instead of the whole mesh
+	ThreadPool::GetInstance().ParallelFor(end - begin, MORPHING_MIN_BATCH_SIZE, [=](unsigned int first, unsigned int last)
+	{
+		ApplyRange(base, targets, targetCount, weights, previousWeights, begin + first, begin + last, out);
+	});
+}
+
+void Morphing::ApplyRange(const Vertex* base, const MorphTarget* targets, unsigned int targetCount, const float* weights, const float* previousWeights,
+	unsigned int begin, unsigned int end, Vertex* out)
+{
+	// Where each target's vertices within the range start and end,
+	// indices are sorted so the range is a single run of them
+	auto findRun = [=](const MorphTarget& target, unsigned int& first, unsigned int& last)
+	{
+		const unsigned int* indices = target.vertices.data();
+		first = (unsigned int)(std::lower_bound(indices, indices + target.vertices.size(), begin) - indices);
+		last = (unsigned int)(std::lower_bound(indices + first, indices + target.vertices.size(), end) - indices);
+	};
+
+	// Put back everything the previous weights moved
+	for (unsigned int t = 0; t < targetCount; t++)
+	{
+		if (!IsActive(previousWeights[t]))
+			continue;
+
+		unsigned int first, last;
+		findRun(targets[t], first, last);
+		const unsigned int* indices = targets[t].vertices.data();
+		for (unsigned int k = first; k < last; k++)
+		{
+			unsigned int v = indices[k];
+			out[v].Position = base[v].Position;
+			out[v].Normal = base[v].Normal;
+			out[v].Tangent = base[v].Tangent;
+		}
+	}
+
+	// Every weighted target adds its deltas on top
+	for (unsigned int t = 0; t < targetCount; t++)
+	{
+		if (!IsActive(weights[t]))
+			continue;
+
+		unsigned int first, last;
+		const MorphTarget& target = targets[t];
+		findRun(target, first, last);
+		XMVECTOR weight = XMVectorReplicate(weights[t]);
+		for (unsigned int k = first; k < last; k++)
+		{
+			Vertex& vertex = out[target.vertices[k]];
+			XMStoreFloat3(&vertex.Position, XMVectorMultiplyAdd(XMLoadFloat3(&target.positionDeltas[k]), weight, XMLoadFloat3(&vertex.Position)));
+			XMStoreFloat3(&vertex.Normal, XMVectorMultiplyAdd(XMLoadFloat3(&target.normalDeltas[k]), weight, XMLoadFloat3(&vertex.Normal)));
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&vertex.Tangent),
+				XMVectorMultiplyAdd(XMLoadFloat3(&target.tangentDeltas[k]), weight, XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&vertex.Tangent))));
+		}
+	}
+
+	// Normals and tangents are only unit length again once every delta is in,
+	// vertices several targets share are just normalized more than once
+	for (unsigned int t = 0; t < targetCount; t++)
+	{
+		if (!IsActive(weights[t]))
+			continue;
+
+		unsigned int first, last;
+		findRun(targets[t], first, last);
+		const unsigned int* indices = targets[t].vertices.data();
+		for (unsigned int k = first; k < last; k++)
+		{
+			Vertex& vertex = out[indices[k]];
+			XMStoreFloat3(&vertex.Normal, XMVector3Normalize(XMLoadFloat3(&vertex.Normal)));
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&vertex.Tangent), XMVector3Normalize(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&vertex.Tangent))));
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "Vertex.h"
+
+/*
+	Morph targets (blend shapes) applied on the CPU. A target only
+	keeps deltas for the vertices it moves, sorted by index, so a
+	weight costs as much as the area it deforms rather than the
+	whole mesh. Morphing goes from one set of weights to another:
+	vertices moved by the old weights are put back to the base
+	shape, then every target with a weight adds its deltas on top
+*/
+
+// Weights closer to 0 than this leave their target out
+#define MORPH_MIN_WEIGHT 0.0001f
+
+// Deltas shorter than this are dropped when a target is made from a whole shape
+#define MORPH_DELTA_THRESHOLD 0.00001f
+
+// Fewer vertices than this per thread is not worth a thread
+#define MORPHING_MIN_BATCH_SIZE 8192
+
+/// <summary>
+/// One shape a mesh can blend towards, as deltas from its base shape
+/// </summary>
+struct MorphTarget
+{
+	std::string name;
+	std::vector<unsigned int> vertices;	// Sorted indices of the vertices it moves
+
+	// One of each per vertex it moves
+	std::vector<DirectX::XMFLOAT3> positionDeltas;
+	std::vector<DirectX::XMFLOAT3> normalDeltas;
+	std::vector<DirectX::XMFLOAT3> tangentDeltas;
+};
+
+class Morphing
+{
+public:
+	/// <summary>
+	/// Make a target from a whole copy of the mesh in its new shape,
+	/// keeping only the vertices that moved
+	/// </summary>
+	/// <param name="shaped">Same vertices as the base in the same order, moved into the target shape</param>
+	static MorphTarget CreateTarget(const std::string& name, const Vertex* base, const Vertex* shaped, unsigned int vertexCount,
+		float threshold = MORPH_DELTA_THRESHOLD);
+
+	/// <summary>
+	/// Smallest range of vertices holding every one that either set of weights moves
+	/// </summary>
+	/// <returns>False if neither set moves anything</returns>
+	static bool AffectedRange(const MorphTarget* targets, unsigned int targetCount, const float* weights, const float* previousWeights,
+		unsigned int& begin, unsigned int& end);
+
+	/// <summary>
+	/// Morph vertices from one set of weights to another, split between
+	/// threads when enough of them are affected. Only vertices either
+	/// set moves are touched, everything else in out is left as it is
+	/// </summary>
+	/// <param name="weights">One per target</param>
+	/// <param name="previousWeights">One per target, what out was last morphed with. All 0 if it holds the base shape</param>
+	/// <param name="out">The base shape morphed by the previous weights, the same vertex count as base</param>
+	static void Apply(const Vertex* base, const MorphTarget* targets, unsigned int targetCount, const float* weights, const float* previousWeights, Vertex* out);
+	/// <summary>
+	/// Morph only the vertices within a range on this thread, for
+	/// callers that already split their work between threads
+	/// </summary>
+	static void ApplyRange(const Vertex* base, const MorphTarget* targets, unsigned int targetCount, const float* weights, const float* previousWeights,
+		unsigned int begin, unsigned int end, Vertex* out);
+};
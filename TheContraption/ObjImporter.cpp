@@ -0,0 +1,856 @@
+#include "ObjImporter.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "FileHelpers.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+using namespace DirectX;
+
+// Powers of ten that are exact as doubles
+static const double powersOfTen[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+	1e21, 1e22
+};
+
+static bool IsLineEnd(char c)
+{
+	return c == '\n' || c == '\r';
+}
+
+static const char* SkipSpaces(const char* c, const char* end)
+{
+	while (c < end && (*c == ' ' || *c == '\t'))
+		c++;
+	return c;
+}
+
+static const char* SkipLine(const char* c, const char* end)
+{
+	const char* next = static_cast<const char*>(std::memchr(c, '\n', end - c));
+	return next ? next + 1 : end;
+}
+
+bool ObjImporter::Load(const wchar_t* file, MeshData& out, bool optimize)
+{
+	out.vertices.clear();
+	out.indices.clear();
+
+	MappedFile mapped(file);
+	if (!mapped.IsOpen())
+		return false;
+
+	std::vector<Chunk> chunks;
+	ParseInParallel(mapped.GetData(), mapped.GetSize(), chunks);
+	size_t chunkCount = chunks.size();
+
+	// Lay every chunk's data out in file order
+	unsigned int positionCount = 0;
+	unsigned int uvCount = 0;
+	unsigned int normalCount = 0;
+	unsigned int cornerCount = 0;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		Chunk& chunk = chunks[i];
+		if (chunk.failed)
+			return false;
+
+		chunk.positionOffset = positionCount;
+		chunk.uvOffset = uvCount;
+		chunk.normalOffset = normalCount;
+		chunk.cornerOffset = cornerCount;
+
+		positionCount += (unsigned int)chunk.positions.size();
+		uvCount += (unsigned int)chunk.uvs.size();
+		normalCount += (unsigned int)chunk.normals.size();
+		cornerCount += (unsigned int)chunk.corners.size();
+		ResolveRelative(chunk);
+	}
+
+	if (cornerCount == 0)
+		return false;
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT2> uvs;
+	std::vector<XMFLOAT3> normals;
+	positions.reserve(positionCount);
+	uvs.reserve(uvCount);
+	normals.reserve(normalCount);
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+		uvs.insert(uvs.end(), chunks[i].uvs.begin(), chunks[i].uvs.end());
+		normals.insert(normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+	}
+
+	Attributes attributes = { positions.data(), normals.data(), uvs.data(), positionCount, normalCount, uvCount };
+
+	// Every chunk writes to its own range of the output
+	out.vertices.resize(cornerCount);
+	out.indices.resize(cornerCount);
+	ThreadPool::GetInstance().ParallelFor((unsigned int)chunkCount, 1, [&](unsigned int first, unsigned int last)
+	{
+		for (unsigned int i = first; i < last; i++)
+		{
+			AssembleChunk(chunks[i], attributes, out);
+		}
+	});
+
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		if (chunks[i].failed)
+		{
+			out.vertices.clear();
+			out.indices.clear();
+			return false;
+		}
+	}
+
+	// Every face corner was its own vertex up to here
+	MeshOptimizer::WeldVertices(out);
+	if (optimize)
+		MeshOptimizer::Optimize(out);
+	return true;
+}
+
+bool ObjImporter::LoadStreaming(const wchar_t* file, size_t memoryBudget, const std::function<bool(MeshData& piece)>& emit)
+{
+	memoryBudget = memoryBudget < OBJ_STREAM_MIN_BUDGET ? OBJ_STREAM_MIN_BUDGET : memoryBudget;
+
+	// Scratch files go away however the import ends
+	struct ScratchPaths
+	{
+		std::wstring positions;
+		std::wstring uvs;
+		std::wstring normals;
+		std::wstring corners;
+
+		~ScratchPaths()
+		{
+			RemoveFile(positions.c_str());
+			RemoveFile(uvs.c_str());
+			RemoveFile(normals.c_str());
+			RemoveFile(corners.c_str());
+		}
+	} paths;
+
+	std::wstring scratchPath = std::wstring(file) + OBJ_STREAM_SCRATCH_EXTENSION;
+	paths.positions = scratchPath + L".v";
+	paths.uvs = scratchPath + L".vt";
+	paths.normals = scratchPath + L".vn";
+	paths.corners = scratchPath + L".f";
+
+	FILE* source = OpenForReading(file);
+	Scratch scratch = {};
+	scratch.positions = OpenForWriting(paths.positions.c_str());
+	scratch.uvs = OpenForWriting(paths.uvs.c_str());
+	scratch.normals = OpenForWriting(paths.normals.c_str());
+	scratch.corners = OpenForWriting(paths.corners.c_str());
+	bool spilled = source != nullptr && scratch.positions != nullptr && scratch.uvs != nullptr &&
+		scratch.normals != nullptr && scratch.corners != nullptr;
+
+	// First pass: parse the file a window at a time and spill everything.
+	// Only whole lines are parsed, the one cut off at the end of a window
+	// is carried over to the start of the next
+	size_t windowSize = memoryBudget / OBJ_STREAM_WINDOW_DIVISOR;
+	std::vector<char> window(spilled ? windowSize : 0);
+	size_t carried = 0;
+	while (spilled)
+	{
+		size_t read = std::fread(&window[carried], 1, windowSize - carried, source);
+		size_t filled = carried + read;
+		bool last = carried + read < windowSize;
+		if (filled == 0)
+			break;
+
+		size_t whole = filled;
+		if (!last)
+		{
+			while (whole > 0 && window[whole - 1] != '\n')
+				whole--;
+
+			// A line longer than the window can't be parsed
+			if (whole == 0)
+			{
+				spilled = false;
+				break;
+			}
+		}
+
+		spilled = SpillWindow(&window[0], whole, scratch);
+		carried = filled - whole;
+		std::memmove(&window[0], &window[whole], carried);
+		if (last)
+			break;
+	}
+	std::vector<char>().swap(window);
+
+	if (source != nullptr)
+	{
+		spilled = std::ferror(source) == 0 && spilled;
+		std::fclose(source);
+	}
+	FILE* scratchFiles[] = { scratch.positions, scratch.uvs, scratch.normals, scratch.corners };
+	for (FILE* scratchFile : scratchFiles)
+	{
+		if (scratchFile != nullptr)
+			spilled = std::fclose(scratchFile) == 0 && spilled;
+	}
+	if (!spilled || scratch.cornerCount == 0)
+		return false;
+
+	// Second pass: attributes are looked up at random so they are mapped
+	// and left to the operating system to page, faces are read in order
+	std::unique_ptr<MappedFile> positions(new MappedFile(paths.positions.c_str()));
+	std::unique_ptr<MappedFile> uvs(new MappedFile(paths.uvs.c_str()));
+	std::unique_ptr<MappedFile> normals(new MappedFile(paths.normals.c_str()));
+	Attributes attributes =
+	{
+		reinterpret_cast<const XMFLOAT3*>(positions->GetData()),
+		reinterpret_cast<const XMFLOAT3*>(normals->GetData()),
+		reinterpret_cast<const XMFLOAT2*>(uvs->GetData()),
+		positions->IsOpen() ? scratch.positionCount : 0,
+		normals->IsOpen() ? scratch.normalCount : 0,
+		uvs->IsOpen() ? scratch.uvCount : 0
+	};
+
+	FILE* corners = OpenForReading(paths.corners.c_str());
+	if (corners == nullptr)
+		return false;
+
+	size_t pieceCorners = memoryBudget / OBJ_STREAM_CORNER_COST / 3 * 3;
+	bool emitted = EmitPieces(corners, attributes, pieceCorners, emit);
+	std::fclose(corners);
+	return emitted;
+}
+
+void ObjImporter::ParseInParallel(const char* data, size_t size, std::vector<Chunk>& chunks)
+{
+	// Split the text into one chunk per thread, each ending
+	// at a line break so no line is cut in half
+	size_t chunkCount = ThreadPool::GetInstance().GetThreadCount();
+	size_t maxChunks = size / OBJ_MIN_CHUNK_SIZE;
+	chunkCount = chunkCount > maxChunks ? maxChunks : chunkCount;
+	chunkCount = chunkCount < 1 ? 1 : chunkCount;
+
+	chunks.clear();
+	chunks.resize(chunkCount);
+	const char* end = data + size;
+	const char* begin = data;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = end;
+		if (i + 1 < chunkCount)
+		{
+			chunkEnd = data + size * (i + 1) / chunkCount;
+			chunkEnd = chunkEnd < begin ? begin : chunkEnd;
+			chunkEnd = SkipLine(chunkEnd, end);
+		}
+
+		chunks[i].begin = begin;
+		chunks[i].end = chunkEnd;
+		chunks[i].hasRelative = false;
+		chunks[i].failed = false;
+		begin = chunkEnd;
+	}
+
+	ThreadPool::GetInstance().ParallelFor((unsigned int)chunkCount, 1, [&](unsigned int first, unsigned int last)
+	{
+		for (unsigned int i = first; i < last; i++)
+		{
+			ParseChunk(chunks[i]);
+		}
+	});
+}
+
+void ObjImporter::ParseChunk(Chunk& chunk)
+{
+	const char* c = chunk.begin;
+	const char* end = chunk.end;
+
+	while (c < end && !chunk.failed)
+	{
+		c = SkipSpaces(c, end);
+		if (c + 1 >= end)
+			break;
+
+		if (c[0] == 'v' && c[1] == 'n')
+		{
+			XMFLOAT3 normal;
+			c = ParseFloat(c + 2, end, normal.x);
+			c = ParseFloat(c, end, normal.y);
+			c = ParseFloat(c, end, normal.z);
+			chunk.normals.push_back(normal);
+		}
+		else if (c[0] == 'v' && c[1] == 't')
+		{
+			// The second coordinate is optional and a
+			// third is allowed but never used
+			XMFLOAT2 uv(0, 0);
+			c = ParseFloat(c + 2, end, uv.x);
+			const char* next = c == nullptr ? nullptr : SkipSpaces(c, end);
+			if (next != nullptr && next < end && !IsLineEnd(*next))
+				c = ParseFloat(next, end, uv.y);
+			chunk.uvs.push_back(uv);
+		}
+		else if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t'))
+		{
+			XMFLOAT3 position;
+			c = ParseFloat(c + 1, end, position.x);
+			c = ParseFloat(c, end, position.y);
+			c = ParseFloat(c, end, position.z);
+			chunk.positions.push_back(position);
+		}
+		else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t'))
+		{
+			ParseFace(chunk, c + 1, end);
+		}
+
+		if (c == nullptr)
+		{
+			chunk.failed = true;
+			break;
+		}
+
+		// Comments, groups, materials and anything else are skipped
+		c = SkipLine(c, end);
+	}
+}
+
+void ObjImporter::ParseFace(Chunk& chunk, const char* c, const char* end)
+{
+	Corner polygon[64];
+	unsigned int cornerCount = 0;
+
+	while (true)
+	{
+		c = SkipSpaces(c, end);
+		if (c >= end || IsLineEnd(*c))
+			break;
+
+		if (cornerCount == 64)
+		{
+			chunk.failed = true;
+			return;
+		}
+
+		// Corners look like p, p/t, p//n or p/t/n
+		int index[3] = { 0, OBJ_MISSING_INDEX, OBJ_MISSING_INDEX };
+		for (unsigned int part = 0; part < 3; part++)
+		{
+			if (part > 0)
+			{
+				if (c >= end || *c != '/')
+					break;
+				c++;
+
+				// Empty uv slot in p//n
+				if (c < end && *c == '/')
+					continue;
+			}
+
+			c = ParseInt(c, end, index[part]);
+			if (c == nullptr || index[part] == 0)
+			{
+				chunk.failed = true;
+				return;
+			}
+		}
+
+		// Obj indices start at 1 and negative ones count back from
+		// the latest entry. Those are made relative to the chunk here
+		// and moved to the right place once every chunk is merged
+		Corner& corner = polygon[cornerCount++];
+		corner.relative = 0;
+
+		corner.position = index[0] > 0 ? index[0] - 1 : (int)chunk.positions.size() + index[0];
+		if (index[0] < 0)
+			corner.relative |= OBJ_RELATIVE_POSITION;
+
+		corner.uv = index[1];
+		if (index[1] != OBJ_MISSING_INDEX)
+		{
+			corner.uv = index[1] > 0 ? index[1] - 1 : (int)chunk.uvs.size() + index[1];
+			if (index[1] < 0)
+				corner.relative |= OBJ_RELATIVE_UV;
+		}
+
+		corner.normal = index[2];
+		if (index[2] != OBJ_MISSING_INDEX)
+		{
+			corner.normal = index[2] > 0 ? index[2] - 1 : (int)chunk.normals.size() + index[2];
+			if (index[2] < 0)
+				corner.relative |= OBJ_RELATIVE_NORMAL;
+		}
+
+		chunk.hasRelative |= corner.relative != 0;
+
+		// Skip anything odd trailing the corner
+		while (c < end && *c != ' ' && *c != '\t' && !IsLineEnd(*c))
+			c++;
+	}
+
+	if (cornerCount < 3)
+	{
+		chunk.failed = true;
+		return;
+	}
+
+	// Fan the polygon around its first corner, flipping the
+	// winding since obj files are right handed
+	for (unsigned int i = 2; i < cornerCount; i++)
+	{
+		chunk.corners.push_back(polygon[0]);
+		chunk.corners.push_back(polygon[i]);
+		chunk.corners.push_back(polygon[i - 1]);
+	}
+}
+
+void ObjImporter::ResolveRelative(Chunk& chunk)
+{
+	if (!chunk.hasRelative)
+		return;
+
+	// Negative indices count back from where the face was,
+	// which is only known once earlier chunks are counted
+	for (unsigned int c = 0; c < chunk.corners.size(); c++)
+	{
+		Corner& corner = chunk.corners[c];
+		if (corner.relative & OBJ_RELATIVE_POSITION) corner.position += (int)chunk.positionOffset;
+		if (corner.relative & OBJ_RELATIVE_UV) corner.uv += (int)chunk.uvOffset;
+		if (corner.relative & OBJ_RELATIVE_NORMAL) corner.normal += (int)chunk.normalOffset;
+		corner.relative = 0;
+	}
+}
+
+void ObjImporter::AssembleChunk(Chunk& chunk, const Attributes& attributes, MeshData& out)
+{
+	unsigned int positionCount = attributes.positionCount;
+	unsigned int uvCount = attributes.uvCount;
+	unsigned int normalCount = attributes.normalCount;
+
+	unsigned int cornerCount = (unsigned int)chunk.corners.size();
+	for (unsigned int c = 0; c < cornerCount; c += 3)
+	{
+		Vertex* v = &out.vertices[chunk.cornerOffset + c];
+		bool missingNormal = false;
+
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			const Corner& corner = chunk.corners[c + k];
+
+			// Out of range indices mean the file is broken
+			if ((unsigned int)corner.position >= positionCount ||
+				(corner.uv != OBJ_MISSING_INDEX && (unsigned int)corner.uv >= uvCount) ||
+				(corner.normal != OBJ_MISSING_INDEX && (unsigned int)corner.normal >= normalCount))
+			{
+				chunk.failed = true;
+				return;
+			}
+
+			// Flip Z to move from right handed to left handed and flip
+			// the uvs since DirectX puts (0, 0) in the top left
+			v[k].Position = attributes.positions[corner.position];
+			v[k].Position.z *= -1.0f;
+
+			v[k].UV = corner.uv == OBJ_MISSING_INDEX ? XMFLOAT2(0, 0) : attributes.uvs[corner.uv];
+			v[k].UV.y = 1.0f - v[k].UV.y;
+
+			if (corner.normal == OBJ_MISSING_INDEX)
+			{
+				missingNormal = true;
+			}
+			else
+			{
+				v[k].Normal = attributes.normals[corner.normal];
+				v[k].Normal.z *= -1.0f;
+			}
+
+			v[k].Tangent = XMFLOAT4(0, 0, 0, 1);
+			out.indices[chunk.cornerOffset + c + k] = chunk.cornerOffset + c + k;
+		}
+
+		// Fall back to the flat normal of the triangle
+		if (missingNormal)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&v[0].Position);
+			XMVECTOR normal = XMVector3Normalize(XMVector3Cross(
+				XMLoadFloat3(&v[1].Position) - p0,
+				XMLoadFloat3(&v[2].Position) - p0));
+
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				if (chunk.corners[c + k].normal == OBJ_MISSING_INDEX)
+					XMStoreFloat3(&v[k].Normal, normal);
+			}
+		}
+	}
+}
+
+bool ObjImporter::SpillWindow(const char* data, size_t size, Scratch& scratch)
+{
+	std::vector<Chunk> chunks;
+	ParseInParallel(data, size, chunks);
+
+	for (Chunk& chunk : chunks)
+	{
+		if (chunk.failed)
+			return false;
+
+		// Counted across every window so far
+		chunk.positionOffset = scratch.positionCount;
+		chunk.uvOffset = scratch.uvCount;
+		chunk.normalOffset = scratch.normalCount;
+		ResolveRelative(chunk);
+
+		bool written =
+			(chunk.positions.empty() || std::fwrite(chunk.positions.data(), sizeof(XMFLOAT3) * chunk.positions.size(), 1, scratch.positions) == 1) &&
+			(chunk.uvs.empty() || std::fwrite(chunk.uvs.data(), sizeof(XMFLOAT2) * chunk.uvs.size(), 1, scratch.uvs) == 1) &&
+			(chunk.normals.empty() || std::fwrite(chunk.normals.data(), sizeof(XMFLOAT3) * chunk.normals.size(), 1, scratch.normals) == 1) &&
+			(chunk.corners.empty() || std::fwrite(chunk.corners.data(), sizeof(Corner) * chunk.corners.size(), 1, scratch.corners) == 1);
+		if (!written)
+			return false;
+
+		unsigned long long positionCount = (unsigned long long)scratch.positionCount + chunk.positions.size();
+		unsigned long long uvCount = (unsigned long long)scratch.uvCount + chunk.uvs.size();
+		unsigned long long normalCount = (unsigned long long)scratch.normalCount + chunk.normals.size();
+		if (positionCount > OBJ_MISSING_INDEX || uvCount > OBJ_MISSING_INDEX || normalCount > OBJ_MISSING_INDEX)
+			return false;
+
+		scratch.positionCount = (unsigned int)positionCount;
+		scratch.uvCount = (unsigned int)uvCount;
+		scratch.normalCount = (unsigned int)normalCount;
+		scratch.cornerCount += chunk.corners.size();
+	}
+	return true;
+}
+
+bool ObjImporter::EmitPieces(FILE* corners, const Attributes& attributes, size_t pieceCorners, const std::function<bool(MeshData& piece)>& emit)
+{
+	Chunk piece = {};
+	MeshData out;
+	while (true)
+	{
+		piece.corners.resize(pieceCorners);
+		size_t read = std::fread(piece.corners.data(), sizeof(Corner), pieceCorners, corners);
+		if (read == 0)
+			return std::ferror(corners) == 0;
+
+		// Triangles are never split between pieces
+		if (read % 3 != 0)
+			return false;
+		piece.corners.resize(read);
+
+		out.vertices.resize(read);
+		out.indices.resize(read);
+		out.meshlets.clear();
+		out.lods.clear();
+		AssembleChunk(piece, attributes, out);
+		if (piece.failed)
+			return false;
+
+		MeshOptimizer::WeldVertices(out);
+		MeshOptimizer::Optimize(out);
+		if (!emit(out))
+			return false;
+	}
+}
+
+const char* ObjImporter::ParseFloat(const char* c, const char* end, float& out)
+{
+	if (c == nullptr)
+		return nullptr;
+
+	c = SkipSpaces(c, end);
+
+	bool negative = false;
+	if (c < end && (*c == '-' || *c == '+'))
+	{
+		negative = *c == '-';
+		c++;
+	}
+
+	// Gather every digit into one integer and remember where the
+	// decimal point was, so only one multiply happens at the end
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	bool anyDigits = false;
+
+	while (c < end && *c >= '0' && *c <= '9')
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (unsigned long long)(*c - '0');
+			digits += mantissa != 0;
+		}
+		else
+		{
+			exponent++;
+		}
+		anyDigits = true;
+		c++;
+	}
+
+	if (c < end && *c == '.')
+	{
+		c++;
+		while (c < end && *c >= '0' && *c <= '9')
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (unsigned long long)(*c - '0');
+				digits += mantissa != 0;
+				exponent--;
+			}
+			anyDigits = true;
+			c++;
+		}
+	}
+
+	if (!anyDigits)
+		return nullptr;
+
+	if (c < end && (*c == 'e' || *c == 'E'))
+	{
+		int fileExponent = 0;
+		const char* afterExponent = ParseInt(c + 1, end, fileExponent);
+		if (afterExponent == nullptr)
+			return nullptr;
+
+		exponent += fileExponent;
+		c = afterExponent;
+	}
+
+	double value = (double)mantissa;
+	if (exponent < 0)
+	{
+		while (exponent < -22)
+		{
+			value /= powersOfTen[22];
+			exponent += 22;
+		}
+		value /= powersOfTen[-exponent];
+	}
+	else if (exponent > 0)
+	{
+		while (exponent > 22)
+		{
+			value *= powersOfTen[22];
+			exponent -= 22;
+		}
+		value *= powersOfTen[exponent];
+	}
+
+	out = (float)(negative ? -value : value);
+	return c;
+}
+
+const char* ObjImporter::ParseInt(const char* c, const char* end, int& out)
+{
+	if (c == nullptr)
+		return nullptr;
+
+	bool negative = false;
+	if (c < end && (*c == '-' || *c == '+'))
+	{
+		negative = *c == '-';
+		c++;
+	}
+
+	if (c >= end || *c < '0' || *c > '9')
+		return nullptr;
+
+	long long value = 0;
+	while (c < end && *c >= '0' && *c <= '9')
+	{
+		// Saturate instead of overflowing, the caller will
+		// find the index out of range
+		value = value < 0x7fffffff ? value * 10 + (*c - '0') : value;
+		c++;
+	}
+
+	value = value > 0x7ffffffe ? 0x7ffffffe : value;
+	out = (int)(negative ? -value : value);
+	return c;
+}
+
+#pragma region BENCHMARK
+
+ObjBenchmarkResult ObjImporter::Benchmark(const wchar_t* file)
+{
+	ObjBenchmarkResult result = {};
+	{
+		MappedFile mapped(file);
+		if (!mapped.IsOpen())
+			return result;
+		result.fileSize = mapped.GetSize();
+	}
+
+	MeshData referenceData;
+	auto start = std::chrono::high_resolution_clock::now();
+	bool reference = LoadReference(file, referenceData);
+	auto end = std::chrono::high_resolution_clock::now();
+	result.referenceMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+	result.triangles = (unsigned int)referenceData.indices.size() / 3;
+
+	MeshData data;
+	start = std::chrono::high_resolution_clock::now();
+	bool imported = Load(file, data);
+	end = std::chrono::high_resolution_clock::now();
+	result.importMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+
+	// The old loader's output is what Load has before it welds,
+	// so the same passes on it split parsing from the rest
+	start = std::chrono::high_resolution_clock::now();
+	MeshOptimizer::WeldVertices(referenceData);
+	MeshOptimizer::Optimize(referenceData);
+	end = std::chrono::high_resolution_clock::now();
+	result.optimizeMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+
+	result.loaded = reference && imported;
+	return result;
+}
+
+bool ObjImporter::WriteBenchmarkFile(const wchar_t* file, unsigned int rows, unsigned int columns)
+{
+	FILE* obj = OpenForWriting(file);
+	if (obj == nullptr)
+		return false;
+
+	const float pi = 3.14159265f;
+	const float ringRadius = 2.0f;
+	const float tubeRadius = 0.5f;
+	for (unsigned int r = 0; r < rows; r++)
+	{
+		for (unsigned int c = 0; c < columns; c++)
+		{
+			float u = 2.0f * pi * r / rows;
+			float v = 2.0f * pi * c / columns;
+			float nx = cosf(u) * cosf(v);
+			float ny = sinf(v);
+			float nz = sinf(u) * cosf(v);
+			std::fprintf(obj, "v %f %f %f\n", cosf(u) * ringRadius + nx * tubeRadius, ny * tubeRadius, sinf(u) * ringRadius + nz * tubeRadius);
+			std::fprintf(obj, "vt %f %f\n", (float)c / columns, (float)r / rows);
+			std::fprintf(obj, "vn %f %f %f\n", nx, ny, nz);
+		}
+	}
+
+	// Quads wrap around both ways, every attribute shares the position's index
+	for (unsigned int r = 0; r < rows; r++)
+	{
+		for (unsigned int c = 0; c < columns; c++)
+		{
+			unsigned int a = r * columns + c + 1;
+			unsigned int b = r * columns + (c + 1) % columns + 1;
+			unsigned int d = (r + 1) % rows * columns + c + 1;
+			unsigned int e = (r + 1) % rows * columns + (c + 1) % columns + 1;
+			std::fprintf(obj, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, d, d, d, e, e, e, b, b, b);
+		}
+	}
+
+	bool written = std::ferror(obj) == 0;
+	written = std::fclose(obj) == 0 && written;
+	if (!written)
+		RemoveFile(file);
+	return written;
+}
+
+bool ObjImporter::LoadReference(const wchar_t* file, MeshData& out)
+{
+	out.vertices.clear();
+	out.indices.clear();
+
+	std::ifstream obj(file);
+	if (!obj.is_open())
+		return false;
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT2> uvs;
+	unsigned int indexCounter = 0;
+	char chars[100];
+
+	while (obj.good())
+	{
+		// Lines are read into a fixed buffer and scanned one at a time
+		obj.getline(chars, 100);
+
+		if (chars[0] == 'v' && chars[1] == 'n')
+		{
+			XMFLOAT3 norm;
+			sscanf_s(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+			normals.push_back(norm);
+		}
+		else if (chars[0] == 'v' && chars[1] == 't')
+		{
+			XMFLOAT2 uv;
+			sscanf_s(chars, "vt %f %f", &uv.x, &uv.y);
+			uvs.push_back(uv);
+		}
+		else if (chars[0] == 'v')
+		{
+			XMFLOAT3 pos;
+			sscanf_s(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+			positions.push_back(pos);
+		}
+		else if (chars[0] == 'f')
+		{
+			unsigned int i[12];
+			int numbersRead = sscanf_s(chars, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
+				&i[0], &i[1], &i[2], &i[3], &i[4], &i[5],
+				&i[6], &i[7], &i[8], &i[9], &i[10], &i[11]);
+
+			// Faces without uvs all share one
+			if (numbersRead == 1)
+			{
+				numbersRead = sscanf_s(chars, "f %d//%d %d//%d %d//%d %d//%d",
+					&i[0], &i[2], &i[3], &i[5], &i[6], &i[8], &i[9], &i[11]);
+				i[1] = i[4] = i[7] = i[10] = 1;
+				if (uvs.size() == 0)
+					uvs.push_back(XMFLOAT2(0, 0));
+			}
+
+			// Same conversion to left handed space as Load
+			int corners = numbersRead == 12 || numbersRead == 8 ? 4 : 3;
+			Vertex v[4] = {};
+			for (int k = 0; k < corners; k++)
+			{
+				if (i[k * 3] - 1 >= positions.size() || i[k * 3 + 1] - 1 >= uvs.size() || i[k * 3 + 2] - 1 >= normals.size())
+					return false;
+
+				v[k].Position = positions[i[k * 3] - 1];
+				v[k].UV = uvs[i[k * 3 + 1] - 1];
+				v[k].Normal = normals[i[k * 3 + 2] - 1];
+				v[k].UV.y = 1.0f - v[k].UV.y;
+				v[k].Position.z *= -1.0f;
+				v[k].Normal.z *= -1.0f;
+			}
+
+			out.vertices.push_back(v[0]);
+			out.vertices.push_back(v[2]);
+			out.vertices.push_back(v[1]);
+			if (corners == 4)
+			{
+				out.vertices.push_back(v[0]);
+				out.vertices.push_back(v[3]);
+				out.vertices.push_back(v[2]);
+			}
+			while (indexCounter < out.vertices.size())
+			{
+				out.indices.push_back(indexCounter++);
+			}
+		}
+	}
+
+	return !out.indices.empty();
+}
+
+#pragma endregion
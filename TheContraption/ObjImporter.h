@@ -0,0 +1,168 @@
+#pragma once
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "MeshData.h"
+
+/*
+	Loads .obj files by memory mapping them, parsing chunks of
+	the file on several threads at once and stitching the chunks
+	back together in file order. Files too big for memory can be
+	streamed instead, a window at a time
+*/
+
+// Chunks smaller than this are not worth a thread of their own
+#define OBJ_MIN_CHUNK_SIZE (256 * 1024)
+
+// Memory a streaming import uses when it isn't told otherwise, and the least it needs
+#define OBJ_STREAM_DEFAULT_BUDGET (64 * 1024 * 1024)
+#define OBJ_STREAM_MIN_BUDGET (1024 * 1024)
+
+// Share of the budget a window of text gets. Parsing can turn
+// text into up to six times as many bytes
+#define OBJ_STREAM_WINDOW_DIVISOR 8
+
+// Roughly what a face corner costs while its piece is assembled,
+// welded and optimized, which sets how big the pieces are
+#define OBJ_STREAM_CORNER_COST 160
+
+// Added to the obj path for the scratch files of a streaming import
+#define OBJ_STREAM_SCRATCH_EXTENSION L".stream"
+
+// Index used when a face corner leaves out its uv or normal
+#define OBJ_MISSING_INDEX 0x7fffffff
+
+// Which indices of a face corner were negative in the file
+#define OBJ_RELATIVE_POSITION 0x01
+#define OBJ_RELATIVE_UV 0x02
+#define OBJ_RELATIVE_NORMAL 0x04
+
+/// <summary>
+/// How long the old loader and Load took on the same file
+/// </summary>
+struct ObjBenchmarkResult
+{
+	bool loaded;
+	unsigned long long fileSize;
+	unsigned int triangles;
+	float referenceMilliseconds;	// getline and sscanf_s, the way Mesh used to read obj files
+	float importMilliseconds;		// Load, welding and optimizing included
+	float optimizeMilliseconds;		// Part of Load spent welding and optimizing, which the old loader never did
+};
+
+class ObjImporter
+{
+public:
+	/// <summary>
+	/// Read an obj file into mesh data. Positions and normals are
+	/// converted to left handed space, uvs are flipped vertically,
+	/// faces with more than three corners are triangulated,
+	/// identical vertices are welded together and the result is
+	/// reordered for the vertex cache, overdraw and vertex fetch
+	/// </summary>
+	/// <param name="optimize">False stops after welding, leaving the triangles
+	/// in file order to measure what the reordering gains</param>
+	/// <returns>False if the file could not be read or is broken</returns>
+	static bool Load(const wchar_t* file, MeshData& out, bool optimize = true);
+	/// <summary>
+	/// Read an obj file without ever holding all of it, for files
+	/// bigger than memory. Windows of the file are parsed and spilled
+	/// to scratch files next to it, then the mesh is handed out in
+	/// pieces of whole triangles. Each piece is converted, welded and
+	/// optimized like Load does on its own, with indices relative to
+	/// the piece, so vertices on the borders of pieces are not shared
+	/// </summary>
+	/// <param name="memoryBudget">Roughly the most memory the import may use</param>
+	/// <param name="emit">Gets every piece in file order, returning false stops the import</param>
+	/// <returns>False if the file could not be read, is broken or a piece was refused</returns>
+	static bool LoadStreaming(const wchar_t* file, size_t memoryBudget, const std::function<bool(MeshData& piece)>& emit);
+
+	/// <summary>
+	/// Time the old line by line loader and Load on the same file
+	/// </summary>
+	static ObjBenchmarkResult Benchmark(const wchar_t* file);
+	/// <summary>
+	/// Write a torus of rows * columns vertices and quads, with positions,
+	/// uvs and normals, as a big file for Benchmark
+	/// </summary>
+	/// <returns>False if the file could not be written</returns>
+	static bool WriteBenchmarkFile(const wchar_t* file, unsigned int rows, unsigned int columns);
+
+private:
+	// One corner of a face. Positive obj indices are turned into
+	// 0 based indices straight away, negative ones are only known
+	// relative to the chunk until every chunk has been counted
+	struct Corner
+	{
+		int position;
+		int uv;
+		int normal;
+		unsigned char relative;	// OBJ_RELATIVE flags
+	};
+
+	// Everything parsed from one piece of the file
+	struct Chunk
+	{
+		const char* begin;
+		const char* end;
+
+		std::vector<DirectX::XMFLOAT3> positions;
+		std::vector<DirectX::XMFLOAT3> normals;
+		std::vector<DirectX::XMFLOAT2> uvs;
+		std::vector<Corner> corners;	// Three per triangle
+
+		// Where this chunk's data starts once merged
+		unsigned int positionOffset;
+		unsigned int uvOffset;
+		unsigned int normalOffset;
+		unsigned int cornerOffset;
+
+		bool hasRelative;
+		bool failed;
+	};
+
+	// Data of every chunk merged in file order, wherever it is kept
+	struct Attributes
+	{
+		const DirectX::XMFLOAT3* positions;
+		const DirectX::XMFLOAT3* normals;
+		const DirectX::XMFLOAT2* uvs;
+		unsigned int positionCount;
+		unsigned int normalCount;
+		unsigned int uvCount;
+	};
+
+	// Where a streaming import's attributes and faces wait between its passes
+	struct Scratch
+	{
+		FILE* positions;
+		FILE* uvs;
+		FILE* normals;
+		FILE* corners;
+
+		unsigned int positionCount;
+		unsigned int uvCount;
+		unsigned int normalCount;
+		unsigned long long cornerCount;
+	};
+
+	static void ParseInParallel(const char* data, size_t size, std::vector<Chunk>& chunks);
+	static void ParseChunk(Chunk& chunk);
+	static void ParseFace(Chunk& chunk, const char* c, const char* end);
+	static void ResolveRelative(Chunk& chunk);
+	static void AssembleChunk(Chunk& chunk, const Attributes& attributes, MeshData& out);
+
+	static bool SpillWindow(const char* data, size_t size, Scratch& scratch);
+	static bool EmitPieces(FILE* corners, const Attributes& attributes, size_t pieceCorners, const std::function<bool(MeshData& piece)>& emit);
+
+	/// <summary>
+	/// The loader Mesh used before this importer, kept to benchmark against.
+	/// Every face corner becomes its own vertex and nothing is optimized
+	/// </summary>
+	static bool LoadReference(const wchar_t* file, MeshData& out);
+
+	static const char* ParseFloat(const char* c, const char* end, float& out);
+	static const char* ParseInt(const char* c, const char* end, int& out);
+};
@@ -0,0 +1,3 @@
+// Same as ShadowMapVertexShader.hlsl but reads QuantizedVertex
+#define QUANTIZED_VERTICES
+#include "ShadowMapVertexShader.hlsl"
@@ -0,0 +1,3 @@
+// Same as VertexShader.hlsl but reads QuantizedVertex
+#define QUANTIZED_VERTICES
+#include "VertexShader.hlsl"
@@ -0,0 +1,175 @@
+#include "RangeAllocator.h"
+#include <algorithm>
+
+RangeAllocator::RangeAllocator(unsigned int capacity) :
+	capacity(0),
+	used(0),
+	allocationCount(0)
+{
+	Grow(capacity);
+}
+
+unsigned int RangeAllocator::Allocate(unsigned int size)
+{
+	if (size == 0)
+		return RANGE_INVALID;
+
+	// Best fit keeps the large ranges around for large meshes
+	size_t best = freeRanges.size();
+	for (size_t i = 0; i < freeRanges.size(); i++)
+	{
+		if (freeRanges[i].size >= size && (best == freeRanges.size() || freeRanges[i].size < freeRanges[best].size))
+		{
+			best = i;
+			if (freeRanges[i].size == size)
+				break;
+		}
+	}
+	if (best == freeRanges.size())
+		return RANGE_INVALID;
+
+	Range range = { freeRanges[best].offset, size };
+	freeRanges[best].offset += size;
+	freeRanges[best].size -= size;
+	if (freeRanges[best].size == 0)
+		freeRanges.erase(freeRanges.begin() + best);
+
+	unsigned int handle;
+	if (freeHandles.empty())
+	{
+		handle = (unsigned int)allocations.size();
+		allocations.push_back(range);
+	}
+	else
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		allocations[handle] = range;
+	}
+
+	used += size;
+	allocationCount++;
+	return handle;
+}
+
+void RangeAllocator::Free(unsigned int handle)
+{
+	if (handle >= allocations.size() || allocations[handle].size == 0)
+		return;
+
+	AddFreeRange(allocations[handle].offset, allocations[handle].size);
+	used -= allocations[handle].size;
+	allocationCount--;
+
+	allocations[handle].size = 0;
+	freeHandles.push_back(handle);
+}
+
+unsigned int RangeAllocator::GetOffset(unsigned int handle) const
+{
+	return handle < allocations.size() ? allocations[handle].offset : 0;
+}
+
+unsigned int RangeAllocator::GetSize(unsigned int handle) const
+{
+	return handle < allocations.size() ? allocations[handle].size : 0;
+}
+
+unsigned int RangeAllocator::GetCapacity() const
+{
+	return capacity;
+}
+
+void RangeAllocator::Grow(unsigned int newCapacity)
+{
+	if (newCapacity <= capacity)
+		return;
+
+	AddFreeRange(capacity, newCapacity - capacity);
+	capacity = newCapacity;
+}
+
+void RangeAllocator::Defragment(std::vector<RangeMove>& moves)
+{
+	moves.clear();
+
+	std::vector<unsigned int> live;
+	live.reserve(allocationCount);
+	for (unsigned int handle = 0; handle < allocations.size(); handle++)
+	{
+		if (allocations[handle].size > 0)
+			live.push_back(handle);
+	}
+	std::sort(live.begin(), live.end(), [&](unsigned int a, unsigned int b)
+	{
+		return allocations[a].offset < allocations[b].offset;
+	});
+
+	// Neighbours that move by the same distance are copied as one
+	unsigned int offset = 0;
+	for (unsigned int handle : live)
+	{
+		Range& range = allocations[handle];
+		if (range.offset != offset)
+		{
+			if (!moves.empty() && moves.back().from + moves.back().size == range.offset && moves.back().to + moves.back().size == offset)
+				moves.back().size += range.size;
+			else
+				moves.push_back({ range.offset, offset, range.size });
+			range.offset = offset;
+		}
+		offset += range.size;
+	}
+
+	freeRanges.clear();
+	if (offset < capacity)
+		freeRanges.push_back({ offset, capacity - offset });
+}
+
+RangeAllocatorStats RangeAllocator::GetStats() const
+{
+	RangeAllocatorStats stats = {};
+	stats.capacity = capacity;
+	stats.used = used;
+	stats.allocations = allocationCount;
+	stats.freeRanges = (unsigned int)freeRanges.size();
+	for (const Range& range : freeRanges)
+	{
+		stats.largestFree = std::max(stats.largestFree, range.size);
+	}
+
+	unsigned int free = capacity - used;
+	stats.fragmentation = free == 0 ? 0.0f : 1.0f - (float)stats.largestFree / free;
+	return stats;
+}
+
+void RangeAllocator::AddFreeRange(unsigned int offset, unsigned int size)
+{
+	// First free range after this one
+	auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset, [](const Range& range, unsigned int offset)
+	{
+		return range.offset < offset;
+	});
+
+	bool joinsPrevious = next != freeRanges.begin() && (next - 1)->offset + (next - 1)->size == offset;
+	bool joinsNext = next != freeRanges.end() && offset + size == next->offset;
+
+	if (joinsPrevious && joinsNext)
+	{
+		(next - 1)->size += size + next->size;
+		freeRanges.erase(next);
+	}
+	else if (joinsPrevious)
+	{
+		(next - 1)->size += size;
+	}
+	else if (joinsNext)
+	{
+		next->offset = offset;
+		next->size += size;
+	}
+	else
+	{
+		freeRanges.insert(next, { offset, size });
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+
+/*
+	Hands out ranges of a linear space of elements, like the
+	vertices or indices of a large buffer. It never touches the
+	memory it manages, so it works (and can be tested) without a
+	device. Allocations are referred to by handles because
+	defragmenting moves them around
+*/
+
+// Handle of an allocation that doesn't exist
+#define RANGE_INVALID 0xffffffff
+
+// One allocation moved by defragmenting, in elements
+struct RangeMove
+{
+	unsigned int from;
+	unsigned int to;
+	unsigned int size;
+};
+
+struct RangeAllocatorStats
+{
+	unsigned int capacity;
+	unsigned int used;
+	unsigned int allocations;
+	unsigned int freeRanges;
+	unsigned int largestFree;
+
+	// 0 when all free space is in one range, towards 1 the more it is split up
+	float fragmentation;
+};
+
+class RangeAllocator
+{
+public:
+	RangeAllocator(unsigned int capacity = 0);
+
+	/// <summary>
+	/// Reserve the free range that fits the size most tightly
+	/// </summary>
+	/// <returns>Handle of the allocation, RANGE_INVALID if no free range is big enough</returns>
+	unsigned int Allocate(unsigned int size);
+	/// <summary>
+	/// Give the range back and merge it with the free ranges around it
+	/// </summary>
+	void Free(unsigned int handle);
+
+	unsigned int GetOffset(unsigned int handle) const;
+	unsigned int GetSize(unsigned int handle) const;
+	unsigned int GetCapacity() const;
+
+	/// <summary>
+	/// Add space at the end. Capacity never shrinks
+	/// </summary>
+	void Grow(unsigned int capacity);
+	/// <summary>
+	/// Pack every allocation to the start in the order they already
+	/// are, leaving one free range at the end. The moves come out in
+	/// increasing offset and never move anything forward, so copying
+	/// them in order within one buffer is safe
+	/// </summary>
+	void Defragment(std::vector<RangeMove>& moves);
+
+	RangeAllocatorStats GetStats() const;
+
+private:
+	struct Range
+	{
+		unsigned int offset;
+		unsigned int size;
+	};
+
+	void AddFreeRange(unsigned int offset, unsigned int size);
+
+	std::vector<Range> allocations;		// By handle, a size of 0 marks a free handle
+	std::vector<unsigned int> freeHandles;
+	std::vector<Range> freeRanges;		// Sorted by offset, never touching each other
+
+	unsigned int capacity;
+	unsigned int used;
+	unsigned int allocationCount;
+};
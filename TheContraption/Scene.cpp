@@ -1,4 +1,8 @@
 #include "Scenes.h"
+#include "StaticBatcher.h"
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
 
 Scene::Scene(
 	std::string sceneTitle,
@@ -7,7 +11,7 @@ Scene::Scene(
 	std::vector<std::tuple<std::shared_ptr<Light>,std::shared_ptr<Entity>>> lightAndGui,
 	std::shared_ptr<Sky> sky
 ) :
-	sceneTitle(sceneTitle), cameras(cameras), entities(entities), lights(lights)
+	sceneTitle(sceneTitle), cameras(cameras), entities(entities), lights(lights), shadowFrame(0), shadowIsDirty(true)
 {
 	// Start of cameras vector 
 	currentCam = 0;
@@ -17,7 +21,7 @@ Scene::Scene(
 }
 
 Scene::Scene(std::string sceneTitle) :
-	sceneTitle(sceneTitle)
+	sceneTitle(sceneTitle), shadowFrame(0), shadowIsDirty(true)
 {
 	currentCam = 0;
 
@@ -32,9 +36,44 @@ void Scene::DrawShadows(
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV,
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthBufferDSV,
 	std::shared_ptr<SimpleVertexShader> shadowVS, 
+	std::shared_ptr<SimpleVertexShader> quantizedShadowVS,
 	int shadowMapResolution,
 	float windowWidth, float windowHeight)
 {
+	// Keep last frame's shadow map if no caster has moved or been
+	// deformed, and the light is still looking from the same place.
+	// Geometry versions also change when an entity's mesh is swapped.
+	// Casters always draw LOD 0, so the LOD the camera picks doesn't matter
+	ShadadowShaderData* shadowData = lightToShadowData[lights[0].get()].get();
+	TransformPool& transforms = TransformPool::GetInstance();
+	unsigned int framesSinceCheck = transforms.GetFrame() - shadowFrame;
+	bool shadowIsStale =
+		shadowIsDirty ||
+		framesSinceCheck > 1 ||
+		shadowGeometryVersions.size() != entities.size() ||
+		memcmp(&shadowView, &shadowData->view, sizeof(XMFLOAT4X4)) != 0 ||
+		memcmp(&shadowProjection, &shadowData->projection, sizeof(XMFLOAT4X4)) != 0;
+	shadowFrame = transforms.GetFrame();
+
+	// Only the transforms that moved last frame are looked at. Checking twice
+	// in one frame finds nothing new, and a skipped frame (while another scene
+	// was showing) already counts as stale since its list is gone
+	if (!shadowIsStale && framesSinceCheck == 1)
+	{
+		const std::vector<unsigned int>& changed = transforms.GetChangedThisFrame();
+		for (size_t i = 0; i < changed.size() && !shadowIsStale; i++)
+		{
+			shadowIsStale = changed[i] < shadowCasters.size() && shadowCasters[changed[i]];
+		}
+	}
+
+	for (size_t i = 0; i < entities.size() && !shadowIsStale; i++)
+	{
+		shadowIsStale = shadowGeometryVersions[i] != entities[i]->GetModel()->GetGeometryVersion();
+	}
+
+	if (!shadowIsStale)
+		return;
 
 	// Acne fix 
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
@@ -69,17 +108,39 @@ void Scene::DrawShadows(
 
 	// TODO ---------------------------------------------------------------------------------- FIND WAY TO CHOOSE DIRECTIONAL LIGHT THAT WORKS AND NOT JUST 0
 	// Entity Render Loop
-	shadowVS->SetShader();
-	shadowVS->SetMatrix4x4("view", lightToShadowData[lights[0].get()]->view);
-	shadowVS->SetMatrix4x4("projection", lightToShadowData[lights[0].get()]->projection);
+	shadowVS->SetMatrix4x4("view", shadowData->view);
+	shadowVS->SetMatrix4x4("projection", shadowData->projection);
+	quantizedShadowVS->SetMatrix4x4("view", shadowData->view);
+	quantizedShadowVS->SetMatrix4x4("projection", shadowData->projection);
 	// Loop and draw all entities
-	for (auto& e : entities)
+	shadowCasters.assign(shadowCasters.size(), 0);
+	shadowGeometryVersions.resize(entities.size());
+	for (size_t i = 0; i < entities.size(); i++)
 	{
-		shadowVS->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-		shadowVS->CopyAllBufferData();
-		e->GetModel()->Draw();
+		// Quantized meshes need the shader that can decode them
+		std::shared_ptr<Mesh> model = entities[i]->GetModel();
+		std::shared_ptr<SimpleVertexShader> vs = model->IsQuantized() ? quantizedShadowVS : shadowVS;
+		vs->SetShader();
+		vs->SetData("world", &entities[i]->GetTransform()->GetAffineWorldMatrix(), sizeof(AffineMatrix));
+		if (model->IsQuantized())
+		{
+			vs->SetFloat3("positionOffset", model->GetPositionOffset());
+			vs->SetFloat3("positionScale", model->GetPositionScale());
+		}
+		vs->CopyAllBufferData();
+		model->Draw();
+
+		unsigned int handle = entities[i]->GetTransform()->GetHandle();
+		if (handle >= shadowCasters.size())
+			shadowCasters.resize(handle + 1, 0);
+		shadowCasters[handle] = 1;
+		shadowGeometryVersions[i] = model->GetGeometryVersion();
 	}
 
+	shadowView = shadowData->view;
+	shadowProjection = shadowData->projection;
+	shadowIsDirty = false;
+
 	// Reset pipeline
 	viewport.Width = windowWidth;
 	viewport.Height = windowHeight;
@@ -123,16 +184,18 @@ void Scene::DrawEntities(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 				// Shadow setting 
 				if (dLights == 1) // TODO CHANGE TO BE MORE DYNAMIC
 				{
-					entities[i]->GetMat()->GetVertexShader()->SetMatrix4x4("lightView", lightToShadowData[light]->view);
-					entities[i]->GetMat()->GetVertexShader()->SetMatrix4x4("lightProjection", lightToShadowData[light]->projection);
+					entities[i]->GetVertexShader()->SetMatrix4x4("lightView", lightToShadowData[light]->view);
+					entities[i]->GetVertexShader()->SetMatrix4x4("lightProjection", lightToShadowData[light]->projection);
 					entities[i]->GetMat()->AddTextureSRV("ShadowMap", shadowSRV);
 				}
 
 				dLights++;
 				break;
 			case  LIGHT_TYPE_POINT:
+			{
 				DirectX::XMVECTOR vector1 = DirectX::XMLoadFloat3(&light->position);
-				DirectX::XMVECTOR vector2 = DirectX::XMLoadFloat3(entities[i]->GetTransform()->GetPosition().get());
+				DirectX::XMFLOAT3 entityPos = entities[i]->GetTransform()->GetPosition();
+				DirectX::XMVECTOR vector2 = DirectX::XMLoadFloat3(&entityPos);
 				DirectX::XMVECTOR vectorSub = DirectX::XMVectorSubtract(vector1, vector2);
 				DirectX::XMVECTOR length = DirectX::XMVector3Length(vectorSub);
 
@@ -144,6 +207,7 @@ void Scene::DrawEntities(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
 				name = "pointLight" + std::to_string(pLights);
 				pLights++;
 				break;
+			}
 			case LIGHT_TYPE_SPOT: // Not implemented yet 
 			default:
 				continue;
@@ -189,6 +253,74 @@ void Scene::SetCameras(std::vector<std::shared_ptr<Camera>> cameras)
 void Scene::SetEntities(std::vector<std::shared_ptr<Entity>> entities)
 {
 	(*this).entities = entities;
+	shadowIsDirty = true;
+}
+
+void Scene::BuildStaticBatches(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	// Group static entities by material, in the order they were added
+	std::vector<std::shared_ptr<Entity>> dynamicEntities;
+	std::vector<std::shared_ptr<Material>> batchMaterials;
+	std::vector<std::vector<std::shared_ptr<Entity>>> batchEntities;
+	for (std::shared_ptr<Entity>& entity : entities)
+	{
+		if (!entity->IsStatic())
+		{
+			dynamicEntities.push_back(entity);
+			continue;
+		}
+
+		size_t batch = 0;
+		while (batch < batchMaterials.size() && batchMaterials[batch] != entity->GetMat())
+			batch++;
+		if (batch == batchMaterials.size())
+		{
+			batchMaterials.push_back(entity->GetMat());
+			batchEntities.emplace_back();
+		}
+		batchEntities[batch].push_back(entity);
+	}
+
+	if (batchMaterials.empty())
+		return;
+
+	std::vector<std::shared_ptr<Entity>> batches;
+	for (size_t batch = 0; batch < batchMaterials.size(); batch++)
+	{
+		// Meshes only live on the GPU once they are loaded, so they are read back
+		std::vector<MeshData> geometry(batchEntities[batch].size());
+		std::vector<StaticBatchSource> sources;
+		for (size_t i = 0; i < batchEntities[batch].size(); i++)
+		{
+			std::shared_ptr<Entity>& entity = batchEntities[batch][i];
+			if (!entity->GetModel()->ReadGeometry(geometry[i]))
+			{
+				// Can't be merged, so it keeps drawing on its own
+				dynamicEntities.push_back(entity);
+				continue;
+			}
+
+			StaticBatchSource source;
+			source.mesh = &geometry[i];
+			source.world = entity->GetTransform()->GetWorldMatrix();
+			sources.push_back(source);
+			staticEntities.push_back(entity);
+		}
+
+		if (sources.empty())
+			continue;
+
+		MeshData merged;
+		StaticBatcher::Merge(sources, merged);
+		std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(device, context, merged, false, false);
+		batches.push_back(std::make_shared<Entity>(mesh, batchMaterials[batch]));
+	}
+
+	entities = dynamicEntities;
+	entities.insert(entities.end(), batches.begin(), batches.end());
+	shadowIsDirty = true;
 }
 
 void Scene::SetSky(std::shared_ptr<Sky> sky)
@@ -307,6 +439,55 @@ void Scene::ResizeCam(float windowWidth, float windowHeight)
 	);
 }
 
+std::shared_ptr<Entity> Scene::Pick(float mouseX, float mouseY, float windowWidth, float windowHeight)
+{
+	// Unproject the point on the near and far plane under the mouse
+	std::shared_ptr<Camera> camera = GetCurrentCam();
+	DirectX::XMMATRIX viewProjection = DirectX::XMMatrixMultiply(
+		DirectX::XMLoadFloat4x4(camera->GetViewMatrix().get()),
+		DirectX::XMLoadFloat4x4(camera->GetProjMatrix().get()));
+	DirectX::XMMATRIX inverseViewProjection = DirectX::XMMatrixInverse(nullptr, viewProjection);
+
+	float x = mouseX / windowWidth * 2.0f - 1.0f;
+	float y = 1.0f - mouseY / windowHeight * 2.0f;
+	DirectX::XMVECTOR nearPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(x, y, 0.0f, 1.0f), inverseViewProjection);
+	DirectX::XMVECTOR farPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(x, y, 1.0f, 1.0f), inverseViewProjection);
+	DirectX::XMVECTOR rayDirection = DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(farPoint, nearPoint));
+
+	DirectX::XMFLOAT3 origin;
+	DirectX::XMFLOAT3 direction;
+	DirectX::XMStoreFloat3(&origin, nearPoint);
+	DirectX::XMStoreFloat3(&direction, rayDirection);
+
+	std::shared_ptr<Entity> picked;
+	float closest = FLT_MAX;
+	for (std::shared_ptr<Entity>& entity : entities)
+	{
+		// Miss the bounding sphere and the BVH never has to be built
+		std::shared_ptr<Mesh> model = entity->GetModel();
+		DirectX::XMFLOAT4X4 world = entity->GetTransform()->GetWorldMatrix();
+		DirectX::XMMATRIX worldMatrix = DirectX::XMLoadFloat4x4(&world);
+		float scale = std::max(DirectX::XMVectorGetX(DirectX::XMVector3Length(worldMatrix.r[0])),
+			std::max(DirectX::XMVectorGetX(DirectX::XMVector3Length(worldMatrix.r[1])), DirectX::XMVectorGetX(DirectX::XMVector3Length(worldMatrix.r[2]))));
+		float radius = model->GetBoundsRadius() * scale;
+
+		DirectX::XMFLOAT3 boundsCenter = model->GetBoundsCenter();
+		DirectX::XMVECTOR toCenter = DirectX::XMVectorSubtract(DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&boundsCenter), worldMatrix), nearPoint);
+		float along = DirectX::XMVectorGetX(DirectX::XMVector3Dot(toCenter, rayDirection));
+		float offRaySquared = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(toCenter)) - along * along;
+		if (offRaySquared > radius * radius || along + radius < 0.0f || along - radius > closest)
+			continue;
+
+		MeshHit hit;
+		if (entity->Raycast(origin, direction, closest, hit))
+		{
+			closest = hit.distance;
+			picked = entity;
+		}
+	}
+	return picked;
+}
+
 std::string Scene::GetTitle()
 {
 	return sceneTitle;
@@ -1,8 +1,10 @@
 #include "SceneGui.h"
+#include "EaseLut.h"
 using namespace DirectX;
 
 SceneGui::SceneGui(std::shared_ptr<Scene> scene) :
-	scene(scene)
+	scene(scene),
+	selectionChanged(false)
 
 {
 	keyToEquation = std::unordered_map<std::string, int>();
@@ -15,13 +17,14 @@ void SceneGui::InstructionsGUI()
 	ImGui::TextWrapped("This is an example of a render engine.");
 	ImGui::TextWrapped("In the animation scene you have control over a simple translation animation that opens and closes a sphere with some componenents insides");
 	ImGui::TextWrapped("The generic scene is used to for examples of the rendering ability of this engine and general testing");
+	ImGui::TextWrapped("Right click an object to select it in the entity list");
 	ImGui::End();
 }
 
 void SceneGui::CreateEntityGui(std::shared_ptr<Entity> entity)
 {
 	std::shared_ptr <Transform> trans = entity->GetTransform();
-	XMFLOAT3 pos = *(trans->GetPosition().get());
+	XMFLOAT3 pos = trans->GetPosition();
 	XMFLOAT3 rot = trans->GetEulerRotation();
 	XMFLOAT3 sca = trans->GetScale();
 
@@ -147,13 +150,28 @@ void SceneGui::UpdateEntityGUI(std::vector<std::shared_ptr<Entity>> entities)
 	{
 		// Unique id
 		ImGui::PushID(i);
-		if (ImGui::TreeNode("Entity")) // How to make name based on id? 
+		bool isSelected = entities[i] == selected;
+		if (isSelected && selectionChanged)
+			ImGui::SetNextItemOpen(true);
+		if (ImGui::TreeNodeEx("Entity", isSelected ? ImGuiTreeNodeFlags_Selected : 0)) // How to make name based on id? 
 		{
 			CreateEntityGui(entities[i]);
 			ImGui::TreePop();
 		}
 		ImGui::PopID();
 	}
+	selectionChanged = false;
+}
+
+void SceneGui::SetSelected(std::shared_ptr<Entity> entity)
+{
+	selectionChanged = entity != selected;
+	selected = entity;
+}
+
+std::shared_ptr<Entity> SceneGui::GetSelected()
+{
+	return selected;
 }
 
 
@@ -190,17 +208,10 @@ void SceneGui::CreateCurveGui(int curveType, float plotSizeX, float plotSizeY)
 {
 	ImVec2 size(plotSizeX, plotSizeY);
 
-	float lines[120];
-
-
-	// Actually displays the curve 
-	for (int n = 0; n < 120; n++)
-	{
-		float p = n / 120.0f;
-
-		lines[n] = GetCurveByIndex(curveType, p);
-	}
-	ImGui::PlotLines("AnimCurve", lines, 120, 0, (const char*)0, -0.24f, 1.25f, size);
+	// Actually displays the curve, straight from its table
+	// instead of evaluating it again every frame
+	const EaseTable& table = GetEaseTable(curveType);
+	ImGui::PlotLines("AnimCurve", table.values, EASE_LUT_SIZE + 1, 0, (const char*)0, -0.24f, 1.25f, size);
 }
 
 void SceneGui::CreateCurveGuiWithDropDown(const char* key, int *value, float plotSizeX, float plotSizeY)
@@ -28,6 +28,12 @@ public:
 
 	void CreateEntityGui(std::shared_ptr<Entity> entity);
 	/// <summary>
+	/// Highlight an entity in the entity list and open its settings,
+	/// nullptr clears the selection
+	/// </summary>
+	void SetSelected(std::shared_ptr<Entity> entity);
+	std::shared_ptr<Entity> GetSelected();
+	/// <summary>
 	/// Call this function to automatically create a light
 	/// based on the lights type index
 	/// </summary>
@@ -57,4 +63,8 @@ public:
 	private:
 		std::unordered_map<std::string, int> keyToEquation;
 		std::shared_ptr<Scene> scene;
+
+		// Entity picked in the viewport, opened once when it changes
+		std::shared_ptr<Entity> selected;
+		bool selectionChanged;
 };
\ No newline at end of file
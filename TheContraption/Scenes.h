@@ -40,6 +40,7 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV,
 		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthBufferDSV,
 		std::shared_ptr<SimpleVertexShader> shadowVS,
+		std::shared_ptr<SimpleVertexShader> quantizedShadowVS,
 		int shadowResolutionSize,
 		float windowWidth, float windowHeight);
 	void DrawEntities(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
@@ -54,9 +55,21 @@ public:
 	void SetLights(std::vector<std::shared_ptr<Light>> lights);
 	void SetSky(std::shared_ptr<Sky> sky);
 
+	// Merge the static entities that share a material into one
+	// world space mesh each, which then replace them in the scene.
+	// Call once all entities are set
+	void BuildStaticBatches(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context
+	);
 
 	void ResizeCam(float windowWidth, float windowHeight);
 
+	// Find the entity under a point of the window by casting a ray
+	// from the current camera through it. Returns nullptr if
+	// nothing is there
+	std::shared_ptr<Entity> Pick(float mouseX, float mouseY, float windowWidth, float windowHeight);
+
 	// Recreate the gizmos for light objects 
 	// using the given mesh
 	void GenerateLightGizmos(
@@ -83,6 +96,10 @@ private:
 	// World entities 
 	std::vector<std::shared_ptr<Entity>> entities;
 
+	// Entities that were merged into a static batch, kept
+	// around since the batches only hold their geometry
+	std::vector<std::shared_ptr<Entity>> staticEntities;
+
 	std::shared_ptr<Sky> sky;
 
 	// Camera 
@@ -98,4 +115,13 @@ private:
 	// that want to have shadows 
 	std::unordered_map<Light*, std::shared_ptr<ShadadowShaderData>> lightToShadowData;
 
+	// What the shadow map was last drawn with so it is only redrawn
+	// once a caster has moved or changed shape, or the light has moved 
+	std::vector<unsigned char> shadowCasters;	// Per transform handle, whether it belongs to a caster
+	std::vector<unsigned int> shadowGeometryVersions;
+	unsigned int shadowFrame;					// Transform pool frame whose changed list was last looked at
+	DirectX::XMFLOAT4X4 shadowView;
+	DirectX::XMFLOAT4X4 shadowProjection;
+	bool shadowIsDirty;
+
 };
\ No newline at end of file
@@ -47,6 +47,9 @@ cbuffer ExternalData : register(b0)
 
 	float ditherLevel;
 	float aspect;
+
+	// glTF materials keep roughness in green and metalness in blue of one texture
+	int metalRoughnessPacked;
 }
 
 float2 GetUV(VertexToPixel input)
@@ -62,12 +65,14 @@ float4 GetAlbedo(VertexToPixel input)
 
 float GetRoughness(VertexToPixel input)
 {
-	return RoughnessMap.Sample(BasicSampler, input.uv).r;
+	float4 roughness = RoughnessMap.Sample(BasicSampler, input.uv);
+	return metalRoughnessPacked ? roughness.g : roughness.r;
 }
 
 float GetMetalness(VertexToPixel input)
 {
-	return MetalnessMap.Sample(BasicSampler, input.uv).r;
+	float4 metalness = MetalnessMap.Sample(BasicSampler, input.uv);
+	return metalRoughnessPacked ? metalness.b : metalness.r;
 }
 
 float3 GetSpec(VertexToPixel input)
@@ -214,9 +219,9 @@ float4 main(VertexToPixel input) : SV_TARGET
 
 	// Simplifications include not re-normalizing the same vector more than once!
 	float3 N = normalize(input.normal); // Must be normalized here or before
-	float3 T = normalize(input.tangent); // Must be normalized here or before
+	float3 T = normalize(input.tangent.xyz); // Must be normalized here or before
 	T = normalize(T - N * dot(T, N)); // Gram-Schmidt assumes T&N are normalized!
-	float3 B = cross(T, N);
+	float3 B = cross(T, N) * input.tangent.w;
 	float3x3 TBN = float3x3(T, B, N);
 
 	// Assumes that input.normal is the normal later in the shader
@@ -33,11 +33,43 @@ struct VertexShaderInput
 	//  v    v                v
 	float3 localPosition	: POSITION;     // XYZ position
 	float3 normal			: NORMAL;
-	float3 tangent			: TANGENT;
+	float4 tangent			: TANGENT;      // W is the bitangent handedness
 	float4 uv				: TEXCOORD;
 
 };
 
+// Compact version of VertexShaderInput for quantized meshes
+// - Matches QuantizedVertex in our C++ code
+// - The input layout turns the integers and halves into floats
+struct QuantizedVertexShaderInput
+{
+	float4 localPosition	: POSITION;     // 0-1 across the mesh bounds, W is the handedness
+	float2 normal			: NORMAL;       // Octahedral
+	float2 tangent			: TANGENT;      // Octahedral
+	float2 uv				: TEXCOORD;
+};
+
+// Unfold a point in the -1 to 1 square back into a unit vector
+// - Matches VertexQuantizer::OctDecode
+float3 OctDecode(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+// Expand a quantized vertex into the regular vertex input
+VertexShaderInput DecodeVertex(QuantizedVertexShaderInput input, float3 positionOffset, float3 positionScale)
+{
+	VertexShaderInput output;
+	output.localPosition = positionOffset + input.localPosition.xyz * positionScale;
+	output.normal = OctDecode(input.normal);
+	output.tangent = float4(OctDecode(input.tangent), input.localPosition.w > 0.5f ? 1.0f : -1.0f);
+	output.uv = float4(input.uv, 0.0f, 1.0f);
+	return output;
+}
+
 // Struct representing the data we expect to receive from earlier pipeline stages
 // - Should match the output of our corresponding vertex shader
 // - The name of the struct itself is unimportant
@@ -55,7 +87,7 @@ struct VertexToPixel
 	float2 uv				: TEXCOORD;
     float4 screenPos		: TEXCOORD1;
 	float3 normal			: NORMAL;
-	float3 tangent			: TANGENT;
+	float4 tangent			: TANGENT;
 	float4 shadowMapPos		: SHADOW_POSITION;
 };
 
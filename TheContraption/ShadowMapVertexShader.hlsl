@@ -3,15 +3,27 @@
 // Constant Buffer for external (C++) data
 cbuffer externalData : register(b0)
 {
-	matrix world;
+	row_major float3x4 world;
 	matrix view;
 	matrix projection;
+
+#ifdef QUANTIZED_VERTICES
+	float3 positionOffset;
+	float3 positionScale;
+#endif
 };
 // --------------------------------------------------------
 // A simplified vertex shader for rendering to a shadow map
 // --------------------------------------------------------
+#ifdef QUANTIZED_VERTICES
+float4 main(QuantizedVertexShaderInput quantized) : SV_POSITION
+{
+	VertexShaderInput input = DecodeVertex(quantized, positionOffset, positionScale);
+#else
 float4 main(VertexShaderInput input) : SV_POSITION
 {
-	matrix wvp = mul(projection, mul(view, world));
-	return mul(wvp, float4(input.localPosition, 1.0f));
+#endif
+	float3 worldPos = mul(world, float4(input.localPosition, 1.0f));
+	matrix vp = mul(projection, view);
+	return mul(vp, float4(worldPos, 1.0f));
 }
\ No newline at end of file
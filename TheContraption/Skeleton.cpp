@@ -0,0 +1,142 @@
+#include "Skeleton.h"
+using namespace DirectX;
+
+Skeleton::Skeleton()
+{
+}
+
+Skeleton::~Skeleton()
+{
+
+}
+
+unsigned int Skeleton::AddJoint(const std::string& name, int parent, DirectX::XMFLOAT3 translation, DirectX::XMFLOAT4 rotation, DirectX::XMFLOAT3 scale)
+{
+	unsigned int joint = (unsigned int)parents.size();
+	parent = parent >= 0 && (unsigned int)parent < joint ? parent : SKELETON_NO_PARENT;
+
+	names.push_back(name);
+	parents.push_back(parent);
+	bindPose.translations.push_back(translation);
+	bindPose.rotations.push_back(rotation);
+	bindPose.scales.push_back(scale);
+
+	// The parent's bind matrix is already known, so this
+	// joint's bind and inverse bind can be worked out now
+	AffineMatrix local, bind, inverseBind;
+	ComputeLocalMatrix(bindPose, joint, &local);
+	if (parent == SKELETON_NO_PARENT)
+		bind = local;
+	else
+		AffineMultiply(&bind, local, bindMatrices[parent]);
+	AffineStore(&inverseBind, XMMatrixInverse(nullptr, AffineLoad(bind)));
+
+	bindMatrices.push_back(bind);
+	inverseBindMatrices.push_back(inverseBind);
+	return joint;
+}
+
+unsigned int Skeleton::GetJointCount()
+{
+	return (unsigned int)parents.size();
+}
+
+int Skeleton::GetParent(unsigned int joint)
+{
+	return parents[joint];
+}
+
+int Skeleton::FindJoint(const std::string& name)
+{
+	for (unsigned int i = 0; i < names.size(); i++)
+	{
+		if (names[i] == name)
+			return (int)i;
+	}
+	return -1;
+}
+
+const SkeletonPose& Skeleton::GetBindPose()
+{
+	return bindPose;
+}
+
+void Skeleton::SamplePose(AnimClip& clip, float time, unsigned int* cursors, SkeletonPose& out)
+{
+	out = bindPose;
+
+	unsigned int jointCount = GetJointCount();
+	for (unsigned int t = 0; t < clip.GetTrackCount(); t++)
+	{
+		unsigned int joint = clip.GetTrackPart(t);
+		if (joint >= jointCount)
+			continue;
+
+		XMFLOAT4 value = clip.Sample(t, time, cursors[t]);
+		switch (clip.GetTrackType(t))
+		{
+		case CLIP_TRACK_POSITION:
+			out.translations[joint] = XMFLOAT3(value.x, value.y, value.z);
+			break;
+		case CLIP_TRACK_ROTATION:
+			out.rotations[joint] = value;
+			break;
+		case CLIP_TRACK_SCALE:
+			out.scales[joint] = XMFLOAT3(value.x, value.y, value.z);
+			break;
+		}
+	}
+}
+
+void Skeleton::BlendPoses(const SkeletonPose& a, const SkeletonPose& b, float weight, SkeletonPose& out)
+{
+	size_t jointCount = a.rotations.size();
+	out.translations.resize(jointCount);
+	out.rotations.resize(jointCount);
+	out.scales.resize(jointCount);
+
+	for (size_t j = 0; j < jointCount; j++)
+	{
+		XMStoreFloat3(&out.translations[j], XMVectorLerp(XMLoadFloat3(&a.translations[j]), XMLoadFloat3(&b.translations[j]), weight));
+		XMStoreFloat3(&out.scales[j], XMVectorLerp(XMLoadFloat3(&a.scales[j]), XMLoadFloat3(&b.scales[j]), weight));
+
+		// Normalized lerp, taking the short way around
+		XMVECTOR from = XMLoadFloat4(&a.rotations[j]);
+		XMVECTOR to = XMLoadFloat4(&b.rotations[j]);
+		if (XMVectorGetX(XMVector4Dot(from, to)) < 0.0f)
+			to = -to;
+		XMStoreFloat4(&out.rotations[j], XMQuaternionNormalize(XMVectorLerp(from, to, weight)));
+	}
+}
+
+void Skeleton::ComputeModelMatrices(const SkeletonPose& pose, AffineMatrix* out)
+{
+	// Parents come first, so they are always done by the time a child needs them
+	AffineMatrix local;
+	for (unsigned int j = 0; j < parents.size(); j++)
+	{
+		ComputeLocalMatrix(pose, j, &local);
+		if (parents[j] == SKELETON_NO_PARENT)
+			out[j] = local;
+		else
+			AffineMultiply(&out[j], local, out[parents[j]]);
+	}
+}
+
+void Skeleton::ComputeSkinMatrices(const AffineMatrix* modelMatrices, AffineMatrix* out)
+{
+	for (unsigned int j = 0; j < parents.size(); j++)
+	{
+		AffineMultiply(&out[j], inverseBindMatrices[j], modelMatrices[j]);
+	}
+}
+
+void Skeleton::ComputeLocalMatrix(const SkeletonPose& pose, unsigned int joint, AffineMatrix* out)
+{
+	// Scale, then rotate, then translate, like Transform
+	XMMATRIX local =
+		XMMatrixScalingFromVector(XMLoadFloat3(&pose.scales[joint])) *
+		XMMatrixRotationQuaternion(XMLoadFloat4(&pose.rotations[joint])) *
+		XMMatrixTranslationFromVector(XMLoadFloat3(&pose.translations[joint]));
+	AffineStore(out, local);
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "AffineMatrix.h"
+#include "AnimClip.h"
+
+/*
+	A hierarchy of joints for skinned meshes. Joints are stored
+	parents first, so whole poses are turned into matrices in one
+	linear pass with no recursion. Clips animate a skeleton through
+	tracks whose part is a joint index
+*/
+
+// Parent of the root joint(s)
+#define SKELETON_NO_PARENT -1
+
+/// <summary>
+/// Local transform of every joint, relative to its parent
+/// </summary>
+struct SkeletonPose
+{
+	std::vector<DirectX::XMFLOAT3> translations;
+	std::vector<DirectX::XMFLOAT4> rotations;
+	std::vector<DirectX::XMFLOAT3> scales;
+};
+
+class Skeleton
+{
+public:
+	Skeleton();
+	~Skeleton();
+
+	/// <summary>
+	/// Add a joint in its bind pose. Its parent has to have been added already
+	/// </summary>
+	/// <param name="parent">Index of the parent joint or SKELETON_NO_PARENT</param>
+	/// <returns>Index of the joint</returns>
+	unsigned int AddJoint(const std::string& name, int parent, DirectX::XMFLOAT3 translation, DirectX::XMFLOAT4 rotation, DirectX::XMFLOAT3 scale = DirectX::XMFLOAT3(1, 1, 1));
+
+	unsigned int GetJointCount();
+	int GetParent(unsigned int joint);
+	/// <summary>
+	/// Index of a joint by name, -1 if there is none
+	/// </summary>
+	int FindJoint(const std::string& name);
+	const SkeletonPose& GetBindPose();
+
+	/// <summary>
+	/// Sample a clip into a pose. Joints and channels the clip doesn't key
+	/// keep their bind pose
+	/// </summary>
+	/// <param name="cursors">One per clip track, kept between calls (see AnimClip::Sample)</param>
+	void SamplePose(AnimClip& clip, float time, unsigned int* cursors, SkeletonPose& out);
+	/// <summary>
+	/// Blend two poses of this skeleton, 0 is all a and 1 is all b.
+	/// Out may be either of the inputs
+	/// </summary>
+	static void BlendPoses(const SkeletonPose& a, const SkeletonPose& b, float weight, SkeletonPose& out);
+
+	/// <summary>
+	/// Transform of every joint relative to the mesh
+	/// </summary>
+	/// <param name="out">GetJointCount() matrices</param>
+	void ComputeModelMatrices(const SkeletonPose& pose, AffineMatrix* out);
+	/// <summary>
+	/// What every joint does to the vertices bound to it, which is
+	/// undoing its bind pose and then applying the posed one
+	/// </summary>
+	/// <param name="modelMatrices">From ComputeModelMatrices</param>
+	/// <param name="out">GetJointCount() matrices</param>
+	void ComputeSkinMatrices(const AffineMatrix* modelMatrices, AffineMatrix* out);
+
+private:
+	std::vector<std::string> names;
+	std::vector<int> parents;
+	SkeletonPose bindPose;
+	/// <summary>
+	/// Mesh space to joint space in the bind pose
+	/// </summary>
+	std::vector<AffineMatrix> inverseBindMatrices;
+	/// <summary>
+	/// Joint space to mesh space in the bind pose, parents of new joints need it
+	/// </summary>
+	std::vector<AffineMatrix> bindMatrices;
+
+	static void ComputeLocalMatrix(const SkeletonPose& pose, unsigned int joint, AffineMatrix* out);
+};
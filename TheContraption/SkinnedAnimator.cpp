@@ -0,0 +1,195 @@
+#include "SkinnedAnimator.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cmath>
+using namespace DirectX;
+
+SkinnedAnimator::SkinnedAnimator(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) :
+	device(device),
+	context(context),
+	mode(SKINNING_LINEAR),
+	vertexCount(0),
+	lastSkinTime(0.0f),
+	lastUploadTime(0.0f)
+{
+}
+
+SkinnedAnimator::~SkinnedAnimator()
+{
+
+}
+
+unsigned int SkinnedAnimator::AddCharacter(std::shared_ptr<SkinnedMeshData> model)
+{
+	if (!model || !model->skeleton || model->skin.size() != model->geometry.vertices.size())
+		return SKINNED_NONE;
+
+	characters.push_back(Character());
+	Character& character = characters.back();
+	character.model = model;
+	character.blend = 0.0f;
+	for (unsigned int l = 0; l < 2; l++)
+	{
+		character.layers[l].time = 0.0f;
+		character.layers[l].speed = 1.0f;
+	}
+
+	// Uploaded as it is, meshlets and LODs would stop matching once it deforms
+	MeshData bindGeometry;
+	bindGeometry.vertices = model->geometry.vertices;
+	bindGeometry.indices = model->geometry.indices;
+	character.mesh = std::make_shared<Mesh>(device, context, bindGeometry, false, false);
+
+	unsigned int jointCount = model->skeleton->GetJointCount();
+	character.modelMatrices.resize(jointCount);
+	character.skinMatrices.resize(jointCount);
+	character.dualQuaternions.resize(jointCount);
+	character.skinned.resize(model->geometry.vertices.size());
+	return (unsigned int)characters.size() - 1;
+}
+
+std::shared_ptr<Mesh> SkinnedAnimator::GetMesh(unsigned int character)
+{
+	return character < characters.size() ? characters[character].mesh : nullptr;
+}
+
+void SkinnedAnimator::Play(unsigned int character, std::shared_ptr<AnimClip> clip, unsigned int layer, float speed)
+{
+	if (character >= characters.size() || layer >= 2)
+		return;
+
+	ClipLayer& clipLayer = characters[character].layers[layer];
+	clipLayer.clip = clip;
+	clipLayer.time = 0.0f;
+	clipLayer.speed = speed;
+	clipLayer.cursors.assign(clip ? clip->GetTrackCount() : 0, 0);
+	if (clip)
+		clip->LockTracks();
+}
+
+void SkinnedAnimator::SetBlend(unsigned int character, float weight)
+{
+	if (character >= characters.size())
+		return;
+
+	characters[character].blend = weight < 0.0f ? 0.0f : weight > 1.0f ? 1.0f : weight;
+}
+
+void SkinnedAnimator::UpdateCharacters(float deltaTime)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Characters only touch their own data, so they can be split between threads
+	ThreadPool::GetInstance().ParallelFor((unsigned int)characters.size(), SKINNED_MIN_BATCH_SIZE, [&](unsigned int first, unsigned int last)
+	{
+		SkinCharacters(deltaTime, first, last);
+	});
+
+	auto skinned = std::chrono::high_resolution_clock::now();
+
+	// The device context can only be used from one thread
+	vertexCount = 0;
+	for (unsigned int c = 0; c < characters.size(); c++)
+	{
+		Character& character = characters[c];
+		if (character.skinned.empty())
+			continue;
+
+		character.mesh->UpdateVertices(&character.skinned[0]);
+		vertexCount += (unsigned int)character.skinned.size();
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	lastSkinTime = std::chrono::duration<float, std::milli>(skinned - start).count();
+	lastUploadTime = std::chrono::duration<float, std::milli>(end - skinned).count();
+}
+
+void SkinnedAnimator::SetMode(int mode)
+{
+	(*this).mode = mode == SKINNING_DUAL_QUATERNION ? SKINNING_DUAL_QUATERNION : SKINNING_LINEAR;
+}
+
+int SkinnedAnimator::GetMode()
+{
+	return mode;
+}
+
+unsigned int SkinnedAnimator::GetCharacterCount()
+{
+	return (unsigned int)characters.size();
+}
+
+unsigned int SkinnedAnimator::GetVertexCount()
+{
+	return vertexCount;
+}
+
+float SkinnedAnimator::GetLastSkinTime()
+{
+	return lastSkinTime;
+}
+
+float SkinnedAnimator::GetLastUploadTime()
+{
+	return lastUploadTime;
+}
+
+void SkinnedAnimator::SkinCharacters(float deltaTime, unsigned int first, unsigned int last)
+{
+	for (unsigned int c = first; c < last; c++)
+	{
+		Character& character = characters[c];
+		Skeleton& skeleton = *character.model->skeleton;
+
+		// The second layer keeps time even while it isn't blended in
+		AdvanceLayer(character.layers[0], deltaTime);
+		AdvanceLayer(character.layers[1], deltaTime);
+		SampleLayer(character, character.layers[0], character.pose);
+		if (character.blend > 0.0f)
+		{
+			SampleLayer(character, character.layers[1], character.blendPose);
+			Skeleton::BlendPoses(character.pose, character.blendPose, character.blend, character.pose);
+		}
+
+		skeleton.ComputeModelMatrices(character.pose, &character.modelMatrices[0]);
+		skeleton.ComputeSkinMatrices(&character.modelMatrices[0], &character.skinMatrices[0]);
+		if (mode == SKINNING_DUAL_QUATERNION)
+			Skinning::ToDualQuaternions(&character.skinMatrices[0], skeleton.GetJointCount(), &character.dualQuaternions[0]);
+
+		// Already on a worker, so the vertices stay on this thread
+		const MeshData& geometry = character.model->geometry;
+		Skinning::SkinRange(&geometry.vertices[0], &character.model->skin[0], 0, (unsigned int)geometry.vertices.size(),
+			&character.skinMatrices[0], &character.dualQuaternions[0], mode, &character.skinned[0]);
+	}
+}
+
+void SkinnedAnimator::AdvanceLayer(ClipLayer& layer, float deltaTime)
+{
+	if (!layer.clip)
+		return;
+
+	// Clips that don't loop hold their last frame
+	float duration = layer.clip->GetDuration();
+	layer.time += deltaTime * layer.speed;
+	if (layer.clip->IsLooping() && duration > 0.0f)
+	{
+		layer.time = fmodf(layer.time, duration);
+		layer.time = layer.time < 0.0f ? layer.time + duration : layer.time;
+	}
+	else
+	{
+		layer.time = layer.time < 0.0f ? 0.0f : layer.time > duration ? duration : layer.time;
+	}
+}
+
+void SkinnedAnimator::SampleLayer(Character& character, ClipLayer& layer, SkeletonPose& out)
+{
+	Skeleton& skeleton = *character.model->skeleton;
+	if (!layer.clip)
+	{
+		out = skeleton.GetBindPose();
+		return;
+	}
+
+	skeleton.SamplePose(*layer.clip, layer.time, layer.cursors.empty() ? nullptr : &layer.cursors[0], out);
+}
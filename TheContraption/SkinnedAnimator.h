@@ -0,0 +1,139 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+
+#include "Mesh.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+
+/*
+	Plays clips on skinned characters and deforms their meshes on
+	the CPU. Characters are posed and skinned on several threads at
+	once, each into its own vertex array, and only the upload into
+	their meshes happens on the thread that owns the device context
+*/
+
+// Characters posed and skinned on one thread, below it
+// handing work to other threads costs more than it saves
+#define SKINNED_MIN_BATCH_SIZE 4
+
+// Character id that never refers to a character
+#define SKINNED_NONE 0xffffffff
+
+/// <summary>
+/// Bind pose geometry of a skinned mesh, shared by every character that uses it
+/// </summary>
+struct SkinnedMeshData
+{
+	MeshData geometry;
+	std::vector<VertexSkin> skin;	// One per vertex of the geometry
+	std::shared_ptr<Skeleton> skeleton;
+};
+
+class SkinnedAnimator
+{
+public:
+	SkinnedAnimator(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	~SkinnedAnimator();
+
+	/// <summary>
+	/// Make a character with its own mesh to deform, starting in the bind pose
+	/// </summary>
+	/// <returns>Id of the character</returns>
+	unsigned int AddCharacter(std::shared_ptr<SkinnedMeshData> model);
+	/// <summary>
+	/// The mesh a character is deformed into, for an Entity to draw
+	/// </summary>
+	std::shared_ptr<Mesh> GetMesh(unsigned int character);
+
+	/// <summary>
+	/// Play a clip on a character from the start, the clip's
+	/// track parts are joint indices of its skeleton
+	/// </summary>
+	/// <param name="layer">0 for the main clip, 1 for the one blended over it</param>
+	void Play(unsigned int character, std::shared_ptr<AnimClip> clip, unsigned int layer = 0, float speed = 1.0f);
+	/// <summary>
+	/// How much of the second layer's pose is blended over the first one.
+	/// Both layers keep playing at 0, so fading back in stays in step
+	/// </summary>
+	void SetBlend(unsigned int character, float weight);
+
+	/// <summary>
+	/// Advance, pose and skin every character, then upload their vertices
+	/// </summary>
+	void UpdateCharacters(float deltaTime);
+
+	/// <summary>
+	/// How joints are blended per vertex, see Skinning.h
+	/// </summary>
+	void SetMode(int mode);
+	int GetMode();
+
+	unsigned int GetCharacterCount();
+	/// <summary>
+	/// Vertices deformed by the last update
+	/// </summary>
+	unsigned int GetVertexCount();
+	/// <summary>
+	/// How long posing and skinning took in the last update, in milliseconds
+	/// </summary>
+	float GetLastSkinTime();
+	/// <summary>
+	/// How long uploading the deformed vertices took in the last update, in milliseconds
+	/// </summary>
+	float GetLastUploadTime();
+
+private:
+	/// <summary>
+	/// A clip playing on a character
+	/// </summary>
+	struct ClipLayer
+	{
+		std::shared_ptr<AnimClip> clip;
+		float time;
+		float speed;
+		std::vector<unsigned int> cursors;
+	};
+
+	struct Character
+	{
+		std::shared_ptr<SkinnedMeshData> model;
+		std::shared_ptr<Mesh> mesh;
+
+		ClipLayer layers[2];
+		float blend;
+
+		// Scratch space of every update, kept to avoid reallocating
+		SkeletonPose pose;
+		SkeletonPose blendPose;
+		std::vector<AffineMatrix> modelMatrices;
+		std::vector<AffineMatrix> skinMatrices;
+		std::vector<DualQuaternion> dualQuaternions;
+		std::vector<Vertex> skinned;
+	};
+
+	/// <summary>
+	/// Advance, pose and skin a range of characters
+	/// </summary>
+	void SkinCharacters(float deltaTime, unsigned int first, unsigned int last);
+	/// <summary>
+	/// Move a layer's time along, wrapping or holding at the ends
+	/// </summary>
+	static void AdvanceLayer(ClipLayer& layer, float deltaTime);
+	/// <summary>
+	/// Sample a layer's clip, or the bind pose if it has none
+	/// </summary>
+	static void SampleLayer(Character& character, ClipLayer& layer, SkeletonPose& out);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	std::vector<Character> characters;
+	int mode;
+
+	unsigned int vertexCount;
+	float lastSkinTime;
+	float lastUploadTime;
+};
@@ -0,0 +1,134 @@
+#include "Skinning.h"
+#include "ThreadPool.h"
+#include <vector>
+using namespace DirectX;
+
+/// <summary>
+/// Rotate a vector by a unit quaternion, same as XMVector3Rotate
+/// without building the conjugate
+/// </summary>
+static inline XMVECTOR RotateVector(FXMVECTOR v, FXMVECTOR q)
+{
+	XMVECTOR twice = XMVector3Cross(q, v) * 2.0f;
+	return v + XMVectorSplatW(q) * twice + XMVector3Cross(q, twice);
+}
+
+void Skinning::ToDualQuaternions(const AffineMatrix* skinMatrices, unsigned int jointCount, DualQuaternion* out)
+{
+	for (unsigned int j = 0; j < jointCount; j++)
+	{
+		XMVECTOR scale, rotation, translation;
+		XMMatrixDecompose(&scale, &rotation, &translation, AffineLoad(skinMatrices[j]));
+
+		// Half of the translation (as a pure quaternion) times the rotation
+		XMVECTOR dual = XMQuaternionMultiply(rotation, XMVectorSetW(translation, 0.0f)) * 0.5f;
+		XMStoreFloat4(&out[j].real, rotation);
+		XMStoreFloat4(&out[j].dual, dual);
+	}
+}
+
+void Skinning::Skin(const Vertex* vertices, const VertexSkin* skin, unsigned int vertexCount,
+	const AffineMatrix* skinMatrices, const DualQuaternion* dualQuaternions, int mode, Vertex* out)
+{
+	ThreadPool::GetInstance().ParallelFor(vertexCount, SKINNING_MIN_BATCH_SIZE, [=](unsigned int begin, unsigned int end)
+	{
+		SkinRange(vertices, skin, begin, end, skinMatrices, dualQuaternions, mode, out);
+	});
+}
+
+void Skinning::SkinRange(const Vertex* vertices, const VertexSkin* skin, unsigned int begin, unsigned int end,
+	const AffineMatrix* skinMatrices, const DualQuaternion* dualQuaternions, int mode, Vertex* out)
+{
+	if (mode == SKINNING_DUAL_QUATERNION)
+		SkinDualQuaternion(vertices, skin, begin, end, dualQuaternions, out);
+	else
+		SkinLinear(vertices, skin, begin, end, skinMatrices, out);
+}
+
+void Skinning::SkinLinear(const Vertex* vertices, const VertexSkin* skin, unsigned int begin, unsigned int end, const AffineMatrix* skinMatrices, Vertex* out)
+{
+	for (unsigned int v = begin; v < end; v++)
+	{
+		const Vertex& vertex = vertices[v];
+		const VertexSkin& influence = skin[v];
+		const float* weights = &influence.Weights.x;
+
+		// Weighted sum of the joint matrices, a whole stored row at a time
+		XMVECTOR row0 = XMVectorZero();
+		XMVECTOR row1 = XMVectorZero();
+		XMVECTOR row2 = XMVectorZero();
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			if (weights[i] == 0.0f)
+				continue;
+
+			const AffineMatrix& joint = skinMatrices[influence.Joints[i]];
+			XMVECTOR weight = XMVectorReplicate(weights[i]);
+			row0 = XMVectorMultiplyAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(joint.m[0])), weight, row0);
+			row1 = XMVectorMultiplyAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(joint.m[1])), weight, row1);
+			row2 = XMVectorMultiplyAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(joint.m[2])), weight, row2);
+		}
+
+		// Stored rows are columns of the full matrix
+		XMMATRIX blended = XMMatrixTranspose(XMMATRIX(row0, row1, row2, XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f)));
+
+		// Normals and tangents only get the upper 3x3, which is only
+		// right for uniform scale but is what every joint has here
+		Vertex& skinned = out[v];
+		XMStoreFloat3(&skinned.Position, XMVector3Transform(XMLoadFloat3(&vertex.Position), blended));
+		XMStoreFloat3(&skinned.Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vertex.Normal), blended)));
+		XMVECTOR tangent = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat4(&vertex.Tangent), blended));
+		XMStoreFloat4(&skinned.Tangent, XMVectorSetW(tangent, vertex.Tangent.w));
+		skinned.UV = vertex.UV;
+	}
+}
+
+void Skinning::SkinDualQuaternion(const Vertex* vertices, const VertexSkin* skin, unsigned int begin, unsigned int end, const DualQuaternion* dualQuaternions, Vertex* out)
+{
+	for (unsigned int v = begin; v < end; v++)
+	{
+		const Vertex& vertex = vertices[v];
+		const VertexSkin& influence = skin[v];
+		const float* weights = &influence.Weights.x;
+
+		// Every joint is blended on the same side as the first one,
+		// otherwise opposite quaternions would cancel each other out
+		XMVECTOR pivot = XMLoadFloat4(&dualQuaternions[influence.Joints[0]].real);
+		XMVECTOR real = XMVectorZero();
+		XMVECTOR dual = XMVectorZero();
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			if (weights[i] == 0.0f)
+				continue;
+
+			const DualQuaternion& joint = dualQuaternions[influence.Joints[i]];
+			XMVECTOR jointReal = XMLoadFloat4(&joint.real);
+			float weight = XMVectorGetX(XMVector4Dot(jointReal, pivot)) < 0.0f ? -weights[i] : weights[i];
+			real = XMVectorMultiplyAdd(jointReal, XMVectorReplicate(weight), real);
+			dual = XMVectorMultiplyAdd(XMLoadFloat4(&joint.dual), XMVectorReplicate(weight), dual);
+		}
+
+		// A vertex without any weight follows the first joint instead of
+		// dividing by zero, linear blending gives it a zero matrix
+		if (XMVectorGetX(XMVector4LengthSq(real)) > 0.0f)
+		{
+			XMVECTOR length = XMVector4Length(real);
+			real /= length;
+			dual /= length;
+		}
+		else
+		{
+			real = pivot;
+			dual = XMLoadFloat4(&dualQuaternions[influence.Joints[0]].dual);
+		}
+
+		// Translation back out of the dual part, twice the dual times the conjugate
+		XMVECTOR translation = (XMVectorSplatW(real) * dual - XMVectorSplatW(dual) * real + XMVector3Cross(real, dual)) * 2.0f;
+
+		Vertex& skinned = out[v];
+		XMStoreFloat3(&skinned.Position, RotateVector(XMLoadFloat3(&vertex.Position), real) + translation);
+		XMStoreFloat3(&skinned.Normal, RotateVector(XMLoadFloat3(&vertex.Normal), real));
+		XMStoreFloat4(&skinned.Tangent, XMVectorSetW(RotateVector(XMLoadFloat4(&vertex.Tangent), real), vertex.Tangent.w));
+		skinned.UV = vertex.UV;
+	}
+}
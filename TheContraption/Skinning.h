@@ -0,0 +1,58 @@
+#pragma once
+#include <DirectXMath.h>
+
+#include "AffineMatrix.h"
+#include "Vertex.h"
+
+/*
+	Deforms the vertices of skinned meshes on the CPU. Every vertex
+	blends up to four joints, either as matrices (linear blend
+	skinning) or as dual quaternions, which keeps twisting joints
+	from collapsing at the cost of ignoring joint scale. Large
+	meshes are split between threads, each vertex is independent
+*/
+
+// How joint transforms are blended per vertex
+#define SKINNING_LINEAR 0
+#define SKINNING_DUAL_QUATERNION 1
+
+// Fewer vertices than this per thread is not worth a thread
+#define SKINNING_MIN_BATCH_SIZE 16384
+
+/// <summary>
+/// Rotation and translation of a joint. The real part is the
+/// rotation, the dual part half the translation times it
+/// </summary>
+struct DualQuaternion
+{
+	DirectX::XMFLOAT4 real;
+	DirectX::XMFLOAT4 dual;
+};
+
+class Skinning
+{
+public:
+	/// <summary>
+	/// Turn skin matrices into dual quaternions. Any scale is dropped
+	/// </summary>
+	static void ToDualQuaternions(const AffineMatrix* skinMatrices, unsigned int jointCount, DualQuaternion* out);
+
+	/// <summary>
+	/// Deform every vertex, split between threads when there are enough
+	/// </summary>
+	/// <param name="skinMatrices">Used by SKINNING_LINEAR, from Skeleton::ComputeSkinMatrices</param>
+	/// <param name="dualQuaternions">Used by SKINNING_DUAL_QUATERNION, from ToDualQuaternions</param>
+	/// <param name="mode">SKINNING define of how to blend the joints</param>
+	static void Skin(const Vertex* vertices, const VertexSkin* skin, unsigned int vertexCount,
+		const AffineMatrix* skinMatrices, const DualQuaternion* dualQuaternions, int mode, Vertex* out);
+	/// <summary>
+	/// Deform a range of vertices on this thread, for callers that
+	/// already split their work between threads
+	/// </summary>
+	static void SkinRange(const Vertex* vertices, const VertexSkin* skin, unsigned int begin, unsigned int end,
+		const AffineMatrix* skinMatrices, const DualQuaternion* dualQuaternions, int mode, Vertex* out);
+
+private:
+	static void SkinLinear(const Vertex* vertices, const VertexSkin* skin, unsigned int begin, unsigned int end, const AffineMatrix* skinMatrices, Vertex* out);
+	static void SkinDualQuaternion(const Vertex* vertices, const VertexSkin* skin, unsigned int begin, unsigned int end, const DualQuaternion* dualQuaternions, Vertex* out);
+};
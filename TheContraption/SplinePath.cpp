@@ -0,0 +1,255 @@
+#include "SplinePath.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+using namespace DirectX;
+
+/// <summary>
+/// Basis of every spline type, row r is the weight of each of a segment's
+/// four control points in the coefficient of t^(3 - r)
+/// </summary>
+static const float SPLINE_BASIS[SPLINE_TYPE_COUNT][4][4] =
+{
+	// Catmull-Rom
+	{
+		{ -0.5f,  1.5f, -1.5f,  0.5f },
+		{  1.0f, -2.5f,  2.0f, -0.5f },
+		{ -0.5f,  0.0f,  0.5f,  0.0f },
+		{  0.0f,  1.0f,  0.0f,  0.0f },
+	},
+	// Bezier
+	{
+		{ -1.0f,  3.0f, -3.0f,  1.0f },
+		{  3.0f, -6.0f,  3.0f,  0.0f },
+		{ -3.0f,  3.0f,  0.0f,  0.0f },
+		{  1.0f,  0.0f,  0.0f,  0.0f },
+	},
+	// B-spline
+	{
+		{ -1.0f / 6.0f,  3.0f / 6.0f, -3.0f / 6.0f,  1.0f / 6.0f },
+		{  3.0f / 6.0f, -6.0f / 6.0f,  3.0f / 6.0f,  0.0f },
+		{ -3.0f / 6.0f,  0.0f,         3.0f / 6.0f,  0.0f },
+		{  1.0f / 6.0f,  4.0f / 6.0f,  1.0f / 6.0f,  0.0f },
+	},
+};
+
+SplinePath::SplinePath(int type, const std::vector<DirectX::XMFLOAT3>& points, bool closed) :
+	type(type >= 0 && type < SPLINE_TYPE_COUNT ? type : SPLINE_CATMULL_ROM),
+	closed(closed),
+	length(0.0f)
+{
+	BuildSegments(points);
+	BuildTable();
+}
+
+SplinePath::~SplinePath()
+{
+
+}
+
+DirectX::XMVECTOR SplinePath::Sample(float distance, DirectX::XMVECTOR* direction) const
+{
+	float parameter = Reparameterize(distance);
+	unsigned int segment = std::min((unsigned int)parameter, (unsigned int)segments.size() - 1);
+	return EvaluateSegment(segments[segment], XMVectorReplicate(parameter - segment), direction);
+}
+
+void SplinePath::SampleBatch(const float* distances, unsigned int count, DirectX::XMFLOAT3* positions, DirectX::XMFLOAT3* directions) const
+{
+	unsigned int lastSegment = (unsigned int)segments.size() - 1;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float parameter = Reparameterize(distances[i]);
+		unsigned int segment = std::min((unsigned int)parameter, lastSegment);
+
+		XMVECTOR direction;
+		XMStoreFloat3(&positions[i], EvaluateSegment(segments[segment], XMVectorReplicate(parameter - segment), directions ? &direction : nullptr));
+		if (directions)
+			XMStoreFloat3(&directions[i], direction);
+	}
+}
+
+DirectX::XMVECTOR SplinePath::Evaluate(float parameter) const
+{
+	float segmentCount = (float)segments.size();
+	parameter = parameter < 0.0f ? 0.0f : parameter > segmentCount ? segmentCount : parameter;
+	unsigned int segment = std::min((unsigned int)parameter, (unsigned int)segments.size() - 1);
+	return EvaluateSegment(segments[segment], XMVectorReplicate(parameter - segment), nullptr);
+}
+
+int SplinePath::GetType()
+{
+	return type;
+}
+
+bool SplinePath::IsClosed()
+{
+	return closed;
+}
+
+unsigned int SplinePath::GetSegmentCount()
+{
+	return (unsigned int)segments.size();
+}
+
+float SplinePath::GetLength()
+{
+	return length;
+}
+
+float SplinePath::Reparameterize(float distance) const
+{
+	// Closed paths go around again, open ones stop at their ends
+	distance = closed ? distance - floorf(distance) : distance < 0.0f ? 0.0f : distance > 1.0f ? 1.0f : distance;
+
+	float entry = distance * (table.size() - 1);
+	unsigned int before = std::min((unsigned int)entry, (unsigned int)table.size() - 2);
+	float t = entry - before;
+
+	// Hermite through both entries and their slopes, the speed along a
+	// curve changes too much between entries for a straight blend
+	const XMFLOAT2& from = table[before];
+	const XMFLOAT2& to = table[before + 1];
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return (2.0f * t3 - 3.0f * t2 + 1.0f) * from.x + (t3 - 2.0f * t2 + t) * from.y
+		+ (-2.0f * t3 + 3.0f * t2) * to.x + (t3 - t2) * to.y;
+}
+
+DirectX::XMVECTOR SplinePath::EvaluateSegment(const Segment& segment, DirectX::FXMVECTOR t, DirectX::XMVECTOR* direction) const
+{
+	XMVECTOR a = XMLoadFloat4(&segment.a);
+	XMVECTOR b = XMLoadFloat4(&segment.b);
+	XMVECTOR c = XMLoadFloat4(&segment.c);
+	XMVECTOR d = XMLoadFloat4(&segment.d);
+
+	// Derivative of the cubic, 3a * t^2 + 2b * t + c
+	if (direction)
+		*direction = XMVector3Normalize(XMVectorMultiplyAdd(XMVectorMultiplyAdd(a * 3.0f, t, b * 2.0f), t, c));
+
+	return XMVectorMultiplyAdd(XMVectorMultiplyAdd(XMVectorMultiplyAdd(a, t, b), t, c), t, d);
+}
+
+void SplinePath::BuildSegments(const std::vector<DirectX::XMFLOAT3>& points)
+{
+	// How many segments the points make, and where each one's four points start
+	int count = (int)points.size();
+	int segmentCount = 0;
+	int stride = 1;
+	int offset = 0;
+	switch (type)
+	{
+	case SPLINE_CATMULL_ROM:
+		segmentCount = count < 2 ? 0 : closed ? count : count - 1;
+		offset = -1;
+		break;
+	case SPLINE_BEZIER:
+		segmentCount = closed ? (count >= 3 ? count / 3 : 0) : (count >= 4 ? (count - 1) / 3 : 0);
+		stride = 3;
+		break;
+	case SPLINE_B_SPLINE:
+		// Closed ones start around the first point instead of the second
+		segmentCount = closed ? (count >= 3 ? count : 0) : (count >= 4 ? count - 3 : 0);
+		offset = closed ? -1 : 0;
+		break;
+	}
+
+	const float (*basis)[4] = SPLINE_BASIS[type];
+	for (int s = 0; s < segmentCount; s++)
+	{
+		// Open Catmull-Rom paths repeat their end points for the missing neighbours
+		XMVECTOR control[4];
+		for (int k = 0; k < 4; k++)
+		{
+			int index = s * stride + offset + k;
+			index = closed ? (index % count + count) % count : std::min(std::max(index, 0), count - 1);
+			control[k] = XMLoadFloat3(&points[index]);
+		}
+
+		XMVECTOR coefficients[4];
+		for (int r = 0; r < 4; r++)
+		{
+			coefficients[r] = control[0] * basis[r][0] + control[1] * basis[r][1] + control[2] * basis[r][2] + control[3] * basis[r][3];
+		}
+
+		Segment segment;
+		XMStoreFloat4(&segment.a, coefficients[0]);
+		XMStoreFloat4(&segment.b, coefficients[1]);
+		XMStoreFloat4(&segment.c, coefficients[2]);
+		XMStoreFloat4(&segment.d, coefficients[3]);
+		segments.push_back(segment);
+	}
+
+	// Too few points for a curve, it stays on the first one (or the origin)
+	if (segments.empty())
+	{
+		Segment segment = {};
+		if (count > 0)
+			segment.d = XMFLOAT4(points[0].x, points[0].y, points[0].z, 0.0f);
+		segments.push_back(segment);
+	}
+}
+
+void SplinePath::BuildTable()
+{
+	// Length from the start to evenly spaced parameters, in straight pieces
+	unsigned int steps = (unsigned int)segments.size() * SPLINE_LENGTH_STEPS;
+	std::vector<float> lengths(steps + 1, 0.0f);
+	XMVECTOR previous = Evaluate(0.0f);
+	for (unsigned int i = 1; i <= steps; i++)
+	{
+		XMVECTOR point = Evaluate((float)i / SPLINE_LENGTH_STEPS);
+		lengths[i] = lengths[i - 1] + XMVectorGetX(XMVector3Length(point - previous));
+		previous = point;
+	}
+	length = lengths[steps];
+
+	// Invert it once here, so sampling never has to search for a distance
+	unsigned int entries = (unsigned int)segments.size() * SPLINE_TABLE_RESOLUTION + 1;
+	table.resize(entries);
+	unsigned int step = 0;
+	for (unsigned int e = 0; e < entries; e++)
+	{
+		if (length <= 0.0f)
+		{
+			table[e] = XMFLOAT2((float)segments.size() * e / (entries - 1), 0.0f);
+			continue;
+		}
+
+		float target = length * e / (entries - 1);
+		while (step + 1 < steps && lengths[step + 1] < target)
+		{
+			step++;
+		}
+
+		float piece = lengths[step + 1] - lengths[step];
+		float blend = piece > 0.0f ? (target - lengths[step]) / piece : 0.0f;
+		blend = blend < 0.0f ? 0.0f : blend > 1.0f ? 1.0f : blend;
+		table[e].x = (step + blend) / SPLINE_LENGTH_STEPS;
+	}
+	table[entries - 1].x = (float)segments.size();
+
+	if (length <= 0.0f)
+		return;
+
+	// Slope of the parameter is the length of an entry over the speed of the
+	// curve there. Capped at three times either neighbouring interval, so it
+	// never runs backwards where the curve slows to a stop
+	float entryLength = length / (entries - 1);
+	for (unsigned int e = 0; e < entries; e++)
+	{
+		float parameter = table[e].x;
+		unsigned int segmentIndex = std::min((unsigned int)parameter, (unsigned int)segments.size() - 1);
+		const Segment& segment = segments[segmentIndex];
+		XMVECTOR t = XMVectorReplicate(parameter - segmentIndex);
+		XMVECTOR derivative = XMVectorMultiplyAdd(XMVectorMultiplyAdd(XMLoadFloat4(&segment.a) * 3.0f, t, XMLoadFloat4(&segment.b) * 2.0f), t, XMLoadFloat4(&segment.c));
+		float speed = XMVectorGetX(XMVector3Length(derivative));
+
+		float limit = FLT_MAX;
+		if (e > 0)
+			limit = std::min(limit, 3.0f * (table[e].x - table[e - 1].x));
+		if (e + 1 < entries)
+			limit = std::min(limit, 3.0f * (table[e + 1].x - table[e].x));
+		table[e].y = speed * limit > entryLength ? entryLength / speed : limit;
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+
+/*
+	Cubic spline paths to move things along at a constant speed.
+	Every segment is turned into a cubic polynomial once, and an
+	arc-length table is built alongside it that maps a fraction of
+	the path's length straight to a curve parameter. Sampling is a
+	table read, a cubic blend between two entries and the segment's
+	cubic, with no searching or root finding, so many objects can be
+	moved along a path every frame
+*/
+
+// Kind of curve the control points describe
+#define SPLINE_CATMULL_ROM 0	// Passes through every point
+#define SPLINE_BEZIER 1			// Points in fours sharing their ends, passes through every third one
+#define SPLINE_B_SPLINE 2		// Smoothest, passes near the points but not through them
+#define SPLINE_TYPE_COUNT 3
+
+// Straight pieces every segment is split into when measuring its length
+#define SPLINE_LENGTH_STEPS 64
+
+// Arc-length table entries per segment, more makes the speed more even. At
+// 32 it stays within about 1%, except right where a curve stops dead (like
+// at a B-spline point repeated three times), where it only roughly follows
+#define SPLINE_TABLE_RESOLUTION 32
+
+class SplinePath
+{
+public:
+	/// <summary>
+	/// Build a path and its arc-length table
+	/// </summary>
+	/// <param name="type">SPLINE define of how to read the points</param>
+	/// <param name="points">At least 2 for Catmull-Rom, 4 for Bezier and B-splines. Open Bezier
+	/// paths use 3 more per segment, closed ones wrap around and use 3 per segment</param>
+	/// <param name="closed">Whether the end joins back onto the start</param>
+	SplinePath(int type, const std::vector<DirectX::XMFLOAT3>& points, bool closed = false);
+	~SplinePath();
+
+	/// <summary>
+	/// Point and direction at a fraction of the path's length. Closed paths
+	/// wrap around, open ones hold at their ends
+	/// </summary>
+	/// <param name="direction">Unit length, optional</param>
+	DirectX::XMVECTOR Sample(float distance, DirectX::XMVECTOR* direction = nullptr) const;
+	/// <summary>
+	/// Sample many fractions of the length at once
+	/// </summary>
+	/// <param name="directions">Unit length, optional</param>
+	void SampleBatch(const float* distances, unsigned int count, DirectX::XMFLOAT3* positions, DirectX::XMFLOAT3* directions = nullptr) const;
+
+	/// <summary>
+	/// Point at a curve parameter, 0 to GetSegmentCount(). Speed along
+	/// the path is uneven this way, it's what the table is built from
+	/// </summary>
+	DirectX::XMVECTOR Evaluate(float parameter) const;
+
+	int GetType();
+	bool IsClosed();
+	unsigned int GetSegmentCount();
+	float GetLength();
+
+private:
+	/// <summary>
+	/// Cubic of one segment, a * t^3 + b * t^2 + c * t + d
+	/// </summary>
+	struct Segment
+	{
+		DirectX::XMFLOAT4 a;
+		DirectX::XMFLOAT4 b;
+		DirectX::XMFLOAT4 c;
+		DirectX::XMFLOAT4 d;
+	};
+
+	/// <summary>
+	/// Curve parameter of a fraction of the length, from the table
+	/// </summary>
+	float Reparameterize(float distance) const;
+	DirectX::XMVECTOR EvaluateSegment(const Segment& segment, DirectX::FXMVECTOR t, DirectX::XMVECTOR* direction) const;
+	void BuildSegments(const std::vector<DirectX::XMFLOAT3>& points);
+	void BuildTable();
+
+	int type;
+	bool closed;
+	float length;
+
+	std::vector<Segment> segments;
+	// Curve parameter at evenly spaced fractions of the length (x), and
+	// how fast it changes from one entry to the next there (y)
+	std::vector<DirectX::XMFLOAT2> table;
+};
@@ -0,0 +1,87 @@
+#include "StaticBatcher.h"
+#include <cfloat>
+#include <cmath>
+using namespace DirectX;
+
+void StaticBatcher::Merge(const std::vector<StaticBatchSource>& sources, MeshData& out)
+{
+	out = MeshData();
+
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	for (const StaticBatchSource& source : sources)
+	{
+		vertexCount += source.mesh->vertices.size();
+		indexCount += source.mesh->indices.size();
+	}
+	out.vertices.reserve(vertexCount);
+	out.indices.reserve(indexCount);
+	out.meshlets.reserve(sources.size());
+
+	for (const StaticBatchSource& source : sources)
+	{
+		AppendSource(source, out);
+	}
+
+	out.lods.push_back({ 0, (unsigned int)out.indices.size(), 0.0f });
+}
+
+void StaticBatcher::AppendSource(const StaticBatchSource& source, MeshData& out)
+{
+	const MeshData& mesh = *source.mesh;
+	unsigned int vertexBase = (unsigned int)out.vertices.size();
+	unsigned int indexBase = (unsigned int)out.indices.size();
+
+	// Normals need the inverse transpose so non uniform scale doesn't skew them
+	XMMATRIX world = XMLoadFloat4x4(&source.world);
+	XMMATRIX normalMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, world));
+
+	// A mirroring transform turns triangles inside out and flips the tangent frame
+	bool mirrored = XMVectorGetX(XMMatrixDeterminant(world)) < 0.0f;
+
+	XMVECTOR minBounds = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxBounds = XMVectorReplicate(-FLT_MAX);
+	for (const Vertex& v : mesh.vertices)
+	{
+		Vertex placed = v;
+		XMVECTOR position = XMVector3TransformCoord(XMLoadFloat3(&v.Position), world);
+		XMStoreFloat3(&placed.Position, position);
+		XMStoreFloat3(&placed.Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&v.Normal), normalMatrix)));
+
+		XMFLOAT3 tangent(v.Tangent.x, v.Tangent.y, v.Tangent.z);
+		XMStoreFloat3(&tangent, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&tangent), world)));
+		placed.Tangent = XMFLOAT4(tangent.x, tangent.y, tangent.z, mirrored ? -v.Tangent.w : v.Tangent.w);
+
+		out.vertices.push_back(placed);
+		minBounds = XMVectorMin(minBounds, position);
+		maxBounds = XMVectorMax(maxBounds, position);
+	}
+
+	for (unsigned int i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		out.indices.push_back(vertexBase + mesh.indices[i + 0]);
+		out.indices.push_back(vertexBase + mesh.indices[mirrored ? i + 2 : i + 1]);
+		out.indices.push_back(vertexBase + mesh.indices[mirrored ? i + 1 : i + 2]);
+	}
+
+	// The range is culled by its sphere only, a cutoff of 1 never passes the cone test
+	Meshlet range = {};
+	range.indexOffset = indexBase;
+	range.triangleCount = ((unsigned int)out.indices.size() - indexBase) / 3;
+	range.vertexCount = (unsigned int)mesh.vertices.size();
+	range.coneCutoff = 1.0f;
+
+	if (!mesh.vertices.empty())
+	{
+		XMVECTOR center = (minBounds + maxBounds) * 0.5f;
+		XMVECTOR radiusSq = XMVectorZero();
+		for (unsigned int v = vertexBase; v < out.vertices.size(); v++)
+		{
+			radiusSq = XMVectorMax(radiusSq, XMVector3LengthSq(XMLoadFloat3(&out.vertices[v].Position) - center));
+		}
+		XMStoreFloat3(&range.center, center);
+		range.radius = std::sqrt(XMVectorGetX(radiusSq));
+	}
+
+	out.meshlets.push_back(range);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+
+#include "MeshData.h"
+
+/*
+	Merges the geometry of entities that never move into one mesh
+	in world space, so everything sharing a material can be drawn
+	with a single draw call. Each source keeps its own range of the
+	index buffer, described as a meshlet with a bounding sphere and
+	no normal cone, so Mesh culls the sources like any meshlet
+*/
+
+// One mesh placed in the world
+struct StaticBatchSource
+{
+	const MeshData* mesh;
+	DirectX::XMFLOAT4X4 world;
+};
+
+class StaticBatcher
+{
+public:
+	/// <summary>
+	/// Transform every source into world space and append them to one
+	/// mesh. Sources keep their order, the meshlets of the result are
+	/// their index ranges and the result has a single LOD
+	/// </summary>
+	static void Merge(const std::vector<StaticBatchSource>& sources, MeshData& out);
+
+private:
+	static void AppendSource(const StaticBatchSource& source, MeshData& out);
+};
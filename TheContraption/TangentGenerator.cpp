@@ -0,0 +1,219 @@
+#include "TangentGenerator.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+using namespace DirectX;
+
+// Vertex that has not been split yet
+#define TANGENT_NO_MIRROR 0xffffffff
+
+void TangentGenerator::Generate(MeshData& mesh, int mode)
+{
+	unsigned int triangleCount = (unsigned int)mesh.indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	std::vector<Face> faces;
+	ComputeFaces(mesh.vertices.data(), mesh.indices.data(), triangleCount, mode, faces);
+
+	// MikkTSpace never lets one vertex serve both sides of a uv mirror
+	if (mode == TANGENT_MODE_MIKKTSPACE)
+		SplitMirroredVertices(mesh, faces);
+
+	GatherVertices(mesh.vertices.data(), (unsigned int)mesh.vertices.size(), mesh.indices.data(), (unsigned int)mesh.indices.size(), faces, mode);
+}
+
+void TangentGenerator::Generate(Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, int mode)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	std::vector<Face> faces;
+	ComputeFaces(vertices, indices, triangleCount, mode, faces);
+	GatherVertices(vertices, vertexCount, indices, indexCount, faces, mode);
+}
+
+void TangentGenerator::ComputeFaces(const Vertex* vertices, const unsigned int* indices, unsigned int triangleCount, int mode, std::vector<Face>& faces)
+{
+	faces.resize(triangleCount);
+	Face* output = faces.data();
+	ThreadPool::GetInstance().ParallelFor(triangleCount, TANGENT_MIN_BATCH_SIZE, [=](unsigned int begin, unsigned int end)
+	{
+		ComputeFaceRange(vertices, indices, begin, end, mode, output);
+	});
+}
+
+void TangentGenerator::ComputeFaceRange(const Vertex* vertices, const unsigned int* indices, unsigned int begin, unsigned int end, int mode, Face* faces)
+{
+	for (unsigned int t = begin; t < end; t++)
+	{
+		const Vertex& v0 = vertices[indices[t * 3 + 0]];
+		const Vertex& v1 = vertices[indices[t * 3 + 1]];
+		const Vertex& v2 = vertices[indices[t * 3 + 2]];
+
+		XMVECTOR p0 = XMLoadFloat3(&v0.Position);
+		XMVECTOR d1 = XMLoadFloat3(&v1.Position) - p0;
+		XMVECTOR d2 = XMLoadFloat3(&v2.Position) - p0;
+
+		float s1 = v1.UV.x - v0.UV.x;
+		float t1 = v1.UV.y - v0.UV.y;
+		float s2 = v2.UV.x - v0.UV.x;
+		float t2 = v2.UV.y - v0.UV.y;
+		float determinant = s1 * t2 - s2 * t1;
+
+		// Directions of increasing u and v, both scaled by the determinant
+		XMVECTOR tangent = d1 * t2 - d2 * t1;
+		XMVECTOR bitangent = d2 * s1 - d1 * s2;
+
+		Face& face = faces[t];
+
+		// Zero area in uv space has no tangent to speak of, so the
+		// triangle is left out instead of dividing by zero
+		if (determinant == 0.0f || !std::isfinite(determinant))
+		{
+			face.tangent = XMFLOAT3(0, 0, 0);
+			face.handedness = 0.0f;
+			continue;
+		}
+
+		// The shaders rebuild the bitangent as cross(T, N) * w, which has to
+		// point towards decreasing v since uvs were flipped on import. Both
+		// vectors share the determinant so its sign cancels out here
+		XMVECTOR normal = XMVector3Cross(d1, d2);
+		float side = XMVectorGetX(XMVector3Dot(XMVector3Cross(tangent, normal), bitangent));
+		face.handedness = side <= 0.0f ? 1.0f : -1.0f;
+
+		// Dividing by the determinant weights the tangent by area,
+		// MikkTSpace only keeps the direction
+		if (mode == TANGENT_MODE_FAST)
+			tangent /= determinant;
+		else
+			tangent = XMVector3Normalize(determinant < 0.0f ? -tangent : tangent);
+
+		XMStoreFloat3(&face.tangent, tangent);
+	}
+}
+
+void TangentGenerator::SplitMirroredVertices(MeshData& mesh, const std::vector<Face>& faces)
+{
+	// Which handedness each vertex is used with (1 = right, 2 = left)
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	std::vector<unsigned char> sides(vertexCount, 0);
+	for (unsigned int i = 0; i < mesh.indices.size(); i++)
+	{
+		float handedness = faces[i / 3].handedness;
+		sides[mesh.indices[i]] |= handedness > 0.0f ? 1 : handedness < 0.0f ? 2 : 0;
+	}
+
+	// Left handed triangles move over to a copy of any vertex used both ways
+	std::vector<unsigned int> mirror(vertexCount, TANGENT_NO_MIRROR);
+	for (unsigned int i = 0; i < mesh.indices.size(); i++)
+	{
+		unsigned int v = mesh.indices[i];
+		if (sides[v] != 3 || faces[i / 3].handedness >= 0.0f)
+			continue;
+
+		if (mirror[v] == TANGENT_NO_MIRROR)
+		{
+			Vertex copy = mesh.vertices[v];
+			mirror[v] = (unsigned int)mesh.vertices.size();
+			mesh.vertices.push_back(copy);
+		}
+
+		mesh.indices[i] = mirror[v];
+	}
+}
+
+void TangentGenerator::GatherVertices(Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, const std::vector<Face>& faces, int mode)
+{
+	// Corners around each vertex, one vertex after another
+	std::vector<unsigned int> cornerStart(vertexCount + 1, 0);
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		cornerStart[indices[i] + 1]++;
+	}
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		cornerStart[v + 1] += cornerStart[v];
+	}
+
+	std::vector<unsigned int> corners(indexCount);
+	std::vector<unsigned int> fill(cornerStart.begin(), cornerStart.end() - 1);
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		corners[fill[indices[i]]++] = i;
+	}
+
+	const Face* faceData = faces.data();
+	const unsigned int* startData = cornerStart.data();
+	const unsigned int* cornerData = corners.data();
+	ThreadPool::GetInstance().ParallelFor(vertexCount, TANGENT_MIN_BATCH_SIZE, [=](unsigned int begin, unsigned int end)
+	{
+		GatherVertexRange(vertices, indices, faceData, startData, cornerData, begin, end, mode);
+	});
+}
+
+void TangentGenerator::GatherVertexRange(Vertex* vertices, const unsigned int* indices, const Face* faces,
+	const unsigned int* cornerStart, const unsigned int* corners,
+	unsigned int begin, unsigned int end, int mode)
+{
+	for (unsigned int v = begin; v < end; v++)
+	{
+		XMVECTOR normal = XMVector3Normalize(XMLoadFloat3(&vertices[v].Normal));
+		XMVECTOR sum = XMVectorZero();
+		float handedness = 0.0f;
+
+		for (unsigned int c = cornerStart[v]; c < cornerStart[v + 1]; c++)
+		{
+			unsigned int corner = corners[c];
+			const Face& face = faces[corner / 3];
+			XMVECTOR tangent = XMLoadFloat3(&face.tangent);
+			handedness += face.handedness;
+
+			if (mode == TANGENT_MODE_FAST)
+			{
+				sum += tangent;
+				continue;
+			}
+
+			// Weight by the angle the triangle covers at this corner,
+			// measured in the plane of the vertex normal
+			unsigned int triangle = corner - corner % 3;
+			XMVECTOR p = XMLoadFloat3(&vertices[indices[corner]].Position);
+			XMVECTOR next = XMLoadFloat3(&vertices[indices[triangle + (corner + 1) % 3]].Position) - p;
+			XMVECTOR previous = XMLoadFloat3(&vertices[indices[triangle + (corner + 2) % 3]].Position) - p;
+			next = XMVector3Normalize(next - normal * XMVector3Dot(normal, next));
+			previous = XMVector3Normalize(previous - normal * XMVector3Dot(normal, previous));
+			float cosine = std::min(1.0f, std::max(-1.0f, XMVectorGetX(XMVector3Dot(next, previous))));
+
+			tangent = XMVector3Normalize(tangent - normal * XMVector3Dot(normal, tangent));
+			sum += tangent * std::acos(cosine);
+		}
+
+		// Gram-Schmidt so the tangent is exactly 90 degrees from the normal
+		XMVECTOR tangent = sum - normal * XMVector3Dot(normal, sum);
+		if (XMVectorGetX(XMVector3LengthSq(tangent)) > 1e-20f)
+			tangent = XMVector3Normalize(tangent);
+		else
+			tangent = AnyPerpendicular(normal);
+
+		XMStoreFloat4(&vertices[v].Tangent, XMVectorSetW(tangent, handedness < 0.0f ? -1.0f : 1.0f));
+	}
+}
+
+XMVECTOR TangentGenerator::AnyPerpendicular(FXMVECTOR normal)
+{
+	// Cross with whichever axis is furthest from the normal
+	XMFLOAT3 n;
+	XMStoreFloat3(&n, XMVectorAbs(normal));
+	XMVECTOR axis =
+		n.x <= n.y && n.x <= n.z ? XMVectorSet(1, 0, 0, 0) :
+		n.y <= n.z ? XMVectorSet(0, 1, 0, 0) :
+		XMVectorSet(0, 0, 1, 0);
+
+	XMVECTOR tangent = XMVector3Cross(normal, axis);
+	if (XMVectorGetX(XMVector3LengthSq(tangent)) <= 0.0f)
+		return XMVectorSet(1, 0, 0, 0);
+	return XMVector3Normalize(tangent);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+
+#include "MeshData.h"
+
+/*
+	Calculates the tangent and bitangent handedness of every
+	vertex. Triangles are processed on several threads and each
+	vertex then gathers from the triangles around it, so no two
+	threads ever write to the same vertex
+*/
+
+// Area weighted sum of the triangle tangents (the original approach)
+#define TANGENT_MODE_FAST 0
+
+// Same weighting and splitting rules as MikkTSpace so normal maps
+// baked by other tools line up
+#define TANGENT_MODE_MIKKTSPACE 1
+
+// Fewer triangles or vertices than this per thread is not worth a thread
+#define TANGENT_MIN_BATCH_SIZE 16384
+
+class TangentGenerator
+{
+public:
+	/// <summary>
+	/// Calculate tangents for every vertex of the mesh. In MikkTSpace mode
+	/// vertices shared by triangles with mirrored uvs are split in two
+	/// </summary>
+	static void Generate(MeshData& mesh, int mode = TANGENT_MODE_MIKKTSPACE);
+	/// <summary>
+	/// Calculate tangents in place without adding any vertices
+	/// </summary>
+	static void Generate(Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, int mode = TANGENT_MODE_MIKKTSPACE);
+
+private:
+	// Tangent of one triangle in uv space
+	struct Face
+	{
+		DirectX::XMFLOAT3 tangent;
+		float handedness;	// 1 or -1, 0 if the uvs are degenerate
+	};
+
+	static void ComputeFaces(const Vertex* vertices, const unsigned int* indices, unsigned int triangleCount, int mode, std::vector<Face>& faces);
+	static void ComputeFaceRange(const Vertex* vertices, const unsigned int* indices, unsigned int begin, unsigned int end, int mode, Face* faces);
+	static void SplitMirroredVertices(MeshData& mesh, const std::vector<Face>& faces);
+
+	static void GatherVertices(Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, const std::vector<Face>& faces, int mode);
+	static void GatherVertexRange(Vertex* vertices, const unsigned int* indices, const Face* faces,
+		const unsigned int* cornerStart, const unsigned int* corners,
+		unsigned int begin, unsigned int end, int mode);
+
+	static DirectX::XMVECTOR AnyPerpendicular(DirectX::FXMVECTOR normal);
+};
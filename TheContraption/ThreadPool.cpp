@@ -0,0 +1,82 @@
+#include "ThreadPool.h"
+
+ThreadPool* ThreadPool::instance;
+
+// Set while a thread is working on a range, so a loop started from
+// inside one doesn't wait on workers that may all be busy with it
+static thread_local bool insideRange = false;
+
+ThreadPool::ThreadPool() :
+	current(nullptr),
+	generation(0)
+{
+	// This thread makes up the last one. Workers run until the program exits
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	for (unsigned int i = 0; i + 1 < threadCount; i++)
+	{
+		threads.emplace_back(&ThreadPool::WorkerLoop, this);
+		threads.back().detach();
+	}
+}
+
+unsigned int ThreadPool::GetThreadCount()
+{
+	return (unsigned int)threads.size() + 1;
+}
+
+void ThreadPool::Run(Job& job)
+{
+	if (job.rangeCount <= 1 || insideRange || threads.empty())
+	{
+		job.invoke(job.function, 0, job.count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submitLock(submitMutex);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		current = &job;
+		generation++;
+	}
+	wake.notify_all();
+
+	RunRanges(job);
+
+	// Every range is taken by now, workers that haven't joined in
+	// never will, the ones that did are waited on before the job goes away
+	std::unique_lock<std::mutex> lock(mutex);
+	current = nullptr;
+	finished.wait(lock, [&job]() { return job.workers == 0; });
+}
+
+void ThreadPool::RunRanges(Job& job)
+{
+	insideRange = true;
+	for (unsigned int r = job.nextRange++; r < job.rangeCount; r = job.nextRange++)
+	{
+		job.invoke(job.function,
+			(unsigned int)((unsigned long long)job.count * r / job.rangeCount),
+			(unsigned int)((unsigned long long)job.count * (r + 1) / job.rangeCount));
+	}
+	insideRange = false;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	unsigned long long seen = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [&]() { return current != nullptr && generation != seen; });
+		seen = generation;
+		Job* job = current;
+		job->workers++;
+
+		lock.unlock();
+		RunRanges(*job);
+		lock.lock();
+
+		if (--job->workers == 0)
+			finished.notify_all();
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Worker threads shared by every system that splits a loop between
+	threads. They are started once and sleep until there is work, so
+	splitting a loop costs a wake up instead of starting and joining a
+	thread per range. The calling thread always works on its own loop
+	too, and loops started from inside a range run on that thread alone
+*/
+
+class ThreadPool
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static ThreadPool& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new ThreadPool();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	ThreadPool(ThreadPool const&) = delete;
+	void operator=(ThreadPool const&) = delete;
+
+private:
+	static ThreadPool* instance;
+	ThreadPool();
+#pragma endregion
+
+public:
+	/// <summary>
+	/// Split 0 to count into ranges and run them on the workers and this
+	/// thread, returning once every range is done
+	/// </summary>
+	/// <param name="minBatchSize">Fewest items a range is worth, fewer items than twice this run on this thread alone</param>
+	/// <param name="function">Called as function(first, last) once per range, from any thread</param>
+	template<typename Function>
+	void ParallelFor(unsigned int count, unsigned int minBatchSize, Function function);
+
+	/// <summary>
+	/// Threads a loop can be split between, this one included
+	/// </summary>
+	unsigned int GetThreadCount();
+
+private:
+	// One loop being split, lives on the stack of the thread that started it
+	struct Job
+	{
+		void (*invoke)(void* function, unsigned int first, unsigned int last);
+		void* function;
+		unsigned int count;
+		unsigned int rangeCount;
+		std::atomic<unsigned int> nextRange;
+		unsigned int workers;	// Workers still inside the job, guarded by the mutex
+	};
+
+	template<typename Function>
+	static void Invoke(void* function, unsigned int first, unsigned int last);
+
+	void Run(Job& job);
+	void RunRanges(Job& job);
+	void WorkerLoop();
+
+	std::vector<std::thread> threads;
+
+	// Only one loop is handed to the workers at a time
+	std::mutex submitMutex;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	Job* current;
+	unsigned long long generation;
+};
+
+template<typename Function>
+void ThreadPool::ParallelFor(unsigned int count, unsigned int minBatchSize, Function function)
+{
+	unsigned int rangeCount = minBatchSize > 0 ? count / minBatchSize : count;
+	rangeCount = rangeCount > GetThreadCount() ? GetThreadCount() : rangeCount;
+
+	Job job;
+	job.invoke = &Invoke<Function>;
+	job.function = &function;
+	job.count = count;
+	job.rangeCount = rangeCount < 1 ? 1 : rangeCount;
+	job.nextRange = 0;
+	job.workers = 0;
+	Run(job);
+}
+
+template<typename Function>
+void ThreadPool::Invoke(void* function, unsigned int first, unsigned int last)
+{
+	(*static_cast<Function*>(function))(first, last);
+}
@@ -1,181 +1,153 @@
 #include "Transform.h"
+#include <cmath>
 
 Transform::Transform() :
-	position(std::make_shared<DirectX::XMFLOAT3>(0.0f, 0.0f, 0.0f)),
-	eulerRotation(0.0f, 0.0f, 0.0f),
-	scale(1.0f, 1.0f, 1.0f)
+	pool(&TransformPool::GetInstance())
 {
-	DirectX::XMStoreFloat4x4(&world, DirectX::XMMatrixIdentity());
-	DirectX::XMStoreFloat4x4(&worldTranspose, DirectX::XMMatrixIdentity());
-
-	matIsDirty = true;
-	dirIsDirty = true;
-
-	parent = nullptr;
-
-	CleanVectors();
+	handle = pool->Allocate();
 }
 
-#pragma region HELPERS
-
-void Transform::CleanMatrices()
+Transform::~Transform()
 {
-	// Create a new world if transform has been mutated 
-	if (matIsDirty)
+	// Children outliving this transform go back to world space
+	for (unsigned int i = 0; i < children.size(); i++)
 	{
-		// Get each of parts that represent the world matrix 
-		DirectX::XMMATRIX pos =
-			DirectX::XMMatrixTranslationFromVector(
-				DirectX::XMLoadFloat3(position.get()));
-
-		DirectX::XMMATRIX rot =
-			DirectX::XMMatrixRotationRollPitchYawFromVector(DirectX::XMLoadFloat3(&eulerRotation));
-
-		DirectX::XMMATRIX sc =
-			DirectX::XMMatrixScalingFromVector(
-				XMLoadFloat3(&scale));
-
-		// Update the matricies 
-		DirectX::XMMATRIX wm = pos * rot * sc;
-		DirectX::XMStoreFloat4x4(&world, wm);
-		DirectX::XMStoreFloat4x4(&worldTranspose,
-			DirectX::XMMatrixInverse(0, DirectX::XMMatrixTranspose(wm)));
-
-		matIsDirty = false;
+		children[i]->parent.reset();
+		pool->SetParent(children[i]->handle, TRANSFORM_NO_PARENT);
 	}
-}
 
-void Transform::CleanVectors()
-{
-	if (!dirIsDirty)
-		return;
-
-	DirectX::XMVECTOR rotQuat = DirectX::XMQuaternionRotationRollPitchYawFromVector(DirectX::XMLoadFloat3(&eulerRotation));
-	DirectX::XMStoreFloat3(&right, DirectX::XMVector3Rotate(DirectX::XMVectorSet(1, 0, 0, 0), rotQuat));
-	DirectX::XMStoreFloat3(&up, DirectX::XMVector3Rotate(DirectX::XMVectorSet(0, 1, 0, 0), rotQuat));
-	DirectX::XMStoreFloat3(&forward, DirectX::XMVector3Rotate(DirectX::XMVectorSet(0, 0, 1, 0), rotQuat));
-
-	dirIsDirty = false;
+	pool->Free(handle);
 }
-#pragma endregion 
 
 #pragma region SETTERS
 
 void Transform::SetPosition(float x, float y, float z)
 {
-	// Was there a XMFloat function for this? 
-	position.get()->x = x;
-	position.get()->y = y;
-	position.get()->z = z;
-
-	matIsDirty = true;
+	pool->SetPosition(handle, DirectX::XMFLOAT3(x, y, z));
 }
 
 void Transform::SetPosition(DirectX::XMFLOAT3 position)
 {
-	*(this->position.get()) = position;
-
-	matIsDirty = true;
+	pool->SetPosition(handle, position);
 }
 
 void Transform::SetEulerRotation(float pitch, float yaw, float roll)
 {
-	eulerRotation.x = pitch;
-	eulerRotation.y = yaw;
-	eulerRotation.z = roll;
-
-	matIsDirty = true;
-	dirIsDirty = true;
+	DirectX::XMFLOAT4 rotation;
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionRotationRollPitchYaw(pitch, yaw, roll));
+	pool->SetRotation(handle, rotation);
 }
 
 void Transform::SetEulerRotation(DirectX::XMFLOAT3 rotation)
 {
-	this->eulerRotation = rotation;
+	SetEulerRotation(rotation.x, rotation.y, rotation.z);
+}
 
-	matIsDirty = true;
-	dirIsDirty = true;
+void Transform::SetRotation(DirectX::XMFLOAT4 rotation)
+{
+	pool->SetRotation(handle, rotation);
 }
 
 void Transform::SetScale(float x, float y, float z)
 {
-	scale.x = x;
-	scale.y = y;
-	scale.z = z;
-
-	matIsDirty = true;
+	pool->SetScale(handle, DirectX::XMFLOAT3(x, y, z));
 }
 
 void Transform::SetScale(DirectX::XMFLOAT3 scale)
 {
-	this->scale = scale;
-
-	matIsDirty = true;
+	pool->SetScale(handle, scale);
 }
 
 void Transform::SetScale(float s)
 {
 	SetScale(s, s, s);
-
-	matIsDirty = true;
 }
 
 #pragma endregion
 
 #pragma region GETTERS
-std::shared_ptr<DirectX::XMFLOAT3> Transform::GetPosition()
+DirectX::XMFLOAT3 Transform::GetPosition()
 {
-	return position;
+	return pool->GetPosition(handle);
 }
 
 DirectX::XMFLOAT3 Transform::GetEulerRotation()
 {
-	return eulerRotation;
+	// Pull the angles back out of the rotation matrix, following
+	// the same roll, pitch, yaw order XMMatrixRotationRollPitchYaw uses
+	DirectX::XMFLOAT4 q = pool->GetRotation(handle);
+	DirectX::XMFLOAT4X4 m;
+	DirectX::XMStoreFloat4x4(&m, DirectX::XMMatrixRotationQuaternion(DirectX::XMLoadFloat4(&q)));
+
+	float sinPitch = -m._32;
+	sinPitch = sinPitch > 1.0f ? 1.0f : (sinPitch < -1.0f ? -1.0f : sinPitch);
+
+	DirectX::XMFLOAT3 euler;
+	euler.x = std::asin(sinPitch);
+
+	if (std::abs(sinPitch) < 0.9999f)
+	{
+		euler.y = std::atan2(m._31, m._33);
+		euler.z = std::atan2(m._12, m._22);
+	}
+	else
+	{
+		// Looking straight up or down, yaw and roll share an axis
+		euler.y = std::atan2(-m._13, m._11);
+		euler.z = 0.0f;
+	}
+
+	return euler;
+}
+
+DirectX::XMFLOAT4 Transform::GetRotation()
+{
+	return pool->GetRotation(handle);
 }
 
 DirectX::XMFLOAT3 Transform::GetScale()
 {
-	return scale;
+	return pool->GetScale(handle);
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-	CleanMatrices();
-	return world;
+	return AffineToFloat4x4(pool->GetWorldMatrix(handle));
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 {
-	CleanMatrices();
-	return worldTranspose;
+	return AffineToFloat4x4(pool->GetWorldInverseTransposeMatrix(handle));
 }
 
-DirectX::XMFLOAT3 Transform::GetRight()
+const AffineMatrix& Transform::GetAffineWorldMatrix()
 {
-	if (dirIsDirty)
-		CleanVectors();
+	return pool->GetWorldMatrix(handle);
+}
 
-	return right;
+const AffineMatrix& Transform::GetAffineWorldInverseTransposeMatrix()
+{
+	return pool->GetWorldInverseTransposeMatrix(handle);
 }
 
-DirectX::XMFLOAT3 Transform::GetUp()
+DirectX::XMFLOAT3 Transform::GetRight()
 {
-	if (dirIsDirty)
-		CleanVectors();
+	return pool->GetRight(handle);
+}
 
-	return up;
+DirectX::XMFLOAT3 Transform::GetUp()
+{
+	return pool->GetUp(handle);
 }
 
 DirectX::XMFLOAT3 Transform::GetForward()
 {
-	if (dirIsDirty)
-		CleanVectors();
-
-	return forward;
+	return pool->GetForward(handle);
 }
 
 std::shared_ptr<Transform> Transform::GetParent()
 {
-	return parent;
+	return parent.lock();
 }
 
 std::shared_ptr<Transform> Transform::GetChild(unsigned int index)
@@ -185,7 +157,7 @@ std::shared_ptr<Transform> Transform::GetChild(unsigned int index)
 
 int Transform::GetChildIndex(std::shared_ptr<Transform> child)
 {
-	// Better to have a has table? 
+	// Better to have a has table?
 
 	unsigned int size = (unsigned int)children.size();
 	for (unsigned int i = 0; i < size; i++)
@@ -196,7 +168,7 @@ int Transform::GetChildIndex(std::shared_ptr<Transform> child)
 		}
 	}
 
-	// If not value is found 
+	// If not value is found
 	return -1;
 }
 
@@ -205,117 +177,137 @@ unsigned int Transform::GetChildCount()
 	return (unsigned int)children.size();
 }
 
+unsigned int Transform::GetHandle()
+{
+	return handle;
+}
+
+unsigned int Transform::GetVersion()
+{
+	return pool->GetVersion(handle);
+}
+
 #pragma endregion
 
-#pragma region MUTATORS 
+#pragma region MUTATORS
 void Transform::MoveAbs(float x, float y, float z)
 {
-	this->position.get()->x += x;
-	this->position.get()->y += y;
-	this->position.get()->z += z;
-	matIsDirty = true;
+	DirectX::XMFLOAT3 position = pool->GetPosition(handle);
+	position.x += x;
+	position.y += y;
+	position.z += z;
+	pool->SetPosition(handle, position);
 }
 
 void Transform::MoveAbs(DirectX::XMFLOAT3 offset)
 {
-	this->position.get()->x += offset.x;
-	this->position.get()->y += offset.y;
-	this->position.get()->z += offset.z;
-	matIsDirty = true;
+	MoveAbs(offset.x, offset.y, offset.z);
 }
 
 void Transform::MoveRelative(float x, float y, float z)
 {
-	// Turn the euler angles into a quaternion 
-	DirectX::XMVECTOR rotQuat = DirectX::XMQuaternionRotationRollPitchYawFromVector(
-		DirectX::XMLoadFloat3(&eulerRotation)
-	);
-	
-	// Creat the movement variable 
-	DirectX::XMVECTOR toMove = DirectX::XMVectorSet(x, y, z, 0);
+	// The local axes already hold the rotation so
+	// there is no need to rebuild a quaternion here
+	DirectX::XMFLOAT3 r = pool->GetRight(handle);
+	DirectX::XMFLOAT3 u = pool->GetUp(handle);
+	DirectX::XMFLOAT3 f = pool->GetForward(handle);
 
-	// Convert to local space 
-	toMove = DirectX::XMVector3Rotate(toMove, rotQuat);
+	DirectX::XMVECTOR toMove =
+		DirectX::XMLoadFloat3(&r) * x +
+		DirectX::XMLoadFloat3(&u) * y +
+		DirectX::XMLoadFloat3(&f) * z;
 
-	// Add in local space 
-	toMove = DirectX::XMVectorAdd(DirectX::XMLoadFloat3(position.get()), toMove);
-
-	// Store 
-	DirectX::XMStoreFloat3(position.get(), toMove);
-	matIsDirty = true;
+	// Add in local space
+	DirectX::XMFLOAT3 position = pool->GetPosition(handle);
+	DirectX::XMStoreFloat3(&position, DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&position), toMove));
+	pool->SetPosition(handle, position);
 }
 
 void Transform::MoveRelative(DirectX::XMFLOAT3 vec)
 {
-	// Setup 
-	DirectX::XMVECTOR rotEuler = DirectX::XMLoadFloat3(&eulerRotation);
-	
-	// Turn the euler angles into a quaternion 
-	DirectX::XMVECTOR rotQuat = DirectX::XMQuaternionRotationRollPitchYaw(
-		(float)DirectX::XMVectorGetIntX(rotEuler),
-		(float)DirectX::XMVectorGetIntY(rotEuler),
-		(float)DirectX::XMVectorGetIntZ(rotEuler)
-	);
-	
-	DirectX::XMVECTOR toMove = DirectX::XMLoadFloat3(&vec);
-
-	// Convert to local space 
-	toMove = DirectX::XMVector3Rotate(toMove, rotQuat);
+	MoveRelative(vec.x, vec.y, vec.z);
+}
 
-	// Add in local space 
-	toMove = DirectX::XMVectorAdd(DirectX::XMLoadFloat3(position.get()), toMove);
+void Transform::RotateEuler(float pitch, float yaw, float roll)
+{
+	// Applying the change first keeps it in local space
+	DirectX::XMFLOAT4 rotation = pool->GetRotation(handle);
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionMultiply(
+		DirectX::XMQuaternionRotationRollPitchYaw(pitch, yaw, roll),
+		DirectX::XMLoadFloat4(&rotation)));
+	pool->SetRotation(handle, rotation);
+}
 
-	// Store 
-	DirectX::XMStoreFloat3(position.get(), toMove);
+void Transform::RotateEuler(DirectX::XMFLOAT3 rotation)
+{
+	RotateEuler(rotation.x, rotation.y, rotation.z);
+}
 
-	matIsDirty = true;
+void Transform::Rotate(DirectX::XMFLOAT3 axis, float angle)
+{
+	// Applying the change last keeps it in world space
+	DirectX::XMFLOAT4 rotation = pool->GetRotation(handle);
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionMultiply(
+		DirectX::XMLoadFloat4(&rotation),
+		DirectX::XMQuaternionRotationAxis(DirectX::XMLoadFloat3(&axis), angle)));
+	pool->SetRotation(handle, rotation);
 }
 
-void Transform::RotateEuler(float pitch, float yaw, float roll)
+void Transform::RotateLocal(DirectX::XMFLOAT3 axis, float angle)
 {
-	eulerRotation.x += pitch;
-	eulerRotation.y += yaw;
-	eulerRotation.z += roll;
+	DirectX::XMFLOAT4 rotation = pool->GetRotation(handle);
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionMultiply(
+		DirectX::XMQuaternionRotationAxis(DirectX::XMLoadFloat3(&axis), angle),
+		DirectX::XMLoadFloat4(&rotation)));
+	pool->SetRotation(handle, rotation);
+}
 
-	matIsDirty = true;
-	dirIsDirty = true;
+void Transform::Slerp(DirectX::XMFLOAT4 target, float t)
+{
+	DirectX::XMFLOAT4 rotation = pool->GetRotation(handle);
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionSlerp(
+		DirectX::XMLoadFloat4(&rotation),
+		DirectX::XMLoadFloat4(&target),
+		t));
+	pool->SetRotation(handle, rotation);
 }
 
-void Transform::RotateEuler(DirectX::XMFLOAT3 rotation)
+void Transform::LookAt(DirectX::XMFLOAT3 target, DirectX::XMFLOAT3 up)
 {
-	eulerRotation.x += rotation.x;
-	eulerRotation.y += rotation.y;
-	eulerRotation.z += rotation.z;
+	DirectX::XMFLOAT3 position = pool->GetPosition(handle);
+	DirectX::XMVECTOR dir = DirectX::XMLoadFloat3(&target) - DirectX::XMLoadFloat3(&position);
 
-	matIsDirty = true;
-	dirIsDirty = true;
+	// Already at the target so there is no direction to face
+	if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(dir)) < 0.000001f)
+		return;
+
+	// A view matrix is the inverse of the orientation we want,
+	// and the inverse of a rotation is its transpose
+	DirectX::XMMATRIX view = DirectX::XMMatrixLookToLH(
+		DirectX::XMVectorZero(), dir, DirectX::XMLoadFloat3(&up));
+
+	DirectX::XMFLOAT4 rotation;
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionRotationMatrix(DirectX::XMMatrixTranspose(view)));
+	pool->SetRotation(handle, rotation);
 }
 
 void Transform::Scale(float x, float y, float z)
 {
+	DirectX::XMFLOAT3 scale = pool->GetScale(handle);
 	scale.x += x;
 	scale.y += y;
 	scale.z += z;
-
-	matIsDirty = true;
+	pool->SetScale(handle, scale);
 }
 
 void Transform::Scale(DirectX::XMFLOAT3 scale)
 {
-	this->scale.x += scale.x;
-	this->scale.y += scale.y;
-	this->scale.z += scale.z;
-
-	matIsDirty = true;
+	Scale(scale.x, scale.y, scale.z);
 }
 
 void Transform::Scale(float scale)
 {
-	this->scale.x += scale;
-	this->scale.y += scale;
-	this->scale.z += scale;
-
-	matIsDirty = true;
+	Scale(scale, scale, scale);
 }
 
 #pragma endregion
@@ -324,28 +316,56 @@ void Transform::Scale(float scale)
 
 void Transform::AddChild(std::shared_ptr<Transform> child)
 {
-	children.push_back(child);
+	child->SetParent(shared_from_this());
 }
 
 void Transform::RemoveChild(std::shared_ptr<Transform> child)
 {
-	int index = GetChildIndex(child);
-	children[index]->SetParent(nullptr);
-	children.erase(children.begin() + index);
+	if (GetChildIndex(child) == -1)
+		return;
+
+	child->SetParent(nullptr);
 }
 
 void Transform::RemoveChild(int childIndex)
 {
-	children.erase(children.begin() + childIndex);
+	children[childIndex]->SetParent(nullptr);
 }
 
 void Transform::SetParent(std::shared_ptr<Transform> parent)
 {
-	//// Check if currently a child 
-	//if (parent != nullptr)
-	//{
-	//	parent->RemoveChild()
-	//}
+	std::shared_ptr<Transform> current = this->parent.lock();
+	if (current == parent)
+		return;
+
+	// A transform can't become a child of its own children
+	for (std::shared_ptr<Transform> p = parent; p != nullptr; p = p->GetParent())
+	{
+		if (p.get() == this)
+			return;
+	}
+
+	// Keep this transform alive while it is moved between parents
+	std::shared_ptr<Transform> self = shared_from_this();
+
+	// Check if currently a child
+	if (current != nullptr)
+	{
+		int index = current->GetChildIndex(self);
+		if (index != -1)
+			current->children.erase(current->children.begin() + index);
+	}
+
+	this->parent = parent;
+	if (parent != nullptr)
+	{
+		parent->children.push_back(self);
+		pool->SetParent(handle, (int)parent->handle);
+	}
+	else
+	{
+		pool->SetParent(handle, TRANSFORM_NO_PARENT);
+	}
 }
 
 #pragma endregion
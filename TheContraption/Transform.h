@@ -3,43 +3,21 @@
 #include <memory>
 #include <vector>
 
-class Transform
+#include "TransformPool.h"
+
+class Transform : public std::enable_shared_from_this<Transform>
 {
 private:
 
 	/// <summary>
-	/// Represents this objects scale in x, y, and z components 
-	/// </summary>
-	DirectX::XMFLOAT3 scale;
-	/// <summary>
-	/// Represents this objects rotation as a euler 
-	/// </summary>
-	DirectX::XMFLOAT3 eulerRotation;
-
-	DirectX::XMFLOAT4X4 world;
-	DirectX::XMFLOAT4X4 worldTranspose;
-
-	/// <summary>
-	/// Set the matricies so that they accomodate mutations 
-	/// </summary>
-	void CleanMatrices();
-	void CleanVectors();
-
-	bool matIsDirty;
-	bool dirIsDirty;
-
-	// Local Vectors 
-	DirectX::XMFLOAT3 right;
-	DirectX::XMFLOAT3 up;
-	DirectX::XMFLOAT3 forward;
-
-	/// <summary>
-	/// Represents this objects position in x, y, and z components 
+	/// Index of this transform's data inside of the transform pool 
 	/// </summary>
-	std::shared_ptr<DirectX::XMFLOAT3> position;
+	unsigned int handle;
+	TransformPool* pool;
 
 	std::vector<std::shared_ptr<Transform>> children;
-	std::shared_ptr<Transform> parent;
+	// Weak so that a parent and child don't keep each other alive 
+	std::weak_ptr<Transform> parent;
 
 public:
 
@@ -48,6 +26,11 @@ public:
 	/// Create a transform that represents a position, scale, and rotation in 3D space 
 	/// </summary>
 	Transform();
+	~Transform();
+
+	// Transforms own a slot in the pool so they can't be copied 
+	Transform(Transform const&) = delete;
+	void operator=(Transform const&) = delete;
 
 	#pragma region SETTERS
 	/// <summary>
@@ -69,6 +52,11 @@ public:
 	/// <param name="rotation"></param>
 	void SetEulerRotation(DirectX::XMFLOAT3 rotation);
 	/// <summary>
+	/// Sets the rotation of this transform to the given quaternion 
+	/// </summary>
+	/// <param name="rotation"></param>
+	void SetRotation(DirectX::XMFLOAT4 rotation);
+	/// <summary>
 	/// Sets the scale of this transform to the given components
 	/// </summary>
 	void SetScale(float x, float y, float z);
@@ -88,13 +76,18 @@ public:
 	/// Get this transform's current x, y, and z position in 3D space
 	/// </summary>
 	/// <returns></returns>
-	std::shared_ptr<DirectX::XMFLOAT3> GetPosition();
+	DirectX::XMFLOAT3 GetPosition();
 	/// <summary>
-	/// Get this transform's current euler rotation 
+	/// Get this transform's current rotation converted to euler angles 
 	/// </summary>
 	/// <returns></returns>
 	DirectX::XMFLOAT3 GetEulerRotation();
 	/// <summary>
+	/// Get this transform's current rotation as a normalized quaternion 
+	/// </summary>
+	/// <returns></returns>
+	DirectX::XMFLOAT4 GetRotation();
+	/// <summary>
 	/// Get this transform's current x, y, and z scalar components 
 	/// </summary>
 	/// <returns></returns>
@@ -110,6 +103,18 @@ public:
 	/// <returns></returns>
 	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
 	/// <summary>
+	/// Get this transform's world matrix in the compact 3x4 form
+	/// that is sent to shaders 
+	/// </summary>
+	/// <returns></returns>
+	const AffineMatrix& GetAffineWorldMatrix();
+	/// <summary>
+	/// Get this transform's world inverse transpose in the compact 3x4
+	/// form that is sent to shaders. Only holds rotation and scale 
+	/// </summary>
+	/// <returns></returns>
+	const AffineMatrix& GetAffineWorldInverseTransposeMatrix();
+	/// <summary>
 	/// Get the vector that represents the direction right in orientation 
 	/// </summary>
 	/// <returns></returns>
@@ -148,6 +153,16 @@ public:
 	/// </summary>
 	/// <returns></returns>
 	unsigned int GetChildCount();
+	/// <summary>
+	/// Get the index of this transform's data within the transform pool 
+	/// </summary>
+	/// <returns></returns>
+	unsigned int GetHandle();
+	/// <summary>
+	/// Goes up every time this transform's world matrix changes 
+	/// </summary>
+	/// <returns></returns>
+	unsigned int GetVersion();
 	#pragma endregion
 
 	#pragma region MUTATORS
@@ -168,14 +183,31 @@ public:
 	/// </summary>
 	void MoveRelative(DirectX::XMFLOAT3 offset);
 	/// <summary>
-	/// Rotate this transform by the given euler angles
+	/// Rotate this transform by the given euler angles in local space
 	/// </summary>
 	void RotateEuler(float pitch, float yaw, float roll);
 	/// <summary>
-	/// Rotate this transform by the given euler angles
+	/// Rotate this transform by the given euler angles in local space
 	/// </summary>
 	void RotateEuler(DirectX::XMFLOAT3);
 	/// <summary>
+	/// Rotate this transform around an axis given in world space 
+	/// </summary>
+	void Rotate(DirectX::XMFLOAT3 axis, float angle);
+	/// <summary>
+	/// Rotate this transform around one of its own axes 
+	/// </summary>
+	void RotateLocal(DirectX::XMFLOAT3 axis, float angle);
+	/// <summary>
+	/// Move this transform's rotation towards the given quaternion
+	/// by an amount from 0 to 1 
+	/// </summary>
+	void Slerp(DirectX::XMFLOAT4 target, float t);
+	/// <summary>
+	/// Turn this transform so its forward faces the given point 
+	/// </summary>
+	void LookAt(DirectX::XMFLOAT3 target, DirectX::XMFLOAT3 up = DirectX::XMFLOAT3(0, 1, 0));
+	/// <summary>
 	/// Scale this transform for each axis 
 	/// </summary>
 	void Scale(float x, float y, float z);
@@ -192,7 +224,8 @@ public:
 	#pragma region HIERACHY
 
 	/// <summary>
-	/// Connect a transform to make it relative to this transform 
+	/// Connect a transform to make it relative to this transform.
+	/// Both transforms must be owned by a shared_ptr 
 	/// </summary>
 	/// <param name="child"></param>
 	void AddChild(std::shared_ptr<Transform> child);
@@ -207,7 +240,9 @@ public:
 	/// <param name="childIndex"></param>
 	void RemoveChild(int childIndex);
 	/// <summary>
-	/// Link this transform to a new parent 
+	/// Link this transform to a new parent. Its position, rotation
+	/// and scale are kept and become relative to the parent.
+	/// Pass nullptr to detach it 
 	/// </summary>
 	/// <param name="parent"></param>
 	void SetParent(std::shared_ptr<Transform> parent);
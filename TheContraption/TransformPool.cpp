@@ -0,0 +1,594 @@
+#include "TransformPool.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+using namespace DirectX;
+
+// Singleton requirement
+TransformPool* TransformPool::instance;
+
+TransformPool::TransformPool() :
+	orderIsDirty(false),
+	frame(1),
+	count(0),
+	lastUpdateTime(0.0f)
+{
+
+}
+
+#pragma region SLOTS
+
+unsigned int TransformPool::Allocate()
+{
+	// Reuse an old slot before growing
+	if (freeSlots.empty())
+		Grow();
+
+	unsigned int handle = freeSlots.back();
+	freeSlots.pop_back();
+
+	posX[handle] = 0.0f; posY[handle] = 0.0f; posZ[handle] = 0.0f;
+	rotX[handle] = 0.0f; rotY[handle] = 0.0f; rotZ[handle] = 0.0f; rotW[handle] = 1.0f;
+	scaleX[handle] = 1.0f; scaleY[handle] = 1.0f; scaleZ[handle] = 1.0f;
+
+	parent[handle] = TRANSFORM_NO_PARENT;
+	depth[handle] = 0;
+
+	alive[handle] = 1;
+	count++;
+	orderIsDirty = true;
+
+	// Make sure derived data is created at least once
+	dirty[handle] = TRANSFORM_DIRTY_MATRIX | TRANSFORM_DIRTY_VECTORS;
+	Clean(handle);
+	return handle;
+}
+
+void TransformPool::Free(unsigned int handle)
+{
+	if (handle >= alive.size() || !alive[handle])
+		return;
+
+	alive[handle] = 0;
+	dirty[handle] = 0;
+	parent[handle] = TRANSFORM_NO_PARENT;
+	freeSlots.push_back(handle);
+	count--;
+	orderIsDirty = true;
+}
+
+void TransformPool::Grow()
+{
+	// Grow by a whole batch so that the batched update never
+	// has to deal with a partial batch at the end
+	unsigned int oldSize = (unsigned int)alive.size();
+	unsigned int newSize = oldSize + TRANSFORM_BATCH_WIDTH;
+
+	posX.resize(newSize, 0.0f); posY.resize(newSize, 0.0f); posZ.resize(newSize, 0.0f);
+	rotX.resize(newSize, 0.0f); rotY.resize(newSize, 0.0f); rotZ.resize(newSize, 0.0f); rotW.resize(newSize, 1.0f);
+	scaleX.resize(newSize, 1.0f); scaleY.resize(newSize, 1.0f); scaleZ.resize(newSize, 1.0f);
+
+	AffineMatrix identity;
+	AffineStore(&identity, XMMatrixIdentity());
+	local.resize(newSize, identity);
+	world.resize(newSize, identity);
+	worldInvTranspose.resize(newSize, identity);
+	right.resize(newSize, XMFLOAT3(1, 0, 0));
+	up.resize(newSize, XMFLOAT3(0, 1, 0));
+	forward.resize(newSize, XMFLOAT3(0, 0, 1));
+
+	parent.resize(newSize, TRANSFORM_NO_PARENT);
+	depth.resize(newSize, 0);
+	worldVersion.resize(newSize, 0);
+	parentVersion.resize(newSize, 0);
+	changedFrame.resize(newSize, 0);
+
+	dirty.resize(newSize, 0);
+	alive.resize(newSize, 0);
+
+	// Push in reverse so lower slots are handed out first
+	for (unsigned int i = newSize; i > oldSize; i--)
+	{
+		freeSlots.push_back(i - 1);
+	}
+}
+
+#pragma endregion
+
+#pragma region REBUILD
+
+void TransformPool::MarkDirty(unsigned int handle, unsigned char flags)
+{
+	dirty[handle] |= flags;
+}
+
+void TransformPool::UpdateWorldMatrices()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Local pass - every transform on its own
+	unsigned int size = (unsigned int)dirty.size();
+	for (unsigned int i = 0; i < size; i += TRANSFORM_BATCH_WIDTH)
+	{
+		// Check the flags of a whole batch at once so
+		// untouched batches are skipped quickly
+		unsigned int batchFlags;
+		std::memcpy(&batchFlags, &dirty[i], sizeof(unsigned int));
+		if ((batchFlags & 0x03030303) == 0)
+			continue;
+
+		RebuildBatch(i);
+	}
+
+	// Hierarchy pass - order is sorted by depth so a parent's world
+	// matrix is always final before any of its children read it.
+	// Transforms within one level never depend on each other, so
+	// each level could be split between threads
+	if (orderIsDirty)
+		RebuildOrder();
+
+	unsigned int orderSize = (unsigned int)order.size();
+	for (unsigned int o = 0; o < orderSize; o++)
+	{
+		unsigned int i = order[o];
+		if (IsWorldStale(i))
+			CleanWorld(i);
+	}
+
+	// Everything rebuilt since the last update, including transforms
+	// cleaned early because they were read, makes up this frame's list
+	changedThisFrame.swap(changedPending);
+	changedPending.clear();
+	frame++;
+
+	auto end = std::chrono::high_resolution_clock::now();
+	lastUpdateTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void TransformPool::RebuildBatch(unsigned int first)
+{
+	// Each vector holds the same component of four
+	// different transforms (one per lane)
+	XMVECTOR qx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&rotX[first]));
+	XMVECTOR qy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&rotY[first]));
+	XMVECTOR qz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&rotZ[first]));
+	XMVECTOR qw = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&rotW[first]));
+
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR x2 = qx + qx, y2 = qy + qy, z2 = qz + qz;
+	XMVECTOR xx = qx * x2, yy = qy * y2, zz = qz * z2;
+	XMVECTOR xy = qx * y2, xz = qx * z2, yz = qy * z2;
+	XMVECTOR wx = qw * x2, wy = qw * y2, wz = qw * z2;
+
+	// Rotation matrix elements, matching XMMatrixRotationQuaternion
+	alignas(16) float r[9][TRANSFORM_BATCH_WIDTH];
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(r[0]), one - (yy + zz));
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(r[1]), xy + wz);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(r[2]), xz - wy);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(r[3]), xy - wz);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(r[4]), one - (xx + zz));
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(r[5]), yz + wx);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(r[6]), xz + wy);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(r[7]), yz - wx);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(r[8]), one - (xx + yy));
+
+	for (unsigned int lane = 0; lane < TRANSFORM_BATCH_WIDTH; lane++)
+	{
+		unsigned int i = first + lane;
+
+		if (dirty[i] & TRANSFORM_DIRTY_MATRIX)
+		{
+			// Scale * Rotation * Translation, written a column at a time
+			AffineMatrix& l = local[i];
+			l._11 = r[0][lane] * scaleX[i]; l._12 = r[3][lane] * scaleY[i]; l._13 = r[6][lane] * scaleZ[i]; l._14 = posX[i];
+			l._21 = r[1][lane] * scaleX[i]; l._22 = r[4][lane] * scaleY[i]; l._23 = r[7][lane] * scaleZ[i]; l._24 = posY[i];
+			l._31 = r[2][lane] * scaleX[i]; l._32 = r[5][lane] * scaleY[i]; l._33 = r[8][lane] * scaleZ[i]; l._34 = posZ[i];
+
+			dirty[i] |= TRANSFORM_DIRTY_WORLD;
+		}
+
+		if (dirty[i] & TRANSFORM_DIRTY_VECTORS)
+		{
+			// Rows of the rotation are the local axes
+			right[i] = XMFLOAT3(r[0][lane], r[1][lane], r[2][lane]);
+			up[i] = XMFLOAT3(r[3][lane], r[4][lane], r[5][lane]);
+			forward[i] = XMFLOAT3(r[6][lane], r[7][lane], r[8][lane]);
+		}
+
+		dirty[i] &= ~(TRANSFORM_DIRTY_MATRIX | TRANSFORM_DIRTY_VECTORS);
+	}
+}
+
+void TransformPool::Clean(unsigned int handle)
+{
+	// Gather this transform and everything above it
+	chain.clear();
+	for (int i = (int)handle; i != TRANSFORM_NO_PARENT; i = parent[i])
+	{
+		chain.push_back((unsigned int)i);
+	}
+
+	// Clean from the top of the hierarchy down
+	for (size_t c = chain.size(); c > 0; c--)
+	{
+		unsigned int i = chain[c - 1];
+
+		if (dirty[i] & (TRANSFORM_DIRTY_MATRIX | TRANSFORM_DIRTY_VECTORS))
+			CleanLocal(i);
+
+		if (IsWorldStale(i))
+			CleanWorld(i);
+	}
+}
+
+void TransformPool::CleanLocal(unsigned int handle)
+{
+	XMMATRIX rot = XMMatrixRotationQuaternion(
+		XMVectorSet(rotX[handle], rotY[handle], rotZ[handle], rotW[handle]));
+
+	XMMATRIX lm =
+		XMMatrixScaling(scaleX[handle], scaleY[handle], scaleZ[handle]) *
+		rot *
+		XMMatrixTranslation(posX[handle], posY[handle], posZ[handle]);
+
+	AffineStore(&local[handle], lm);
+
+	XMStoreFloat3(&right[handle], rot.r[0]);
+	XMStoreFloat3(&up[handle], rot.r[1]);
+	XMStoreFloat3(&forward[handle], rot.r[2]);
+
+	dirty[handle] &= ~(TRANSFORM_DIRTY_MATRIX | TRANSFORM_DIRTY_VECTORS);
+	dirty[handle] |= TRANSFORM_DIRTY_WORLD;
+}
+
+void TransformPool::CleanWorld(unsigned int handle)
+{
+	// Local matrices are always scale * rotation * translation
+	// so their inverse transpose comes straight from the axes
+	AffineMatrix localInvTranspose;
+	AffineInverseTranspose(&localInvTranspose, local[handle]);
+
+	// Children are placed relative to their parent's world. Since
+	// (A * B)^-T = A^-T * B^-T the parent's inverse transpose is
+	// reused instead of inverting the combined matrix
+	int p = parent[handle];
+	if (p != TRANSFORM_NO_PARENT)
+	{
+		AffineMultiply(&world[handle], local[handle], world[p]);
+		AffineMultiply(&worldInvTranspose[handle], localInvTranspose, worldInvTranspose[p]);
+		parentVersion[handle] = worldVersion[p];
+	}
+	else
+	{
+		world[handle] = local[handle];
+		worldInvTranspose[handle] = localInvTranspose;
+	}
+
+	worldVersion[handle]++;
+	dirty[handle] &= ~TRANSFORM_DIRTY_WORLD;
+
+	// Only list a transform once per frame
+	if (changedFrame[handle] != frame)
+	{
+		changedFrame[handle] = frame;
+		changedPending.push_back(handle);
+	}
+}
+
+bool TransformPool::IsWorldStale(unsigned int handle)
+{
+	if (dirty[handle] & TRANSFORM_DIRTY_WORLD)
+		return true;
+
+	// Parent has moved since this world was built
+	int p = parent[handle];
+	return p != TRANSFORM_NO_PARENT && parentVersion[handle] != worldVersion[p];
+}
+
+void TransformPool::RebuildOrder()
+{
+	unsigned int size = (unsigned int)alive.size();
+	unsigned int maxDepth = 0;
+
+	// Depth is how many parents are above a transform
+	for (unsigned int i = 0; i < size; i++)
+	{
+		if (!alive[i])
+			continue;
+
+		unsigned int d = 0;
+		for (int p = parent[i]; p != TRANSFORM_NO_PARENT; p = parent[p])
+		{
+			d++;
+		}
+
+		depth[i] = d;
+		maxDepth = d > maxDepth ? d : maxDepth;
+	}
+
+	// Counting sort by depth
+	levelStart.assign(maxDepth + 2, 0);
+	for (unsigned int i = 0; i < size; i++)
+	{
+		if (alive[i])
+			levelStart[depth[i] + 1]++;
+	}
+
+	for (unsigned int d = 1; d < levelStart.size(); d++)
+	{
+		levelStart[d] += levelStart[d - 1];
+	}
+
+	order.resize(count);
+	std::vector<unsigned int> next(levelStart.begin(), levelStart.end() - 1);
+	for (unsigned int i = 0; i < size; i++)
+	{
+		if (alive[i])
+			order[next[depth[i]]++] = i;
+	}
+
+	orderIsDirty = false;
+}
+
+void TransformPool::SetParent(unsigned int handle, int parentHandle)
+{
+	// Refuse links that would create a loop
+	for (int p = parentHandle; p != TRANSFORM_NO_PARENT; p = parent[p])
+	{
+		if (p == (int)handle)
+			return;
+	}
+
+	parent[handle] = parentHandle;
+	dirty[handle] |= TRANSFORM_DIRTY_WORLD;
+	orderIsDirty = true;
+}
+
+int TransformPool::GetParent(unsigned int handle)
+{
+	return parent[handle];
+}
+
+unsigned int TransformPool::GetVersion(unsigned int handle)
+{
+	// Bring the version up to date with any pending changes
+	if (parent[handle] != TRANSFORM_NO_PARENT || dirty[handle])
+		Clean(handle);
+
+	return worldVersion[handle];
+}
+
+const std::vector<unsigned int>& TransformPool::GetChangedThisFrame()
+{
+	return changedThisFrame;
+}
+
+unsigned int TransformPool::GetFrame()
+{
+	return frame;
+}
+
+bool TransformPool::IsAlive(unsigned int handle)
+{
+	return handle < alive.size() && alive[handle];
+}
+
+#pragma endregion
+
+#pragma region ACCESSORS
+
+DirectX::XMFLOAT3 TransformPool::GetPosition(unsigned int handle)
+{
+	return XMFLOAT3(posX[handle], posY[handle], posZ[handle]);
+}
+
+DirectX::XMFLOAT4 TransformPool::GetRotation(unsigned int handle)
+{
+	return XMFLOAT4(rotX[handle], rotY[handle], rotZ[handle], rotW[handle]);
+}
+
+DirectX::XMFLOAT3 TransformPool::GetScale(unsigned int handle)
+{
+	return XMFLOAT3(scaleX[handle], scaleY[handle], scaleZ[handle]);
+}
+
+void TransformPool::SetPosition(unsigned int handle, DirectX::XMFLOAT3 position)
+{
+	posX[handle] = position.x;
+	posY[handle] = position.y;
+	posZ[handle] = position.z;
+
+	dirty[handle] |= TRANSFORM_DIRTY_MATRIX;
+}
+
+void TransformPool::SetRotation(unsigned int handle, DirectX::XMFLOAT4 rotation)
+{
+	// Keep the stored quaternion unit length so the matrix
+	// build never has to normalize
+	XMFLOAT4 q;
+	XMStoreFloat4(&q, XMQuaternionNormalize(XMLoadFloat4(&rotation)));
+
+	rotX[handle] = q.x;
+	rotY[handle] = q.y;
+	rotZ[handle] = q.z;
+	rotW[handle] = q.w;
+
+	dirty[handle] |= TRANSFORM_DIRTY_MATRIX | TRANSFORM_DIRTY_VECTORS;
+}
+
+void TransformPool::SetScale(unsigned int handle, DirectX::XMFLOAT3 scale)
+{
+	scaleX[handle] = scale.x;
+	scaleY[handle] = scale.y;
+	scaleZ[handle] = scale.z;
+
+	dirty[handle] |= TRANSFORM_DIRTY_MATRIX;
+}
+
+const AffineMatrix& TransformPool::GetWorldMatrix(unsigned int handle)
+{
+	if (parent[handle] != TRANSFORM_NO_PARENT || dirty[handle])
+		Clean(handle);
+
+	return world[handle];
+}
+
+const AffineMatrix& TransformPool::GetWorldInverseTransposeMatrix(unsigned int handle)
+{
+	if (parent[handle] != TRANSFORM_NO_PARENT || dirty[handle])
+		Clean(handle);
+
+	return worldInvTranspose[handle];
+}
+
+DirectX::XMFLOAT3 TransformPool::GetRight(unsigned int handle)
+{
+	if (dirty[handle] & TRANSFORM_DIRTY_VECTORS)
+		CleanLocal(handle);
+
+	return right[handle];
+}
+
+DirectX::XMFLOAT3 TransformPool::GetUp(unsigned int handle)
+{
+	if (dirty[handle] & TRANSFORM_DIRTY_VECTORS)
+		CleanLocal(handle);
+
+	return up[handle];
+}
+
+DirectX::XMFLOAT3 TransformPool::GetForward(unsigned int handle)
+{
+	if (dirty[handle] & TRANSFORM_DIRTY_VECTORS)
+		CleanLocal(handle);
+
+	return forward[handle];
+}
+
+unsigned int TransformPool::GetCount()
+{
+	return count;
+}
+
+float TransformPool::GetLastUpdateTime()
+{
+	return lastUpdateTime;
+}
+
+#pragma endregion
+
+#pragma region BENCHMARK
+
+/// <summary>
+/// A transform kept the way Transform used to, on its own with full
+/// matrices that are rebuilt with a general inverse when read
+/// </summary>
+struct PerObjectTransform
+{
+	XMFLOAT3 position;
+	XMFLOAT4 rotation;
+	XMFLOAT3 scale;
+	XMFLOAT4X4 world;
+	XMFLOAT4X4 worldInvTranspose;
+	bool matIsDirty;
+
+	const XMFLOAT4X4& GetWorldMatrix()
+	{
+		if (matIsDirty)
+		{
+			XMMATRIX wm =
+				XMMatrixScaling(scale.x, scale.y, scale.z) *
+				XMMatrixRotationQuaternion(XMLoadFloat4(&rotation)) *
+				XMMatrixTranslation(position.x, position.y, position.z);
+
+			XMStoreFloat4x4(&world, wm);
+			XMStoreFloat4x4(&worldInvTranspose, XMMatrixInverse(nullptr, XMMatrixTranspose(wm)));
+			matIsDirty = false;
+		}
+		return world;
+	}
+
+	const XMFLOAT4X4& GetWorldInverseTransposeMatrix()
+	{
+		GetWorldMatrix();
+		return worldInvTranspose;
+	}
+};
+
+TransformBenchmarkResult TransformPool::RunBenchmark(unsigned int count, unsigned int rounds)
+{
+	TransformBenchmarkResult result = {};
+	result.count = count;
+	if (count == 0 || rounds == 0)
+		return result;
+
+	// Same transforms on both sides, every object allocated
+	// separately like entities used to own them
+	TransformPool pool;
+	std::vector<unsigned int> handles(count);
+	std::vector<std::unique_ptr<PerObjectTransform>> objects(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT4 rotation;
+		XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(i * 0.1f, i * 0.2f, i * 0.3f));
+		XMFLOAT3 scale(1.0f + (i % 3) * 0.5f, 1.0f, 1.0f + (i % 5) * 0.25f);
+
+		handles[i] = pool.Allocate();
+		pool.SetRotation(handles[i], rotation);
+		pool.SetScale(handles[i], scale);
+
+		objects[i].reset(new PerObjectTransform());
+		objects[i]->rotation = pool.GetRotation(handles[i]);
+		objects[i]->scale = scale;
+	}
+
+	float perObject = 0.0f;
+	float batched = 0.0f;
+	for (unsigned int round = 0; round < rounds; round++)
+	{
+		// Move everything so both sides have every matrix to rebuild
+		for (unsigned int i = 0; i < count; i++)
+		{
+			XMFLOAT3 position((float)(i % 100), (float)round, (float)(i / 100));
+			pool.SetPosition(handles[i], position);
+			objects[i]->position = position;
+			objects[i]->matIsDirty = true;
+		}
+
+		// Drawing read both matrices of every entity
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			objects[i]->GetWorldMatrix();
+			objects[i]->GetWorldInverseTransposeMatrix();
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		perObject += std::chrono::duration<float, std::milli>(end - start).count();
+
+		start = std::chrono::high_resolution_clock::now();
+		pool.UpdateWorldMatrices();
+		end = std::chrono::high_resolution_clock::now();
+		batched += std::chrono::duration<float, std::milli>(end - start).count();
+	}
+	result.perObjectMilliseconds = perObject / rounds;
+	result.batchedMilliseconds = batched / rounds;
+
+	// Both ways have to end up with the same matrices
+	XMVECTOR worst = XMVectorZero();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMMATRIX a = AffineLoad(pool.world[handles[i]]);
+		XMMATRIX b = XMLoadFloat4x4(&objects[i]->world);
+		for (unsigned int r = 0; r < 4; r++)
+		{
+			worst = XMVectorMax(worst, XMVectorAbs(a.r[r] - b.r[r]));
+		}
+	}
+	XMFLOAT4 difference;
+	XMStoreFloat4(&difference, worst);
+	result.maxDifference = fmaxf(fmaxf(difference.x, difference.y), fmaxf(difference.z, difference.w));
+	return result;
+}
+
+#pragma endregion
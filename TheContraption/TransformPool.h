@@ -0,0 +1,210 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+
+#include "AffineMatrix.h"
+
+/*
+	Holds the data of every transform in the engine within
+	contiguous arrays (structure of arrays) so that world
+	matrices can be rebuilt together in one linear pass
+	each frame instead of object by object
+*/
+
+// How many transforms are rebuilt together in one SIMD batch
+#define TRANSFORM_BATCH_WIDTH 4
+
+// Dirty flags for the data derived from a transform
+#define TRANSFORM_DIRTY_MATRIX 0x01
+#define TRANSFORM_DIRTY_VECTORS 0x02
+#define TRANSFORM_DIRTY_WORLD 0x04
+
+// Parent index of a transform that is not in a hierarchy
+#define TRANSFORM_NO_PARENT -1
+
+/// <summary>
+/// How long rebuilding the same transforms took object by object and batched
+/// </summary>
+struct TransformBenchmarkResult
+{
+	unsigned int count;
+	float perObjectMilliseconds;	// Each transform cleaned on its own with a general inverse, like Transform used to
+	float batchedMilliseconds;		// UpdateWorldMatrices
+	float maxDifference;			// Largest difference between the world matrices of both ways
+};
+
+class TransformPool
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static TransformPool& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new TransformPool();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	TransformPool(TransformPool const&) = delete;
+	void operator=(TransformPool const&) = delete;
+
+private:
+	static TransformPool* instance;
+	TransformPool();
+#pragma endregion
+
+public:
+	/// <summary>
+	/// Reserve a slot for a new transform and get its handle
+	/// </summary>
+	unsigned int Allocate();
+	/// <summary>
+	/// Release the slot of a transform so it can be reused
+	/// </summary>
+	void Free(unsigned int handle);
+
+	/// <summary>
+	/// Rebuild the matrices and direction vectors of every
+	/// dirty transform in one batched pass, then push world
+	/// matrices down the hierarchy parents before children
+	/// </summary>
+	void UpdateWorldMatrices();
+	/// <summary>
+	/// Rebuild the derived data of a single transform and any
+	/// out of date parents above it. Used when a transform is
+	/// read before the next batched update
+	/// </summary>
+	void Clean(unsigned int handle);
+	/// <summary>
+	/// Flag the derived data of a transform as out of date
+	/// </summary>
+	void MarkDirty(unsigned int handle, unsigned char flags);
+
+	/// <summary>
+	/// Make a transform relative to another one. Pass
+	/// TRANSFORM_NO_PARENT to detach it from its parent
+	/// </summary>
+	void SetParent(unsigned int handle, int parentHandle);
+	int GetParent(unsigned int handle);
+
+	/// <summary>
+	/// Counter that goes up every time the world matrix of a
+	/// transform is rebuilt. Consumers can store it and compare
+	/// later to know if they need to refresh their copy
+	/// </summary>
+	unsigned int GetVersion(unsigned int handle);
+	/// <summary>
+	/// Handles of every transform whose world matrix was rebuilt
+	/// during the last frame. Valid until the next batched update.
+	/// A handle may have been freed since, check IsAlive
+	/// </summary>
+	const std::vector<unsigned int>& GetChangedThisFrame();
+	/// <summary>
+	/// Goes up by one every time the changed list is rebuilt, so a
+	/// consumer can tell whether it missed a frame's list
+	/// </summary>
+	unsigned int GetFrame();
+	bool IsAlive(unsigned int handle);
+
+	#pragma region ACCESSORS
+	DirectX::XMFLOAT3 GetPosition(unsigned int handle);
+	DirectX::XMFLOAT4 GetRotation(unsigned int handle);
+	DirectX::XMFLOAT3 GetScale(unsigned int handle);
+	void SetPosition(unsigned int handle, DirectX::XMFLOAT3 position);
+	void SetRotation(unsigned int handle, DirectX::XMFLOAT4 rotation);
+	void SetScale(unsigned int handle, DirectX::XMFLOAT3 scale);
+
+	const AffineMatrix& GetWorldMatrix(unsigned int handle);
+	const AffineMatrix& GetWorldInverseTransposeMatrix(unsigned int handle);
+	DirectX::XMFLOAT3 GetRight(unsigned int handle);
+	DirectX::XMFLOAT3 GetUp(unsigned int handle);
+	DirectX::XMFLOAT3 GetForward(unsigned int handle);
+	#pragma endregion
+
+	/// <summary>
+	/// Amount of transforms currently alive in the pool
+	/// </summary>
+	unsigned int GetCount();
+	/// <summary>
+	/// How long the last batched update took in milliseconds
+	/// </summary>
+	float GetLastUpdateTime();
+
+	/// <summary>
+	/// Rebuild every matrix of freshly moved transforms both object by
+	/// object and batched. Runs on a pool of its own, the engine's
+	/// transforms are left alone
+	/// </summary>
+	/// <param name="count">How many transforms to rebuild</param>
+	/// <param name="rounds">Rebuilds to average the times over</param>
+	static TransformBenchmarkResult RunBenchmark(unsigned int count, unsigned int rounds);
+
+private:
+	/// <summary>
+	/// Rebuild a whole batch of transforms starting at the given index
+	/// </summary>
+	void RebuildBatch(unsigned int first);
+	/// <summary>
+	/// Grow every array by one batch worth of slots
+	/// </summary>
+	void Grow();
+	/// <summary>
+	/// Rebuild the local matrix and vectors of a single transform
+	/// </summary>
+	void CleanLocal(unsigned int handle);
+	/// <summary>
+	/// Combine a transform's local matrix with its parent's world
+	/// </summary>
+	void CleanWorld(unsigned int handle);
+	/// <summary>
+	/// Whether a transform's world matrix is behind its local
+	/// matrix or its parent's world matrix
+	/// </summary>
+	bool IsWorldStale(unsigned int handle);
+	/// <summary>
+	/// Sort every alive transform by depth so parents always
+	/// come before their children
+	/// </summary>
+	void RebuildOrder();
+
+	// Local data
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> rotX, rotY, rotZ, rotW; // Normalized quaternion
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	// Derived data
+	std::vector<AffineMatrix> local;
+	std::vector<AffineMatrix> world;
+	std::vector<AffineMatrix> worldInvTranspose;
+	std::vector<DirectX::XMFLOAT3> right;
+	std::vector<DirectX::XMFLOAT3> up;
+	std::vector<DirectX::XMFLOAT3> forward;
+
+	// Hierarchy
+	std::vector<int> parent;
+	std::vector<unsigned int> depth;
+	std::vector<unsigned int> worldVersion;	// Bumped each time the world matrix is rebuilt
+	std::vector<unsigned int> parentVersion;	// Parent's version used for the current world matrix
+	std::vector<unsigned int> order;			// Alive transforms sorted by depth
+	std::vector<unsigned int> levelStart;		// Where each depth begins inside of order
+	std::vector<unsigned int> chain;			// Scratch space for cleaning a single transform
+	bool orderIsDirty;
+
+	// Change tracking
+	std::vector<unsigned int> changedFrame;		// Last frame each transform was added to the changed list
+	std::vector<unsigned int> changedPending;	// Rebuilt since the last batched update
+	std::vector<unsigned int> changedThisFrame;	// Rebuilt during the last frame
+	unsigned int frame;
+
+	// Book keeping
+	std::vector<unsigned char> dirty;
+	std::vector<unsigned char> alive;
+	std::vector<unsigned int> freeSlots;
+	unsigned int count;
+
+	float lastUpdateTime;
+};
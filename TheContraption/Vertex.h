@@ -1,6 +1,7 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
 
 // --------------------------------------------------------
 // A custom vertex definition
@@ -11,6 +12,29 @@ struct Vertex
 {
 	DirectX::XMFLOAT3 Position;	    // The local position of the vertex
 	DirectX::XMFLOAT3 Normal;
-	DirectX::XMFLOAT3 Tangent;
+	DirectX::XMFLOAT4 Tangent;	// w is the bitangent handedness, 1 or -1
 	DirectX::XMFLOAT2 UV;	    
-};
\ No newline at end of file
+};
+
+// --------------------------------------------------------
+// A compact version of Vertex for meshes that can afford
+// to lose a little precision (20 bytes instead of 48)
+// --------------------------------------------------------
+struct QuantizedVertex
+{
+	DirectX::PackedVector::XMUSHORTN4 Position;	// 0-1 across the mesh bounds, w is the tangent handedness (0 or 1)
+	DirectX::PackedVector::XMSHORTN2 Normal;	// Octahedral
+	DirectX::PackedVector::XMSHORTN2 Tangent;	// Octahedral
+	DirectX::PackedVector::XMHALF2 UV;
+};
+
+// --------------------------------------------------------
+// Which joints move a vertex of a skinned mesh and by how
+// much. Kept in its own array alongside the mesh's Vertex
+// array, so meshes that aren't skinned don't pay for it
+// --------------------------------------------------------
+struct VertexSkin
+{
+	unsigned short Joints[4];
+	DirectX::XMFLOAT4 Weights;	// Sum to 1, unused influences have a weight of 0
+};
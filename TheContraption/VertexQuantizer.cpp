@@ -0,0 +1,117 @@
+#include "VertexQuantizer.h"
+#include <algorithm>
+#include <cfloat>
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+void VertexQuantizer::Quantize(const Vertex* vertices, unsigned int count, QuantizedMeshData& out)
+{
+	XMVECTOR minBounds = XMVectorReplicate(count == 0 ? 0.0f : FLT_MAX);
+	XMVECTOR maxBounds = XMVectorReplicate(count == 0 ? 0.0f : -FLT_MAX);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&vertices[i].Position);
+		minBounds = XMVectorMin(minBounds, p);
+		maxBounds = XMVectorMax(maxBounds, p);
+	}
+
+	XMStoreFloat3(&out.positionOffset, minBounds);
+	XMStoreFloat3(&out.positionScale, maxBounds - minBounds);
+
+	out.vertices.resize(count);
+	Encode(vertices, count, out.positionOffset, out.positionScale, out.vertices.data());
+}
+
+QuantizationError VertexQuantizer::MeasureError(const Vertex* original, const QuantizedMeshData& quantized)
+{
+	QuantizationError error = {};
+	unsigned int count = (unsigned int)quantized.vertices.size();
+
+	std::vector<Vertex> decoded(count);
+	Decode(quantized.vertices.data(), count, quantized.positionOffset, quantized.positionScale, decoded.data());
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const Vertex& a = original[i];
+		const Vertex& b = decoded[i];
+
+		XMVECTOR position = XMVector3Length(XMLoadFloat3(&a.Position) - XMLoadFloat3(&b.Position));
+		XMVECTOR normal = XMVector3AngleBetweenNormals(XMVector3Normalize(XMLoadFloat3(&a.Normal)), XMLoadFloat3(&b.Normal));
+		XMVECTOR tangent = XMVector3AngleBetweenNormals(XMVector3Normalize(XMLoadFloat4(&a.Tangent)), XMLoadFloat4(&b.Tangent));
+		XMVECTOR uv = XMVectorAbs(XMLoadFloat2(&a.UV) - XMLoadFloat2(&b.UV));
+
+		error.position = std::max(error.position, XMVectorGetX(position));
+		error.normal = std::max(error.normal, XMConvertToDegrees(XMVectorGetX(normal)));
+		error.tangent = std::max(error.tangent, XMConvertToDegrees(XMVectorGetX(tangent)));
+		error.uv = std::max(error.uv, std::max(XMVectorGetX(uv), XMVectorGetY(uv)));
+	}
+
+	return error;
+}
+
+void VertexQuantizer::Encode(const Vertex* in, unsigned int count, XMFLOAT3 positionOffset, XMFLOAT3 positionScale, QuantizedVertex* out)
+{
+	// Flat axes have nothing to scale so they all land on 0
+	XMVECTOR offset = XMLoadFloat3(&positionOffset);
+	XMVECTOR scale = XMLoadFloat3(&positionScale);
+	XMVECTOR invScale = XMVectorSelect(XMVectorReciprocal(scale), XMVectorZero(), XMVectorLessOrEqual(scale, XMVectorZero()));
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		// The spare w of the position holds the tangent handedness
+		XMVECTOR tangent = XMLoadFloat4(&in[i].Tangent);
+		XMVECTOR position = (XMLoadFloat3(&in[i].Position) - offset) * invScale;
+		position = XMVectorSetW(position, XMVectorGetW(tangent) < 0.0f ? 0.0f : 1.0f);
+
+		XMStoreUShortN4(&out[i].Position, position);
+		XMStoreShortN2(&out[i].Normal, OctEncode(XMLoadFloat3(&in[i].Normal)));
+		XMStoreShortN2(&out[i].Tangent, OctEncode(tangent));
+		XMStoreHalf2(&out[i].UV, XMLoadFloat2(&in[i].UV));
+	}
+}
+
+void VertexQuantizer::Decode(const QuantizedVertex* in, unsigned int count, XMFLOAT3 positionOffset, XMFLOAT3 positionScale, Vertex* out)
+{
+	XMVECTOR offset = XMLoadFloat3(&positionOffset);
+	XMVECTOR scale = XMLoadFloat3(&positionScale);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMVECTOR packed = XMLoadUShortN4(&in[i].Position);
+		XMVECTOR position = XMVectorMultiplyAdd(packed, scale, offset);
+		XMVECTOR tangent = XMVectorSetW(OctDecode(XMLoadShortN2(&in[i].Tangent)), XMVectorGetW(packed) > 0.5f ? 1.0f : -1.0f);
+		XMStoreFloat3(&out[i].Position, position);
+		XMStoreFloat3(&out[i].Normal, OctDecode(XMLoadShortN2(&in[i].Normal)));
+		XMStoreFloat4(&out[i].Tangent, tangent);
+		XMStoreFloat2(&out[i].UV, XMLoadHalf2(&in[i].UV));
+	}
+}
+
+XMVECTOR VertexQuantizer::OctEncode(FXMVECTOR n)
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1
+	XMVECTOR absolute = XMVectorAbs(n);
+	XMVECTOR length = XMVector3Dot(absolute, XMVectorSplatOne());
+	if (XMVectorGetX(length) <= 0.0f)
+		return XMVectorZero();
+	XMVECTOR p = n / length;
+
+	// The lower half folds over the diagonals onto the corners
+	XMVECTOR sign = XMVectorSelect(XMVectorReplicate(-1.0f), XMVectorSplatOne(), XMVectorGreaterOrEqual(p, XMVectorZero()));
+	XMVECTOR folded = (XMVectorSplatOne() - XMVectorAbs(XMVectorSwizzle<1, 0, 2, 3>(p))) * sign;
+	return XMVectorSelect(p, folded, XMVectorLess(XMVectorSplatZ(p), XMVectorZero()));
+}
+
+XMVECTOR VertexQuantizer::OctDecode(FXMVECTOR e)
+{
+	// Matches OctDecode in ShaderInclude.hlsli
+	XMVECTOR absolute = XMVectorAbs(e);
+	float z = 1.0f - XMVectorGetX(absolute) - XMVectorGetY(absolute);
+	XMVECTOR n = XMVectorSetZ(e, z);
+
+	XMVECTOR t = XMVectorReplicate(std::max(-z, 0.0f));
+	XMVECTOR unfold = XMVectorSelect(t, -t, XMVectorGreaterOrEqual(n, XMVectorZero()));
+	n += XMVectorSelect(unfold, XMVectorZero(), XMVectorSelectControl(0, 0, 1, 1));
+
+	return XMVector3Normalize(n);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+
+#include "Vertex.h"
+
+/*
+	Packs full float vertices into QuantizedVertex and back.
+	Positions are stored relative to the mesh bounds, normals
+	and tangents are folded onto an octahedron and uvs become
+	half floats
+*/
+
+// How far a quantized vertex ended up from the original
+struct QuantizationError
+{
+	float position;	// Largest distance in mesh units
+	float normal;	// Largest angle in degrees
+	float tangent;	// Largest angle in degrees
+	float uv;		// Largest difference of either component
+};
+
+struct QuantizedMeshData
+{
+	std::vector<QuantizedVertex> vertices;
+
+	// Turns the 0-1 positions back into mesh space
+	DirectX::XMFLOAT3 positionOffset;	// Bounds min
+	DirectX::XMFLOAT3 positionScale;	// Bounds size
+};
+
+class VertexQuantizer
+{
+public:
+	/// <summary>
+	/// Fit the positions to the bounds of the vertices and pack them
+	/// </summary>
+	static void Quantize(const Vertex* vertices, unsigned int count, QuantizedMeshData& out);
+	/// <summary>
+	/// Decode every vertex again and compare it to the original
+	/// </summary>
+	static QuantizationError MeasureError(const Vertex* original, const QuantizedMeshData& quantized);
+
+	/// <summary>
+	/// Pack vertices with positions already known to be inside of the bounds
+	/// </summary>
+	static void Encode(const Vertex* in, unsigned int count, DirectX::XMFLOAT3 positionOffset, DirectX::XMFLOAT3 positionScale, QuantizedVertex* out);
+	/// <summary>
+	/// Unpack vertices the same way the quantized vertex shader does
+	/// </summary>
+	static void Decode(const QuantizedVertex* in, unsigned int count, DirectX::XMFLOAT3 positionOffset, DirectX::XMFLOAT3 positionScale, Vertex* out);
+
+	/// <summary>
+	/// Map a unit vector to a point in the -1 to 1 square
+	/// </summary>
+	static DirectX::XMVECTOR OctEncode(DirectX::FXMVECTOR n);
+	/// <summary>
+	/// Map a point in the -1 to 1 square back to a unit vector
+	/// </summary>
+	static DirectX::XMVECTOR OctDecode(DirectX::FXMVECTOR e);
+};
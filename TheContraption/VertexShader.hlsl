@@ -10,12 +10,17 @@ cbuffer ExternalData : register(b0)
 	// cause there to be spacing to be added by direct without telling us 
 	// Since we need to know exactly how long items being passed are into
 	// the shader this can cause a large issue for us.
-	matrix world; // Equivelent to 4x4 
+	row_major float3x4 world; // Affine so the last row is left out 
 	matrix viewMatrix;
 	matrix projMatrix;
-	matrix worldInvTranspose;
+	row_major float3x4 worldInvTranspose;
 	matrix lightView;
 	matrix lightProjection;
+
+#ifdef QUANTIZED_VERTICES
+	float3 positionOffset; // Bounds the quantized positions are relative to
+	float3 positionScale;
+#endif
 }
 
 
@@ -26,21 +31,29 @@ cbuffer ExternalData : register(b0)
 // - Output is a single struct of data to pass down the pipeline
 // - Named "main" because that's the default the shader compiler looks for
 // --------------------------------------------------------
+#ifdef QUANTIZED_VERTICES
+VertexToPixel main( QuantizedVertexShaderInput quantized )
+{
+	VertexShaderInput input = DecodeVertex(quantized, positionOffset, positionScale);
+#else
 VertexToPixel main( VertexShaderInput input )
 {
+#endif
 	VertexToPixel output;
 	
-	// Multiply the three matrices together first
-	matrix mvp = mul(projMatrix, mul(viewMatrix, world));
-	output.screenPosition = mul(mvp, float4(input.localPosition, 1.0f));
+	// World is only 3x4 so move into world space first
+	// and then multiply the view and projection together
+	float3 worldPos = mul(world, float4(input.localPosition, 1.0f));
+	matrix vp = mul(projMatrix, viewMatrix);
+	output.screenPosition = mul(vp, float4(worldPos, 1.0f));
 
 	output.uv = input.uv;
 
 	output.normal = mul((float3x3)worldInvTranspose, input.normal); // Perfect
-	output.tangent = mul((float3x3)world, input.tangent);
-	output.worldPosition = mul(world, float4(input.localPosition, 1.0f)).xyz;
+	output.tangent = float4(mul((float3x3)world, input.tangent.xyz), input.tangent.w);
+	output.worldPosition = worldPos;
 	
-	float4 clip = mul(mvp, float4(input.localPosition, 1.0f));  // into clip space
+	float4 clip = output.screenPosition;  // into clip space
 
 
 	//xNDC *= 720;
@@ -50,8 +63,8 @@ VertexToPixel main( VertexShaderInput input )
 
 
 	// Shadows 
-	matrix shadowMvp = mul(lightProjection, mul(lightView, world));
-	output.shadowMapPos = mul(shadowMvp, float4(input.localPosition, 1.0f));
+	matrix shadowVp = mul(lightProjection, lightView);
+	output.shadowMapPos = mul(shadowVp, float4(worldPos, 1.0f));
 
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)